@@ -0,0 +1,86 @@
+call :love
+hlt
+
+; ==================================================
+; times
+;
+; params: a, b
+; vars: product, i
+; ==================================================
+times:
+enter 4
+pop [rax+2]
+pop [rax+3]
+
+push 0
+push 0
+pop rcx
+pop rbx
+
+WHILE_0:
+push rcx
+push [rax+3]
+jb :COMPARISON_0
+jmp :WHILE_END_0
+COMPARISON_0:
+
+push rbx
+push [rax+2]
+add
+push rcx
+push 1
+add
+pop rcx
+pop rbx
+jmp :WHILE_0
+
+WHILE_END_0:
+push rbx
+leave
+ret
+
+; ==================================================
+; love
+;
+; params: 
+; vars: n, sum, k
+; ==================================================
+love:
+enter 5
+
+in
+pop [rax+2]
+
+push 0
+push 0
+pop [rax+4]
+pop [rax+3]
+
+WHILE_1:
+push [rax+4]
+push [rax+2]
+jb :COMPARISON_1
+jmp :WHILE_END_1
+COMPARISON_1:
+
+push [rax+3]
+push [rax+4]
+push [rax+4]
+; calling times
+call :times
+add
+push [rax+4]
+push 1
+add
+pop [rax+4]
+pop [rax+3]
+jmp :WHILE_1
+
+WHILE_END_1:
+push [rax+3]
+out
+
+push 0
+leave
+ret
+
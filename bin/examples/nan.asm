@@ -0,0 +1,81 @@
+call :love
+hlt
+
+; ==================================================
+; love
+;
+; params: 
+; vars: 
+; ==================================================
+love:
+
+; IF statement
+push 3
+push 0
+div
+
+push 2
+div
+
+push 0
+mul
+
+push 0
+je :IF_END_0
+
+push 3
+push 2
+sub
+
+out
+jmp :IF_ELSE_END_0
+IF_END_0:
+IF_ELSE_END_0:
+
+; IF statement
+push 0
+push 3
+sub
+
+sqrt
+push 0
+mul
+
+push 0
+je :IF_END_1
+
+push 3
+push 2
+sub
+
+out
+jmp :IF_ELSE_END_1
+IF_END_1:
+IF_ELSE_END_1:
+
+; IF statement
+push 0
+push 3
+sub
+
+sqrt
+push 0
+ja :COMPARISON_0
+jmp :IF_END_2
+COMPARISON_0:
+
+push 0
+out
+jmp :IF_ELSE_END_2
+IF_END_2:
+IF_ELSE_END_2:
+
+push 0
+push rax
+push [rax]
+sub
+pop rax
+ret
+
+ret
+
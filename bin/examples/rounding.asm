@@ -0,0 +1,31 @@
+call :love
+hlt
+
+; ==================================================
+; love
+;
+; params: 
+; vars: x
+; ==================================================
+love:
+
+in
+pop [rax+2]
+
+push [rax+2]
+push 0.66666666666666663
+mul
+
+push 2000000
+sub
+
+out
+push 0
+push rax
+push [rax]
+sub
+pop rax
+ret
+
+ret
+
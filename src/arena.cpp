@@ -0,0 +1,124 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+const size_t DEFAULT_BLOCK_SIZE = 1024 * 1024;
+const size_t ARENA_ALIGNMENT    = alignof(void*);
+
+size_t      alignSize (size_t size);
+ArenaBlock* newBlock  (Arena* arena, size_t minCapacity);
+
+void construct(Arena* arena, size_t blockSize)
+{
+    assert(arena     != nullptr);
+    assert(blockSize  > 0);
+
+    arena->blocks    = nullptr;
+    arena->blockSize = blockSize;
+    arena->allocated = 0;
+}
+
+void construct(Arena* arena)
+{
+    construct(arena, DEFAULT_BLOCK_SIZE);
+}
+
+void destroy(Arena* arena)
+{
+    assert(arena != nullptr);
+
+    while (arena->blocks != nullptr)
+    {
+        ArenaBlock* prev = arena->blocks->prev;
+        free(arena->blocks);
+        arena->blocks = prev;
+    }
+
+    arena->blockSize = 0;
+    arena->allocated = 0;
+}
+
+void* allocate(Arena* arena, size_t size)
+{
+    assert(arena != nullptr);
+
+    size = alignSize(size);
+
+    ArenaBlock* block = arena->blocks;
+    if (block == nullptr || block->used + size > block->capacity)
+    {
+        block = newBlock(arena, size);
+    }
+
+    void* memory = block->data + block->used;
+    block->used      += size;
+    arena->allocated += size;
+
+    return memory;
+}
+
+void* reallocate(Arena* arena, void* memory, size_t oldSize, size_t newSize)
+{
+    assert(arena != nullptr);
+
+    if (memory == nullptr) { return allocate(arena, newSize); }
+
+    oldSize = alignSize(oldSize);
+    newSize = alignSize(newSize);
+
+    ArenaBlock* block = arena->blocks;
+    assert(block != nullptr);
+
+    // The most recent allocation can simply be extended in place
+    if ((char*) memory + oldSize == block->data + block->used &&
+        block->used - oldSize + newSize <= block->capacity)
+    {
+        block->used      += newSize - oldSize;
+        arena->allocated += newSize - oldSize;
+
+        return memory;
+    }
+
+    void* newMemory = allocate(arena, newSize);
+    memcpy(newMemory, memory, oldSize < newSize ? oldSize : newSize);
+
+    return newMemory;
+}
+
+char* copyString(Arena* arena, const char* string, size_t length)
+{
+    assert(arena  != nullptr);
+    assert(string != nullptr);
+
+    char* newString = (char*) allocate(arena, length + 1);
+
+    memcpy(newString, string, length);
+    newString[length] = '\0';
+
+    return newString;
+}
+
+size_t alignSize(size_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+ArenaBlock* newBlock(Arena* arena, size_t minCapacity)
+{
+    assert(arena != nullptr);
+
+    size_t capacity = (minCapacity > arena->blockSize) ? minCapacity : arena->blockSize;
+
+    ArenaBlock* block = (ArenaBlock*) malloc(alignSize(sizeof(ArenaBlock)) + capacity);
+    assert(block != nullptr);
+
+    block->prev     = arena->blocks;
+    block->data     = (char*) block + alignSize(sizeof(ArenaBlock));
+    block->used     = 0;
+    block->capacity = capacity;
+
+    arena->blocks = block;
+
+    return block;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdlib.h>
+
+//------------------------------------------------------------------------------
+// Bump allocator. Memory is handed out from big blocks and is only released
+// all at once by destroy, so there's no per-object free.
+//------------------------------------------------------------------------------
+struct ArenaBlock
+{
+    ArenaBlock* prev;
+    char*       data;
+    size_t      used;
+    size_t      capacity;
+};
+
+struct Arena
+{
+    ArenaBlock* blocks;
+    size_t      blockSize;
+    size_t      allocated; // total bytes handed out
+};
+
+void  construct  (Arena* arena, size_t blockSize);
+void  construct  (Arena* arena);
+void  destroy    (Arena* arena);
+
+void* allocate   (Arena* arena, size_t size);
+void* reallocate (Arena* arena, void* memory, size_t oldSize, size_t newSize);
+char* copyString (Arena* arena, const char* string, size_t length);
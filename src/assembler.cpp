@@ -0,0 +1,454 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assembler.h"
+#include "interner.h"
+
+#define ASSERT_ASSEMBLER(assembler) assert((assembler)               != nullptr); \
+                                    assert((assembler)->bytecode     != nullptr); \
+                                    assert((assembler)->labelSymbols != nullptr); \
+                                    assert((assembler)->fixups       != nullptr);
+
+const double   REALLOC_MULTIPLIER      = 2;
+const size_t   DEFAULT_LABELS_CAPACITY = 256;
+const size_t   DEFAULT_FIXUPS_CAPACITY = 256;
+const size_t   MAX_OPERAND_LENGTH      = 64;
+const uint32_t NO_CODE_SYMBOL          = UINT32_MAX;
+const uint32_t NO_OFFSET               = UINT32_MAX;
+
+enum OperandKind
+{
+    NO_OPERAND,
+    SOURCE_OPERAND,      // number, register or memory
+    DESTINATION_OPERAND, // register or memory
+    LABEL_OPERAND,
+    SIZE_OPERAND         // non-negative integer
+};
+
+struct Mnemonic
+{
+    const char* name;
+    Opcode      opcode; // for push and pop it's the memory form
+    OperandKind operand;
+};
+
+static const Mnemonic MNEMONICS[] = {
+    { "push",   OP_PUSH_MEM, SOURCE_OPERAND      },
+    { "pop",    OP_POP_MEM,  DESTINATION_OPERAND },
+    { "add",    OP_ADD,      NO_OPERAND          },
+    { "sub",    OP_SUB,      NO_OPERAND          },
+    { "mul",    OP_MUL,      NO_OPERAND          },
+    { "div",    OP_DIV,      NO_OPERAND          },
+    { "jmp",    OP_JMP,      LABEL_OPERAND       },
+    { "je",     OP_JE,       LABEL_OPERAND       },
+    { "jne",    OP_JNE,      LABEL_OPERAND       },
+    { "ja",     OP_JA,       LABEL_OPERAND       },
+    { "jb",     OP_JB,       LABEL_OPERAND       },
+    { "jae",    OP_JAE,      LABEL_OPERAND       },
+    { "jbe",    OP_JBE,      LABEL_OPERAND       },
+    { "call",   OP_CALL,     LABEL_OPERAND       },
+    { "ret",    OP_RET,      NO_OPERAND          },
+    { "in",     OP_IN,       NO_OPERAND          },
+    { "out",    OP_OUT,      NO_OPERAND          },
+    { "flr",    OP_FLR,      NO_OPERAND          },
+    { "sqrt",   OP_SQRT,     NO_OPERAND          },
+    { "rndjmp", OP_RNDJMP,   NO_OPERAND          },
+    { "enter",  OP_ENTER,    SIZE_OPERAND        },
+    { "leave",  OP_LEAVE,    NO_OPERAND          },
+    { "hlt",    OP_HLT,      NO_OPERAND          }
+};
+
+static const size_t MNEMONICS_COUNT = sizeof(MNEMONICS) / sizeof(MNEMONICS[0]);
+
+struct Fixup
+{
+    uint32_t position; // of the 4 byte target operand
+    SymbolId label;
+    Opcode   opcode;
+    size_t   line;
+};
+
+struct Assembler
+{
+    Bytecode*       bytecode;
+
+    uint32_t*       labelSymbols; // code symbol of every label, indexed by its interned id
+    size_t          labelSymbolsCapacity;
+
+    Fixup*          fixups;
+    size_t          fixupsCount;
+    size_t          fixupsCapacity;
+
+    size_t          line;
+    AssemblerError  status;
+};
+
+void            assembleLine      (Assembler* assembler, const char* line, const char* end);
+void            defineLabel       (Assembler* assembler, const char* name, size_t length);
+void            writeStackOperand (Assembler* assembler, const Mnemonic* mnemonic, const char* operand, size_t length);
+void            writeLabelTarget  (Assembler* assembler, Opcode opcode, const char* operand, size_t length);
+void            writeSize         (Assembler* assembler, const char* operand, size_t length);
+void            resolveFixups     (Assembler* assembler);
+
+const Mnemonic* findMnemonic      (const char* name, size_t length);
+Register        findRegister      (const char* name, size_t length);
+bool            parseMemory       (const char* operand, size_t length, Register* reg, int32_t* offset);
+bool            parseNumber       (const char* operand, size_t length, double* number);
+const char*     skipSpaces        (const char* position, const char* end);
+const char*     skipWord          (const char* position, const char* end);
+void            reserveLabel      (Assembler* assembler, SymbolId label);
+
+const char* errorString(AssemblerError error)
+{
+    if (error < ASSEMBLER_ERRORS_COUNT)
+    {
+        return ASSEMBLER_ERROR_STRINGS[error];
+    }
+
+    return "UNDEFINED error";
+}
+
+AssemblerError assemble(Bytecode* bytecode, const char* text, size_t length, size_t* errorLine)
+{
+    assert(bytecode != nullptr);
+    assert(text     != nullptr);
+
+    Assembler assembler            = {};
+    assembler.bytecode             = bytecode;
+    assembler.labelSymbols         = (uint32_t*) malloc(DEFAULT_LABELS_CAPACITY * sizeof(uint32_t));
+    assembler.labelSymbolsCapacity = DEFAULT_LABELS_CAPACITY;
+    assembler.fixups               = (Fixup*)    malloc(DEFAULT_FIXUPS_CAPACITY * sizeof(Fixup));
+    assembler.fixupsCapacity       = DEFAULT_FIXUPS_CAPACITY;
+
+    assert(assembler.labelSymbols != nullptr);
+    assert(assembler.fixups       != nullptr);
+
+    memset(assembler.labelSymbols, 0xFF, DEFAULT_LABELS_CAPACITY * sizeof(uint32_t));
+
+    const char* end  = text + length;
+    const char* line = text;
+
+    while (line < end && assembler.status == ASSEMBLER_NO_ERROR)
+    {
+        const char* lineEnd = (const char*) memchr(line, '\n', end - line);
+        if (lineEnd == nullptr) { lineEnd = end; }
+
+        assembler.line++;
+        assembleLine(&assembler, line, lineEnd);
+
+        line = lineEnd + 1;
+    }
+
+    if (assembler.status == ASSEMBLER_NO_ERROR)
+    {
+        resolveFixups(&assembler);
+    }
+
+    if (errorLine != nullptr) { *errorLine = assembler.line; }
+
+    free(assembler.labelSymbols);
+    free(assembler.fixups);
+
+    return assembler.status;
+}
+
+void assembleLine(Assembler* assembler, const char* line, const char* end)
+{
+    ASSERT_ASSEMBLER(assembler);
+
+    const char* comment = (const char*) memchr(line, ';', end - line);
+    if (comment != nullptr) { end = comment; }
+
+    const char* word    = skipSpaces(line, end);
+    const char* wordEnd = skipWord(word, end);
+    if (word == wordEnd) { return; }
+
+    if (wordEnd[-1] == ':')
+    {
+        defineLabel(assembler, word, wordEnd - word - 1);
+        if (skipSpaces(wordEnd, end) != end) { assembler->status = ASSEMBLER_ERROR_INVALID_OPERAND; }
+        return;
+    }
+
+    const Mnemonic* mnemonic = findMnemonic(word, wordEnd - word);
+    if (mnemonic == nullptr)
+    {
+        assembler->status = ASSEMBLER_ERROR_UNKNOWN_INSTRUCTION;
+        return;
+    }
+
+    const char* operand    = skipSpaces(wordEnd, end);
+    const char* operandEnd = skipWord(operand, end);
+    size_t      length     = operandEnd - operand;
+
+    if (skipSpaces(operandEnd, end) != end || (mnemonic->operand == NO_OPERAND) != (length == 0))
+    {
+        assembler->status = ASSEMBLER_ERROR_INVALID_OPERAND;
+        return;
+    }
+
+    if (mnemonic->operand == SOURCE_OPERAND || mnemonic->operand == DESTINATION_OPERAND)
+    {
+        writeStackOperand(assembler, mnemonic, operand, length);
+        return;
+    }
+
+    appendOpcode(assembler->bytecode, mnemonic->opcode);
+
+    if (mnemonic->operand == LABEL_OPERAND)
+    {
+        writeLabelTarget(assembler, mnemonic->opcode, operand, length);
+    }
+
+    if (mnemonic->operand == SIZE_OPERAND)
+    {
+        writeSize(assembler, operand, length);
+    }
+}
+
+void defineLabel(Assembler* assembler, const char* name, size_t length)
+{
+    ASSERT_ASSEMBLER(assembler);
+    assert(name != nullptr);
+
+    SymbolId label = intern(name, length);
+    reserveLabel(assembler, label);
+
+    if (assembler->labelSymbols[label] != NO_CODE_SYMBOL)
+    {
+        assembler->status = ASSEMBLER_ERROR_DUPLICATE_LABEL;
+        return;
+    }
+
+    // Whether it's a function becomes known only when something calls it
+    assembler->labelSymbols[label] = (uint32_t) addSymbol(assembler->bytecode, (uint32_t) assembler->bytecode->size,
+                                                          name, length, CODE_LABEL);
+}
+
+//------------------------------------------------------------------------------
+// push accepts [reg+N], [reg], [N], a register or a number, pop accepts all
+// of them except the number.
+//------------------------------------------------------------------------------
+void writeStackOperand(Assembler* assembler, const Mnemonic* mnemonic, const char* operand, size_t length)
+{
+    ASSERT_ASSEMBLER(assembler);
+    assert(mnemonic != nullptr);
+    assert(operand  != nullptr);
+
+    bool     isPush = mnemonic->opcode == OP_PUSH_MEM;
+    Register reg    = NO_REGISTER;
+    int32_t  offset = 0;
+    double   number = 0;
+
+    if (parseMemory(operand, length, &reg, &offset))
+    {
+        appendOpcode   (assembler->bytecode, isPush ? OP_PUSH_MEM : OP_POP_MEM);
+        appendRegister (assembler->bytecode, reg);
+        appendInt32    (assembler->bytecode, offset);
+        return;
+    }
+
+    reg = findRegister(operand, length);
+    if (reg != NO_REGISTER)
+    {
+        appendOpcode   (assembler->bytecode, isPush ? OP_PUSH_REG : OP_POP_REG);
+        appendRegister (assembler->bytecode, reg);
+        return;
+    }
+
+    if (isPush && parseNumber(operand, length, &number))
+    {
+        appendOpcode (assembler->bytecode, OP_PUSH_NUMBER);
+        appendDouble (assembler->bytecode, number);
+        return;
+    }
+
+    assembler->status = ASSEMBLER_ERROR_INVALID_OPERAND;
+}
+
+void writeLabelTarget(Assembler* assembler, Opcode opcode, const char* operand, size_t length)
+{
+    ASSERT_ASSEMBLER(assembler);
+    assert(operand != nullptr);
+
+    if (length < 2 || operand[0] != ':')
+    {
+        assembler->status = ASSEMBLER_ERROR_INVALID_OPERAND;
+        return;
+    }
+
+    if (assembler->fixupsCount >= assembler->fixupsCapacity)
+    {
+        assembler->fixupsCapacity = (size_t) (assembler->fixupsCapacity * REALLOC_MULTIPLIER);
+        assembler->fixups         = (Fixup*) realloc(assembler->fixups, assembler->fixupsCapacity * sizeof(Fixup));
+        assert(assembler->fixups != nullptr);
+    }
+
+    Fixup* fixup    = &assembler->fixups[assembler->fixupsCount++];
+    fixup->position = (uint32_t) assembler->bytecode->size;
+    fixup->label    = intern(operand + 1, length - 1);
+    fixup->opcode   = opcode;
+    fixup->line     = assembler->line;
+
+    appendUint32(assembler->bytecode, NO_OFFSET);
+}
+
+void writeSize(Assembler* assembler, const char* operand, size_t length)
+{
+    ASSERT_ASSEMBLER(assembler);
+    assert(operand != nullptr);
+
+    double size = 0;
+    if (!parseNumber(operand, length, &size) || !(size >= 0 && size <= UINT32_MAX) || size != (double) (uint32_t) size)
+    {
+        assembler->status = ASSEMBLER_ERROR_INVALID_OPERAND;
+        return;
+    }
+
+    appendUint32(assembler->bytecode, (uint32_t) size);
+}
+
+void resolveFixups(Assembler* assembler)
+{
+    ASSERT_ASSEMBLER(assembler);
+
+    for (size_t i = 0; i < assembler->fixupsCount; i++)
+    {
+        Fixup* fixup = &assembler->fixups[i];
+
+        reserveLabel(assembler, fixup->label);
+
+        uint32_t symbol = assembler->labelSymbols[fixup->label];
+        if (symbol == NO_CODE_SYMBOL)
+        {
+            assembler->line   = fixup->line;
+            assembler->status = ASSEMBLER_ERROR_UNDEFINED_LABEL;
+            return;
+        }
+
+        CodeSymbol* target = &assembler->bytecode->symbols[symbol];
+        if (fixup->opcode == OP_CALL) { target->kind = CODE_FUNCTION; }
+
+        memcpy(assembler->bytecode->code + fixup->position, &target->offset, sizeof(target->offset));
+    }
+}
+
+const Mnemonic* findMnemonic(const char* name, size_t length)
+{
+    assert(name != nullptr);
+
+    for (size_t i = 0; i < MNEMONICS_COUNT; i++)
+    {
+        if (strncmp(MNEMONICS[i].name, name, length) == 0 && MNEMONICS[i].name[length] == '\0')
+        {
+            return &MNEMONICS[i];
+        }
+    }
+
+    return nullptr;
+}
+
+Register findRegister(const char* name, size_t length)
+{
+    assert(name != nullptr);
+
+    for (uint8_t i = 0; i < REGISTERS_COUNT; i++)
+    {
+        if (strncmp(REGISTER_NAMES[i], name, length) == 0 && REGISTER_NAMES[i][length] == '\0')
+        {
+            return (Register) i;
+        }
+    }
+
+    return NO_REGISTER;
+}
+
+bool parseMemory(const char* operand, size_t length, Register* reg, int32_t* offset)
+{
+    assert(operand != nullptr);
+    assert(reg     != nullptr);
+    assert(offset  != nullptr);
+
+    if (length < 3 || operand[0] != '[' || operand[length - 1] != ']') { return false; }
+
+    const char* inner  = operand + 1;
+    size_t      rest   = length - 2;
+    const char* plus   = (const char*) memchr(inner, '+', rest);
+    size_t      prefix = (plus != nullptr) ? (size_t) (plus - inner) : rest;
+
+    *reg    = findRegister(inner, prefix);
+    *offset = 0;
+
+    if (*reg == NO_REGISTER)
+    {
+        prefix = 0; // no register, the whole thing is the address
+    }
+    else if (plus == nullptr)
+    {
+        return true;
+    }
+    else
+    {
+        prefix++;
+    }
+
+    double number = 0;
+    if (!parseNumber(inner + prefix, rest - prefix, &number) || number != (double) (int32_t) number) { return false; }
+
+    *offset = (int32_t) number;
+    return true;
+}
+
+bool parseNumber(const char* operand, size_t length, double* number)
+{
+    assert(operand != nullptr);
+    assert(number  != nullptr);
+
+    if (length == 0 || length >= MAX_OPERAND_LENGTH) { return false; }
+
+    char buffer[MAX_OPERAND_LENGTH] = {};
+    memcpy(buffer, operand, length);
+
+    char* numberEnd = nullptr;
+    *number = strtod(buffer, &numberEnd);
+
+    return numberEnd == buffer + length;
+}
+
+const char* skipSpaces(const char* position, const char* end)
+{
+    while (position < end && (*position == ' ' || *position == '\t' || *position == '\r'))
+    {
+        position++;
+    }
+
+    return position;
+}
+
+const char* skipWord(const char* position, const char* end)
+{
+    while (position < end && *position != ' ' && *position != '\t' && *position != '\r')
+    {
+        position++;
+    }
+
+    return position;
+}
+
+void reserveLabel(Assembler* assembler, SymbolId label)
+{
+    ASSERT_ASSEMBLER(assembler);
+
+    if (label < assembler->labelSymbolsCapacity) { return; }
+
+    size_t oldCapacity = assembler->labelSymbolsCapacity;
+    while (label >= assembler->labelSymbolsCapacity)
+    {
+        assembler->labelSymbolsCapacity = (size_t) (assembler->labelSymbolsCapacity * REALLOC_MULTIPLIER);
+    }
+
+    assembler->labelSymbols = (uint32_t*) realloc(assembler->labelSymbols, assembler->labelSymbolsCapacity * sizeof(uint32_t));
+    assert(assembler->labelSymbols != nullptr);
+
+    memset(assembler->labelSymbols + oldCapacity, 0xFF, (assembler->labelSymbolsCapacity - oldCapacity) * sizeof(uint32_t));
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "bytecode.h"
+
+enum AssemblerError
+{
+    ASSEMBLER_NO_ERROR,
+    ASSEMBLER_ERROR_UNKNOWN_INSTRUCTION,
+    ASSEMBLER_ERROR_INVALID_OPERAND,
+    ASSEMBLER_ERROR_DUPLICATE_LABEL,
+    ASSEMBLER_ERROR_UNDEFINED_LABEL,
+
+    ASSEMBLER_ERRORS_COUNT
+};
+
+static const char* ASSEMBLER_ERROR_STRINGS[ASSEMBLER_ERRORS_COUNT] = {
+    "no error",
+    "unknown instruction",
+    "invalid operand",
+    "label is defined twice",
+    "jump to undefined label"
+};
+
+//------------------------------------------------------------------------------
+// Translates the text assembly written by the compiler into bytecode in a
+// single pass, jumps to labels that aren't defined yet are patched at the end.
+// Label names are interned, so the interner has to be constructed.
+//------------------------------------------------------------------------------
+const char*    errorString (AssemblerError error);
+AssemblerError assemble    (Bytecode* bytecode, const char* text, size_t length, size_t* errorLine);
@@ -0,0 +1,207 @@
+#include <assert.h>
+#include "bytecode.h"
+#include "../libs/file_manager.h"
+
+#define ASSERT_BYTECODE(bytecode) assert((bytecode)          != nullptr); \
+                                  assert((bytecode)->code    != nullptr); \
+                                  assert((bytecode)->symbols != nullptr); \
+                                  assert((bytecode)->names   != nullptr);
+
+const double REALLOC_MULTIPLIER       = 2;
+const size_t DEFAULT_CODE_CAPACITY    = 4096;
+const size_t DEFAULT_SYMBOLS_CAPACITY = 64;
+const size_t DEFAULT_NAMES_CAPACITY   = 1024;
+
+void* growArray(void* array, size_t* capacity, size_t required, size_t elementSize);
+
+void construct(Bytecode* bytecode)
+{
+    assert(bytecode != nullptr);
+
+    bytecode->code            = (uint8_t*)    malloc(DEFAULT_CODE_CAPACITY);
+    bytecode->size            = 0;
+    bytecode->capacity        = DEFAULT_CODE_CAPACITY;
+
+    bytecode->symbols         = (CodeSymbol*) malloc(DEFAULT_SYMBOLS_CAPACITY * sizeof(CodeSymbol));
+    bytecode->symbolsCount    = 0;
+    bytecode->symbolsCapacity = DEFAULT_SYMBOLS_CAPACITY;
+
+    bytecode->names           = (char*)       malloc(DEFAULT_NAMES_CAPACITY);
+    bytecode->namesSize       = 0;
+    bytecode->namesCapacity   = DEFAULT_NAMES_CAPACITY;
+
+    assert(bytecode->code    != nullptr);
+    assert(bytecode->symbols != nullptr);
+    assert(bytecode->names   != nullptr);
+}
+
+void destroy(Bytecode* bytecode)
+{
+    ASSERT_BYTECODE(bytecode);
+
+    free(bytecode->code);
+    free(bytecode->symbols);
+    free(bytecode->names);
+
+    bytecode->code            = nullptr;
+    bytecode->size            = 0;
+    bytecode->capacity        = 0;
+    bytecode->symbols         = nullptr;
+    bytecode->symbolsCount    = 0;
+    bytecode->symbolsCapacity = 0;
+    bytecode->names           = nullptr;
+    bytecode->namesSize       = 0;
+    bytecode->namesCapacity   = 0;
+}
+
+void appendBytes(Bytecode* bytecode, const void* bytes, size_t length)
+{
+    ASSERT_BYTECODE(bytecode);
+    assert(bytes != nullptr);
+
+    bytecode->code = (uint8_t*) growArray(bytecode->code, &bytecode->capacity, bytecode->size + length, sizeof(uint8_t));
+
+    memcpy(bytecode->code + bytecode->size, bytes, length);
+    bytecode->size += length;
+}
+
+size_t addSymbol(Bytecode* bytecode, uint32_t offset, const char* name, size_t length, CodeSymbolKind kind)
+{
+    ASSERT_BYTECODE(bytecode);
+    assert(name != nullptr);
+
+    bytecode->symbols = (CodeSymbol*) growArray(bytecode->symbols, &bytecode->symbolsCapacity,
+                                                bytecode->symbolsCount + 1, sizeof(CodeSymbol));
+    bytecode->names   = (char*)       growArray(bytecode->names, &bytecode->namesCapacity,
+                                                bytecode->namesSize + length + 1, sizeof(char));
+
+    CodeSymbol* symbol = &bytecode->symbols[bytecode->symbolsCount];
+    symbol->offset     = offset;
+    symbol->name       = (uint32_t) bytecode->namesSize;
+    symbol->kind       = kind;
+
+    memcpy(bytecode->names + bytecode->namesSize, name, length);
+    bytecode->names[bytecode->namesSize + length] = '\0';
+    bytecode->namesSize += length + 1;
+
+    return bytecode->symbolsCount++;
+}
+
+const char* codeSymbolName(const Bytecode* bytecode, size_t symbol)
+{
+    ASSERT_BYTECODE(bytecode);
+    assert(symbol < bytecode->symbolsCount);
+
+    return bytecode->names + bytecode->symbols[symbol].name;
+}
+
+size_t instructionLength(Opcode opcode)
+{
+    switch (opcode)
+    {
+        case OP_PUSH_NUMBER: { return 1 + sizeof(double);                     }
+        case OP_PUSH_REG:
+        case OP_POP_REG:     { return 1 + sizeof(Register);                   }
+        case OP_PUSH_MEM:
+        case OP_POP_MEM:     { return 1 + sizeof(Register) + sizeof(int32_t); }
+        case OP_JMP:
+        case OP_JE:
+        case OP_JNE:
+        case OP_JA:
+        case OP_JB:
+        case OP_JAE:
+        case OP_JBE:
+        case OP_CALL:
+        case OP_ENTER:       { return 1 + sizeof(uint32_t);                   }
+        default:             { return 1;                                      }
+    }
+}
+
+bool writeImage(const Bytecode* bytecode, FILE* file)
+{
+    ASSERT_BYTECODE(bytecode);
+    assert(file != nullptr);
+
+    BinFileHeader fileHeader = {};
+    fileHeader.signature     = IMAGE_SIGNATURE;
+    fileHeader.version       = IMAGE_VERSION;
+
+    ImageHeader header  = {};
+    header.codeSize     = (uint32_t) bytecode->size;
+    header.symbolsCount = (uint32_t) bytecode->symbolsCount;
+    header.namesSize    = (uint32_t) bytecode->namesSize;
+
+    return fwrite(&fileHeader,       sizeof(fileHeader), 1,                      file) == 1                      &&
+           fwrite(&header,           sizeof(header),     1,                      file) == 1                      &&
+           fwrite(bytecode->code,    sizeof(uint8_t),    bytecode->size,         file) == bytecode->size         &&
+           fwrite(bytecode->symbols, sizeof(CodeSymbol), bytecode->symbolsCount, file) == bytecode->symbolsCount &&
+           fwrite(bytecode->names,   sizeof(char),       bytecode->namesSize,    file) == bytecode->namesSize;
+}
+
+//------------------------------------------------------------------------------
+// Replaces the contents of bytecode with the image. Only the layout is checked
+// here, the code itself is validated by the virtual machine before running.
+//------------------------------------------------------------------------------
+bool readImage(Bytecode* bytecode, const char* buffer, size_t size)
+{
+    ASSERT_BYTECODE(bytecode);
+    assert(buffer != nullptr);
+
+    BinFileHeader fileHeader = {};
+    ImageHeader   header     = {};
+
+    if (size < sizeof(fileHeader) + sizeof(header)) { return false; }
+
+    memcpy(&fileHeader, buffer,                      sizeof(fileHeader));
+    memcpy(&header,     buffer + sizeof(fileHeader), sizeof(header));
+
+    if (fileHeader.signature != IMAGE_SIGNATURE || fileHeader.version > IMAGE_VERSION) { return false; }
+
+    size_t symbolsSize = (size_t) header.symbolsCount * sizeof(CodeSymbol);
+    if (size != sizeof(fileHeader) + sizeof(header) + header.codeSize + symbolsSize + header.namesSize) { return false; }
+
+    const char* section = buffer + sizeof(fileHeader) + sizeof(header);
+
+    bytecode->size = 0;
+    appendBytes(bytecode, section, header.codeSize);
+    section += header.codeSize;
+
+    bytecode->symbolsCount = header.symbolsCount;
+    bytecode->symbols      = (CodeSymbol*) growArray(bytecode->symbols, &bytecode->symbolsCapacity,
+                                                     bytecode->symbolsCount, sizeof(CodeSymbol));
+    memcpy(bytecode->symbols, section, symbolsSize);
+    section += symbolsSize;
+
+    bytecode->namesSize = header.namesSize;
+    bytecode->names     = (char*) growArray(bytecode->names, &bytecode->namesCapacity, bytecode->namesSize, sizeof(char));
+    memcpy(bytecode->names, section, header.namesSize);
+
+    for (size_t i = 0; i < bytecode->symbolsCount; i++)
+    {
+        uint32_t name = bytecode->symbols[i].name;
+        if (name >= bytecode->namesSize || memchr(bytecode->names + name, '\0', bytecode->namesSize - name) == nullptr)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void* growArray(void* array, size_t* capacity, size_t required, size_t elementSize)
+{
+    assert(array    != nullptr);
+    assert(capacity != nullptr);
+
+    if (required <= *capacity) { return array; }
+
+    while (*capacity < required)
+    {
+        *capacity = (size_t) (*capacity * REALLOC_MULTIPLIER);
+    }
+
+    array = realloc(array, *capacity * elementSize);
+    assert(array != nullptr);
+
+    return array;
+}
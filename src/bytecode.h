@@ -0,0 +1,168 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+// Binary form of the stack CPU code. An instruction is an opcode byte
+// followed by its operands, if it has any:
+//   OP_PUSH_NUMBER          8 byte double
+//   OP_PUSH_REG, OP_POP_REG register byte
+//   OP_PUSH_MEM, OP_POP_MEM register byte and 4 byte offset, i.e. [reg+offset]
+//   jumps and OP_CALL       4 byte code offset of the target
+//   OP_ENTER                4 byte frame size
+// Operands are unaligned and in host byte order. Functions and labels are kept
+// aside as symbols with their code offsets, rndjmp jumps to one of them.
+//
+// An image file is a BinFileHeader followed by an ImageHeader, the code, the
+// symbols and their zero terminated names.
+//------------------------------------------------------------------------------
+enum Opcode : uint8_t
+{
+    OP_HLT,
+    OP_PUSH_NUMBER,
+    OP_PUSH_REG,
+    OP_PUSH_MEM,
+    OP_POP_REG,
+    OP_POP_MEM,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_JMP,
+    OP_JE,
+    OP_JNE,
+    OP_JA,
+    OP_JB,
+    OP_JAE,
+    OP_JBE,
+    OP_CALL,
+    OP_RET,
+    OP_IN,
+    OP_OUT,
+    OP_FLR,
+    OP_SQRT,
+    OP_RNDJMP,
+    OP_ENTER,
+    OP_LEAVE,
+
+    OPCODES_COUNT
+};
+
+enum Register : uint8_t
+{
+    RAX,
+    RBX,
+    RCX,
+    RDX,
+
+    REGISTERS_COUNT,
+    NO_REGISTER = REGISTERS_COUNT // [N] addresses memory without a register
+};
+
+static const char* REGISTER_NAMES[REGISTERS_COUNT] = { "rax", "rbx", "rcx", "rdx" };
+
+static const char* OPCODE_MNEMONICS[OPCODES_COUNT] = {
+    "hlt", "push", "push", "push", "pop", "pop",
+    "add", "sub", "mul", "div",
+    "jmp", "je", "jne", "ja", "jb", "jae", "jbe",
+    "call", "ret", "in", "out", "flr", "sqrt", "rndjmp",
+    "enter", "leave"
+};
+
+static const short IMAGE_SIGNATURE = 'P' << 8 | 'T';
+static const short IMAGE_VERSION   = 2; // 2 added enter and leave, version 1 images still run
+
+enum CodeSymbolKind : uint32_t
+{
+    CODE_FUNCTION,
+    CODE_LABEL
+};
+
+struct CodeSymbol
+{
+    uint32_t       offset;
+    uint32_t       name; // offset in Bytecode::names
+    CodeSymbolKind kind;
+};
+
+struct ImageHeader
+{
+    uint32_t codeSize;
+    uint32_t symbolsCount;
+    uint32_t namesSize;
+};
+
+struct Bytecode
+{
+    uint8_t*    code;
+    size_t      size;
+    size_t      capacity;
+
+    CodeSymbol* symbols;
+    size_t      symbolsCount;
+    size_t      symbolsCapacity;
+
+    char*       names;
+    size_t      namesSize;
+    size_t      namesCapacity;
+};
+
+void        construct         (Bytecode* bytecode);
+void        destroy           (Bytecode* bytecode);
+
+void        appendBytes       (Bytecode* bytecode, const void* bytes, size_t length);
+size_t      addSymbol         (Bytecode* bytecode, uint32_t offset, const char* name, size_t length, CodeSymbolKind kind);
+const char* codeSymbolName    (const Bytecode* bytecode, size_t symbol);
+size_t      instructionLength (Opcode opcode);
+
+bool        writeImage        (const Bytecode* bytecode, FILE* file);
+bool        readImage         (Bytecode* bytecode, const char* buffer, size_t size);
+
+inline void appendOpcode(Bytecode* bytecode, Opcode opcode)
+{
+    appendBytes(bytecode, &opcode, sizeof(opcode));
+}
+
+inline void appendRegister(Bytecode* bytecode, Register reg)
+{
+    appendBytes(bytecode, &reg, sizeof(reg));
+}
+
+inline void appendInt32(Bytecode* bytecode, int32_t value)
+{
+    appendBytes(bytecode, &value, sizeof(value));
+}
+
+inline void appendUint32(Bytecode* bytecode, uint32_t value)
+{
+    appendBytes(bytecode, &value, sizeof(value));
+}
+
+inline void appendDouble(Bytecode* bytecode, double value)
+{
+    appendBytes(bytecode, &value, sizeof(value));
+}
+
+inline uint32_t readUint32(const uint8_t* position)
+{
+    uint32_t value = 0;
+    memcpy(&value, position, sizeof(value));
+    return value;
+}
+
+inline int32_t readInt32(const uint8_t* position)
+{
+    int32_t value = 0;
+    memcpy(&value, position, sizeof(value));
+    return value;
+}
+
+inline double readDouble(const uint8_t* position)
+{
+    double value = 0;
+    memcpy(&value, position, sizeof(value));
+    return value;
+}
@@ -0,0 +1,780 @@
+#include <assert.h>
+#include <string.h>
+#include "c_transpiler.h"
+
+#define ASSERT_TRANSPILER(transpiler) assert(transpiler                 != nullptr); \
+                                      assert(transpiler->table          != nullptr); \
+                                      assert(transpiler->emitter.buffer != nullptr);
+
+#define OUTPUT      (&transpiler->emitter)
+#define CUR_FUNC    transpiler->curFunction
+
+#define TYPE(node)  NODE_TYPE  (transpiler->tree, node)
+#define DATA(node)  NODE_DATA  (transpiler->tree, node)
+#define LEFT(node)  NODE_LEFT  (transpiler->tree, node)
+#define RIGHT(node) NODE_RIGHT (transpiler->tree, node)
+
+const size_t NO_TEMP               = SIZE_MAX;
+const size_t C_NUMBER_LENGTH       = 32;
+const size_t SHORT_PRECISION       = 15; // enough for the numbers people write
+const size_t EXACT_PRECISION       = 17; // enough for any double to read back the same
+
+const char*  C_FUNCTION_PREFIX     = "potter_";
+const char*  C_VARIABLE_PREFIX     = "v_"; // keeps names like 'int' or 'for' away from C keywords
+const char*  C_TEMP_PREFIX         = "t";
+
+const char*  C_OPERATORS[]         = { "+", "-", "*", "/", "==", "!=", "<=", ">=", "<", ">" };
+
+//------------------------------------------------------------------------------
+// Built-ins that need the C library. They behave like the software CPU does:
+// flagrate prints with %lg, and a failed accio stops the program.
+//------------------------------------------------------------------------------
+const char*  C_RUNTIME =
+    "#include <math.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "\n"
+    "double potter_accio(void)\n"
+    "{\n"
+    "    double value = 0;\n"
+    "\n"
+    "    if (scanf(\"%lg\", &value) != 1)\n"
+    "    {\n"
+    "        printf(\"RUNTIME ERROR: couldn't read a number from the input\\n\");\n"
+    "        exit(EXIT_FAILURE);\n"
+    "    }\n"
+    "\n"
+    "    return value;\n"
+    "}\n"
+    "\n"
+    "double potter_flagrate(double value)\n"
+    "{\n"
+    "    printf(\"%lg\\n\", value);\n"
+    "\n"
+    "    return value;\n"
+    "}\n";
+
+void compileError        (CTranspiler* transpiler, CompilerError error);
+
+void writeSignature      (CTranspiler* transpiler, const Function* function);
+void writeFunction       (CTranspiler* transpiler, NodeIndex node);
+void writeRandomJumps    (CTranspiler* transpiler);
+
+void writeStatements     (CTranspiler* transpiler, NodeIndex node);
+void writeStatement      (CTranspiler* transpiler, NodeIndex node);
+void writeCondition      (CTranspiler* transpiler, NodeIndex node);
+void writeLoop           (CTranspiler* transpiler, NodeIndex node);
+void writeAssignment     (CTranspiler* transpiler, NodeIndex node);
+void writeReturn         (CTranspiler* transpiler, NodeIndex node);
+
+bool hasRandomJump       (CTranspiler* transpiler, NodeIndex node);
+bool isOrderedCall       (CTranspiler* transpiler, NodeIndex node);
+bool needsTemps          (CTranspiler* transpiler, NodeIndex node);
+void countOrderedCalls   (CTranspiler* transpiler, NodeIndex node, size_t* count);
+bool writeCalls          (CTranspiler* transpiler, NodeIndex node, bool valueUsed);
+
+void writeCondExpression (CTranspiler* transpiler, NodeIndex node);
+void writeExpression     (CTranspiler* transpiler, NodeIndex node);
+void writeOperand        (CTranspiler* transpiler, NodeIndex node);
+void writeMath           (CTranspiler* transpiler, NodeIndex node);
+void writeCall           (CTranspiler* transpiler, NodeIndex node);
+void writeArguments      (CTranspiler* transpiler, NodeIndex node);
+void writeNumber         (CTranspiler* transpiler, double number);
+
+void putIndent           (CTranspiler* transpiler);
+void putOpenBrace        (CTranspiler* transpiler);
+void putCloseBrace       (CTranspiler* transpiler);
+void putLabel            (CTranspiler* transpiler, LabelKind label, size_t index);
+void putFunctionName     (CTranspiler* transpiler, SymbolId function);
+void putVariableName     (CTranspiler* transpiler, SymbolId variable);
+void putTemp             (CTranspiler* transpiler, size_t temp);
+
+void construct(CTranspiler* transpiler, const CompactTree* tree, SymbolTable* table, bool commentsEnabled)
+{
+    assert(transpiler != nullptr);
+    assert(tree       != nullptr);
+    assert(table      != nullptr);
+
+    transpiler->table           = table;
+    transpiler->tree            = tree;
+    transpiler->commentsEnabled = commentsEnabled;
+}
+
+void destroy(CTranspiler* transpiler)
+{
+    assert(transpiler != nullptr);
+
+    transpiler->table = nullptr;
+    transpiler->tree  = nullptr;
+}
+
+void compileError(CTranspiler* transpiler, CompilerError error)
+{
+    assert(transpiler != nullptr);
+
+    transpiler->status = error;
+
+    printf("COMPILATION ERROR: %s\n", errorString(error));
+}
+
+CompilerError compile(CTranspiler* transpiler, const char* outputFile)
+{
+    assert(transpiler != nullptr);
+    assert(outputFile != nullptr);
+
+    Function* mainFunction = getFunction(transpiler->table, MAIN_SYMBOL);
+    if (mainFunction == nullptr)
+    {
+        compileError(transpiler, COMPILER_ERROR_NO_MAIN_FUNCTION);
+        return transpiler->status;
+    }
+
+    FILE* file = fopen(outputFile, "w");
+    if (file == nullptr)
+    {
+        compileError(transpiler, COMPILER_ERROR_FILE_OPEN_FAILURE);
+        return transpiler->status;
+    }
+
+    construct(OUTPUT, file, transpiler->commentsEnabled);
+
+    size_t nodesCount = transpiler->tree->nodesCount;
+    transpiler->temps = (size_t*) malloc((nodesCount + 1) * sizeof(size_t));
+    assert(transpiler->temps != nullptr);
+
+    for (size_t i = 0; i < nodesCount; i++)
+    {
+        transpiler->temps[i] = NO_TEMP;
+    }
+
+    emit     (OUTPUT, C_RUNTIME);
+    emitChar (OUTPUT, '\n');
+
+    // Functions may be called before they're defined
+    for (size_t i = 0; i < transpiler->table->functionsCount; i++)
+    {
+        writeSignature (transpiler, &transpiler->table->functions[i]);
+        emit           (OUTPUT, ";\n");
+    }
+
+    emitChar(OUTPUT, '\n');
+
+    CUR_FUNC = transpiler->table->functions;
+
+    NodeIndex curDeclaration = (nodesCount > 0) ? 0 : NO_NODE; // root is node 0
+    while (curDeclaration != NO_NODE)
+    {
+        writeFunction(transpiler, RIGHT(curDeclaration));
+        curDeclaration = LEFT(curDeclaration);
+        CUR_FUNC++;
+    }
+
+    emit            (OUTPUT, "int main(void)\n{\n    ");
+    putFunctionName (transpiler, MAIN_SYMBOL);
+    emit            (OUTPUT, "();\n\n    return 0;\n}\n");
+
+    free(transpiler->temps);
+    transpiler->temps = nullptr;
+
+    destroy(OUTPUT);
+    fclose(file);
+
+    return transpiler->status;
+}
+
+void writeSignature(CTranspiler* transpiler, const Function* function)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(function != nullptr);
+
+    emit            (OUTPUT, "double ");
+    putFunctionName (transpiler, function->name);
+    emitChar        (OUTPUT, '(');
+
+    if (function->paramsCount == 0)
+    {
+        emit(OUTPUT, "void");
+    }
+
+    for (size_t i = 0; i < function->paramsCount; i++)
+    {
+        if (i > 0) { emit(OUTPUT, ", "); }
+
+        emit            (OUTPUT, "double ");
+        putVariableName (transpiler, function->vars[i]);
+    }
+
+    emitChar(OUTPUT, ')');
+}
+
+void writeFunction(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(node != NO_NODE);
+
+    transpiler->funcCondLabel = transpiler->curCondLabel;
+    transpiler->funcLoopLabel = transpiler->curLoopLabel;
+    transpiler->randomJumps   = hasRandomJump(transpiler, LEFT(node));
+    transpiler->curTemp       = 0;
+
+    writeSignature (transpiler, CUR_FUNC);
+    emitChar       (OUTPUT, '\n');
+    putOpenBrace   (transpiler);
+
+    for (size_t i = CUR_FUNC->paramsCount; i < CUR_FUNC->varsCount; i++)
+    {
+        putIndent       (transpiler);
+        emit            (OUTPUT, "double ");
+        putVariableName (transpiler, CUR_FUNC->vars[i]);
+        emit            (OUTPUT, " = 0;\n");
+    }
+
+    if (CUR_FUNC->varsCount > CUR_FUNC->paramsCount) { emitChar(OUTPUT, '\n'); }
+
+    // riddikulus may restart the body, so it's one of the jump targets
+    if (transpiler->randomJumps) { emit(OUTPUT, "BODY: ;\n"); }
+
+    writeStatements(transpiler, LEFT(node));
+
+    // Falling off the end returns 0
+    putIndent (transpiler);
+    emit      (OUTPUT, "return 0;\n");
+
+    if (transpiler->randomJumps) { writeRandomJumps(transpiler); }
+
+    putCloseBrace (transpiler);
+    emitChar      (OUTPUT, '\n');
+}
+
+//------------------------------------------------------------------------------
+// Every riddikulus of the function jumps here, and from here to the start of
+// the body or to one of the function's labels, the same ones the native back
+// end picks from.
+//------------------------------------------------------------------------------
+void writeRandomJumps(CTranspiler* transpiler)
+{
+    ASSERT_TRANSPILER(transpiler);
+
+    static const LabelKind CONDITION_LABELS[] = { IF_END_LABEL, IF_ELSE_END_LABEL };
+    static const LabelKind LOOP_LABELS[]      = { WHILE_LABEL, WHILE_BODY_LABEL, WHILE_END_LABEL };
+
+    size_t conditions = transpiler->curCondLabel - transpiler->funcCondLabel;
+    size_t loops      = transpiler->curLoopLabel - transpiler->funcLoopLabel;
+
+    emit         (OUTPUT, "\nRANDOM_JUMP:\n");
+    putIndent    (transpiler);
+    emit         (OUTPUT, "switch (rand() % ");
+    emitUnsigned (OUTPUT, 1 + 2 * conditions + 3 * loops);
+    emit         (OUTPUT, ")\n");
+    putOpenBrace (transpiler);
+
+    size_t target = 0;
+
+    // The other targets are numbered from 1, so every path out of the function returns
+    putIndent    (transpiler);
+    emit         (OUTPUT, "default: goto BODY;\n");
+    target++;
+
+    for (size_t i = transpiler->funcCondLabel; i < transpiler->curCondLabel; i++)
+    {
+        for (LabelKind label : CONDITION_LABELS)
+        {
+            putIndent    (transpiler);
+            emit         (OUTPUT, "case ");
+            emitUnsigned (OUTPUT, target++);
+            emit         (OUTPUT, ": goto ");
+            emit         (OUTPUT, LABEL_NAMES[label]);
+            emitChar     (OUTPUT, '_');
+            emitUnsigned (OUTPUT, i);
+            emit         (OUTPUT, ";\n");
+        }
+    }
+
+    for (size_t i = transpiler->funcLoopLabel; i < transpiler->curLoopLabel; i++)
+    {
+        for (LabelKind label : LOOP_LABELS)
+        {
+            putIndent    (transpiler);
+            emit         (OUTPUT, "case ");
+            emitUnsigned (OUTPUT, target++);
+            emit         (OUTPUT, ": goto ");
+            emit         (OUTPUT, LABEL_NAMES[label]);
+            emitChar     (OUTPUT, '_');
+            emitUnsigned (OUTPUT, i);
+            emit         (OUTPUT, ";\n");
+        }
+    }
+
+    putCloseBrace(transpiler);
+}
+
+void writeStatements(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(node != NO_NODE);
+
+    NodeIndex curStatement = RIGHT(node);
+    while (curStatement != NO_NODE)
+    {
+        writeStatement(transpiler, curStatement);
+        curStatement = RIGHT(curStatement);
+    }
+}
+
+void writeStatement(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(node       != NO_NODE);
+    assert(LEFT(node) != NO_NODE);
+
+    switch (TYPE(LEFT(node)))
+    {
+        case COND_TYPE:  { writeCondition  (transpiler, LEFT(node));        break; }
+        case LOOP_TYPE:  { writeLoop       (transpiler, LEFT(node));        break; }
+        case VDECL_TYPE: { writeAssignment (transpiler, LEFT(node));        break; }
+        case ASSG_TYPE:  { writeAssignment (transpiler, LEFT(node));        break; }
+        case JUMP_TYPE:  { writeReturn     (transpiler, LEFT(node));        break; }
+
+        // Only the calls of a bare expression have any effect
+        default:         { writeCalls      (transpiler, LEFT(node), false); break; }
+    }
+}
+
+void writeCondition(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(node != NO_NODE);
+
+    size_t label = transpiler->curCondLabel++;
+
+    if (needsTemps(transpiler, LEFT(node))) { writeCalls(transpiler, LEFT(node), true); }
+
+    putIndent           (transpiler);
+    emit                (OUTPUT, "if (");
+    writeCondExpression (transpiler, LEFT(node));
+    emit                (OUTPUT, ")\n");
+
+    putOpenBrace    (transpiler);
+    writeStatements (transpiler, LEFT(RIGHT(node)));
+    putCloseBrace   (transpiler);
+
+    if (RIGHT(RIGHT(node)) != NO_NODE)
+    {
+        putIndent       (transpiler);
+        emit            (OUTPUT, "else\n");
+        putOpenBrace    (transpiler);
+        putLabel        (transpiler, IF_END_LABEL, label);
+        writeStatements (transpiler, RIGHT(RIGHT(node)));
+        putCloseBrace   (transpiler);
+    }
+    else
+    {
+        putLabel(transpiler, IF_END_LABEL, label);
+    }
+
+    putLabel(transpiler, IF_ELSE_END_LABEL, label);
+}
+
+//------------------------------------------------------------------------------
+// A condition with calls taken out into temporaries has to compute them on
+// every iteration, so such a loop checks it at the top of an endless one.
+//------------------------------------------------------------------------------
+void writeLoop(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(node != NO_NODE);
+
+    size_t label = transpiler->curLoopLabel++;
+
+    putLabel(transpiler, WHILE_LABEL, label);
+
+    if (needsTemps(transpiler, LEFT(node)))
+    {
+        putIndent    (transpiler);
+        emit         (OUTPUT, "for (;;)\n");
+        putOpenBrace (transpiler);
+        writeCalls   (transpiler, LEFT(node), true);
+
+        putIndent           (transpiler);
+        emit                (OUTPUT, "if (!(");
+        writeCondExpression (transpiler, LEFT(node));
+        emit                (OUTPUT, ")) { break; }\n");
+    }
+    else
+    {
+        putIndent           (transpiler);
+        emit                (OUTPUT, "while (");
+        writeCondExpression (transpiler, LEFT(node));
+        emit                (OUTPUT, ")\n");
+        putOpenBrace        (transpiler);
+    }
+
+    putLabel        (transpiler, WHILE_BODY_LABEL, label);
+    writeStatements (transpiler, RIGHT(node));
+    putCloseBrace   (transpiler);
+    putLabel        (transpiler, WHILE_END_LABEL, label);
+}
+
+void writeAssignment(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(node != NO_NODE);
+
+    if (needsTemps(transpiler, RIGHT(node))) { writeCalls(transpiler, RIGHT(node), true); }
+
+    putIndent       (transpiler);
+    putVariableName (transpiler, DATA(LEFT(node)).name.id);
+    emit            (OUTPUT, " = ");
+    writeExpression (transpiler, RIGHT(node));
+    emit            (OUTPUT, ";\n");
+}
+
+void writeReturn(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(node != NO_NODE);
+
+    if (needsTemps(transpiler, RIGHT(node))) { writeCalls(transpiler, RIGHT(node), true); }
+
+    putIndent       (transpiler);
+    emit            (OUTPUT, "return ");
+    writeExpression (transpiler, RIGHT(node));
+    emit            (OUTPUT, ";\n");
+}
+
+bool hasRandomJump(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+
+    if (node == NO_NODE) { return false; }
+
+    if (TYPE(node) == CALL_TYPE && DATA(LEFT(node)).name.id == RAND_JUMP_SYMBOL) { return true; }
+
+    return hasRandomJump(transpiler, LEFT(node)) || hasRandomJump(transpiler, RIGHT(node));
+}
+
+// floor and sqrt have no effects, so it doesn't matter when they are made
+bool isOrderedCall(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(node != NO_NODE);
+
+    if (TYPE(node) != CALL_TYPE) { return false; }
+
+    SymbolId function = DATA(LEFT(node)).name.id;
+    return function != FLOOR_SYMBOL && function != SQRT_SYMBOL;
+}
+
+//------------------------------------------------------------------------------
+// A single call can stay where it is. riddikulus is a jump and can't be a
+// part of a C expression, so it always goes out to a statement of its own.
+//------------------------------------------------------------------------------
+bool needsTemps(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(node != NO_NODE);
+
+    size_t count = 0;
+    countOrderedCalls(transpiler, node, &count);
+
+    return count > 1 || hasRandomJump(transpiler, node);
+}
+
+void countOrderedCalls(CTranspiler* transpiler, NodeIndex node, size_t* count)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(count != nullptr);
+
+    if (node == NO_NODE) { return; }
+
+    if (isOrderedCall(transpiler, node)) { (*count)++; }
+
+    countOrderedCalls(transpiler, LEFT(node),  count);
+    countOrderedCalls(transpiler, RIGHT(node), count);
+}
+
+//------------------------------------------------------------------------------
+// Makes the calls of the expression in the order of the software CPU: left
+// operand first, arguments last to first, as the parser keeps them. A result
+// that is needed goes into a new temporary, which writeExpression then uses
+// instead of the call. Returns true if the calls end with riddikulus, nothing
+// after it is made.
+//------------------------------------------------------------------------------
+bool writeCalls(CTranspiler* transpiler, NodeIndex node, bool valueUsed)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(node != NO_NODE);
+
+    if (TYPE(node) == MATH_TYPE)
+    {
+        return writeCalls(transpiler, LEFT(node),  valueUsed) ||
+               writeCalls(transpiler, RIGHT(node), valueUsed);
+    }
+
+    if (TYPE(node) != CALL_TYPE) { return false; }
+
+    if (DATA(LEFT(node)).name.id == RAND_JUMP_SYMBOL)
+    {
+        putIndent (transpiler);
+        emit      (OUTPUT, "goto RANDOM_JUMP;\n");
+        return true;
+    }
+
+    for (NodeIndex curParamExpr = RIGHT(node); curParamExpr != NO_NODE; curParamExpr = RIGHT(curParamExpr))
+    {
+        if (writeCalls(transpiler, LEFT(curParamExpr), true)) { return true; }
+    }
+
+    if (!isOrderedCall(transpiler, node)) { return false; }
+
+    putIndent(transpiler);
+
+    if (valueUsed)
+    {
+        emit    (OUTPUT, "const double ");
+        putTemp (transpiler, transpiler->curTemp);
+        emit    (OUTPUT, " = ");
+    }
+
+    writeCall (transpiler, node);
+    emit      (OUTPUT, ";\n");
+
+    if (valueUsed) { transpiler->temps[node] = transpiler->curTemp++; }
+
+    return false;
+}
+
+// A comparison is a condition as it is, elsewhere it's a number
+void writeCondExpression(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(node != NO_NODE);
+
+    if (TYPE(node) == MATH_TYPE && DATA(node).operation > DIV_OP)
+    {
+        writeOperand (transpiler, LEFT(node));
+        emitChar     (OUTPUT, ' ');
+        emit         (OUTPUT, C_OPERATORS[DATA(node).operation]);
+        emitChar     (OUTPUT, ' ');
+        writeOperand (transpiler, RIGHT(node));
+        return;
+    }
+
+    writeExpression(transpiler, node);
+}
+
+void writeExpression(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(node != NO_NODE);
+
+    if (transpiler->temps[node] != NO_TEMP)
+    {
+        putTemp(transpiler, transpiler->temps[node]);
+        return;
+    }
+
+    switch (TYPE(node))
+    {
+        case MATH_TYPE: { writeMath       (transpiler, node);                     break; }
+        case NUMB_TYPE: { writeNumber     (transpiler, DATA(node).number);        break; }
+        case NAME_TYPE: { putVariableName (transpiler, DATA(node).name.id);       break; }
+        case CALL_TYPE: { writeCall       (transpiler, node);                     break; }
+        default:        { assert(!"Invalid node type");                           break; }
+    }
+}
+
+void writeOperand(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(node != NO_NODE);
+
+    if (TYPE(node) == MATH_TYPE && DATA(node).operation <= DIV_OP && transpiler->temps[node] == NO_TEMP)
+    {
+        emitChar        (OUTPUT, '(');
+        writeExpression (transpiler, node);
+        emitChar        (OUTPUT, ')');
+        return;
+    }
+
+    writeExpression(transpiler, node);
+}
+
+void writeMath(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(node != NO_NODE);
+
+    bool isComparison = DATA(node).operation > DIV_OP;
+
+    if (isComparison) { emit(OUTPUT, "(double) ("); }
+
+    writeOperand (transpiler, LEFT(node));
+    emitChar     (OUTPUT, ' ');
+    emit         (OUTPUT, C_OPERATORS[DATA(node).operation]);
+    emitChar     (OUTPUT, ' ');
+    writeOperand (transpiler, RIGHT(node));
+
+    if (isComparison) { emitChar(OUTPUT, ')'); }
+}
+
+void writeCall(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(node != NO_NODE);
+
+    SymbolId function = DATA(LEFT(node)).name.id;
+
+    switch (function)
+    {
+        case PRINT_SYMBOL: { emit(OUTPUT, "potter_flagrate("); break; }
+        case SCAN_SYMBOL:  { emit(OUTPUT, "potter_accio(");    break; }
+        case FLOOR_SYMBOL: { emit(OUTPUT, "floor(");           break; }
+        case SQRT_SYMBOL:  { emit(OUTPUT, "sqrt(");            break; }
+
+        // Only reached when the jump has already been made
+        case RAND_JUMP_SYMBOL:
+        {
+            emit(OUTPUT, "0.0");
+            return;
+        }
+
+        default:
+        {
+            if (getFunction(transpiler->table, function) == nullptr)
+            {
+                compileError(transpiler, COMPILER_ERROR_CALL_UNDEFINED_FUNCTION);
+                return;
+            }
+
+            putFunctionName (transpiler, function);
+            emitChar        (OUTPUT, '(');
+            break;
+        }
+    }
+
+    writeArguments (transpiler, RIGHT(node));
+    emitChar       (OUTPUT, ')');
+}
+
+// The parser keeps the arguments last to first
+void writeArguments(CTranspiler* transpiler, NodeIndex node)
+{
+    ASSERT_TRANSPILER(transpiler);
+
+    if (node == NO_NODE) { return; }
+
+    if (RIGHT(node) != NO_NODE)
+    {
+        writeArguments (transpiler, RIGHT(node));
+        emit           (OUTPUT, ", ");
+    }
+
+    writeExpression(transpiler, LEFT(node));
+}
+
+//------------------------------------------------------------------------------
+// Numbers are written so that they read back exactly, and always as double
+// constants, so that 1 / 2 doesn't become an integer division.
+//------------------------------------------------------------------------------
+void writeNumber(CTranspiler* transpiler, double number)
+{
+    ASSERT_TRANSPILER(transpiler);
+
+    if (isnan(number))
+    {
+        emit(OUTPUT, signbit(number) ? "(-NAN)" : "NAN");
+        return;
+    }
+
+    if (isinf(number))
+    {
+        emit(OUTPUT, signbit(number) ? "(-HUGE_VAL)" : "HUGE_VAL");
+        return;
+    }
+
+    char text[C_NUMBER_LENGTH] = {};
+
+    snprintf(text, sizeof(text), "%.*g", (int) SHORT_PRECISION, number);
+    if (strtod(text, nullptr) != number)
+    {
+        snprintf(text, sizeof(text), "%.*g", (int) EXACT_PRECISION, number);
+    }
+
+    bool isNegative = text[0] == '-';
+
+    if (isNegative) { emitChar(OUTPUT, '('); }
+
+    emit(OUTPUT, text);
+    if (strpbrk(text, ".e") == nullptr) { emit(OUTPUT, ".0"); }
+
+    if (isNegative) { emitChar(OUTPUT, ')'); }
+}
+
+void putIndent(CTranspiler* transpiler)
+{
+    ASSERT_TRANSPILER(transpiler);
+
+    for (size_t i = 0; i < transpiler->curIndent; i++)
+    {
+        emit(OUTPUT, "    ");
+    }
+}
+
+void putOpenBrace(CTranspiler* transpiler)
+{
+    ASSERT_TRANSPILER(transpiler);
+
+    putIndent (transpiler);
+    emit      (OUTPUT, "{\n");
+
+    transpiler->curIndent++;
+}
+
+void putCloseBrace(CTranspiler* transpiler)
+{
+    ASSERT_TRANSPILER(transpiler);
+    assert(transpiler->curIndent > 0);
+
+    transpiler->curIndent--;
+
+    putIndent (transpiler);
+    emit      (OUTPUT, "}\n");
+}
+
+// Labels are only there for riddikulus, other functions would get unused label warnings
+void putLabel(CTranspiler* transpiler, LabelKind label, size_t index)
+{
+    ASSERT_TRANSPILER(transpiler);
+
+    if (!transpiler->randomJumps) { return; }
+
+    emit         (OUTPUT, LABEL_NAMES[label]);
+    emitChar     (OUTPUT, '_');
+    emitUnsigned (OUTPUT, index);
+    emit         (OUTPUT, ": ;\n");
+}
+
+void putFunctionName(CTranspiler* transpiler, SymbolId function)
+{
+    ASSERT_TRANSPILER(transpiler);
+
+    emit(OUTPUT, C_FUNCTION_PREFIX);
+    emit(OUTPUT, getSymbolName(function));
+}
+
+void putVariableName(CTranspiler* transpiler, SymbolId variable)
+{
+    ASSERT_TRANSPILER(transpiler);
+
+    emit(OUTPUT, C_VARIABLE_PREFIX);
+    emit(OUTPUT, getSymbolName(variable));
+}
+
+void putTemp(CTranspiler* transpiler, size_t temp)
+{
+    ASSERT_TRANSPILER(transpiler);
+
+    emit         (OUTPUT, C_TEMP_PREFIX);
+    emitUnsigned (OUTPUT, temp);
+}
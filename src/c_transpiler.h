@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdio.h>
+#include "compact_tree.h"
+#include "compiler.h"
+
+//------------------------------------------------------------------------------
+// C back end. Every function becomes a C function of doubles, parameters keep
+// their order and variables are declared at the top of the function, since
+// they are function wide. The built-ins are small functions at the top of the
+// output, so it needs nothing but the C library:
+//     cc -O2 program.c -lm -o program
+//
+// C leaves the evaluation order of operands and arguments unspecified. When
+// an expression makes more than one call, the calls are taken out into
+// temporaries in the order the software CPU makes them.
+//------------------------------------------------------------------------------
+struct CTranspiler
+{
+    SymbolTable*       table;
+    const CompactTree* tree;
+    Emitter            emitter;
+    bool               commentsEnabled;
+    Function*          curFunction;
+    size_t             curIndent;
+
+    size_t*            temps;             // temporary that holds a call's result, by node
+    size_t             curTemp;
+
+    size_t             curCondLabel;
+    size_t             curLoopLabel;
+    size_t             funcCondLabel;     // first labels of the current function,
+    size_t             funcLoopLabel;     // riddikulus jumps to one of its labels
+    bool               randomJumps;
+
+    CompilerError      status;
+};
+
+void          construct (CTranspiler* transpiler, const CompactTree* tree, SymbolTable* table, bool commentsEnabled);
+void          destroy   (CTranspiler* transpiler);
+CompilerError compile   (CTranspiler* transpiler, const char* outputFile);
@@ -0,0 +1,217 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common_subexpressions.h"
+
+#define INSTRUCTION(value) (function->instructions[value])
+#define BLOCK(block)       (function->blocks[block])
+
+//------------------------------------------------------------------------------
+// What makes two instructions compute the same value. Operands of commutative
+// operations are ordered and greater (greater_equal) is turned into less
+// (less_equal) with the operands swapped, so that 'a + b' and 'b + a' meet.
+//------------------------------------------------------------------------------
+struct ValueKey
+{
+    IrOpcode opcode;
+    IrValue  first;
+    IrValue  second;
+    double   number;
+};
+
+// Open addressing hash table of the values available in the current block
+struct ValueTable
+{
+    IrValue* entries;  // NO_VALUE if empty
+    size_t   capacity; // power of two
+    size_t*  filled;   // positions of the entries, to clear them for the next block
+    size_t   filledCount;
+};
+
+void     numberBlock   (IrFunction* function, IrBlockId block, ValueTable* table, IrValue* replacements,
+                        CseStats* stats);
+bool     isNumbered    (IrOpcode opcode);
+bool     isCommutative (IrOpcode opcode);
+ValueKey getKey        (const IrFunction* function, IrValue value);
+bool     keysEqual     (const ValueKey* first, const ValueKey* second);
+size_t   hashKey       (const ValueKey* key);
+IrValue  findOrInsert  (const IrFunction* function, ValueTable* table, IrValue value);
+
+void eliminateCommonSubexpressions(IrProgram* program, void* stats)
+{
+    assert(program != nullptr);
+    assert(stats   != nullptr);
+
+    for (size_t i = 0; i < program->functionsCount; i++)
+    {
+        IrFunction* function = &program->functions[i];
+        if (function->inMemory || function->blocksCount == 0) { continue; }
+
+        ValueTable table = {};
+        table.capacity = 16;
+        while (table.capacity < 2 * function->instructionsCount) { table.capacity *= 2; }
+
+        table.entries = (IrValue*) malloc(table.capacity * sizeof(IrValue));
+        table.filled  = (size_t*)  calloc(function->instructionsCount + 1, sizeof(size_t));
+        IrValue* replacements = (IrValue*) malloc((function->instructionsCount + 1) * sizeof(IrValue));
+        assert(table.entries != nullptr);
+        assert(table.filled  != nullptr);
+        assert(replacements  != nullptr);
+
+        memset(table.entries, 0xFF, table.capacity * sizeof(IrValue));
+        memset(replacements,  0xFF, (function->instructionsCount + 1) * sizeof(IrValue));
+
+        for (IrBlockId block = 0; block < function->blocksCount; block++)
+        {
+            if (BLOCK(block).removed) { continue; }
+
+            numberBlock(function, block, &table, replacements, (CseStats*) stats);
+        }
+
+        // Uses in the other blocks, phis of the successors included. A value
+        // that replaces another is never replaced itself.
+        for (size_t value = 0; value < function->instructionsCount; value++)
+        {
+            IrInstruction* instruction = &INSTRUCTION(value);
+            if (instruction->block == NO_BLOCK) { continue; }
+
+            for (size_t j = 0; j < instruction->operandsCount; j++)
+            {
+                IrValue replacement = replacements[instruction->operands[j]];
+                if (replacement != NO_VALUE) { instruction->operands[j] = replacement; }
+            }
+        }
+
+        free(table.entries);
+        free(table.filled);
+        free(replacements);
+    }
+}
+
+void numberBlock(IrFunction* function, IrBlockId block, ValueTable* table, IrValue* replacements, CseStats* stats)
+{
+    assert(function     != nullptr);
+    assert(table        != nullptr);
+    assert(replacements != nullptr);
+    assert(stats        != nullptr);
+
+    size_t position = 0;
+    while (position < BLOCK(block).codeCount)
+    {
+        IrValue        value       = BLOCK(block).code[position];
+        IrInstruction* instruction = &INSTRUCTION(value);
+
+        // Operands defined in blocks that aren't numbered yet are fixed up at
+        // the end, which can only miss a match here, not make a wrong one
+        for (size_t j = 0; j < instruction->operandsCount; j++)
+        {
+            IrValue replacement = replacements[instruction->operands[j]];
+            if (replacement != NO_VALUE) { instruction->operands[j] = replacement; }
+        }
+
+        IrValue available = isNumbered(instruction->opcode) ? findOrInsert(function, table, value) : value;
+        if (available == value)
+        {
+            position++;
+            continue;
+        }
+
+        replacements[value] = available;
+        if (instruction->opcode != IR_CONST) { stats->savedEvaluations++; }
+
+        removeInstruction(function, value);
+    }
+
+    for (size_t i = 0; i < table->filledCount; i++)
+    {
+        table->entries[table->filled[i]] = NO_VALUE;
+    }
+
+    table->filledCount = 0;
+}
+
+bool isNumbered(IrOpcode opcode)
+{
+    return opcode == IR_CONST || (opcode >= IR_ADD && opcode <= IR_SQRT);
+}
+
+bool isCommutative(IrOpcode opcode)
+{
+    return opcode == IR_ADD || opcode == IR_MUL || opcode == IR_EQUAL || opcode == IR_NOT_EQUAL;
+}
+
+ValueKey getKey(const IrFunction* function, IrValue value)
+{
+    assert(function != nullptr);
+
+    const IrInstruction* instruction = &INSTRUCTION(value);
+
+    ValueKey key = {};
+    key.opcode = instruction->opcode;
+    key.first  = instruction->operandsCount > 0 ? instruction->operands[0] : NO_VALUE;
+    key.second = instruction->operandsCount > 1 ? instruction->operands[1] : NO_VALUE;
+    key.number = instruction->opcode == IR_CONST ? instruction->number : 0;
+
+    bool swap = false;
+    if (key.opcode == IR_GREATER)       { key.opcode = IR_LESS;       swap = true; }
+    if (key.opcode == IR_GREATER_EQUAL) { key.opcode = IR_LESS_EQUAL; swap = true; }
+    if (isCommutative(key.opcode))      { swap = key.first > key.second; }
+
+    if (swap)
+    {
+        IrValue first = key.first;
+        key.first  = key.second;
+        key.second = first;
+    }
+
+    return key;
+}
+
+// Numbers are compared bit by bit, 0 and -0 are different constants
+bool keysEqual(const ValueKey* first, const ValueKey* second)
+{
+    assert(first  != nullptr);
+    assert(second != nullptr);
+
+    return first->opcode == second->opcode && first->first == second->first && first->second == second->second &&
+           memcmp(&first->number, &second->number, sizeof(double)) == 0;
+}
+
+size_t hashKey(const ValueKey* key)
+{
+    assert(key != nullptr);
+
+    uint64_t bits = 0;
+    memcpy(&bits, &key->number, sizeof(double));
+
+    uint64_t hash = (uint64_t) key->opcode;
+    hash = hash * 0x9E3779B97F4A7C15ull + key->first;
+    hash = hash * 0x9E3779B97F4A7C15ull + key->second;
+    hash = hash * 0x9E3779B97F4A7C15ull + bits;
+
+    return (size_t) (hash ^ (hash >> 29));
+}
+
+// Returns the value computed the same way earlier in the block, or value itself after adding it
+IrValue findOrInsert(const IrFunction* function, ValueTable* table, IrValue value)
+{
+    assert(function != nullptr);
+    assert(table    != nullptr);
+
+    ValueKey key  = getKey(function, value);
+    size_t   mask = table->capacity - 1;
+
+    for (size_t position = hashKey(&key) & mask; ; position = (position + 1) & mask)
+    {
+        IrValue entry = table->entries[position];
+        if (entry == NO_VALUE)
+        {
+            table->entries[position]            = value;
+            table->filled[table->filledCount++] = position;
+            return value;
+        }
+
+        ValueKey entryKey = getKey(function, entry);
+        if (keysEqual(&key, &entryKey)) { return entry; }
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "ir.h"
+
+//------------------------------------------------------------------------------
+// Local value numbering. Within a basic block, a pure instruction with the
+// same opcode and operands as an earlier one (in either order for add, mul,
+// equal and not_equal) is replaced by it. Constants with the same number are
+// merged as well, but as they are pushed as numbers anyway, they don't count
+// as saved evaluations.
+//
+// The reused value gets more than one use, so the compiler keeps it in a
+// frame slot instead of computing it again. Calls, accio and everything else
+// that isn't pure (see isPure) are never merged, and functions with
+// riddikulus are left alone.
+//------------------------------------------------------------------------------
+struct CseStats
+{
+    size_t savedEvaluations;
+};
+
+void eliminateCommonSubexpressions (IrProgram* program, void* stats);
@@ -0,0 +1,157 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "compact_tree.h"
+
+#define ASSERT_COMPACT_TREE(tree) assert((tree)        != nullptr); \
+                                  assert((tree)->types != nullptr); \
+                                  assert((tree)->data  != nullptr); \
+                                  assert((tree)->left  != nullptr); \
+                                  assert((tree)->right != nullptr);
+
+const double REALLOC_MULTIPLIER      = 2;
+const size_t DEFAULT_NODES_CAPACITY  = 1024;
+const size_t DEFAULT_STACK_CAPACITY  = 256;
+
+struct FlattenEntry
+{
+    const Node* node;
+    NodeIndex   parent;
+    bool        isLeft;
+};
+
+void reallocNodes(CompactTree* tree);
+
+void construct(CompactTree* tree, size_t capacity)
+{
+    assert(tree != nullptr);
+
+    if (capacity == 0) { capacity = DEFAULT_NODES_CAPACITY; }
+
+    tree->types         = (uint8_t*)   calloc(capacity, sizeof(uint8_t));
+    tree->data          = (NodeData*)  calloc(capacity, sizeof(NodeData));
+    tree->left          = (NodeIndex*) calloc(capacity, sizeof(NodeIndex));
+    tree->right         = (NodeIndex*) calloc(capacity, sizeof(NodeIndex));
+    tree->nodesCount    = 0;
+    tree->nodesCapacity = capacity;
+
+    ASSERT_COMPACT_TREE(tree);
+}
+
+void destroy(CompactTree* tree)
+{
+    ASSERT_COMPACT_TREE(tree);
+
+    free(tree->types);
+    free(tree->data);
+    free(tree->left);
+    free(tree->right);
+
+    tree->types         = nullptr;
+    tree->data          = nullptr;
+    tree->left          = nullptr;
+    tree->right         = nullptr;
+    tree->nodesCount    = 0;
+    tree->nodesCapacity = 0;
+}
+
+NodeIndex addNode(CompactTree* tree, NodeType type, NodeData data, NodeIndex left, NodeIndex right)
+{
+    ASSERT_COMPACT_TREE(tree);
+    assert(type < TYPES_COUNT);
+
+    if (tree->nodesCount >= tree->nodesCapacity)
+    {
+        reallocNodes(tree);
+    }
+
+    NodeIndex node = (NodeIndex) tree->nodesCount++;
+    assert(node != NO_NODE);
+
+    tree->types[node] = (uint8_t) type;
+    tree->data[node]  = data;
+    tree->left[node]  = left;
+    tree->right[node] = right;
+
+    return node;
+}
+
+NodeIndex compactTree(CompactTree* tree, const Node* root)
+{
+    ASSERT_COMPACT_TREE(tree);
+
+    if (root == nullptr) { return NO_NODE; }
+
+    // Iterative preorder walk: the declaration and statement chains are as
+    // long as the program, so recursion could overflow the stack.
+    size_t        stackCapacity = DEFAULT_STACK_CAPACITY;
+    size_t        stackSize     = 0;
+    FlattenEntry* stack         = (FlattenEntry*) calloc(stackCapacity, sizeof(FlattenEntry));
+    assert(stack != nullptr);
+
+    stack[stackSize++] = { root, NO_NODE, false };
+
+    NodeIndex rootIndex = NO_NODE;
+
+    while (stackSize > 0)
+    {
+        FlattenEntry entry = stack[--stackSize];
+        NodeIndex    node  = addNode(tree, entry.node->type, entry.node->data, NO_NODE, NO_NODE);
+
+        if      (entry.parent == NO_NODE) { rootIndex                 = node; }
+        else if (entry.isLeft)            { tree->left[entry.parent]  = node; }
+        else                              { tree->right[entry.parent] = node; }
+
+        if (stackSize + 2 > stackCapacity)
+        {
+            stackCapacity *= REALLOC_MULTIPLIER;
+            stack = (FlattenEntry*) realloc(stack, stackCapacity * sizeof(FlattenEntry));
+            assert(stack != nullptr);
+        }
+
+        if (entry.node->right != nullptr) { stack[stackSize++] = { entry.node->right, node, false }; }
+        if (entry.node->left  != nullptr) { stack[stackSize++] = { entry.node->left,  node, true  }; }
+    }
+
+    free(stack);
+
+    return rootIndex;
+}
+
+NodeIndex getParent(const CompactTree* tree, NodeIndex node)
+{
+    ASSERT_COMPACT_TREE(tree);
+    assert(node < tree->nodesCount);
+
+    // In preorder a parent always precedes its children
+    for (NodeIndex i = node; i > 0; i--)
+    {
+        if (tree->left[i - 1] == node || tree->right[i - 1] == node)
+        {
+            return i - 1;
+        }
+    }
+
+    return NO_NODE;
+}
+
+size_t getMemoryUsed(const CompactTree* tree)
+{
+    assert(tree != nullptr);
+
+    return tree->nodesCount * (sizeof(uint8_t) + sizeof(NodeData) + 2 * sizeof(NodeIndex));
+}
+
+void reallocNodes(CompactTree* tree)
+{
+    ASSERT_COMPACT_TREE(tree);
+
+    tree->nodesCapacity *= REALLOC_MULTIPLIER;
+
+    tree->types = (uint8_t*)   realloc(tree->types, tree->nodesCapacity * sizeof(uint8_t));
+    tree->data  = (NodeData*)  realloc(tree->data,  tree->nodesCapacity * sizeof(NodeData));
+    tree->left  = (NodeIndex*) realloc(tree->left,  tree->nodesCapacity * sizeof(NodeIndex));
+    tree->right = (NodeIndex*) realloc(tree->right, tree->nodesCapacity * sizeof(NodeIndex));
+
+    ASSERT_COMPACT_TREE(tree);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include "expression_tree.h"
+
+typedef uint32_t NodeIndex;
+
+static const NodeIndex NO_NODE = UINT32_MAX;
+
+//------------------------------------------------------------------------------
+// Structure-of-arrays form of the syntax tree used by the back ends. Nodes are
+// addressed by 32-bit indices and laid out in preorder, so the root is always
+// node 0 and every function's nodes form one contiguous range. Parents aren't
+// stored, see getParent.
+//------------------------------------------------------------------------------
+struct CompactTree
+{
+    uint8_t*   types;
+    NodeData*  data;
+    NodeIndex* left;
+    NodeIndex* right;
+
+    size_t     nodesCount;
+    size_t     nodesCapacity;
+};
+
+#define NODE_TYPE(tree, node)  ((NodeType) (tree)->types[node])
+#define NODE_DATA(tree, node)  ((tree)->data[node])
+#define NODE_LEFT(tree, node)  ((tree)->left[node])
+#define NODE_RIGHT(tree, node) ((tree)->right[node])
+
+void      construct     (CompactTree* tree, size_t capacity);
+void      destroy       (CompactTree* tree);
+
+NodeIndex addNode       (CompactTree* tree, NodeType type, NodeData data, NodeIndex left, NodeIndex right);
+NodeIndex compactTree   (CompactTree* tree, const Node* root);
+NodeIndex getParent     (const CompactTree* tree, NodeIndex node);
+size_t    getMemoryUsed (const CompactTree* tree);
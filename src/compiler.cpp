@@ -1,55 +1,110 @@
 #include <assert.h>
 #include <string.h>
 #include "compiler.h"
+#include "peephole.h"
+#include "frame_slots.h"
 
-#define ASSERT_COMPILER(compiler) assert(compiler        != nullptr); \
-                                  assert(compiler->table != nullptr); \
-                                  assert(compiler->file  != nullptr); \
+#define ASSERT_COMPILER(compiler) assert(compiler                 != nullptr); \
+                                  assert(compiler->table          != nullptr); \
+                                  assert(compiler->emitter.buffer != nullptr || \
+                                         compiler->bytecode.code  != nullptr);
 
-#define OUTPUT   compiler->file
-#define CUR_FUNC compiler->curFunction
+#define OUTPUT      (&compiler->emitter)
+#define FUNCTION    (compiler->curFunction)
+#define CUR_FUNC    (compiler->curFunction->symbols)
 
-const size_t HORIZONTAL_LINE_LENGTH = 50;
+#define INSTRUCTION(value) (FUNCTION->instructions[value])
+#define BLOCK(block)       (FUNCTION->blocks[block])
 
-void compileError        (Compiler* compiler, CompilerError error); 
-
-void writeHorizontalLine (Compiler* compiler);
-void writeFunctionHeader (Compiler* compiler);
+#define IS_IMAGE    (compiler->format == IMAGE_OUTPUT)
 
-void writeFunction       (Compiler* compiler, Node* node);
-void writeBlock          (Compiler* compiler, Node* node);
-void writeStatement      (Compiler* compiler, Node* node);
+const size_t DEFAULT_LABELS_CAPACITY = 64;
+const size_t DEFAULT_FIXUPS_CAPACITY = 64;
+const size_t DEFAULT_CODE_CAPACITY   = 256;
+const size_t MAX_LABEL_NAME_LENGTH   = 64;
 
-void writeCondition      (Compiler* compiler, Node* node);
-void writeLoop           (Compiler* compiler, Node* node);
-void writeAssignment     (Compiler* compiler, Node* node);
-void writeReturn         (Compiler* compiler, Node* node);
+void compileError        (Compiler* compiler, CompilerError error); 
 
-void writeExpression     (Compiler* compiler, Node* node);
-void writeMath           (Compiler* compiler, Node* node);
-void writeCompare        (Compiler* compiler, Node* node);
-void writeNumber         (Compiler* compiler, Node* node);
-void writeVar            (Compiler* compiler, Node* node);
+void constructImage      (Compiler* compiler);
+void destroyImage        (Compiler* compiler);
+void addFixup            (CodeFixup** fixups, size_t* count, size_t* capacity, CodeFixup fixup);
+void resolveLabelFixups  (Compiler* compiler);
+void resolveCallFixups   (Compiler* compiler);
 
-void writeCall           (Compiler* compiler, Node* node);
-bool writeStdCall        (Compiler* compiler, Node* node);
+void writeFunctionHeader (Compiler* compiler);
 
-void construct(Compiler* compiler, Node* tree, SymbolTable* table)
+void prepareFunction     (Compiler* compiler);
+void finishFunction      (Compiler* compiler);
+void removeDeadValues    (Compiler* compiler);
+void findUsers           (Compiler* compiler);
+void selectTrees         (Compiler* compiler, IrBlockId block);
+bool isDeferrable        (Compiler* compiler, IrValue value);
+void takeOperands        (Compiler* compiler, const IrValue* operands, size_t count);
+void flushPending        (Compiler* compiler);
+void threadJumps         (Compiler* compiler);
+void markLabels          (Compiler* compiler);
+bool isJumpOnly          (Compiler* compiler, IrBlockId block);
+IrBlockId nextBlock      (Compiler* compiler, size_t position);
+
+void writeFunction       (Compiler* compiler);
+void writeBlock          (Compiler* compiler, size_t position);
+void writeValue          (Compiler* compiler, IrValue value);
+void pushValue           (Compiler* compiler, IrValue value);
+void writeCompare        (Compiler* compiler, IrValue value);
+void writeCall           (Compiler* compiler, IrValue value);
+void writeTerminator     (Compiler* compiler, IrBlockId block, IrBlockId next);
+void writePhiCopies      (Compiler* compiler, IrBlockId block, IrBlockId target);
+bool isCopyNeeded        (Compiler* compiler, IrValue phi, size_t edge);
+void writeBranch         (Compiler* compiler, IrValue branch, IrBlockId next);
+void writeJumpIf         (Compiler* compiler, IrValue condition, bool value, IrBlockId target);
+Opcode compareJump       (MathOp operation, bool inverted);
+Opcode mathInstruction   (IrOpcode opcode);
+
+void putSlot             (Compiler* compiler, Opcode opcode, uint32_t slot);
+void putStored           (Compiler* compiler, Opcode opcode, IrValue value);
+void putBlockJump        (Compiler* compiler, Opcode opcode, IrBlockId block);
+void putBlockLabel       (Compiler* compiler, IrBlockId block);
+
+void appendInstruction   (Compiler* compiler, Instruction instruction);
+void putInstruction      (Compiler* compiler, Opcode opcode);
+void putNumber           (Compiler* compiler, double number);
+void putRegister         (Compiler* compiler, Opcode opcode, Register reg);
+void putMemory           (Compiler* compiler, Opcode opcode, Register reg, int32_t offset);
+void putJump             (Compiler* compiler, Opcode opcode, LabelKind label, size_t index);
+void putLabel            (Compiler* compiler, LabelKind label, size_t index);
+void putCall             (Compiler* compiler, Function* function);
+void putEnter            (Compiler* compiler, size_t size);
+void putFunctionLabel    (Compiler* compiler);
+void putComment          (Compiler* compiler, const char* text);
+void putComment          (Compiler* compiler, const char* text, const char* name);
+void putBlankLine        (Compiler* compiler);
+
+void flushCode           (Compiler* compiler);
+void outputInstruction   (Compiler* compiler, const Instruction* instruction);
+void outputJump          (Compiler* compiler, const Instruction* jump);
+void outputLabel         (Compiler* compiler, LabelKind label, size_t index);
+void outputCall          (Compiler* compiler, size_t function);
+
+void construct(Compiler* compiler, IrProgram* program, OutputFormat format, bool commentsEnabled,
+               PeepholeStats* peepholeStats)
 {
-    assert(compiler != nullptr);
-    assert(tree     != nullptr);
-    assert(table    != nullptr);
-
-    compiler->table = table; 
-    compiler->tree  = tree;
+    assert(compiler       != nullptr);
+    assert(program        != nullptr);
+    assert(program->table != nullptr);
+
+    compiler->table           = program->table; 
+    compiler->program         = program;
+    compiler->format          = format;
+    compiler->commentsEnabled = commentsEnabled && format == TEXT_OUTPUT;
+    compiler->peepholeStats   = peepholeStats;
 }
 
 void destroy(Compiler* compiler)
 {
     assert(compiler != nullptr);
 
-    compiler->table = nullptr;
-    compiler->tree  = nullptr;
+    compiler->table   = nullptr;
+    compiler->program = nullptr;
 }
 
 const char* errorString(CompilerError error)
@@ -64,7 +119,7 @@ const char* errorString(CompilerError error)
 
 void compileError(Compiler* compiler, CompilerError error)
 {
-    ASSERT_COMPILER(compiler);
+    assert(compiler != nullptr);
 
     compiler->status = error;
 
@@ -76,370 +131,1411 @@ CompilerError compile(Compiler* compiler, const char* outputFile)
     assert(compiler   != nullptr);
     assert(outputFile != nullptr);
 
-    OUTPUT = fopen(outputFile, "w");
-    if (OUTPUT == nullptr)
+    if (getFunction(compiler->table, MAIN_SYMBOL) == nullptr)
     {
-        compileError(compiler, COMPILER_ERROR_FILE_OPEN_FAILURE);
+        compileError(compiler, COMPILER_ERROR_NO_MAIN_FUNCTION);
         return compiler->status;
     }
 
-    if (getFunction(compiler->table, MAIN_FUNCTION_NAME) == nullptr)
+    FILE* file = fopen(outputFile, IS_IMAGE ? "wb" : "w");
+    if (file == nullptr)
     {
-        compileError(compiler, COMPILER_ERROR_NO_MAIN_FUNCTION);
+        compileError(compiler, COMPILER_ERROR_FILE_OPEN_FAILURE);
         return compiler->status;
     }
 
-    CUR_FUNC = compiler->table->functions;
+    if (IS_IMAGE)
+    {
+        constructImage(compiler);
+    }
+    else
+    {
+        construct(OUTPUT, file, compiler->commentsEnabled);
+    }
+
+    compiler->code.instructions = (Instruction*) malloc(DEFAULT_CODE_CAPACITY * sizeof(Instruction));
+    compiler->code.count        = 0;
+    compiler->code.capacity     = DEFAULT_CODE_CAPACITY;
+    assert(compiler->code.instructions != nullptr);
+
+    FUNCTION = compiler->program->functions;
+
+    Function* mainFunction = getFunction(compiler->table, MAIN_SYMBOL);
 
-    fprintf(OUTPUT, "call :love\n"
-                    "hlt\n\n");
+    // Memory starts zeroed, so main's enter finds an empty frame at 0 and puts its own there too
+    putCall        (compiler, mainFunction);
+    putInstruction (compiler, OP_HLT);
+    putBlankLine   (compiler);
+    flushCode      (compiler);
+
+    // Functions go in the symbol table's order, which is the order they are declared in
+    for (size_t i = 0; i < compiler->program->functionsCount; i++)
+    {
+        FUNCTION = &compiler->program->functions[i];
+        if (FUNCTION->removed) { continue; }
+
+        writeFunction(compiler);
+    }
 
-    Node* curDeclaration = compiler->tree;
-    while (curDeclaration != nullptr)
+    free(compiler->code.instructions);
+    compiler->code = {};
+
+    if (IS_IMAGE)
+    {
+        resolveCallFixups(compiler);
+
+        if (!writeImage(&compiler->bytecode, file))
+        {
+            compileError(compiler, COMPILER_ERROR_FILE_WRITE_FAILURE);
+        }
+
+        destroyImage(compiler);
+    }
+    else
     {
-        writeFunction(compiler, curDeclaration->right);
-        curDeclaration = curDeclaration->left;
-        CUR_FUNC++;
+        destroy(OUTPUT);
     }
 
-    fclose(OUTPUT);
+    fclose(file);
 
     return compiler->status;
 }
 
-void writeHorizontalLine(Compiler* compiler)
+void writeFunctionHeader(Compiler* compiler)
 {
     ASSERT_COMPILER(compiler);
 
-    fprintf(OUTPUT, "; ");
+    if (!compiler->commentsEnabled) { return; }
+
+    emitHorizontalLine (OUTPUT);
+    emitComment        (OUTPUT, getSymbolName(CUR_FUNC->name));
+    emit               (OUTPUT, ";\n; params: ");
 
-    for (size_t i = 0; i < HORIZONTAL_LINE_LENGTH; i++)
+    for (size_t i = 0; i < CUR_FUNC->paramsCount; i++)
     {
-        fprintf(OUTPUT, "=");
+        emit(OUTPUT, getSymbolName(CUR_FUNC->vars[i]));
+
+        if (i < CUR_FUNC->paramsCount - 1)
+        {
+            emit(OUTPUT, ", ");
+        }
+    }
+
+    emit(OUTPUT, "\n; vars: ");
+
+    for (size_t i = CUR_FUNC->paramsCount; i < CUR_FUNC->varsCount; i++)
+    {
+        emit(OUTPUT, getSymbolName(CUR_FUNC->vars[i]));
+
+        if (i < CUR_FUNC->varsCount - 1)
+        {
+            emit(OUTPUT, ", ");
+        }
     }
 
-    fprintf(OUTPUT, "\n");
+    emitChar           (OUTPUT, '\n');
+    emitHorizontalLine (OUTPUT);
 }
 
-void writeFunctionHeader(Compiler* compiler)
+//------------------------------------------------------------------------------
+// The function's IR is written block by block in its layout order. The entry
+// pops the arguments to the parameters' slots, which are the first ones in
+// the frame, the rest of the values that need a slot get one after them.
+//------------------------------------------------------------------------------
+void writeFunction(Compiler* compiler)
 {
     ASSERT_COMPILER(compiler);
+    assert(FUNCTION->blocksCount > 0);
 
-    writeHorizontalLine(compiler);
-    fprintf(OUTPUT, "; %s\n;\n; params: ", CUR_FUNC->name);
+    prepareFunction(compiler);
+
+    writeFunctionHeader (compiler);
+    putFunctionLabel    (compiler);
+    putEnter            (compiler, compiler->slotsCount + 2);
 
     for (size_t i = 0; i < CUR_FUNC->paramsCount; i++)
     {
-        fprintf(OUTPUT, "%s", CUR_FUNC->vars[i]);
+        putSlot(compiler, OP_POP_MEM, (uint32_t) i);
+    }
 
-        if (i < CUR_FUNC->paramsCount - 1)
+    putBlankLine(compiler);
+
+    for (size_t i = 0; i < FUNCTION->layoutCount; i++)
+    {
+        writeBlock(compiler, i);
+    }
+
+    flushCode      (compiler);
+    finishFunction (compiler);
+
+    if (IS_IMAGE) { resolveLabelFixups(compiler); }
+}
+
+void prepareFunction(Compiler* compiler)
+{
+    ASSERT_COMPILER(compiler);
+
+    splitCriticalEdges(compiler->program, FUNCTION);
+
+    size_t valuesCount = FUNCTION->instructionsCount + 1;
+    size_t blocksCount = FUNCTION->blocksCount + 1;
+
+    compiler->uses         = (uint32_t*)       calloc(valuesCount, sizeof(uint32_t));
+    compiler->users        = (IrValue*)        calloc(valuesCount, sizeof(IrValue));
+    compiler->placements   = (ValuePlacement*) calloc(valuesCount, sizeof(ValuePlacement));
+    compiler->slots        = (uint32_t*)       calloc(valuesCount, sizeof(uint32_t));
+    compiler->registers    = (Register*)       calloc(valuesCount, sizeof(Register));
+    compiler->pending      = (IrValue*)        calloc(valuesCount, sizeof(IrValue));
+    compiler->forwards     = (IrBlockId*)      calloc(blocksCount, sizeof(IrBlockId));
+    compiler->labeled      = (bool*)           calloc(blocksCount, sizeof(bool));
+    compiler->pendingCount = 0;
+
+    assert(compiler->uses       != nullptr);
+    assert(compiler->users      != nullptr);
+    assert(compiler->placements != nullptr);
+    assert(compiler->slots      != nullptr);
+    assert(compiler->registers  != nullptr);
+    assert(compiler->pending    != nullptr);
+    assert(compiler->forwards   != nullptr);
+    assert(compiler->labeled    != nullptr);
+
+    countUses        (FUNCTION, compiler->uses, nullptr);
+    removeDeadValues (compiler);
+    findUsers        (compiler);
+
+    for (size_t i = 0; i < FUNCTION->layoutCount; i++)
+    {
+        selectTrees(compiler, FUNCTION->layout[i]);
+    }
+
+    assignSlots (compiler);
+    threadJumps (compiler);
+    markLabels  (compiler);
+}
+
+void finishFunction(Compiler* compiler)
+{
+    ASSERT_COMPILER(compiler);
+
+    free(compiler->uses);
+    free(compiler->users);
+    free(compiler->placements);
+    free(compiler->slots);
+    free(compiler->registers);
+    free(compiler->pending);
+    free(compiler->forwards);
+    free(compiler->labeled);
+
+    compiler->uses       = nullptr;
+    compiler->users      = nullptr;
+    compiler->placements = nullptr;
+    compiler->slots      = nullptr;
+    compiler->registers  = nullptr;
+    compiler->pending    = nullptr;
+    compiler->forwards   = nullptr;
+    compiler->labeled    = nullptr;
+}
+
+//------------------------------------------------------------------------------
+// A pure value nothing uses isn't computed, and then its operands lose a use.
+// Parameters are popped by the entry all the same.
+//------------------------------------------------------------------------------
+void removeDeadValues(Compiler* compiler)
+{
+    ASSERT_COMPILER(compiler);
+
+    IrValue* worklist      = (IrValue*) calloc(FUNCTION->instructionsCount + 1, sizeof(IrValue));
+    size_t   worklistCount = 0;
+    assert(worklist != nullptr);
+
+    for (IrValue value = 0; value < FUNCTION->instructionsCount; value++)
+    {
+        IrOpcode opcode = INSTRUCTION(value).opcode;
+
+        if (INSTRUCTION(value).block == NO_BLOCK)
+        {
+            compiler->placements[value] = DEAD_VALUE;
+            continue;
+        }
+
+        if (compiler->uses[value] == 0 && isPure(opcode) && opcode != IR_PARAM)
         {
-            fprintf(OUTPUT, ", ");
+            compiler->placements[value] = DEAD_VALUE;
+            worklist[worklistCount++]   = value;
         }
     }
 
-    fprintf(OUTPUT, "\n; vars: ");
+    while (worklistCount > 0)
+    {
+        const IrInstruction* instruction = &INSTRUCTION(worklist[--worklistCount]);
 
-    for (size_t i = CUR_FUNC->paramsCount; i < CUR_FUNC->varsCount; i++)
+        for (size_t i = 0; i < instruction->operandsCount; i++)
+        {
+            IrValue operand = instruction->operands[i];
+            compiler->uses[operand]--;
+
+            bool dead = compiler->uses[operand] == 0 && isPure(INSTRUCTION(operand).opcode) &&
+                        INSTRUCTION(operand).opcode != IR_PARAM && compiler->placements[operand] != DEAD_VALUE;
+
+            if (dead)
+            {
+                compiler->placements[operand] = DEAD_VALUE;
+                worklist[worklistCount++]     = operand;
+            }
+        }
+    }
+
+    free(worklist);
+}
+
+// The users left after dead values are gone, a single use is all that matters
+void findUsers(Compiler* compiler)
+{
+    ASSERT_COMPILER(compiler);
+
+    for (IrValue value = 0; value < FUNCTION->instructionsCount; value++)
     {
-        fprintf(OUTPUT, "%s", CUR_FUNC->vars[i]);
+        if (compiler->placements[value] == DEAD_VALUE) { continue; }
 
-        if (i < CUR_FUNC->varsCount - 1)
+        const IrInstruction* instruction = &INSTRUCTION(value);
+
+        for (size_t i = 0; i < instruction->operandsCount; i++)
+        {
+            compiler->users[instruction->operands[i]] = value;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Decides which values are computed right where they are used. The values
+// that could be are kept on a pending stack in the order they come in the
+// block, which is also the order their code would leave them on the CPU
+// stack. When an instruction's pending operands are exactly the top of it,
+// in the order of the operands, they are taken as its subtrees and nothing
+// moves past anything it shouldn't. Anything else stores all that's pending.
+// The block's last uses are the copies to the successor's phis, or the
+// terminator's operand.
+//------------------------------------------------------------------------------
+void selectTrees(Compiler* compiler, IrBlockId block)
+{
+    ASSERT_COMPILER(compiler);
+
+    const IrBlock* instructions = &BLOCK(block);
+
+    for (size_t i = 0; i < instructions->codeCount; i++)
+    {
+        IrValue              value       = instructions->code[i];
+        const IrInstruction* instruction = &INSTRUCTION(value);
+
+        if (isTerminator(instruction->opcode)) { break; }
+
+        switch (instruction->opcode)
+        {
+            case IR_CONST: { continue; }
+
+            case IR_PHI:
+            case IR_PARAM:
+            {
+                if (compiler->placements[value] != DEAD_VALUE) { compiler->placements[value] = STORED_VALUE; }
+                continue;
+            }
+
+            default:
+            {
+                break;
+            }
+        }
+
+        if (compiler->placements[value] == DEAD_VALUE) { continue; }
+
+        takeOperands(compiler, instruction->operands, instruction->operandsCount);
+
+        if (isDeferrable(compiler, value))
+        {
+            compiler->placements[value] = DEFERRED_VALUE;
+            compiler->pending[compiler->pendingCount++] = value;
+        }
+        else
         {
-            fprintf(OUTPUT, ", ");
+            flushPending(compiler);
+            compiler->placements[value] = STORED_VALUE;
         }
     }
 
-    fprintf(OUTPUT, "\n");
-    writeHorizontalLine(compiler);
+    IrValue last = terminator(FUNCTION, block);
+    assert(last != NO_VALUE);
+
+    if (INSTRUCTION(last).opcode == IR_JUMP)
+    {
+        IrBlockId      target   = INSTRUCTION(last).targets[0];
+        const IrBlock* phis     = &BLOCK(target);
+        size_t         edge     = 0;
+        IrValue*       incoming = (IrValue*) calloc(phis->codeCount + 1, sizeof(IrValue));
+        size_t         count    = 0;
+        assert(incoming != nullptr);
+
+        while (phis->preds[edge] != block) { edge++; }
+
+        for (size_t i = 0; i < phis->codeCount && INSTRUCTION(phis->code[i]).opcode == IR_PHI; i++)
+        {
+            IrValue phi = phis->code[i];
+            if (compiler->placements[phi] == DEAD_VALUE) { continue; }
+
+            IrValue operand = INSTRUCTION(phi).operands[edge];
+            if (operand != phi) { incoming[count++] = operand; }
+        }
 
-    fprintf(OUTPUT, "%s:\n", CUR_FUNC->name);
+        takeOperands(compiler, incoming, count);
+        free(incoming);
+    }
+    else
+    {
+        takeOperands(compiler, INSTRUCTION(last).operands, INSTRUCTION(last).operandsCount);
+    }
+
+    flushPending(compiler);
 }
 
-void writeFunction(Compiler* compiler, Node* node)
+//------------------------------------------------------------------------------
+// A value with a single use in its own block, or a single copy to a phi of
+// the block its block jumps to. Functions with riddikulus load their
+// variables into values, so those can be deferred as well.
+//------------------------------------------------------------------------------
+bool isDeferrable(Compiler* compiler, IrValue value)
 {
     ASSERT_COMPILER(compiler);
-    assert(node != nullptr);
 
-    writeFunctionHeader(compiler);
+    const IrInstruction* instruction = &INSTRUCTION(value);
 
-    for (size_t i = 0; i < CUR_FUNC->paramsCount; i++)
+    if (!hasResult(instruction->opcode) || compiler->uses[value] != 1) { return false; }
+
+    const IrInstruction* user = &INSTRUCTION(compiler->users[value]);
+
+    if (user->opcode != IR_PHI) { return user->block == instruction->block; }
+
+    IrValue last = terminator(FUNCTION, instruction->block);
+    if (INSTRUCTION(last).opcode != IR_JUMP || INSTRUCTION(last).targets[0] != user->block) { return false; }
+
+    const IrBlock* target = &BLOCK(user->block);
+
+    for (size_t i = 0; i < target->predsCount; i++)
+    {
+        if (user->operands[i] == value) { return target->preds[i] == instruction->block; }
+    }
+
+    return false;
+}
+
+void takeOperands(Compiler* compiler, const IrValue* operands, size_t count)
+{
+    ASSERT_COMPILER(compiler);
+    assert(operands != nullptr || count == 0);
+
+    size_t deferred = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (compiler->placements[operands[i]] == DEFERRED_VALUE) { deferred++; }
+    }
+
+    if (deferred == 0) { return; }
+
+    bool   onTop = deferred <= compiler->pendingCount;
+    size_t next  = compiler->pendingCount - deferred;
+
+    for (size_t i = 0; i < count && onTop; i++)
+    {
+        if (compiler->placements[operands[i]] != DEFERRED_VALUE) { continue; }
+
+        onTop = compiler->pending[next++] == operands[i];
+    }
+
+    if (onTop) { compiler->pendingCount -= deferred; }
+    else       { flushPending(compiler);             }
+}
+
+void flushPending(Compiler* compiler)
+{
+    ASSERT_COMPILER(compiler);
+
+    for (size_t i = 0; i < compiler->pendingCount; i++)
     {
-        fprintf(OUTPUT, "pop [rax+%zu]\n", 2 + i);
+        compiler->placements[compiler->pending[i]] = STORED_VALUE;
     }
 
-    fprintf(OUTPUT, "\n");
-    writeBlock(compiler, node->left);
-    fprintf(OUTPUT, "ret\n\n");
+    compiler->pendingCount = 0;
 }
 
-void writeBlock(Compiler* compiler, Node* node)
+//------------------------------------------------------------------------------
+// A block with nothing but a jump to a block without phis isn't written: the
+// jumps to it go straight to where it jumps. Blocks of functions with
+// riddikulus are all written, any of them may be jumped to.
+//------------------------------------------------------------------------------
+void threadJumps(Compiler* compiler)
 {
     ASSERT_COMPILER(compiler);
-    assert(node != nullptr);
 
-    Node* curStatement = node->right;
-    while (curStatement != nullptr)
+    for (IrBlockId block = 0; block < FUNCTION->blocksCount; block++)
+    {
+        IrBlockId target = block;
+
+        for (size_t steps = 0; steps < FUNCTION->blocksCount && isJumpOnly(compiler, target); steps++)
+        {
+            target = INSTRUCTION(terminator(FUNCTION, target)).targets[0];
+        }
+
+        compiler->forwards[block] = target;
+    }
+}
+
+bool isJumpOnly(Compiler* compiler, IrBlockId block)
+{
+    ASSERT_COMPILER(compiler);
+
+    const IrBlock* instructions = &BLOCK(block);
+
+    if (FUNCTION->inMemory || block == 0 || instructions->removed || instructions->codeCount != 1) { return false; }
+
+    const IrInstruction* jump = &INSTRUCTION(instructions->code[0]);
+    if (jump->opcode != IR_JUMP) { return false; }
+
+    // Skipped on the way to the target, so it must have nothing to copy to its phis
+    const IrBlock* target = &BLOCK(jump->targets[0]);
+    size_t         edge   = 0;
+
+    while (target->preds[edge] != block) { edge++; }
+
+    for (size_t i = 0; i < target->codeCount && INSTRUCTION(target->code[i]).opcode == IR_PHI; i++)
     {
-        writeStatement(compiler, curStatement);
-        curStatement = curStatement->right;
+        if (isCopyNeeded(compiler, target->code[i], edge)) { return false; }
     }
+
+    return true;
 }
 
-void writeStatement(Compiler* compiler, Node* node)
+// Written blocks only, NO_BLOCK after the last one
+IrBlockId nextBlock(Compiler* compiler, size_t position)
 {
     ASSERT_COMPILER(compiler);
-    assert(node       != nullptr);
-    assert(node->left != nullptr);
 
-    switch (node->left->type)
+    for (size_t i = position + 1; i < FUNCTION->layoutCount; i++)
     {
-        case COND_TYPE:  { writeCondition  (compiler, node->left); break; }
-        case LOOP_TYPE:  { writeLoop       (compiler, node->left); break; }
-        case VDECL_TYPE: { writeAssignment (compiler, node->left); break; }
-        case ASSG_TYPE:  { writeAssignment (compiler, node->left); break; }
-        case JUMP_TYPE:  { writeReturn     (compiler, node->left); break; }
-        default:         { writeExpression (compiler, node->left); break; }
+        IrBlockId block = FUNCTION->layout[i];
+        if (compiler->forwards[block] == block) { return block; }
     }
+
+    return NO_BLOCK;
 }
 
-void writeCondition(Compiler* compiler, Node* node)
+// Mirrors writeTerminator, so that the blocks only ever fallen into get no label
+void markLabels(Compiler* compiler)
 {
     ASSERT_COMPILER(compiler);
-    assert(node != nullptr);
 
-    fprintf(OUTPUT, "; IF statement\n");
+    for (size_t i = 0; i < FUNCTION->layoutCount; i++)
+    {
+        IrBlockId block = FUNCTION->layout[i];
+        if (compiler->forwards[block] != block) { continue; }
+
+        if (FUNCTION->inMemory && block != 0) { compiler->labeled[block] = true; }
 
-    writeExpression(compiler, node->left);
+        IrBlockId            next = nextBlock(compiler, i);
+        const IrInstruction* last = &INSTRUCTION(terminator(FUNCTION, block));
+
+        if (last->opcode == IR_JUMP)
+        {
+            IrBlockId target = compiler->forwards[last->targets[0]];
+            if (target != next) { compiler->labeled[target] = true; }
+        }
+        else if (last->opcode == IR_BRANCH)
+        {
+            IrBlockId whenTrue  = compiler->forwards[last->targets[0]];
+            IrBlockId whenFalse = compiler->forwards[last->targets[1]];
+
+            if (whenFalse != next)                       { compiler->labeled[whenFalse] = true; }
+            if (whenTrue  != next || whenFalse == next)  { compiler->labeled[whenTrue]  = true; }
+        }
+    }
+}
 
-    size_t label = compiler->curCondLabel++;
+void writeBlock(Compiler* compiler, size_t position)
+{
+    ASSERT_COMPILER(compiler);
 
-    fprintf(OUTPUT, "push 0\n"
-                    "je :IF_END_%zu\n\n",
-                    label);
+    IrBlockId block = FUNCTION->layout[position];
+    if (compiler->forwards[block] != block) { return; }
 
-    writeBlock(compiler, node->right->left);    
+    if (compiler->labeled[block]) { putBlockLabel(compiler, block); }
 
-    fprintf(OUTPUT, "jmp :IF_ELSE_END_%zu\n"
-                    "IF_END_%zu:\n", 
-                    label,
-                    label);
+    const IrBlock* instructions = &BLOCK(block);
 
-    if (node->right->right != nullptr)
+    for (size_t i = 0; i + 1 < instructions->codeCount; i++)
     {
-        writeBlock(compiler, node->right->right);
+        IrValue value = instructions->code[i];
+        if (compiler->placements[value] != STORED_VALUE || INSTRUCTION(value).opcode == IR_PARAM ||
+            INSTRUCTION(value).opcode == IR_PHI)
+        {
+            continue;
+        }
+
+        writeValue(compiler, value);
+
+        if (hasResult(INSTRUCTION(value).opcode)) { putStored(compiler, OP_POP_MEM, value); }
+
+        putBlankLine(compiler);
     }
 
-    fprintf(OUTPUT, "IF_ELSE_END_%zu:\n\n", label);
+    writeTerminator(compiler, block, nextBlock(compiler, position));
 }
 
-void writeLoop(Compiler* compiler, Node* node)
+// Leaves the value on the stack, its deferred operands are computed on the way
+void writeValue(Compiler* compiler, IrValue value)
 {
     ASSERT_COMPILER(compiler);
-    assert(node != nullptr);
 
-    size_t label = compiler->curLoopLabel++;
+    const IrInstruction* instruction = &INSTRUCTION(value);
+
+    switch (instruction->opcode)
+    {
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_DIV:
+        {
+            pushValue      (compiler, instruction->operands[0]);
+            pushValue      (compiler, instruction->operands[1]);
+            putInstruction (compiler, mathInstruction(instruction->opcode));
+            break;
+        }
+
+        case IR_EQUAL:
+        case IR_NOT_EQUAL:
+        case IR_LESS_EQUAL:
+        case IR_GREATER_EQUAL:
+        case IR_LESS:
+        case IR_GREATER:
+        {
+            writeCompare(compiler, value);
+            break;
+        }
+
+        case IR_FLOOR:
+        case IR_SQRT:
+        {
+            pushValue      (compiler, instruction->operands[0]);
+            putInstruction (compiler, mathInstruction(instruction->opcode));
+            break;
+        }
+
+        case IR_OUT:
+        {
+            pushValue      (compiler, instruction->operands[0]);
+            putInstruction (compiler, OP_OUT);
+            break;
+        }
 
-    fprintf(OUTPUT, "\nWHILE_%zu:\n", label);
-    writeExpression(compiler, node->left);
+        case IR_IN:    { putInstruction (compiler, OP_IN);                                  break; }
+        case IR_LOAD:  { putSlot        (compiler, OP_PUSH_MEM, instruction->index);        break; }
+        case IR_CALL:  { writeCall      (compiler, value);                                  break; }
 
-    fprintf(OUTPUT, "push 0\n"
-                    "je :WHILE_END_%zu\n"
-                    "WHILE_BODY_%zu:\n",
-                    label,
-                    label);
+        case IR_STORE:
+        {
+            pushValue (compiler, instruction->operands[0]);
+            putSlot   (compiler, OP_POP_MEM, instruction->index);
+            break;
+        }
 
-    writeBlock(compiler, node->right);
+        default:
+        {
+            assert(!"Not a value computed by code");
+            break;
+        }
+    }
+}
+
+void pushValue(Compiler* compiler, IrValue value)
+{
+    ASSERT_COMPILER(compiler);
+    assert(compiler->placements[value] != DEAD_VALUE);
 
-    fprintf(OUTPUT, "jmp :WHILE_%zu\n"
-                    "WHILE_END_%zu:\n\n",
-                    label,
-                    label);
+    if (INSTRUCTION(value).opcode == IR_CONST)
+    {
+        putNumber(compiler, INSTRUCTION(value).number);
+    }
+    else if (compiler->placements[value] == DEFERRED_VALUE)
+    {
+        writeValue(compiler, value);
+    }
+    else
+    {
+        putStored(compiler, OP_PUSH_MEM, value);
+    }
 }
 
-void writeAssignment(Compiler* compiler, Node* node)
+// A comparison used as a number, 1 or 0
+void writeCompare(Compiler* compiler, IrValue value)
 {
     ASSERT_COMPILER(compiler);
-    assert(node != nullptr);
 
-    writeExpression(compiler, node->right);
+    const IrInstruction* instruction = &INSTRUCTION(value);
+    MathOp               operation   = (MathOp) (instruction->opcode - IR_ADD);
+    size_t               label       = compiler->curCmpLabel++;
 
-    fprintf(OUTPUT, "pop [rax+%d]\n\n", 2 + getVarOffset(CUR_FUNC, node->left->data.id));
+    pushValue(compiler, instruction->operands[0]);
+    pushValue(compiler, instruction->operands[1]);
+
+    putJump  (compiler, compareJump(operation, false), COMPARISON_LABEL, label);
+    putNumber(compiler, 0);
+    putJump  (compiler, OP_JMP, COMPARISON_END_LABEL, label);
+    putLabel (compiler, COMPARISON_LABEL,     label);
+    putNumber(compiler, 1);
+    putLabel (compiler, COMPARISON_END_LABEL, label);
 }
 
-void writeReturn(Compiler* compiler, Node* node)
+// Arguments are pushed in the order they were evaluated, the first parameter ends up on top
+void writeCall(Compiler* compiler, IrValue value)
 {
     ASSERT_COMPILER(compiler);
-    assert(node != nullptr);
 
-    writeExpression(compiler, node->right);
+    const IrInstruction* instruction = &INSTRUCTION(value);
+    Function*            callee      = &compiler->table->functions[instruction->index];
 
-    fprintf(OUTPUT, "push rax\n"
-                    "push [rax]\n"
-                    "sub\n"
-                    "pop rax\n"
-                    "ret\n\n");
+    for (size_t i = 0; i < instruction->operandsCount; i++)
+    {
+        pushValue(compiler, instruction->operands[i]);
+    }
+
+    putComment (compiler, "calling ", getSymbolName(callee->name));
+    putCall    (compiler, callee);
 }
 
-void writeExpression(Compiler* compiler, Node* node)
+//------------------------------------------------------------------------------
+// Falling off the end of a function returns 0, as in the C back end, so that
+// every call leaves exactly one value.
+//------------------------------------------------------------------------------
+void writeTerminator(Compiler* compiler, IrBlockId block, IrBlockId next)
 {
     ASSERT_COMPILER(compiler);
-    assert(node != nullptr);
 
-    switch (node->type)
+    IrValue              last        = terminator(FUNCTION, block);
+    const IrInstruction* instruction = &INSTRUCTION(last);
+
+    switch (instruction->opcode)
     {
-        case MATH_TYPE: { writeMath   (compiler, node); break; }
-        case NUMB_TYPE: { writeNumber (compiler, node); break; }
-        case NAME_TYPE: { writeVar    (compiler, node); break; }
-        case CALL_TYPE: { writeCall   (compiler, node); break; }
-        default:        { assert(!"Invalid node type"); break; }
+        case IR_JUMP:
+        {
+            writePhiCopies(compiler, block, instruction->targets[0]);
+
+            IrBlockId target = compiler->forwards[instruction->targets[0]];
+            if (target != next) { putBlockJump(compiler, OP_JMP, target); }
+            break;
+        }
+
+        case IR_BRANCH:
+        {
+            writeBranch(compiler, last, next);
+            break;
+        }
+
+        case IR_RETURN:
+        {
+            if (instruction->operandsCount > 0) { pushValue (compiler, instruction->operands[0]); }
+            else                                { putNumber (compiler, 0);                        }
+
+            putInstruction (compiler, OP_LEAVE);
+            putInstruction (compiler, OP_RET);
+            break;
+        }
+
+        case IR_RANDOM_JUMP:
+        {
+            putInstruction(compiler, OP_RNDJMP);
+            break;
+        }
+
+        default:
+        {
+            assert(!"Invalid terminator");
+            break;
+        }
     }
+
+    putBlankLine(compiler);
 }
 
-void writeMath(Compiler* compiler, Node* node)
+//------------------------------------------------------------------------------
+// The phis of the target take their operands for this edge all at once: every
+// value is pushed before any phi's slot is written, so that phis that swap
+// their values don't overwrite each other.
+//------------------------------------------------------------------------------
+void writePhiCopies(Compiler* compiler, IrBlockId block, IrBlockId target)
 {
     ASSERT_COMPILER(compiler);
-    assert(node != nullptr);
 
-    MathOp operation = node->data.operation;
+    const IrBlock* phis  = &BLOCK(target);
+    size_t         edge  = 0;
+    size_t         count = 0;
+
+    while (phis->preds[edge] != block) { edge++; }
 
-    if (operation > DIV_OP)
+    for (size_t i = 0; i < phis->codeCount && INSTRUCTION(phis->code[i]).opcode == IR_PHI; i++)
     {
-        writeCompare(compiler, node);
+        IrValue phi = phis->code[i];
+        if (!isCopyNeeded(compiler, phi, edge)) { continue; }
+
+        pushValue(compiler, INSTRUCTION(phi).operands[edge]);
+        count++;
+    }
+
+    for (size_t i = phis->codeCount; i > 0 && count > 0; i--)
+    {
+        IrValue phi = phis->code[i - 1];
+        if (INSTRUCTION(phi).opcode != IR_PHI || !isCopyNeeded(compiler, phi, edge)) { continue; }
+
+        putStored(compiler, OP_POP_MEM, phi);
+        count--;
+    }
+}
+
+// Not when the phi keeps its value on the edge, or the value it gets is already in its place
+bool isCopyNeeded(Compiler* compiler, IrValue phi, size_t edge)
+{
+    ASSERT_COMPILER(compiler);
+
+    IrValue operand = INSTRUCTION(phi).operands[edge];
+
+    if (compiler->placements[phi] == DEAD_VALUE || operand == phi) { return false; }
+
+    return compiler->placements[operand] != STORED_VALUE || compiler->registers[operand] != compiler->registers[phi] ||
+           compiler->slots[operand] != compiler->slots[phi];
+}
+
+//------------------------------------------------------------------------------
+// Only the target that isn't next is jumped to. A comparison that is only the
+// branch's condition jumps on its operands directly, without materializing
+// 0/1 and comparing that against 0.
+//------------------------------------------------------------------------------
+void writeBranch(Compiler* compiler, IrValue branch, IrBlockId next)
+{
+    ASSERT_COMPILER(compiler);
+
+    const IrInstruction* instruction = &INSTRUCTION(branch);
+
+    IrValue   condition = instruction->operands[0];
+    IrBlockId whenTrue  = compiler->forwards[instruction->targets[0]];
+    IrBlockId whenFalse = compiler->forwards[instruction->targets[1]];
+
+    if (whenFalse == next)
+    {
+        writeJumpIf(compiler, condition, true, whenTrue);
+    }
+    else if (whenTrue == next)
+    {
+        writeJumpIf(compiler, condition, false, whenFalse);
+    }
+    else
+    {
+        writeJumpIf  (compiler, condition, true, whenTrue);
+        putBlockJump (compiler, OP_JMP, whenFalse);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Equality jumps if false with the inverted jcc. An ordering comparison with
+// NaN is false both ways, so its inverted jcc would take NaN as true: it
+// jumps over the jump to the target on success instead.
+//------------------------------------------------------------------------------
+void writeJumpIf(Compiler* compiler, IrValue condition, bool value, IrBlockId target)
+{
+    ASSERT_COMPILER(compiler);
+
+    IrOpcode opcode = INSTRUCTION(condition).opcode;
+    bool     fused  = compiler->placements[condition] == DEFERRED_VALUE && opcode >= IR_EQUAL &&
+                      opcode <= IR_GREATER;
+
+    if (!fused)
+    {
+        pushValue    (compiler, condition);
+        putNumber    (compiler, 0);
+        putBlockJump (compiler, value ? OP_JNE : OP_JE, target);
+        return;
+    }
+
+    MathOp operation = (MathOp) (opcode - IR_ADD);
+
+    pushValue(compiler, INSTRUCTION(condition).operands[0]);
+    pushValue(compiler, INSTRUCTION(condition).operands[1]);
+
+    if (value || operation == EQUAL_OP || operation == NOT_EQUAL_OP)
+    {
+        putBlockJump(compiler, compareJump(operation, !value), target);
         return;
     }
 
-    writeExpression(compiler, node->left);
-    writeExpression(compiler, node->right);
+    size_t cmpLabel = compiler->curCmpLabel++;
+
+    putJump      (compiler, compareJump(operation, false), COMPARISON_LABEL, cmpLabel);
+    putBlockJump (compiler, OP_JMP, target);
+    putLabel     (compiler, COMPARISON_LABEL, cmpLabel);
+}
+
+Opcode compareJump(MathOp operation, bool inverted)
+{
+    switch (operation)
+    {
+        case EQUAL_OP:         { return inverted ? OP_JNE : OP_JE;  }
+        case NOT_EQUAL_OP:     { return inverted ? OP_JE  : OP_JNE; }
+        case LESS_OP:          { return inverted ? OP_JAE : OP_JB;  }
+        case GREATER_OP:       { return inverted ? OP_JBE : OP_JA;  }
+        case LESS_EQUAL_OP:    { return inverted ? OP_JA  : OP_JBE; }
+        case GREATER_EQUAL_OP: { return inverted ? OP_JB  : OP_JAE; }
+        default:               { assert(!"Invalid cmp op"); return OP_HLT; }
+    }
+}
+
+Opcode mathInstruction(IrOpcode opcode)
+{
+    switch (opcode)
+    {
+        case IR_ADD:   { return OP_ADD;  }
+        case IR_SUB:   { return OP_SUB;  }
+        case IR_MUL:   { return OP_MUL;  }
+        case IR_DIV:   { return OP_DIV;  }
+        case IR_FLOOR: { return OP_FLR;  }
+        case IR_SQRT:  { return OP_SQRT; }
+        default:       { assert(!"Invalid math op"); return OP_HLT; }
+    }
+}
+
+void putSlot(Compiler* compiler, Opcode opcode, uint32_t slot)
+{
+    ASSERT_COMPILER(compiler);
+
+    putMemory(compiler, opcode, RAX, (int32_t) (2 + slot));
+}
+
+// OP_PUSH_MEM or OP_POP_MEM of a stored value, which may be kept in a register instead
+void putStored(Compiler* compiler, Opcode opcode, IrValue value)
+{
+    ASSERT_COMPILER(compiler);
+    assert(opcode == OP_PUSH_MEM || opcode == OP_POP_MEM);
+    assert(compiler->placements[value] == STORED_VALUE);
+
+    Register reg = compiler->registers[value];
+
+    if (reg != NO_REGISTER)
+    {
+        putRegister(compiler, opcode == OP_PUSH_MEM ? OP_PUSH_REG : OP_POP_REG, reg);
+    }
+    else
+    {
+        putSlot(compiler, opcode, compiler->slots[value]);
+    }
+}
+
+void putBlockJump(Compiler* compiler, Opcode opcode, IrBlockId block)
+{
+    ASSERT_COMPILER(compiler);
+
+    putJump(compiler, opcode, BLOCK(block).label, BLOCK(block).labelIndex);
+}
+
+void putBlockLabel(Compiler* compiler, IrBlockId block)
+{
+    ASSERT_COMPILER(compiler);
+
+    putLabel(compiler, BLOCK(block).label, BLOCK(block).labelIndex);
+}
+
+//------------------------------------------------------------------------------
+// Code generation appends to the current function's instruction list, see
+// flushCode for how it gets to the output.
+//------------------------------------------------------------------------------
+void appendInstruction(Compiler* compiler, Instruction instruction)
+{
+    ASSERT_COMPILER(compiler);
+
+    InstructionList* code = &compiler->code;
 
-    switch (node->data.operation)
+    if (code->count >= code->capacity)
     {
-        case ADD_OP: { fprintf(OUTPUT, "add\n\n"); break; }
-        case SUB_OP: { fprintf(OUTPUT, "sub\n\n"); break; }
-        case MUL_OP: { fprintf(OUTPUT, "mul\n\n"); break; }
-        case DIV_OP: { fprintf(OUTPUT, "div\n\n"); break; }
-        default:     { assert(!"Invalid math op"); break; }
+        code->capacity     *= 2;
+        code->instructions  = (Instruction*) realloc(code->instructions, code->capacity * sizeof(Instruction));
+        assert(code->instructions != nullptr);
     }
+
+    code->instructions[code->count++] = instruction;
+}
+
+void putInstruction(Compiler* compiler, Opcode opcode)
+{
+    ASSERT_COMPILER(compiler);
+
+    Instruction instruction = {};
+    instruction.kind   = CODE_INSTRUCTION;
+    instruction.opcode = opcode;
+
+    appendInstruction(compiler, instruction);
+}
+
+void putNumber(Compiler* compiler, double number)
+{
+    ASSERT_COMPILER(compiler);
+
+    Instruction instruction = {};
+    instruction.kind   = CODE_INSTRUCTION;
+    instruction.opcode = OP_PUSH_NUMBER;
+    instruction.number = number;
+
+    appendInstruction(compiler, instruction);
+}
+
+void putRegister(Compiler* compiler, Opcode opcode, Register reg)
+{
+    ASSERT_COMPILER(compiler);
+    assert(opcode == OP_PUSH_REG || opcode == OP_POP_REG);
+    assert(reg    <  REGISTERS_COUNT);
+
+    Instruction instruction = {};
+    instruction.kind   = CODE_INSTRUCTION;
+    instruction.opcode = opcode;
+    instruction.reg    = reg;
+
+    appendInstruction(compiler, instruction);
+}
+
+void putMemory(Compiler* compiler, Opcode opcode, Register reg, int32_t offset)
+{
+    ASSERT_COMPILER(compiler);
+    assert(opcode == OP_PUSH_MEM || opcode == OP_POP_MEM);
+    assert(reg    <  REGISTERS_COUNT);
+
+    Instruction instruction = {};
+    instruction.kind   = CODE_INSTRUCTION;
+    instruction.opcode = opcode;
+    instruction.reg    = reg;
+    instruction.offset = offset;
+
+    appendInstruction(compiler, instruction);
+}
+
+void putJump(Compiler* compiler, Opcode opcode, LabelKind label, size_t index)
+{
+    ASSERT_COMPILER(compiler);
+    assert(label < LABEL_KINDS_COUNT);
+
+    Instruction instruction = {};
+    instruction.kind   = CODE_INSTRUCTION;
+    instruction.opcode = opcode;
+    instruction.label  = label;
+    instruction.index  = index;
+
+    appendInstruction(compiler, instruction);
+}
+
+void putLabel(Compiler* compiler, LabelKind label, size_t index)
+{
+    ASSERT_COMPILER(compiler);
+    assert(label < LABEL_KINDS_COUNT);
+
+    Instruction instruction = {};
+    instruction.kind  = LABEL_INSTRUCTION;
+    instruction.label = label;
+    instruction.index = index;
+
+    appendInstruction(compiler, instruction);
+}
+
+void putCall(Compiler* compiler, Function* function)
+{
+    ASSERT_COMPILER(compiler);
+    assert(function != nullptr);
+
+    Instruction instruction = {};
+    instruction.kind   = CODE_INSTRUCTION;
+    instruction.opcode = OP_CALL;
+    instruction.index  = (size_t) (function - compiler->table->functions);
+
+    appendInstruction(compiler, instruction);
 }
 
-void writeCompare(Compiler* compiler, Node* node)
+//------------------------------------------------------------------------------
+// The callee makes its own frame, right after the caller's: enter saves the
+// caller's frame size at the new [rax], moves rax there and stores the size at
+// [rax+1]. leave moves rax back by the saved size.
+//------------------------------------------------------------------------------
+void putEnter(Compiler* compiler, size_t size)
 {
     ASSERT_COMPILER(compiler);
-    assert(node != nullptr);
+    assert(size <= UINT32_MAX);
+
+    Instruction instruction = {};
+    instruction.kind   = CODE_INSTRUCTION;
+    instruction.opcode = OP_ENTER;
+    instruction.index  = size;
+
+    appendInstruction(compiler, instruction);
+}
 
-    size_t label = compiler->curCmpLabel++;
+// Functions start a new list, so the label goes straight to the output
+void putFunctionLabel(Compiler* compiler)
+{
+    ASSERT_COMPILER(compiler);
+    assert(compiler->code.count == 0);
 
-    writeExpression(compiler, node->left);
-    writeExpression(compiler, node->right);
+    const char* name = getSymbolName(CUR_FUNC->name);
 
-    switch (node->data.operation)
+    if (!IS_IMAGE)
     {
-        case EQUAL_OP:         { fprintf(OUTPUT, "je");     break; }
-        case NOT_EQUAL_OP:     { fprintf(OUTPUT, "jne");    break; }
-        case LESS_OP:          { fprintf(OUTPUT, "jb");     break; }
-        case GREATER_OP:       { fprintf(OUTPUT, "ja");     break; }
-        case LESS_EQUAL_OP:    { fprintf(OUTPUT, "jbe");    break; }
-        case GREATER_EQUAL_OP: { fprintf(OUTPUT, "jae");    break; }
-        default:               { assert(!"Invalid cmp op"); break;}
+        emitLabel(OUTPUT, name);
+        return;
     }
 
-    fprintf(OUTPUT, " :COMPARISON_%zu\n"
-                    "push 0\n"
-                    "jmp :COMPARISON_END_%zu\n"
-                    "COMPARISON_%zu:\n"
-                    "push 1\n"
-                    "COMPARISON_END_%zu:\n\n", 
-                    label,
-                    label,
-                    label,
-                    label);
+    uint32_t offset = (uint32_t) compiler->bytecode.size;
+    compiler->functionOffsets[CUR_FUNC - compiler->table->functions] = offset;
+
+    addSymbol(&compiler->bytecode, offset, name, strlen(name), CODE_FUNCTION);
+}
+
+void putComment(Compiler* compiler, const char* text)
+{
+    putComment(compiler, text, nullptr);
+}
+
+void putComment(Compiler* compiler, const char* text, const char* name)
+{
+    ASSERT_COMPILER(compiler);
+    assert(text != nullptr);
+
+    if (!compiler->commentsEnabled) { return; }
+
+    Instruction instruction = {};
+    instruction.kind = COMMENT_INSTRUCTION;
+    instruction.text = text;
+    instruction.name = name;
+
+    appendInstruction(compiler, instruction);
 }
 
-void writeNumber(Compiler* compiler, Node* node)
+void putBlankLine(Compiler* compiler)
 {
     ASSERT_COMPILER(compiler);
-    assert(node != nullptr);
 
-    fprintf(OUTPUT, "push %lg\n", node->data.number);
+    if (!compiler->commentsEnabled) { return; }
+
+    Instruction instruction = {};
+    instruction.kind = BLANK_LINE_INSTRUCTION;
+
+    appendInstruction(compiler, instruction);
+}
+
+//------------------------------------------------------------------------------
+// Runs the peephole pass over the list if the code is optimized, then writes
+// it as assembly text or image bytecode, depending on the output format. Text
+// mnemonics and label names are the ones the software CPU assembler expects.
+//------------------------------------------------------------------------------
+void flushCode(Compiler* compiler)
+{
+    ASSERT_COMPILER(compiler);
+
+    if (compiler->peepholeStats != nullptr)
+    {
+        optimizeCode(&compiler->code, compiler->peepholeStats);
+    }
+
+    for (size_t i = 0; i < compiler->code.count; i++)
+    {
+        outputInstruction(compiler, &compiler->code.instructions[i]);
+    }
+
+    compiler->code.count = 0;
 }
 
-void writeVar(Compiler* compiler, Node* node)
+void outputInstruction(Compiler* compiler, const Instruction* instruction)
 {
     ASSERT_COMPILER(compiler);
-    assert(node != nullptr);
+    assert(instruction != nullptr);
+
+    switch (instruction->kind)
+    {
+        case LABEL_INSTRUCTION:
+        {
+            outputLabel(compiler, instruction->label, instruction->index);
+            return;
+        }
+
+        case COMMENT_INSTRUCTION:
+        {
+            if (instruction->name == nullptr) { emitComment(OUTPUT, instruction->text);                    }
+            else                              { emitComment(OUTPUT, instruction->text, instruction->name); }
+            return;
+        }
+
+        case BLANK_LINE_INSTRUCTION: { emitBlankLine(OUTPUT); return; }
+        case DELETED_INSTRUCTION:    {                        return; }
+        case CODE_INSTRUCTION:       {                        break;  }
+        default:                     { assert(!"Invalid instruction kind"); return; }
+    }
+
+    Opcode opcode = instruction->opcode;
+
+    switch (opcode)
+    {
+        case OP_PUSH_NUMBER:
+        {
+            if (IS_IMAGE)
+            {
+                appendOpcode (&compiler->bytecode, OP_PUSH_NUMBER);
+                appendDouble (&compiler->bytecode, instruction->number);
+            }
+            else
+            {
+                emitInstruction(OUTPUT, "push", instruction->number);
+            }
+            break;
+        }
+
+        case OP_PUSH_REG:
+        case OP_POP_REG:
+        {
+            if (IS_IMAGE)
+            {
+                appendOpcode   (&compiler->bytecode, opcode);
+                appendRegister (&compiler->bytecode, instruction->reg);
+            }
+            else
+            {
+                emitRegInstruction(OUTPUT, OPCODE_MNEMONICS[opcode], REGISTER_NAMES[instruction->reg]);
+            }
+            break;
+        }
+
+        case OP_PUSH_MEM:
+        case OP_POP_MEM:
+        {
+            if (IS_IMAGE)
+            {
+                appendOpcode   (&compiler->bytecode, opcode);
+                appendRegister (&compiler->bytecode, instruction->reg);
+                appendInt32    (&compiler->bytecode, instruction->offset);
+            }
+            else
+            {
+                emitMemInstruction(OUTPUT, OPCODE_MNEMONICS[opcode], REGISTER_NAMES[instruction->reg],
+                                   instruction->offset);
+            }
+            break;
+        }
+
+        case OP_JMP:
+        case OP_JE:
+        case OP_JNE:
+        case OP_JA:
+        case OP_JB:
+        case OP_JAE:
+        case OP_JBE:
+        {
+            outputJump(compiler, instruction);
+            break;
+        }
+
+        case OP_CALL:
+        {
+            outputCall(compiler, instruction->index);
+            break;
+        }
+
+        case OP_ENTER:
+        {
+            if (IS_IMAGE)
+            {
+                appendOpcode (&compiler->bytecode, OP_ENTER);
+                appendUint32 (&compiler->bytecode, (uint32_t) instruction->index);
+            }
+            else
+            {
+                emitInstruction(OUTPUT, "enter", (double) instruction->index);
+            }
+            break;
+        }
 
-    fprintf(OUTPUT, "push [rax+%d]\n", 2 + getVarOffset(CUR_FUNC, node->data.id));
+        default:
+        {
+            if (IS_IMAGE) { appendOpcode(&compiler->bytecode, opcode);          }
+            else          { emitInstruction(OUTPUT, OPCODE_MNEMONICS[opcode]); }
+            break;
+        }
+    }
 }
 
-void writeCall(Compiler* compiler, Node* node)
+void outputJump(Compiler* compiler, const Instruction* jump)
 {
     ASSERT_COMPILER(compiler);
-    assert(node != nullptr);
+    assert(jump        != nullptr);
+    assert(jump->label <  LABEL_KINDS_COUNT);
+
+    if (!IS_IMAGE)
+    {
+        emitJump(OUTPUT, OPCODE_MNEMONICS[jump->opcode], LABEL_NAMES[jump->label], jump->index);
+        return;
+    }
 
-    if (writeStdCall(compiler, node)) { return; }
+    appendOpcode(&compiler->bytecode, jump->opcode);
 
-    Function* function = getFunction(compiler->table, node->left->data.id);
-    if (function == nullptr) 
+    CodeFixup fixup = { (uint32_t) compiler->bytecode.size, jump->label, jump->index };
+    addFixup(&compiler->fixups, &compiler->fixupsCount, &compiler->fixupsCapacity, fixup);
+
+    appendUint32(&compiler->bytecode, 0);
+}
+
+void outputLabel(Compiler* compiler, LabelKind label, size_t index)
+{
+    ASSERT_COMPILER(compiler);
+    assert(label < LABEL_KINDS_COUNT);
+
+    if (!IS_IMAGE)
     {
-        compileError(compiler, COMPILER_ERROR_CALL_UNDEFINED_FUNCTION);
-        return; 
+        emitLabel(OUTPUT, LABEL_NAMES[label], index);
+        return;
     }
 
-    Node* curParamExpr = node->right;
-    while (curParamExpr != nullptr)
+    size_t capacity = compiler->labelCapacities[label];
+    if (index >= capacity)
     {
-        writeExpression(compiler, curParamExpr->left);
-        curParamExpr = curParamExpr->right;
+        while (index >= compiler->labelCapacities[label])
+        {
+            compiler->labelCapacities[label] *= 2;
+        }
+
+        compiler->labelOffsets[label] = (uint32_t*) realloc(compiler->labelOffsets[label],
+                                                            compiler->labelCapacities[label] * sizeof(uint32_t));
+        assert(compiler->labelOffsets[label] != nullptr);
     }
 
-    fprintf(OUTPUT, "; calling %s\n"
-                    "push [rax+1]\n"
-                    "push rax\n"
-                    "push [rax+1]\n"
-                    "add\n"
-                    "pop rax\n"
-                    "pop [rax]\n"
-                    "push %zu\n"
-                    "pop [rax+1]\n"
-                    "call :%s\n\n",
-                    function->name,
-                    function->varsCount + 2,
-                    function->name);
+    uint32_t offset = (uint32_t) compiler->bytecode.size;
+    compiler->labelOffsets[label][index] = offset;
+
+    char name[MAX_LABEL_NAME_LENGTH] = {};
+    int  length = snprintf(name, sizeof(name), "%s_%zu", LABEL_NAMES[label], index);
+    assert(length > 0 && (size_t) length < sizeof(name));
+
+    addSymbol(&compiler->bytecode, offset, name, length, CODE_LABEL);
 }
 
-bool writeStdCall(Compiler* compiler, Node* node)
+void outputCall(Compiler* compiler, size_t function)
 {
     ASSERT_COMPILER(compiler);
-    assert(node != nullptr);
+    assert(function < compiler->table->functionsCount);
 
-    const char* name = node->left->data.id;
-    if (strcmp(name, KEYWORDS[PRINT_KEYWORD].name) == 0)
+    if (!IS_IMAGE)
     {
-        writeExpression(compiler, node->right->left);
-        fprintf(OUTPUT, "out\n");
-    } 
-    else if (strcmp(name, KEYWORDS[SCAN_KEYWORD].name) == 0)
+        emitJump(OUTPUT, "call", getSymbolName(compiler->table->functions[function].name));
+        return;
+    }
+
+    appendOpcode(&compiler->bytecode, OP_CALL);
+
+    CodeFixup fixup = { (uint32_t) compiler->bytecode.size, LABEL_KINDS_COUNT, function };
+    addFixup(&compiler->callFixups, &compiler->callFixupsCount, &compiler->callFixupsCapacity, fixup);
+
+    appendUint32(&compiler->bytecode, 0);
+}
+
+void constructImage(Compiler* compiler)
+{
+    assert(compiler        != nullptr);
+    assert(compiler->table != nullptr);
+
+    construct(&compiler->bytecode);
+
+    for (size_t i = 0; i < LABEL_KINDS_COUNT; i++)
     {
-        fprintf(OUTPUT, "in\n");
-    } 
-    else if (strcmp(name, KEYWORDS[FLOOR_KEYWORD].name) == 0)
+        compiler->labelOffsets[i]    = (uint32_t*) malloc(DEFAULT_LABELS_CAPACITY * sizeof(uint32_t));
+        compiler->labelCapacities[i] = DEFAULT_LABELS_CAPACITY;
+        assert(compiler->labelOffsets[i] != nullptr);
+    }
+
+    compiler->functionOffsets    = (uint32_t*)  calloc(compiler->table->functionsCount, sizeof(uint32_t));
+    compiler->fixups             = (CodeFixup*) malloc(DEFAULT_FIXUPS_CAPACITY * sizeof(CodeFixup));
+    compiler->fixupsCount        = 0;
+    compiler->fixupsCapacity     = DEFAULT_FIXUPS_CAPACITY;
+    compiler->callFixups         = (CodeFixup*) malloc(DEFAULT_FIXUPS_CAPACITY * sizeof(CodeFixup));
+    compiler->callFixupsCount    = 0;
+    compiler->callFixupsCapacity = DEFAULT_FIXUPS_CAPACITY;
+
+    assert(compiler->functionOffsets != nullptr);
+    assert(compiler->fixups          != nullptr);
+    assert(compiler->callFixups      != nullptr);
+}
+
+void destroyImage(Compiler* compiler)
+{
+    ASSERT_COMPILER(compiler);
+
+    destroy(&compiler->bytecode);
+
+    for (size_t i = 0; i < LABEL_KINDS_COUNT; i++)
     {
-        writeExpression(compiler, node->right->left);
-        fprintf(OUTPUT, "flr\n");
+        free(compiler->labelOffsets[i]);
+        compiler->labelOffsets[i]    = nullptr;
+        compiler->labelCapacities[i] = 0;
     }
-    else if (strcmp(name, KEYWORDS[SQRT_KEYWORD].name) == 0)
+
+    free(compiler->functionOffsets);
+    free(compiler->fixups);
+    free(compiler->callFixups);
+
+    compiler->functionOffsets    = nullptr;
+    compiler->fixups             = nullptr;
+    compiler->fixupsCount        = 0;
+    compiler->fixupsCapacity     = 0;
+    compiler->callFixups         = nullptr;
+    compiler->callFixupsCount    = 0;
+    compiler->callFixupsCapacity = 0;
+}
+
+void addFixup(CodeFixup** fixups, size_t* count, size_t* capacity, CodeFixup fixup)
+{
+    assert(fixups   != nullptr);
+    assert(count    != nullptr);
+    assert(capacity != nullptr);
+
+    if (*count >= *capacity)
     {
-        writeExpression(compiler, node->right->left);
-        fprintf(OUTPUT, "sqrt\n");
-    }  
-    else if (strcmp(name, KEYWORDS[RAND_JUMP_KEYWORD].name) == 0)
+        *capacity *= 2;
+        *fixups    = (CodeFixup*) realloc(*fixups, *capacity * sizeof(CodeFixup));
+        assert(*fixups != nullptr);
+    }
+
+    (*fixups)[(*count)++] = fixup;
+}
+
+// Every label a function jumps to is inside the function, so by its end they're all known
+void resolveLabelFixups(Compiler* compiler)
+{
+    ASSERT_COMPILER(compiler);
+
+    for (size_t i = 0; i < compiler->fixupsCount; i++)
     {
-        fprintf(OUTPUT, "rndjmp\n");
+        CodeFixup fixup  = compiler->fixups[i];
+        uint32_t  target = compiler->labelOffsets[fixup.label][fixup.index];
+
+        memcpy(compiler->bytecode.code + fixup.position, &target, sizeof(target));
     }
-    else 
+
+    compiler->fixupsCount = 0;
+}
+
+void resolveCallFixups(Compiler* compiler)
+{
+    ASSERT_COMPILER(compiler);
+
+    for (size_t i = 0; i < compiler->callFixupsCount; i++)
     {
-        return false;
+        CodeFixup fixup  = compiler->callFixups[i];
+        uint32_t  target = compiler->functionOffsets[fixup.index];
+
+        memcpy(compiler->bytecode.code + fixup.position, &target, sizeof(target));
     }
 
-    return true;
-}
\ No newline at end of file
+    compiler->callFixupsCount = 0;
+}
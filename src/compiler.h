@@ -2,7 +2,9 @@
 
 #include <stdio.h>
 #include "symbol_table.h"
-#include "expression_tree.h"
+#include "ir.h"
+#include "emitter.h"
+#include "bytecode.h"
 
 enum CompilerError
 {
@@ -10,6 +12,7 @@ enum CompilerError
     COMPILER_ERROR_FILE_OPEN_FAILURE,
     COMPILER_ERROR_NO_MAIN_FUNCTION,
     COMPILER_ERROR_CALL_UNDEFINED_FUNCTION,
+    COMPILER_ERROR_FILE_WRITE_FAILURE,
 
     COMPILER_ERRORS_COUNT
 };
@@ -18,24 +21,120 @@ static const char* COMPILER_ERROR_STRINGS[COMPILER_ERRORS_COUNT] = {
     "no error",
     "couldn't open file to write output to",
     "main function ('love') wasn't found",
-    "calling undefined function"
+    "calling undefined function",
+    "couldn't write the output file"
 };
 
+enum OutputFormat
+{
+    TEXT_OUTPUT,  // assembly text for the software CPU
+    IMAGE_OUTPUT  // bytecode image, see bytecode.h
+};
+
+//------------------------------------------------------------------------------
+// Jump operand in the image waiting for its target. Jumps to labels are
+// patched at the end of the function that contains them, calls (index is the
+// callee's index in the symbol table) at the end of compile.
+//------------------------------------------------------------------------------
+struct CodeFixup
+{
+    uint32_t  position;
+    LabelKind label;
+    size_t    index;
+};
+
+//------------------------------------------------------------------------------
+// Code of the function being compiled. It's kept as a list until the end of
+// the function, where the peephole pass (peephole.h) may rewrite it, and then
+// written out as text or image code.
+//------------------------------------------------------------------------------
+enum InstructionKind
+{
+    CODE_INSTRUCTION,       // opcode with its operands
+    LABEL_INSTRUCTION,
+    COMMENT_INSTRUCTION,    // text output with comments only
+    BLANK_LINE_INSTRUCTION, // text output with comments only
+    DELETED_INSTRUCTION     // removed by the peephole pass
+};
+
+struct Instruction
+{
+    InstructionKind kind;
+    Opcode          opcode;
+    Register        reg;    // pushed or popped register, base of a memory operand
+    int32_t         offset; // of a memory operand
+    double          number; // pushed number
+    LabelKind       label;  // label or jump target
+    size_t          index;  // label number, callee's index in the symbol table for calls, frame size for enter
+    const char*     text;   // comment
+    const char*     name;   // appended to the comment, nullptr if none
+};
+
+struct InstructionList
+{
+    Instruction* instructions;
+    size_t       count;
+    size_t       capacity;
+};
+
+//------------------------------------------------------------------------------
+// How a value of the function being compiled gets to the stack where it's
+// used. A deferred value has a single use that comes right after it, so it's
+// computed there, as part of the user's code. A stored one is popped to its
+// register or frame slot once computed and pushed from there. Constants are
+// pushed as numbers wherever they are used.
+//------------------------------------------------------------------------------
+enum ValuePlacement : uint8_t
+{
+    UNPLACED_VALUE,
+    DEAD_VALUE,     // pure and unused, not computed at all
+    DEFERRED_VALUE,
+    STORED_VALUE
+};
+
+struct PeepholeStats;
+
 struct Compiler
 {
-    SymbolTable*  table;
-    Node*         tree;
-    FILE*         file;
-    Function*     curFunction;
+    SymbolTable*       table;
+    IrProgram*         program;
+    OutputFormat       format;
+    Emitter            emitter;
+    bool               commentsEnabled;
+    IrFunction*        curFunction;
+
+    InstructionList    code;
+    PeepholeStats*     peepholeStats; // nullptr unless the code is optimized
+
+    uint32_t*          uses;          // indexed by the current function's values
+    IrValue*           users;
+    ValuePlacement*    placements;
+    uint32_t*          slots;
+    Register*          registers;     // NO_REGISTER for the values in frame slots, see frame_slots.h
+    IrBlockId*         forwards;      // where a jump to each block really goes, see threadJumps
+    bool*              labeled;       // blocks something jumps to
+    IrValue*           pending;       // see selectTrees
+    size_t             pendingCount;
+    size_t             slotsCount;
+
+    Bytecode           bytecode;
+    uint32_t*          labelOffsets    [LABEL_KINDS_COUNT]; // indexed by label number
+    size_t             labelCapacities [LABEL_KINDS_COUNT];
+    uint32_t*          functionOffsets;                     // indexed like table->functions
+    CodeFixup*         fixups;
+    size_t             fixupsCount;
+    size_t             fixupsCapacity;
+    CodeFixup*         callFixups;
+    size_t             callFixupsCount;
+    size_t             callFixupsCapacity;
 
-    size_t        curCondLabel;
-    size_t        curLoopLabel;
-    size_t        curCmpLabel;
+    size_t             curCmpLabel;
 
-    CompilerError status;
+    CompilerError      status;
 };
 
-void          construct   (Compiler* compiler, Node* tree, SymbolTable* table);
+void          construct   (Compiler* compiler, IrProgram* program, OutputFormat format, bool commentsEnabled,
+                           PeepholeStats* peepholeStats);
 void          destroy     (Compiler* compiler);
 const char*   errorString (CompilerError error);
 CompilerError compile     (Compiler* compiler, const char* outputFile);
\ No newline at end of file
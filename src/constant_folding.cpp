@@ -0,0 +1,332 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include "constant_folding.h"
+
+#define NUMBER(value)             newNode(NUMB_TYPE, { .number = value }, nullptr, nullptr)
+#define IS_NUMBER(node)           ((node)->type == NUMB_TYPE)
+#define IS_NUMBER_EQUAL(node, x)  (IS_NUMBER(node) && (node)->data.number == (x))
+#define IS_OPERATION(node, op)    ((node)->type == MATH_TYPE && (node)->data.operation == (op))
+#define IS_ADDITIVE(node)         (IS_OPERATION(node, ADD_OP) || IS_OPERATION(node, SUB_OP))
+
+const size_t COMPARE_INSTRUCTIONS = 4; // jcc, push 0, jmp, push 1
+const size_t CALL_INSTRUCTIONS    = 9; // frame switch, frame size and the call itself
+
+void   simplifySubtree   (Node* node, FoldingStats* stats);
+bool   simplifyMath      (Node* node);
+bool   foldMath          (Node* node);
+bool   foldStdCall       (Node* node);
+bool   reassociate       (Node* node);
+bool   applyIdentities   (Node* node);
+
+void   setAdditive       (Node* node, Node* variable, double constant);
+void   replaceWithChild  (Node* node, Node* child);
+void   replaceWithNumber (Node* node, double number);
+
+void foldConstants(Node* root, FoldingStats* stats)
+{
+    assert(stats != nullptr);
+
+    simplifySubtree(root, stats);
+}
+
+//------------------------------------------------------------------------------
+// Children are simplified first, so every rule below only has to look one or
+// two levels down. Only MATH nodes and calls of floor/sqrt are ever rewritten.
+//------------------------------------------------------------------------------
+void simplifySubtree(Node* node, FoldingStats* stats)
+{
+    if (node == nullptr) { return; }
+
+    simplifySubtree(node->left,  stats);
+    simplifySubtree(node->right, stats);
+
+    if (node->type != MATH_TYPE && node->type != CALL_TYPE) { return; }
+
+    size_t instructionsBefore = countInstructions(node);
+    bool   simplified         = (node->type == MATH_TYPE) ? simplifyMath(node) : foldStdCall(node);
+
+    if (simplified)
+    {
+        stats->simplifiedExpressions++;
+        stats->removedInstructions += instructionsBefore - countInstructions(node);
+    }
+}
+
+bool simplifyMath(Node* node)
+{
+    assert(node       != nullptr);
+    assert(node->type == MATH_TYPE);
+
+    if (foldMath(node)) { return true; }
+
+    // Keep constants of commutative operations on the right, so that chains look the same
+    if ((IS_OPERATION(node, ADD_OP) || IS_OPERATION(node, MUL_OP)) && IS_NUMBER(node->left) && !IS_NUMBER(node->right))
+    {
+        Node* constant = node->left;
+        setLeft  (node, node->right);
+        setRight (node, constant);
+    }
+
+    bool simplified = reassociate(node);
+
+    if (applyIdentities(node)) { simplified = true; }
+
+    return simplified;
+}
+
+bool foldMath(Node* node)
+{
+    assert(node       != nullptr);
+    assert(node->type == MATH_TYPE);
+
+    if (!IS_NUMBER(node->left) || !IS_NUMBER(node->right)) { return false; }
+
+    // Division by zero is left to run time
+    if (IS_OPERATION(node, DIV_OP) && node->right->data.number == 0) { return false; }
+
+    replaceWithNumber(node, calculate(node->data.operation, node->left->data.number, node->right->data.number));
+
+    return true;
+}
+
+bool foldStdCall(Node* node)
+{
+    assert(node       != nullptr);
+    assert(node->type == CALL_TYPE);
+
+    SymbolId function = node->left->data.name.id;
+    if (function != FLOOR_SYMBOL && function != SQRT_SYMBOL) { return false; }
+
+    Node* argument = node->right->left;
+    if (!IS_NUMBER(argument)) { return false; }
+
+    double value = argument->data.number;
+
+    if (function == FLOOR_SYMBOL)
+    {
+        replaceWithNumber(node, floor(value));
+        return true;
+    }
+
+    if (value < 0) { return false; }
+
+    replaceWithNumber(node, sqrt(value));
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Merges the constants of (x +- c1) +- c2, (c1 - x) +- c2, c2 - (x +- c1),
+// c2 - (c1 - x) and (x * c1) * c2, so that a chain needs a single constant.
+//------------------------------------------------------------------------------
+bool reassociate(Node* node)
+{
+    assert(node       != nullptr);
+    assert(node->type == MATH_TYPE);
+
+    if (IS_OPERATION(node, MUL_OP) && IS_NUMBER(node->right) &&
+        IS_OPERATION(node->left, MUL_OP) && IS_NUMBER(node->left->right))
+    {
+        Node* product = NUMBER(node->left->right->data.number * node->right->data.number);
+
+        setLeft  (node, node->left->left);
+        setRight (node, product);
+        return true;
+    }
+
+    if (!IS_ADDITIVE(node)) { return false; }
+
+    double sign = IS_OPERATION(node, ADD_OP) ? 1 : -1;
+
+    if (IS_NUMBER(node->right) && IS_ADDITIVE(node->left))
+    {
+        Node*  inner    = node->left;
+        double constant = sign * node->right->data.number;
+
+        if (IS_NUMBER(inner->right))
+        {
+            constant += IS_OPERATION(inner, ADD_OP) ? inner->right->data.number : -inner->right->data.number;
+            setAdditive(node, inner->left, constant);
+            return true;
+        }
+
+        if (IS_NUMBER(inner->left) && IS_OPERATION(inner, SUB_OP))
+        {
+            setLeft  (node, NUMBER(inner->left->data.number + constant));
+            setRight (node, inner->right);
+            setData  (node, SUB_OP);
+            return true;
+        }
+
+        return false;
+    }
+
+    if (IS_OPERATION(node, SUB_OP) && IS_NUMBER(node->left) && IS_ADDITIVE(node->right))
+    {
+        Node*  inner    = node->right;
+        double constant = node->left->data.number;
+
+        if (IS_NUMBER(inner->right))
+        {
+            constant -= IS_OPERATION(inner, ADD_OP) ? inner->right->data.number : -inner->right->data.number;
+            setLeft  (node, NUMBER(constant));
+            setRight (node, inner->left);
+            return true;
+        }
+
+        if (IS_NUMBER(inner->left) && IS_OPERATION(inner, SUB_OP))
+        {
+            setAdditive(node, inner->right, constant - inner->left->data.number);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// x + 0, 0 + x, x - 0, x * 1, 1 * x, x / 1 -> x
+// x * 0 is left alone, it's NaN for inf and NaN and -0 for negative x
+//------------------------------------------------------------------------------
+bool applyIdentities(Node* node)
+{
+    assert(node != nullptr);
+
+    if (node->type != MATH_TYPE) { return false; }
+
+    switch (node->data.operation)
+    {
+        case ADD_OP:
+        {
+            if (IS_NUMBER_EQUAL(node->right, 0)) { replaceWithChild(node, node->left);  return true; }
+            if (IS_NUMBER_EQUAL(node->left,  0)) { replaceWithChild(node, node->right); return true; }
+            break;
+        }
+
+        case SUB_OP:
+        case DIV_OP:
+        {
+            double identity = IS_OPERATION(node, SUB_OP) ? 0 : 1;
+            if (IS_NUMBER_EQUAL(node->right, identity)) { replaceWithChild(node, node->left); return true; }
+            break;
+        }
+
+        case MUL_OP:
+        {
+            if (IS_NUMBER_EQUAL(node->right, 1)) { replaceWithChild(node, node->left);  return true; }
+            if (IS_NUMBER_EQUAL(node->left,  1)) { replaceWithChild(node, node->right); return true; }
+            break;
+        }
+
+        default: { break; }
+    }
+
+    return false;
+}
+
+double calculate(MathOp operation, double a, double b)
+{
+    switch (operation)
+    {
+        case ADD_OP:           { return a + b;  }
+        case SUB_OP:           { return a - b;  }
+        case MUL_OP:           { return a * b;  }
+        case DIV_OP:           { return a / b;  }
+        case EQUAL_OP:         { return a == b; }
+        case NOT_EQUAL_OP:     { return a != b; }
+        case LESS_EQUAL_OP:    { return a <= b; }
+        case GREATER_EQUAL_OP: { return a >= b; }
+        case LESS_OP:          { return a <  b; }
+        case GREATER_OP:       { return a >  b; }
+        default:               { assert(!"Invalid math op"); return 0; }
+    }
+}
+
+void setAdditive(Node* node, Node* variable, double constant)
+{
+    assert(node     != nullptr);
+    assert(variable != nullptr);
+
+    setData  (node, (constant < 0) ? SUB_OP : ADD_OP);
+    setLeft  (node, variable);
+    setRight (node, NUMBER(fabs(constant)));
+}
+
+void replaceWithChild(Node* node, Node* child)
+{
+    assert(node  != nullptr);
+    assert(child != nullptr);
+
+    Node* parent = node->parent;
+
+    copyNode(node, child);
+    node->parent = parent;
+
+    deleteNode(child);
+}
+
+void replaceWithNumber(Node* node, double number)
+{
+    assert(node != nullptr);
+
+    setData(node, number);
+    node->left  = nullptr;
+    node->right = nullptr;
+}
+
+size_t countInstructions(const Node* expression)
+{
+    if (expression == nullptr) { return 0; }
+
+    switch (expression->type)
+    {
+        case NUMB_TYPE:
+        case NAME_TYPE:
+        {
+            return 1;
+        }
+
+        case MATH_TYPE:
+        {
+            size_t operands = countInstructions(expression->left) + countInstructions(expression->right);
+            return operands + ((expression->data.operation > DIV_OP) ? COMPARE_INSTRUCTIONS : 1);
+        }
+
+        case CALL_TYPE:
+        {
+            size_t arguments = 0;
+            for (const Node* argument = expression->right; argument != nullptr; argument = argument->right)
+            {
+                arguments += countInstructions(argument->left);
+            }
+
+            switch (expression->left->data.name.id)
+            {
+                case PRINT_SYMBOL:
+                case SCAN_SYMBOL:
+                case FLOOR_SYMBOL:
+                case SQRT_SYMBOL:
+                case RAND_JUMP_SYMBOL: { return arguments + 1;                 }
+                default:               { return arguments + CALL_INSTRUCTIONS; }
+            }
+        }
+
+        default:
+        {
+            return 0;
+        }
+    }
+}
+
+bool hasSideEffects(const Node* expression)
+{
+    if (expression == nullptr) { return false; }
+
+    if (expression->type == CALL_TYPE)
+    {
+        SymbolId function = expression->left->data.name.id;
+        if (function != FLOOR_SYMBOL && function != SQRT_SYMBOL) { return true; }
+    }
+
+    return hasSideEffects(expression->left) || hasSideEffects(expression->right);
+}
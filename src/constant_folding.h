@@ -0,0 +1,14 @@
+#pragma once
+
+#include "expression_tree.h"
+
+struct FoldingStats
+{
+    size_t simplifiedExpressions;
+    size_t removedInstructions; // stack code instructions saved, as writeExpression would emit them
+};
+
+void   foldConstants     (Node* root, FoldingStats* stats);
+size_t countInstructions (const Node* expression);
+bool   hasSideEffects    (const Node* expression);
+double calculate         (MathOp operation, double a, double b);
@@ -0,0 +1,273 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include "dead_code.h"
+#include "constant_folding.h"
+
+#define INSTRUCTION(value) (function->instructions[value])
+#define BLOCK(block)       (function->blocks[block])
+
+void   simplifyFunction  (IrFunction* function, DeadCodeStats* stats);
+size_t foldValues        (IrFunction* function);
+bool   foldValue         (IrFunction* function, IrValue value);
+bool   isConst           (const IrFunction* function, IrValue value);
+size_t foldBranches      (IrFunction* function);
+size_t removeUnreachable (IrFunction* function);
+void   pruneFunctions    (IrProgram* program, DeadCodeStats* stats);
+void   removeFunction    (IrFunction* function);
+
+void eliminateDeadCode(IrProgram* program, void* stats)
+{
+    assert(program != nullptr);
+    assert(stats   != nullptr);
+
+    for (size_t i = 0; i < program->functionsCount; i++)
+    {
+        IrFunction* function = &program->functions[i];
+        if (function->inMemory || function->blocksCount == 0) { continue; }
+
+        simplifyFunction(function, (DeadCodeStats*) stats);
+    }
+
+    // Calls in the blocks dropped above don't keep their callees
+    pruneFunctions(program, (DeadCodeStats*) stats);
+}
+
+void simplifyFunction(IrFunction* function, DeadCodeStats* stats)
+{
+    assert(function != nullptr);
+    assert(stats    != nullptr);
+
+    while (true)
+    {
+        stats->foldedValues += foldValues(function);
+
+        size_t foldedBranches = foldBranches(function);
+        size_t removedBlocks  = removeUnreachable(function);
+
+        stats->foldedBranches += foldedBranches;
+        stats->removedBlocks  += removedBlocks;
+
+        if (foldedBranches == 0 && removedBlocks == 0) { break; }
+
+        removeTrivialPhis(function);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Math on constants becomes a constant in place, the same way foldConstants
+// does it on the tree: division by zero and the square root of a negative
+// number are left to run time. An operand may come later in the numbering
+// (a phi's value replaced), so it goes on until nothing changes.
+//------------------------------------------------------------------------------
+size_t foldValues(IrFunction* function)
+{
+    assert(function != nullptr);
+
+    size_t folded  = 0;
+    bool   changed = true;
+
+    while (changed)
+    {
+        changed = false;
+
+        for (IrValue value = 0; value < function->instructionsCount; value++)
+        {
+            if (!foldValue(function, value)) { continue; }
+
+            folded++;
+            changed = true;
+        }
+    }
+
+    return folded;
+}
+
+bool foldValue(IrFunction* function, IrValue value)
+{
+    assert(function != nullptr);
+
+    IrInstruction* instruction = &INSTRUCTION(value);
+    if (instruction->block == NO_BLOCK) { return false; }
+
+    IrOpcode opcode = instruction->opcode;
+    if (opcode < IR_ADD || opcode > IR_SQRT) { return false; }
+
+    for (size_t i = 0; i < instruction->operandsCount; i++)
+    {
+        if (!isConst(function, instruction->operands[i])) { return false; }
+    }
+
+    double first  = INSTRUCTION(instruction->operands[0]).number;
+    double number = 0;
+
+    if (opcode == IR_FLOOR)
+    {
+        number = floor(first);
+    }
+    else if (opcode == IR_SQRT)
+    {
+        if (first < 0) { return false; }
+        number = sqrt(first);
+    }
+    else
+    {
+        double second = INSTRUCTION(instruction->operands[1]).number;
+        if (opcode == IR_DIV && second == 0) { return false; }
+
+        number = calculate((MathOp) (opcode - IR_ADD), first, second);
+    }
+
+    instruction->opcode        = IR_CONST;
+    instruction->number        = number;
+    instruction->operandsCount = 0;
+
+    return true;
+}
+
+bool isConst(const IrFunction* function, IrValue value)
+{
+    assert(function != nullptr);
+    assert(value    <  function->instructionsCount);
+
+    return INSTRUCTION(value).block != NO_BLOCK && INSTRUCTION(value).opcode == IR_CONST;
+}
+
+// A branch on a constant jumps where the constant sends it, the other target loses the edge
+size_t foldBranches(IrFunction* function)
+{
+    assert(function != nullptr);
+
+    size_t folded = 0;
+
+    for (IrBlockId block = 0; block < function->blocksCount; block++)
+    {
+        if (BLOCK(block).removed) { continue; }
+
+        IrValue        last   = terminator(function, block);
+        IrInstruction* branch = &INSTRUCTION(last);
+        if (branch->opcode != IR_BRANCH || !isConst(function, branch->operands[0])) { continue; }
+
+        bool      taken   = INSTRUCTION(branch->operands[0]).number != 0;
+        IrBlockId target  = branch->targets[taken ? 0 : 1];
+        IrBlockId skipped = branch->targets[taken ? 1 : 0];
+
+        branch->opcode        = IR_JUMP;
+        branch->targets[0]    = target;
+        branch->targets[1]    = NO_BLOCK;
+        branch->operandsCount = 0;
+
+        // Both targets can be the same block, then it keeps one of the two edges
+        removeEdge(function, block, skipped);
+
+        folded++;
+    }
+
+    return folded;
+}
+
+size_t removeUnreachable(IrFunction* function)
+{
+    assert(function != nullptr);
+
+    bool*      reachable = (bool*)      calloc(function->blocksCount, sizeof(bool));
+    IrBlockId* stack     = (IrBlockId*) calloc(function->blocksCount, sizeof(IrBlockId));
+    assert(reachable != nullptr);
+    assert(stack     != nullptr);
+
+    size_t stackCount = 0;
+
+    reachable[0]        = true;
+    stack[stackCount++] = 0;
+
+    while (stackCount > 0)
+    {
+        IrBlockId block = stack[--stackCount];
+
+        for (size_t i = 0; i < successorsCount(function, block); i++)
+        {
+            IrBlockId next = successor(function, block, i);
+            if (reachable[next]) { continue; }
+
+            reachable[next]     = true;
+            stack[stackCount++] = next;
+        }
+    }
+
+    size_t removed = 0;
+
+    for (IrBlockId block = 0; block < function->blocksCount; block++)
+    {
+        if (reachable[block] || BLOCK(block).removed) { continue; }
+
+        removeBlock(function, block);
+        removed++;
+    }
+
+    free(reachable);
+    free(stack);
+
+    return removed;
+}
+
+//------------------------------------------------------------------------------
+// Functions reached from love through the calls that are left. Without love
+// the program doesn't compile anyway, so nothing is pruned then.
+//------------------------------------------------------------------------------
+void pruneFunctions(IrProgram* program, DeadCodeStats* stats)
+{
+    assert(program != nullptr);
+    assert(stats   != nullptr);
+
+    Function* mainFunction = getFunction(program->table, MAIN_SYMBOL);
+    if (mainFunction == nullptr) { return; }
+
+    bool*     reached = (bool*)     calloc(program->functionsCount, sizeof(bool));
+    uint32_t* stack   = (uint32_t*) calloc(program->functionsCount, sizeof(uint32_t));
+    assert(reached != nullptr);
+    assert(stack   != nullptr);
+
+    size_t   stackCount = 0;
+    uint32_t mainIndex  = (uint32_t) (mainFunction - program->table->functions);
+
+    reached[mainIndex]  = true;
+    stack[stackCount++] = mainIndex;
+
+    while (stackCount > 0)
+    {
+        IrFunction* function = &program->functions[stack[--stackCount]];
+
+        for (IrValue value = 0; value < function->instructionsCount; value++)
+        {
+            const IrInstruction* instruction = &INSTRUCTION(value);
+            if (instruction->block == NO_BLOCK || instruction->opcode != IR_CALL) { continue; }
+
+            if (reached[instruction->index]) { continue; }
+
+            reached[instruction->index] = true;
+            stack[stackCount++]         = instruction->index;
+        }
+    }
+
+    for (size_t i = 0; i < program->functionsCount; i++)
+    {
+        if (reached[i] || program->functions[i].removed) { continue; }
+
+        removeFunction(&program->functions[i]);
+        stats->removedFunctions++;
+    }
+
+    free(reached);
+    free(stack);
+}
+
+// Its arrays belong to the program's arena, so they are only forgotten
+void removeFunction(IrFunction* function)
+{
+    assert(function != nullptr);
+
+    function->removed           = true;
+    function->instructionsCount = 0;
+    function->blocksCount       = 0;
+    function->layoutCount       = 0;
+}
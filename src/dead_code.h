@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ir.h"
+
+//------------------------------------------------------------------------------
+// Removes the code that can never run. Inside a function, math on constants
+// is folded, a branch on a constant becomes a jump, and the blocks the entry
+// can't reach are dropped with the edges they had: the statements after a
+// return and the revelio branch that's never taken. Dropping a block's edges
+// can leave phis with a single value, which may make more conditions constant.
+// This repeats until nothing changes.
+//
+// Then the call graph is walked from love, and the functions it never reaches
+// are removed from the program and never written out. Functions with
+// riddikulus keep all of their blocks, as riddikulus may land in any of them,
+// but they are still pruned when nothing calls them.
+//------------------------------------------------------------------------------
+struct DeadCodeStats
+{
+    size_t foldedValues;
+    size_t foldedBranches;
+    size_t removedBlocks;
+    size_t removedFunctions;
+};
+
+void eliminateDeadCode (IrProgram* program, void* stats);
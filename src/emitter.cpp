@@ -0,0 +1,154 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include "emitter.h"
+
+#define ASSERT_EMITTER(emitter) assert((emitter)         != nullptr); \
+                                assert((emitter)->buffer != nullptr); \
+                                assert((emitter)->file   != nullptr);
+
+const size_t EMITTER_BUFFER_CAPACITY = 64 * 1024;
+const size_t HORIZONTAL_LINE_LENGTH  = 50;
+const double MAX_PLAIN_INTEGER       = 1e6;
+const size_t SHORT_PRECISION         = 15; // enough for the numbers people write
+const size_t EXACT_PRECISION         = 17; // enough for any double to read back the same
+
+void construct(Emitter* emitter, FILE* file, bool commentsEnabled)
+{
+    assert(emitter != nullptr);
+    assert(file    != nullptr);
+
+    emitter->buffer = (char*) malloc(EMITTER_BUFFER_CAPACITY);
+    assert(emitter->buffer != nullptr);
+
+    emitter->size            = 0;
+    emitter->capacity        = EMITTER_BUFFER_CAPACITY;
+    emitter->file            = file;
+    emitter->commentsEnabled = commentsEnabled;
+}
+
+void destroy(Emitter* emitter)
+{
+    ASSERT_EMITTER(emitter);
+
+    flush(emitter);
+    free(emitter->buffer);
+
+    emitter->buffer   = nullptr;
+    emitter->size     = 0;
+    emitter->capacity = 0;
+    emitter->file     = nullptr;
+}
+
+void flush(Emitter* emitter)
+{
+    ASSERT_EMITTER(emitter);
+
+    if (emitter->size > 0)
+    {
+        fwrite(emitter->buffer, sizeof(char), emitter->size, emitter->file);
+        emitter->size = 0;
+    }
+}
+
+void makeRoom(Emitter* emitter, size_t length)
+{
+    ASSERT_EMITTER(emitter);
+
+    flush(emitter);
+
+    if (length > emitter->capacity)
+    {
+        emitter->capacity = length;
+        emitter->buffer   = (char*) realloc(emitter->buffer, emitter->capacity);
+        assert(emitter->buffer != nullptr);
+    }
+}
+
+char* putDigits(char* cursor, uint64_t value)
+{
+    assert(cursor != nullptr);
+
+    size_t length = 1;
+    for (uint64_t rest = value / 10; rest > 0; rest /= 10)
+    {
+        length++;
+    }
+
+    char* digit = cursor + length;
+    do
+    {
+        *--digit = '0' + value % 10;
+        value /= 10;
+    }
+    while (value > 0);
+
+    return cursor + length;
+}
+
+char* putNumber(char* cursor, double value)
+{
+    assert(cursor != nullptr);
+
+    // Integers are by far the most common constants, print them without snprintf
+    if (fabs(value) < MAX_PLAIN_INTEGER && value == (double) (int64_t) value && !(value == 0 && signbit(value)))
+    {
+        return putInt(cursor, (int64_t) value);
+    }
+
+    // The assembler reads it back with strtod, folded constants like 2/3 must come back as the same double
+    int written = snprintf(cursor, MAX_NUMBER_LENGTH, "%.*g", (int) SHORT_PRECISION, value);
+
+    if (strtod(cursor, nullptr) != value && !isnan(value))
+    {
+        written = snprintf(cursor, MAX_NUMBER_LENGTH, "%.*g", (int) EXACT_PRECISION, value);
+    }
+
+    assert(written > 0 && (size_t) written < MAX_NUMBER_LENGTH);
+
+    return cursor + written;
+}
+
+void emitNumber(Emitter* emitter, double value)
+{
+    ASSERT_EMITTER(emitter);
+
+    endLine(emitter, putNumber(beginLine(emitter, MAX_NUMBER_LENGTH), value));
+}
+
+void emitComment(Emitter* emitter, const char* text)
+{
+    ASSERT_EMITTER(emitter);
+
+    if (!emitter->commentsEnabled) { return; }
+
+    emit(emitter, "; ");
+    emit(emitter, text);
+    emitChar(emitter, '\n');
+}
+
+void emitComment(Emitter* emitter, const char* text, const char* name)
+{
+    ASSERT_EMITTER(emitter);
+
+    if (!emitter->commentsEnabled) { return; }
+
+    emit(emitter, "; ");
+    emit(emitter, text);
+    emit(emitter, name);
+    emitChar(emitter, '\n');
+}
+
+void emitHorizontalLine(Emitter* emitter)
+{
+    ASSERT_EMITTER(emitter);
+
+    if (!emitter->commentsEnabled) { return; }
+
+    reserve(emitter, HORIZONTAL_LINE_LENGTH + 3);
+
+    emit(emitter, "; ");
+    memset(emitter->buffer + emitter->size, '=', HORIZONTAL_LINE_LENGTH);
+    emitter->size += HORIZONTAL_LINE_LENGTH;
+    emitChar(emitter, '\n');
+}
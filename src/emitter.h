@@ -0,0 +1,251 @@
+#pragma once
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+//------------------------------------------------------------------------------
+// Assembly text is accumulated in a memory buffer and written to the file in
+// large chunks. With comments disabled, comment lines, function banners and
+// blank separator lines are dropped, leaving only the code.
+//------------------------------------------------------------------------------
+struct Emitter
+{
+    char*  buffer;
+    size_t size;
+    size_t capacity;
+
+    FILE*  file;
+    bool   commentsEnabled;
+};
+
+void construct          (Emitter* emitter, FILE* file, bool commentsEnabled);
+void destroy            (Emitter* emitter);
+void flush              (Emitter* emitter);
+void makeRoom           (Emitter* emitter, size_t length);
+
+char* putDigits         (char* cursor, uint64_t value);
+char* putNumber         (char* cursor, double value);
+void  emitNumber        (Emitter* emitter, double value);
+
+void emitComment        (Emitter* emitter, const char* text);
+void emitComment        (Emitter* emitter, const char* text, const char* name);
+void emitHorizontalLine (Emitter* emitter);
+
+const size_t MAX_NUMBER_LENGTH = 32; // putNumber never writes more, sign and exponent included
+const size_t MAX_LINE_LENGTH   = 64; // a mnemonic, a register and a number, names come on top
+
+//------------------------------------------------------------------------------
+// Appending is on the hot path of every back end, so it's inlined here. With
+// string literal mnemonics and labels the compiler also folds strlen away.
+//
+// Lines are written through a local cursor after a single reserve. Stores
+// through a char* may alias the emitter itself, so appending piece by piece
+// reloads the buffer and the size after every character.
+//------------------------------------------------------------------------------
+inline void reserve(Emitter* emitter, size_t length)
+{
+    if (emitter->size + length > emitter->capacity) { makeRoom(emitter, length); }
+}
+
+inline char* beginLine(Emitter* emitter, size_t length)
+{
+    reserve(emitter, length);
+    return emitter->buffer + emitter->size;
+}
+
+inline void endLine(Emitter* emitter, char* cursor)
+{
+    assert(cursor <= emitter->buffer + emitter->capacity);
+    emitter->size = cursor - emitter->buffer;
+}
+
+inline char* put(char* cursor, const char* text, size_t length)
+{
+    memcpy(cursor, text, length);
+    return cursor + length;
+}
+
+inline char* put(char* cursor, const char* text)
+{
+    return put(cursor, text, strlen(text));
+}
+
+inline char* putChar(char* cursor, char symbol)
+{
+    *cursor = symbol;
+    return cursor + 1;
+}
+
+// Frame offsets, label indices and constants are mostly single digits
+inline char* putUnsigned(char* cursor, uint64_t value)
+{
+    if (value < 10) { return putChar(cursor, '0' + value); }
+    else            { return putDigits(cursor, value);     }
+}
+
+inline char* putInt(char* cursor, int64_t value)
+{
+    if (value < 0)
+    {
+        cursor = putChar(cursor, '-');
+        return putUnsigned(cursor, -(uint64_t) value);
+    }
+    else
+    {
+        return putUnsigned(cursor, (uint64_t) value);
+    }
+}
+
+inline char* putDouble(char* cursor, double value)
+{
+    if (value >= 0 && value < 10 && value == (double) (int) value && !(value == 0 && signbit(value)))
+    {
+        return putChar(cursor, '0' + (int) value);
+    }
+    else
+    {
+        return putNumber(cursor, value);
+    }
+}
+
+inline void emit(Emitter* emitter, const char* text, size_t length)
+{
+    endLine(emitter, put(beginLine(emitter, length), text, length));
+}
+
+inline void emit(Emitter* emitter, const char* text)
+{
+    emit(emitter, text, strlen(text));
+}
+
+inline void emitChar(Emitter* emitter, char symbol)
+{
+    reserve(emitter, 1);
+    emitter->buffer[emitter->size++] = symbol;
+}
+
+inline void emitUnsigned(Emitter* emitter, uint64_t value)
+{
+    endLine(emitter, putUnsigned(beginLine(emitter, MAX_NUMBER_LENGTH), value));
+}
+
+inline void emitInt(Emitter* emitter, int64_t value)
+{
+    endLine(emitter, putInt(beginLine(emitter, MAX_NUMBER_LENGTH), value));
+}
+
+inline void emitDouble(Emitter* emitter, double value)
+{
+    endLine(emitter, putDouble(beginLine(emitter, MAX_NUMBER_LENGTH), value));
+}
+
+inline void emitBlankLine(Emitter* emitter)
+{
+    if (emitter->commentsEnabled) { emitChar(emitter, '\n'); }
+}
+
+inline void emitInstruction(Emitter* emitter, const char* mnemonic)
+{
+    char* cursor = beginLine(emitter, MAX_LINE_LENGTH);
+
+    cursor = put     (cursor, mnemonic);
+    cursor = putChar (cursor, '\n');
+
+    endLine(emitter, cursor);
+}
+
+inline void emitInstruction(Emitter* emitter, const char* mnemonic, double value)
+{
+    char* cursor = beginLine(emitter, MAX_LINE_LENGTH);
+
+    cursor = put       (cursor, mnemonic);
+    cursor = putChar   (cursor, ' ');
+    cursor = putDouble (cursor, value);
+    cursor = putChar   (cursor, '\n');
+
+    endLine(emitter, cursor);
+}
+
+inline void emitRegInstruction(Emitter* emitter, const char* mnemonic, const char* reg)
+{
+    char* cursor = beginLine(emitter, MAX_LINE_LENGTH);
+
+    cursor = put     (cursor, mnemonic);
+    cursor = putChar (cursor, ' ');
+    cursor = put     (cursor, reg);
+    cursor = putChar (cursor, '\n');
+
+    endLine(emitter, cursor);
+}
+
+inline void emitMemInstruction(Emitter* emitter, const char* mnemonic, const char* reg, int64_t offset)
+{
+    char* cursor = beginLine(emitter, MAX_LINE_LENGTH);
+
+    cursor = put (cursor, mnemonic);
+    cursor = put (cursor, " [");
+    cursor = put (cursor, reg);
+
+    if (offset != 0)
+    {
+        cursor = putChar (cursor, '+');
+        cursor = putInt  (cursor, offset);
+    }
+
+    cursor = put (cursor, "]\n");
+
+    endLine(emitter, cursor);
+}
+
+inline void emitJump(Emitter* emitter, const char* mnemonic, const char* label)
+{
+    size_t labelLength = strlen(label);
+    char*  cursor      = beginLine(emitter, MAX_LINE_LENGTH + labelLength);
+
+    cursor = put     (cursor, mnemonic);
+    cursor = put     (cursor, " :");
+    cursor = put     (cursor, label, labelLength);
+    cursor = putChar (cursor, '\n');
+
+    endLine(emitter, cursor);
+}
+
+inline void emitJump(Emitter* emitter, const char* mnemonic, const char* label, size_t index)
+{
+    char* cursor = beginLine(emitter, MAX_LINE_LENGTH);
+
+    cursor = put         (cursor, mnemonic);
+    cursor = put         (cursor, " :");
+    cursor = put         (cursor, label);
+    cursor = putChar     (cursor, '_');
+    cursor = putUnsigned (cursor, index);
+    cursor = putChar     (cursor, '\n');
+
+    endLine(emitter, cursor);
+}
+
+inline void emitLabel(Emitter* emitter, const char* label)
+{
+    size_t labelLength = strlen(label);
+    char*  cursor      = beginLine(emitter, MAX_LINE_LENGTH + labelLength);
+
+    cursor = put (cursor, label, labelLength);
+    cursor = put (cursor, ":\n");
+
+    endLine(emitter, cursor);
+}
+
+inline void emitLabel(Emitter* emitter, const char* label, size_t index)
+{
+    char* cursor = beginLine(emitter, MAX_LINE_LENGTH);
+
+    cursor = put         (cursor, label);
+    cursor = putChar     (cursor, '_');
+    cursor = putUnsigned (cursor, index);
+    cursor = put         (cursor, ":\n");
+
+    endLine(emitter, cursor);
+}
\ No newline at end of file
@@ -37,6 +37,17 @@ const size_t LEFT_CHILD_LENGTH    = strlen("{ } { ");
 int  counterFileUpdate (const char* filename);
 void graphDumpSubtree  (FILE* file, Node* node);
 
+//------------------------------------------------------------------------------
+// All nodes live in the arena of the current compilation. Nodes are allocated
+// in parse order, so a function's nodes end up next to each other.
+//------------------------------------------------------------------------------
+static Arena* NODE_ARENA = nullptr;
+
+void setNodeArena(Arena* arena)
+{
+    NODE_ARENA = arena;
+}
+
 void destroySubtree(Node* root)
 {
     CHECK_NULL(root, return);
@@ -49,7 +60,12 @@ void destroySubtree(Node* root)
 
 Node* newNode()
 {
-    return (Node*) calloc(1, sizeof(Node));
+    assert(NODE_ARENA != nullptr);
+
+    Node* node = (Node*) allocate(NODE_ARENA, sizeof(Node));
+    *node = {};
+
+    return node;
 }
 
 Node* newNode(NodeType type, NodeData data, Node* left, Node* right)
@@ -74,11 +90,10 @@ void deleteNode(Node* node)
 {
     assert(node != nullptr);
 
+    // the memory itself is released together with the arena
     node->parent = nullptr;
     node->left   = nullptr;
     node->right  = nullptr;
-
-    free(node);
 }
 
 void setLeft(Node* root, Node* left)
@@ -151,12 +166,13 @@ void setData(Node* node, MathOp op)
     node->data.operation = op;
 }
 
-void setData(Node* node, const char* id)
+void setData(Node* node, SymbolId id)
 {
     assert(node != nullptr);
 
-    node->type    = NAME_TYPE;
-    node->data.id = id;
+    node->type           = NAME_TYPE;
+    node->data.name.id   = id;
+    node->data.name.slot = NO_SLOT;
 }
 
 int counterFileUpdate(const char* filename)
@@ -224,7 +240,7 @@ void graphDumpSubtree(FILE* file, Node* node)
     {
         case DECL_TYPE:  { fprintf(file, "\"D\"%s];\n",                 DECL_GRAPH_STYLE); break; }
         case VDECL_TYPE: { fprintf(file, "\"=\"%s];\n",                 ASSG_GRAPH_STYLE); break; }
-        case NAME_TYPE:  { fprintf(file, "\"%s\"%s];\n", node->data.id, NAME_GRAPH_STYLE); break; } 
+        case NAME_TYPE:  { fprintf(file, "\"%s\"%s];\n", getSymbolName(node->data.name.id), NAME_GRAPH_STYLE); break; } 
         case LIST_TYPE:  { fprintf(file, "\"param\"%s];\n",             LIST_GRAPH_STYLE); break; } 
         
         case BLCK_TYPE:  { fprintf(file, "\"Block\"%s];\n",             BLCK_GRAPH_STYLE); break; }
@@ -278,29 +294,14 @@ void dumpToFile(FILE* file, Node* node)
     }
     else if (node->type == NAME_TYPE)
     {
-        if (strcmp(node->data.id, MAIN_FUNCTION_NAME) == 0)
-        {
-            fprintf(file, "%s ", UNIVERSAL_MAIN_NAME);
-        }
-        else if (strcmp(node->data.id, KEYWORDS[PRINT_KEYWORD].name) == 0)
+        switch (node->data.name.id)
         {
-            fprintf(file, "%s ", UNIVERSAL_PRINT_NAME);   
-        }
-        else if (strcmp(node->data.id, KEYWORDS[SCAN_KEYWORD].name) == 0)
-        {
-            fprintf(file, "%s ", UNIVERSAL_SCAN_NAME);   
-        }
-        else if (strcmp(node->data.id, KEYWORDS[FLOOR_KEYWORD].name) == 0)
-        {
-            fprintf(file, "%s ", UNIVERSAL_FLOOR_NAME);   
-        }
-        else if (strcmp(node->data.id, KEYWORDS[SQRT_KEYWORD].name) == 0)
-        {
-            fprintf(file, "%s ", UNIVERSAL_SQRT_NAME);   
-        }
-        else
-        {
-            fprintf(file, "%s ", node->data.id);
+            case MAIN_SYMBOL:  { fprintf(file, "%s ", UNIVERSAL_MAIN_NAME);            break; }
+            case PRINT_SYMBOL: { fprintf(file, "%s ", UNIVERSAL_PRINT_NAME);           break; }
+            case SCAN_SYMBOL:  { fprintf(file, "%s ", UNIVERSAL_SCAN_NAME);            break; }
+            case FLOOR_SYMBOL: { fprintf(file, "%s ", UNIVERSAL_FLOOR_NAME);           break; }
+            case SQRT_SYMBOL:  { fprintf(file, "%s ", UNIVERSAL_SQRT_NAME);            break; }
+            default:           { fprintf(file, "%s ", getSymbolName(node->data.name.id)); break; }
         }
     }
     else 
@@ -390,29 +391,31 @@ Node* readTreeFromFile(const char* filename)
         {
             len = strspn(buffer + ofs, LETTERS);
 
+            node->data.name.slot = NO_SLOT; // slots are resolved by the parser only
+
             if (strncmp(buffer + ofs, UNIVERSAL_MAIN_NAME, len) == 0)
             {
-                node->data.id = MAIN_FUNCTION_NAME;
+                node->data.name.id = MAIN_SYMBOL;
             }
             else if (strncmp(buffer + ofs, UNIVERSAL_PRINT_NAME, len) == 0)
             {
-                node->data.id = KEYWORDS[PRINT_KEYWORD].name;
+                node->data.name.id = PRINT_SYMBOL;
             }
             else if (strncmp(buffer + ofs, UNIVERSAL_SCAN_NAME, len) == 0)
             {
-                node->data.id = KEYWORDS[SCAN_KEYWORD].name;
+                node->data.name.id = SCAN_SYMBOL;
             }
             else if (strncmp(buffer + ofs, UNIVERSAL_FLOOR_NAME, len) == 0)
             {
-                node->data.id = KEYWORDS[FLOOR_KEYWORD].name;
+                node->data.name.id = FLOOR_SYMBOL;
             }
             else if (strncmp(buffer + ofs, UNIVERSAL_SQRT_NAME, len) == 0)
             {
-                node->data.id = KEYWORDS[SQRT_KEYWORD].name;
+                node->data.name.id = SQRT_SYMBOL;
             }
             else
             {
-                node->data.id = copyString(buffer + ofs, len);
+                node->data.name.id = intern(buffer + ofs, len);
             }
         }
         else
@@ -1,13 +1,24 @@
 #pragma once
 
 #include <stdarg.h>
+#include <stdint.h>
 #include "syntax.h"
+#include "interner.h"
+#include "arena.h"
+
+static const int32_t NO_SLOT = -1;
+
+struct NameData
+{
+    SymbolId    id;
+    int32_t     slot; // variable's index in its function's frame, NO_SLOT for function names
+};
 
 union NodeData
 {
     double      number;
     MathOp      operation;
-    const char* id;
+    NameData    name;
 };
 
 enum NodeType
@@ -45,8 +56,9 @@ struct Node
 };
 
 #define BINARY_OP(op, root1, root2) newNode(MATH_TYPE, { .operation = op##_OP }, root1,   root2)
-#define NAME(name)                  newNode(NAME_TYPE, { .id        = name    }, nullptr, nullptr)
+#define NAME(symbol)                newNode(NAME_TYPE, { .name      = { symbol, NO_SLOT } }, nullptr, nullptr)
 
+void   setNodeArena      (Arena* arena);
 void   destroySubtree    (Node* root);
 
 Node*  newNode           ();
@@ -64,7 +76,7 @@ bool   isLeft            (const Node* node);
 void   setData           (Node* node, NodeType type, NodeData data);
 void   setData           (Node* node, double number);
 void   setData           (Node* node, MathOp op);
-void   setData           (Node* node, const char* id);
+void   setData           (Node* node, SymbolId id);
 
 int    counterFileUpdate (const char* filename);
 void   graphDump         (Node* root, const char* treeFilename, const char* outputFilename);
@@ -0,0 +1,942 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frame_slots.h"
+
+#define FUNCTION    (compiler->curFunction)
+#define CUR_FUNC    (compiler->curFunction->symbols)
+
+#define INSTRUCTION(value) (FUNCTION->instructions[value])
+#define BLOCK(block)       (FUNCTION->blocks[block])
+
+static const uint32_t NO_POINT = UINT32_MAX;
+static const uint32_t NO_SLOT  = UINT32_MAX;
+
+// rax is the frame base, the others are free for values, see allocateRegisters
+static const Register ALLOCATED_REGISTERS[]     = { RBX, RCX, RDX };
+static const size_t   ALLOCATED_REGISTERS_COUNT = sizeof(ALLOCATED_REGISTERS) / sizeof(ALLOCATED_REGISTERS[0]);
+
+// An access inside a loop counts as LOOP_WEIGHT accesses outside of it
+static const size_t   LOOP_WEIGHT    = 10;
+static const uint32_t MAX_LOOP_DEPTH = 8;
+
+// Place in the code where a stored value's slot is pushed from
+struct SlotRead
+{
+    IrValue   value;
+    IrBlockId block;
+    uint32_t  point;
+};
+
+//------------------------------------------------------------------------------
+// Points number the code in layout order: the start of every block, every
+// value written in it and its terminator, which is also the block's end. The
+// entry pops the parameters at point 0. Whatever an instruction pushes is read
+// before what it computes is popped, so a value whose range ends at a point
+// can share its slot with one whose range starts there.
+//------------------------------------------------------------------------------
+struct SlotAllocation
+{
+    Compiler*  compiler;
+
+    uint32_t*  blockStarts; // indexed by block
+    uint32_t*  blockEnds;
+    IrValue*   visited;     // last value whose range went through the block, see extendThroughBlocks
+    IrBlockId* stack;
+
+    uint32_t*  starts;      // indexed by value, NO_POINT if it has no slot
+    uint32_t*  ends;
+    uint32_t*  defPoints;   // where it's popped, NO_POINT for phis, see numberCode
+    size_t*    readsBegin;  // its reads, after they are sorted by value
+    size_t*    readsEnd;
+    IrValue*   leaders;     // value whose place it shares, itself if none, see coalescePhis
+    IrValue*   nextMembers; // next value sharing the leader's place, NO_VALUE after the last
+    IrValue*   copyTargets; // a phi the value is copied to, NO_VALUE if none
+    size_t*    weights;     // its reads and its definition, see blockWeight
+
+    uint32_t*  loopDepths;  // indexed by block, how many loops it's in
+    uint32_t*  callPoints;  // points whose code calls a function, in order
+    size_t     callPointsCount;
+
+    SlotRead*  reads;
+    size_t     readsCount;
+    size_t     readsCapacity;
+
+    uint32_t*  slotEnds;    // where the value in each slot stops being live
+
+    uint32_t*  liveIn;      // indexed by block, liveStamp if the last value asked about is live into it
+    uint32_t   liveStamp;
+};
+
+void     findLoopDepths      (SlotAllocation* allocation);
+size_t   blockWeight         (SlotAllocation* allocation, IrBlockId block);
+void     numberCode          (SlotAllocation* allocation);
+bool     numberTerminator    (SlotAllocation* allocation, IrBlockId block, uint32_t point);
+bool     addReads            (SlotAllocation* allocation, IrValue value, IrBlockId block, uint32_t point);
+bool     addRead             (SlotAllocation* allocation, IrValue value, IrBlockId block, uint32_t point);
+void     extend              (SlotAllocation* allocation, IrValue value, uint32_t point);
+void     extendThroughBlocks (SlotAllocation* allocation, size_t first, size_t last);
+int      compareReads        (const void* first, const void* second);
+void     coalescePhis        (SlotAllocation* allocation);
+bool     canCoalesce         (SlotAllocation* allocation, IrValue first, IrValue second);
+bool     interfere           (SlotAllocation* allocation, IrValue first, IrValue second);
+bool     isLiveAfter         (SlotAllocation* allocation, IrValue value, IrValue definition);
+void     markLiveIn          (SlotAllocation* allocation, IrValue value);
+void     mergeGroups         (SlotAllocation* allocation, IrValue first, IrValue second);
+size_t   sortByStart         (SlotAllocation* allocation, IrValue** order);
+size_t   allocateRegisters   (SlotAllocation* allocation, const IrValue* order, size_t orderCount);
+size_t   chooseRegister      (SlotAllocation* allocation, IrValue value, const IrValue* occupants);
+bool     isRegisterFree      (SlotAllocation* allocation, const IrValue* occupants, size_t index, uint32_t start);
+bool     crossesCall         (SlotAllocation* allocation, uint32_t start, uint32_t end);
+size_t   allocateSlots       (SlotAllocation* allocation, const IrValue* order, size_t orderCount);
+uint32_t chooseSlot          (SlotAllocation* allocation, IrValue value, uint32_t reserved, size_t* slotsCount);
+bool     isSlotFree          (SlotAllocation* allocation, uint32_t slot, uint32_t reserved, uint32_t start);
+
+void assignSlots(Compiler* compiler)
+{
+    assert(compiler != nullptr);
+
+    size_t valuesCount = FUNCTION->instructionsCount + 1;
+    size_t blocksCount = FUNCTION->blocksCount + 1;
+
+    SlotAllocation allocation = {};
+    allocation.compiler      = compiler;
+    allocation.blockStarts   = (uint32_t*)  calloc(blocksCount, sizeof(uint32_t));
+    allocation.blockEnds     = (uint32_t*)  calloc(blocksCount, sizeof(uint32_t));
+    allocation.visited       = (IrValue*)   calloc(blocksCount, sizeof(IrValue));
+    allocation.stack         = (IrBlockId*) calloc(blocksCount, sizeof(IrBlockId));
+    allocation.starts        = (uint32_t*)  calloc(valuesCount, sizeof(uint32_t));
+    allocation.ends          = (uint32_t*)  calloc(valuesCount, sizeof(uint32_t));
+    allocation.defPoints     = (uint32_t*)  calloc(valuesCount, sizeof(uint32_t));
+    allocation.readsBegin    = (size_t*)    calloc(valuesCount, sizeof(size_t));
+    allocation.readsEnd      = (size_t*)    calloc(valuesCount, sizeof(size_t));
+    allocation.leaders       = (IrValue*)   calloc(valuesCount, sizeof(IrValue));
+    allocation.nextMembers   = (IrValue*)   calloc(valuesCount, sizeof(IrValue));
+    allocation.copyTargets   = (IrValue*)   calloc(valuesCount, sizeof(IrValue));
+    allocation.weights       = (size_t*)    calloc(valuesCount, sizeof(size_t));
+    allocation.loopDepths    = (uint32_t*)  calloc(blocksCount, sizeof(uint32_t));
+    allocation.callPoints    = (uint32_t*)  calloc(valuesCount + 2 * blocksCount, sizeof(uint32_t));
+    allocation.slotEnds      = (uint32_t*)  calloc(valuesCount + CUR_FUNC->varsCount, sizeof(uint32_t));
+    allocation.liveIn        = (uint32_t*)  calloc(blocksCount, sizeof(uint32_t));
+    allocation.readsCapacity = valuesCount;
+    allocation.reads         = (SlotRead*)  calloc(allocation.readsCapacity, sizeof(SlotRead));
+
+    assert(allocation.blockStarts != nullptr);
+    assert(allocation.blockEnds   != nullptr);
+    assert(allocation.visited     != nullptr);
+    assert(allocation.stack       != nullptr);
+    assert(allocation.starts      != nullptr);
+    assert(allocation.ends        != nullptr);
+    assert(allocation.defPoints   != nullptr);
+    assert(allocation.readsBegin  != nullptr);
+    assert(allocation.readsEnd    != nullptr);
+    assert(allocation.leaders     != nullptr);
+    assert(allocation.nextMembers != nullptr);
+    assert(allocation.copyTargets != nullptr);
+    assert(allocation.weights     != nullptr);
+    assert(allocation.loopDepths  != nullptr);
+    assert(allocation.callPoints  != nullptr);
+    assert(allocation.slotEnds    != nullptr);
+    assert(allocation.liveIn      != nullptr);
+    assert(allocation.reads       != nullptr);
+
+    memset(allocation.visited,     0xFF, blocksCount * sizeof(IrValue));
+    memset(allocation.starts,      0xFF, valuesCount * sizeof(uint32_t));
+    memset(allocation.defPoints,   0xFF, valuesCount * sizeof(uint32_t));
+    memset(allocation.nextMembers, 0xFF, valuesCount * sizeof(IrValue));
+    memset(allocation.copyTargets, 0xFF, valuesCount * sizeof(IrValue));
+    memset(compiler->slots,        0xFF, valuesCount * sizeof(uint32_t));
+    memset(compiler->registers,    NO_REGISTER, valuesCount * sizeof(Register));
+
+    for (IrValue value = 0; value < valuesCount; value++) { allocation.leaders[value] = value; }
+
+    findLoopDepths (&allocation);
+    numberCode     (&allocation);
+
+    qsort(allocation.reads, allocation.readsCount, sizeof(SlotRead), compareReads);
+
+    for (size_t first = 0; first < allocation.readsCount; )
+    {
+        size_t last = first + 1;
+        while (last < allocation.readsCount && allocation.reads[last].value == allocation.reads[first].value)
+        {
+            last++;
+        }
+
+        allocation.readsBegin[allocation.reads[first].value] = first;
+        allocation.readsEnd  [allocation.reads[first].value] = last;
+
+        extendThroughBlocks(&allocation, first, last);
+        first = last;
+    }
+
+    coalescePhis(&allocation);
+
+    IrValue* order      = nullptr;
+    size_t   orderCount = sortByStart(&allocation, &order);
+
+    size_t inRegisters = allocateRegisters (&allocation, order, orderCount);
+    size_t stored      = allocateSlots     (&allocation, order, orderCount);
+
+    for (IrValue value = 0; value < FUNCTION->instructionsCount; value++)
+    {
+        IrValue leader = allocation.leaders[value];
+        if (leader == value) { continue; }
+
+        compiler->registers[value] = compiler->registers[leader];
+        compiler->slots[value]     = compiler->slots[leader];
+
+        if (compiler->registers[value] != NO_REGISTER) { inRegisters++; }
+        stored++;
+    }
+
+    CUR_FUNC->frameSize         = compiler->slotsCount + 2;
+    CUR_FUNC->unsharedFrameSize = stored + 2;
+    CUR_FUNC->registerValues    = inRegisters;
+
+    free(order);
+
+    free(allocation.blockStarts);
+    free(allocation.blockEnds);
+    free(allocation.visited);
+    free(allocation.stack);
+    free(allocation.starts);
+    free(allocation.ends);
+    free(allocation.defPoints);
+    free(allocation.readsBegin);
+    free(allocation.readsEnd);
+    free(allocation.leaders);
+    free(allocation.nextMembers);
+    free(allocation.copyTargets);
+    free(allocation.weights);
+    free(allocation.loopDepths);
+    free(allocation.callPoints);
+    free(allocation.slotEnds);
+    free(allocation.liveIn);
+    free(allocation.reads);
+}
+
+//------------------------------------------------------------------------------
+// A jump back to a block that dominates it closes a loop. The loop's body is
+// what reaches the jump without going through the header, found by walking
+// the predecessors back from it. Loops with the same header are one loop.
+//------------------------------------------------------------------------------
+void findLoopDepths(SlotAllocation* allocation)
+{
+    assert(allocation != nullptr);
+
+    Compiler*  compiler   = allocation->compiler;
+    IrBlockId* dominators = (IrBlockId*) calloc(FUNCTION->blocksCount + 1, sizeof(IrBlockId));
+    IrBlockId* bodies     = (IrBlockId*) calloc(FUNCTION->blocksCount + 1, sizeof(IrBlockId));
+    assert(dominators != nullptr);
+    assert(bodies     != nullptr);
+
+    findDominators(FUNCTION, dominators);
+    memset(bodies, 0xFF, (FUNCTION->blocksCount + 1) * sizeof(IrBlockId));
+
+    for (IrBlockId header = 0; header < FUNCTION->blocksCount; header++)
+    {
+        const IrBlock* instructions = &BLOCK(header);
+        if (instructions->removed || dominators[header] == NO_BLOCK) { continue; }
+
+        size_t stackCount = 0;
+
+        for (size_t i = 0; i < instructions->predsCount; i++)
+        {
+            IrBlockId pred = instructions->preds[i];
+            if (!dominates(dominators, header, pred)) { continue; }
+
+            if (bodies[header] != header)
+            {
+                bodies[header] = header;
+                allocation->loopDepths[header]++;
+            }
+
+            if (bodies[pred] == header) { continue; }
+
+            bodies[pred]                    = header;
+            allocation->stack[stackCount++] = pred;
+        }
+
+        while (stackCount > 0)
+        {
+            IrBlockId block = allocation->stack[--stackCount];
+
+            allocation->loopDepths[block]++;
+
+            for (size_t i = 0; i < BLOCK(block).predsCount; i++)
+            {
+                IrBlockId pred = BLOCK(block).preds[i];
+                if (bodies[pred] == header) { continue; }
+
+                bodies[pred]                    = header;
+                allocation->stack[stackCount++] = pred;
+            }
+        }
+    }
+
+    free(dominators);
+    free(bodies);
+}
+
+size_t blockWeight(SlotAllocation* allocation, IrBlockId block)
+{
+    assert(allocation != nullptr);
+
+    size_t weight = 1;
+
+    for (uint32_t depth = 0; depth < allocation->loopDepths[block] && depth < MAX_LOOP_DEPTH; depth++)
+    {
+        weight *= LOOP_WEIGHT;
+    }
+
+    return weight;
+}
+
+// Mirrors writeBlock: the values it pops to slots and the stored values their code pushes
+void numberCode(SlotAllocation* allocation)
+{
+    assert(allocation != nullptr);
+
+    Compiler* compiler = allocation->compiler;
+    uint32_t  point    = 0;
+
+    for (IrValue value = 0; value < FUNCTION->instructionsCount; value++)
+    {
+        if (INSTRUCTION(value).opcode == IR_PARAM && compiler->placements[value] == STORED_VALUE)
+        {
+            extend(allocation, value, point);
+        }
+    }
+
+    for (size_t i = 0; i < FUNCTION->layoutCount; i++)
+    {
+        IrBlockId      block        = FUNCTION->layout[i];
+        const IrBlock* instructions = &BLOCK(block);
+
+        allocation->blockStarts[block] = ++point;
+
+        for (size_t j = 0; j + 1 < instructions->codeCount; j++)
+        {
+            IrValue value = instructions->code[j];
+            if (compiler->placements[value] != STORED_VALUE || INSTRUCTION(value).opcode == IR_PARAM ||
+                INSTRUCTION(value).opcode == IR_PHI)
+            {
+                continue;
+            }
+
+            point++;
+
+            if (addReads(allocation, value, block, point))
+            {
+                allocation->callPoints[allocation->callPointsCount++] = point;
+            }
+
+            if (hasResult(INSTRUCTION(value).opcode))
+            {
+                allocation->defPoints[value] = point;
+
+                extend(allocation, value, point);
+                allocation->weights[value] += blockWeight(allocation, block);
+            }
+        }
+
+        allocation->blockEnds[block] = ++point;
+
+        if (numberTerminator(allocation, block, point))
+        {
+            allocation->callPoints[allocation->callPointsCount++] = point;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// The copies to the successor's phis push their operands and pop the phis at
+// the jump. A phi that keeps its value on the edge isn't copied, but it has to
+// stay in its slot all the same, as if it were read there. Returns whether
+// the terminator's code calls a function.
+//------------------------------------------------------------------------------
+bool numberTerminator(SlotAllocation* allocation, IrBlockId block, uint32_t point)
+{
+    assert(allocation != nullptr);
+
+    Compiler*            compiler = allocation->compiler;
+    IrValue              last     = terminator(FUNCTION, block);
+    const IrInstruction* jump     = &INSTRUCTION(last);
+
+    if (jump->opcode != IR_JUMP) { return addReads(allocation, last, block, point); }
+
+    const IrBlock* phis  = &BLOCK(jump->targets[0]);
+    size_t         edge  = 0;
+    bool           calls = false;
+
+    while (phis->preds[edge] != block) { edge++; }
+
+    for (size_t i = 0; i < phis->codeCount && INSTRUCTION(phis->code[i]).opcode == IR_PHI; i++)
+    {
+        IrValue phi = phis->code[i];
+        if (compiler->placements[phi] == DEAD_VALUE) { continue; }
+
+        IrValue operand = INSTRUCTION(phi).operands[edge];
+
+        if (addRead(allocation, operand, block, point)) { calls = true; }
+
+        extend(allocation, phi, point);
+        allocation->weights[phi] += blockWeight(allocation, block);
+
+        if (operand != phi && compiler->placements[operand] == STORED_VALUE)
+        {
+            allocation->copyTargets[operand] = phi;
+        }
+    }
+
+    return calls;
+}
+
+//------------------------------------------------------------------------------
+// The operands of a value written at the point, through the deferred ones
+// computed there. Returns whether the value or one of those is a call.
+//------------------------------------------------------------------------------
+bool addReads(SlotAllocation* allocation, IrValue value, IrBlockId block, uint32_t point)
+{
+    assert(allocation != nullptr);
+
+    Compiler*            compiler    = allocation->compiler;
+    const IrInstruction* instruction = &INSTRUCTION(value);
+    bool                 calls       = instruction->opcode == IR_CALL;
+
+    for (size_t i = 0; i < instruction->operandsCount; i++)
+    {
+        if (addRead(allocation, instruction->operands[i], block, point)) { calls = true; }
+    }
+
+    return calls;
+}
+
+bool addRead(SlotAllocation* allocation, IrValue value, IrBlockId block, uint32_t point)
+{
+    assert(allocation != nullptr);
+
+    Compiler* compiler = allocation->compiler;
+
+    if (INSTRUCTION(value).opcode == IR_CONST) { return false; }
+
+    if (compiler->placements[value] == DEFERRED_VALUE) { return addReads(allocation, value, block, point); }
+
+    assert(compiler->placements[value] == STORED_VALUE);
+
+    if (allocation->readsCount >= allocation->readsCapacity)
+    {
+        allocation->readsCapacity *= 2;
+        allocation->reads = (SlotRead*) realloc(allocation->reads, allocation->readsCapacity * sizeof(SlotRead));
+        assert(allocation->reads != nullptr);
+    }
+
+    allocation->reads[allocation->readsCount++] = { value, block, point };
+    allocation->weights[value] += blockWeight(allocation, block);
+
+    return false;
+}
+
+void extend(SlotAllocation* allocation, IrValue value, uint32_t point)
+{
+    assert(allocation != nullptr);
+
+    if (allocation->starts[value] == NO_POINT)
+    {
+        allocation->starts[value] = point;
+        allocation->ends[value]   = point;
+        return;
+    }
+
+    if (point < allocation->starts[value]) { allocation->starts[value] = point; }
+    if (point > allocation->ends[value])   { allocation->ends[value]   = point; }
+}
+
+//------------------------------------------------------------------------------
+// Reads [first, last) are all of one value. It's live into every block on the
+// way back from a read to its definition, and out of their predecessors.
+//------------------------------------------------------------------------------
+void extendThroughBlocks(SlotAllocation* allocation, size_t first, size_t last)
+{
+    assert(allocation != nullptr);
+    assert(first < last);
+
+    Compiler* compiler   = allocation->compiler;
+    IrValue   value      = allocation->reads[first].value;
+    IrBlockId definition = INSTRUCTION(value).block;
+    size_t    stackCount = 0;
+
+    for (size_t i = first; i < last; i++)
+    {
+        const SlotRead* read = &allocation->reads[i];
+
+        extend(allocation, value, read->point);
+
+        if (read->block == definition || allocation->visited[read->block] == value) { continue; }
+
+        allocation->visited[read->block] = value;
+        allocation->stack[stackCount++]  = read->block;
+    }
+
+    while (stackCount > 0)
+    {
+        IrBlockId      block        = allocation->stack[--stackCount];
+        const IrBlock* instructions = &BLOCK(block);
+
+        extend(allocation, value, allocation->blockStarts[block]);
+
+        for (size_t i = 0; i < instructions->predsCount; i++)
+        {
+            IrBlockId pred = instructions->preds[i];
+
+            extend(allocation, value, allocation->blockEnds[pred]);
+
+            if (pred == definition || allocation->visited[pred] == value) { continue; }
+
+            allocation->visited[pred]       = value;
+            allocation->stack[stackCount++] = pred;
+        }
+    }
+}
+
+int compareReads(const void* first, const void* second)
+{
+    IrValue firstValue  = ((const SlotRead*) first)->value;
+    IrValue secondValue = ((const SlotRead*) second)->value;
+
+    return (firstValue > secondValue) - (firstValue < secondValue);
+}
+
+//------------------------------------------------------------------------------
+// A phi and its operand share a place when neither is live where the other
+// is computed, so the copy between them goes away. The test is on what is
+// live, not on the ranges: around a loop they always overlap, as the phi at
+// the top of the body is live until the operand the bottom computes for it.
+// Values that share a place are a group, its leader has their combined range
+// and weight and takes part in the scans for all of them. Parameters keep
+// the slots the entry pops them to, and a group that would have a call in
+// its range only because of the merge isn't merged.
+//------------------------------------------------------------------------------
+void coalescePhis(SlotAllocation* allocation)
+{
+    assert(allocation != nullptr);
+
+    Compiler* compiler = allocation->compiler;
+    if (FUNCTION->inMemory) { return; }
+
+    for (size_t i = 0; i < FUNCTION->layoutCount; i++)
+    {
+        const IrBlock* instructions = &BLOCK(FUNCTION->layout[i]);
+
+        for (size_t j = 0; j < instructions->codeCount && INSTRUCTION(instructions->code[j]).opcode == IR_PHI; j++)
+        {
+            IrValue phi = instructions->code[j];
+            if (compiler->placements[phi] != STORED_VALUE) { continue; }
+
+            for (size_t k = 0; k < INSTRUCTION(phi).operandsCount; k++)
+            {
+                IrValue operand = INSTRUCTION(phi).operands[k];
+                if (compiler->placements[operand] != STORED_VALUE || INSTRUCTION(operand).opcode == IR_PARAM)
+                {
+                    continue;
+                }
+
+                IrValue first  = allocation->leaders[phi];
+                IrValue second = allocation->leaders[operand];
+
+                if (first != second && canCoalesce(allocation, first, second))
+                {
+                    mergeGroups(allocation, first, second);
+                }
+            }
+        }
+    }
+}
+
+bool canCoalesce(SlotAllocation* allocation, IrValue first, IrValue second)
+{
+    assert(allocation != nullptr);
+
+    uint32_t start = allocation->starts[first] < allocation->starts[second] ? allocation->starts[first]
+                                                                            : allocation->starts[second];
+    uint32_t end   = allocation->ends[first]   > allocation->ends[second]   ? allocation->ends[first]
+                                                                            : allocation->ends[second];
+
+    if (crossesCall(allocation, start, end) &&
+        (!crossesCall(allocation, allocation->starts[first],  allocation->ends[first]) ||
+         !crossesCall(allocation, allocation->starts[second], allocation->ends[second])))
+    {
+        return false;
+    }
+
+    for (IrValue member = first; member != NO_VALUE; member = allocation->nextMembers[member])
+    {
+        for (IrValue other = second; other != NO_VALUE; other = allocation->nextMembers[other])
+        {
+            if (interfere(allocation, member, other)) { return false; }
+        }
+    }
+
+    return true;
+}
+
+// In SSA one of two values that are live at once is live where the other one is computed
+bool interfere(SlotAllocation* allocation, IrValue first, IrValue second)
+{
+    assert(allocation != nullptr);
+
+    return isLiveAfter(allocation, first, second) || isLiveAfter(allocation, second, first);
+}
+
+//------------------------------------------------------------------------------
+// Whether the value is still needed after the definition is popped to its
+// place. A phi is popped at the ends of its block's predecessors, after the
+// operands of all the phis there are pushed, so it's the value being live
+// into the phi's block that counts, or being another phi of that block.
+//------------------------------------------------------------------------------
+bool isLiveAfter(SlotAllocation* allocation, IrValue value, IrValue definition)
+{
+    assert(allocation != nullptr);
+
+    Compiler* compiler = allocation->compiler;
+    IrBlockId block    = INSTRUCTION(definition).block;
+
+    markLiveIn(allocation, value);
+
+    if (INSTRUCTION(definition).opcode == IR_PHI)
+    {
+        return (INSTRUCTION(value).opcode == IR_PHI && INSTRUCTION(value).block == block) ||
+               allocation->liveIn[block] == allocation->liveStamp;
+    }
+
+    uint32_t point = allocation->defPoints[definition];
+    assert(point != NO_POINT);
+
+    if (INSTRUCTION(value).block == block && allocation->defPoints[value] != NO_POINT &&
+        allocation->defPoints[value] > point)
+    {
+        return false;
+    }
+
+    for (size_t i = allocation->readsBegin[value]; i < allocation->readsEnd[value]; i++)
+    {
+        if (allocation->reads[i].block == block && allocation->reads[i].point > point) { return true; }
+    }
+
+    for (size_t i = 0; i < successorsCount(FUNCTION, block); i++)
+    {
+        if (allocation->liveIn[successor(FUNCTION, block, i)] == allocation->liveStamp) { return true; }
+    }
+
+    return false;
+}
+
+// Stamps the blocks the value is live into, walking back from its reads like extendThroughBlocks
+void markLiveIn(SlotAllocation* allocation, IrValue value)
+{
+    assert(allocation != nullptr);
+
+    Compiler* compiler   = allocation->compiler;
+    IrBlockId definition = INSTRUCTION(value).block;
+    size_t    stackCount = 0;
+
+    allocation->liveStamp++;
+
+    for (size_t i = allocation->readsBegin[value]; i < allocation->readsEnd[value]; i++)
+    {
+        IrBlockId block = allocation->reads[i].block;
+        if (block == definition || allocation->liveIn[block] == allocation->liveStamp) { continue; }
+
+        allocation->liveIn[block]       = allocation->liveStamp;
+        allocation->stack[stackCount++] = block;
+    }
+
+    while (stackCount > 0)
+    {
+        const IrBlock* instructions = &BLOCK(allocation->stack[--stackCount]);
+
+        for (size_t i = 0; i < instructions->predsCount; i++)
+        {
+            IrBlockId pred = instructions->preds[i];
+            if (pred == definition || allocation->liveIn[pred] == allocation->liveStamp) { continue; }
+
+            allocation->liveIn[pred]        = allocation->liveStamp;
+            allocation->stack[stackCount++] = pred;
+        }
+    }
+}
+
+// The second group joins the first one, its leader leaves the scans
+void mergeGroups(SlotAllocation* allocation, IrValue first, IrValue second)
+{
+    assert(allocation != nullptr);
+
+    IrValue last = first;
+    while (allocation->nextMembers[last] != NO_VALUE) { last = allocation->nextMembers[last]; }
+
+    allocation->nextMembers[last] = second;
+
+    for (IrValue member = second; member != NO_VALUE; member = allocation->nextMembers[member])
+    {
+        allocation->leaders[member] = first;
+    }
+
+    if (allocation->starts[second] != NO_POINT)
+    {
+        extend(allocation, first, allocation->starts[second]);
+        extend(allocation, first, allocation->ends[second]);
+    }
+
+    allocation->weights[first] += allocation->weights[second];
+    allocation->starts[second]  = NO_POINT;
+}
+
+// Points are fewer than values and blocks together, so ranges are ordered by a counting sort
+size_t sortByStart(SlotAllocation* allocation, IrValue** order)
+{
+    assert(allocation != nullptr);
+    assert(order      != nullptr);
+
+    Compiler* compiler   = allocation->compiler;
+    uint32_t  maxPoint   = 0;
+    size_t    orderCount = 0;
+
+    for (IrValue value = 0; value < FUNCTION->instructionsCount; value++)
+    {
+        if (allocation->starts[value] == NO_POINT) { continue; }
+
+        if (allocation->ends[value] > maxPoint) { maxPoint = allocation->ends[value]; }
+
+        orderCount++;
+    }
+
+    size_t* counts = (size_t*) calloc(maxPoint + 2, sizeof(size_t));
+    *order         = (IrValue*) calloc(orderCount + 1, sizeof(IrValue));
+    assert(counts != nullptr);
+    assert(*order != nullptr);
+
+    for (IrValue value = 0; value < FUNCTION->instructionsCount; value++)
+    {
+        if (allocation->starts[value] != NO_POINT) { counts[allocation->starts[value] + 1]++; }
+    }
+
+    for (size_t i = 1; i < maxPoint + 2; i++) { counts[i] += counts[i - 1]; }
+
+    for (IrValue value = 0; value < FUNCTION->instructionsCount; value++)
+    {
+        if (allocation->starts[value] != NO_POINT) { (*order)[counts[allocation->starts[value]]++] = value; }
+    }
+
+    free(counts);
+
+    return orderCount;
+}
+
+//------------------------------------------------------------------------------
+// Linear scan of the ranges over the registers before the slots get theirs.
+// Calls don't save registers, so a value whose range has a call in it stays
+// in the frame, and parameters stay where the entry pops them. When all the
+// registers are taken, the value that is used the least, counting uses in
+// loops by their depth, goes to the frame: the new one or one that has a
+// register. Returns how many values got one.
+//------------------------------------------------------------------------------
+size_t allocateRegisters(SlotAllocation* allocation, const IrValue* order, size_t orderCount)
+{
+    assert(allocation != nullptr);
+    assert(order      != nullptr);
+
+    Compiler* compiler = allocation->compiler;
+    if (FUNCTION->inMemory) { return 0; }
+
+    IrValue occupants[ALLOCATED_REGISTERS_COUNT] = {};
+    size_t  allocated                            = 0;
+
+    for (size_t i = 0; i < ALLOCATED_REGISTERS_COUNT; i++) { occupants[i] = NO_VALUE; }
+
+    for (size_t i = 0; i < orderCount; i++)
+    {
+        IrValue value = order[i];
+        if (INSTRUCTION(value).opcode == IR_PARAM) { continue; }
+
+        if (crossesCall(allocation, allocation->starts[value], allocation->ends[value])) { continue; }
+
+        size_t index = chooseRegister(allocation, value, occupants);
+
+        if (index == ALLOCATED_REGISTERS_COUNT)
+        {
+            size_t cheapest = 0;
+
+            for (size_t j = 1; j < ALLOCATED_REGISTERS_COUNT; j++)
+            {
+                if (allocation->weights[occupants[j]] < allocation->weights[occupants[cheapest]]) { cheapest = j; }
+            }
+
+            if (allocation->weights[occupants[cheapest]] >= allocation->weights[value]) { continue; }
+
+            compiler->registers[occupants[cheapest]] = NO_REGISTER;
+            allocated--;
+
+            index = cheapest;
+        }
+
+        occupants[index]           = value;
+        compiler->registers[value] = ALLOCATED_REGISTERS[index];
+        allocated++;
+    }
+
+    return allocated;
+}
+
+// Like chooseSlot, ALLOCATED_REGISTERS_COUNT if all of them are taken
+size_t chooseRegister(SlotAllocation* allocation, IrValue value, const IrValue* occupants)
+{
+    assert(allocation != nullptr);
+    assert(occupants  != nullptr);
+
+    Compiler*            compiler    = allocation->compiler;
+    const IrInstruction* instruction = &INSTRUCTION(value);
+    uint32_t             start       = allocation->starts[value];
+
+    for (size_t i = 0; i < ALLOCATED_REGISTERS_COUNT; i++)
+    {
+        if (!isRegisterFree(allocation, occupants, i, start)) { continue; }
+
+        IrValue target = allocation->copyTargets[value];
+        if (target != NO_VALUE && compiler->registers[target] == ALLOCATED_REGISTERS[i]) { return i; }
+
+        for (size_t j = 0; j < instruction->operandsCount && instruction->opcode == IR_PHI; j++)
+        {
+            if (compiler->registers[instruction->operands[j]] == ALLOCATED_REGISTERS[i]) { return i; }
+        }
+    }
+
+    for (size_t i = 0; i < ALLOCATED_REGISTERS_COUNT; i++)
+    {
+        if (isRegisterFree(allocation, occupants, i, start)) { return i; }
+    }
+
+    return ALLOCATED_REGISTERS_COUNT;
+}
+
+bool isRegisterFree(SlotAllocation* allocation, const IrValue* occupants, size_t index, uint32_t start)
+{
+    assert(allocation != nullptr);
+    assert(occupants  != nullptr);
+
+    IrValue occupant = occupants[index];
+
+    return occupant == NO_VALUE || allocation->ends[occupant] <= start;
+}
+
+// Whether a call is made in the range, after its start
+bool crossesCall(SlotAllocation* allocation, uint32_t start, uint32_t end)
+{
+    assert(allocation != nullptr);
+
+    size_t first = 0;
+    size_t last  = allocation->callPointsCount;
+
+    while (first < last)
+    {
+        size_t middle = first + (last - first) / 2;
+
+        if (allocation->callPoints[middle] <= start) { first = middle + 1; }
+        else                                         { last  = middle;     }
+    }
+
+    return first < allocation->callPointsCount && allocation->callPoints[first] <= end;
+}
+
+//------------------------------------------------------------------------------
+// Linear scan over the ranges by where they start, of the values that didn't
+// get a register. Returns how many slots the values would take without
+// sharing, the way they were assigned before.
+//------------------------------------------------------------------------------
+size_t allocateSlots(SlotAllocation* allocation, const IrValue* order, size_t orderCount)
+{
+    assert(allocation != nullptr);
+    assert(order      != nullptr);
+
+    Compiler* compiler = allocation->compiler;
+    uint32_t  reserved = (uint32_t) (FUNCTION->inMemory ? CUR_FUNC->varsCount : 0);
+    size_t    base     = FUNCTION->inMemory ? CUR_FUNC->varsCount : CUR_FUNC->paramsCount;
+    size_t    stored   = base;
+
+    for (size_t i = 0; i < orderCount; i++)
+    {
+        if (INSTRUCTION(order[i]).opcode != IR_PARAM) { stored++; }
+    }
+
+    for (uint32_t slot = 0; slot < reserved; slot++) { allocation->slotEnds[slot] = NO_POINT; }
+
+    size_t slotsCount = base;
+
+    for (size_t i = 0; i < orderCount; i++)
+    {
+        IrValue  value = order[i];
+        uint32_t slot  = 0;
+
+        if (compiler->registers[value] != NO_REGISTER) { continue; }
+
+        if (INSTRUCTION(value).opcode == IR_PARAM)
+        {
+            slot = INSTRUCTION(value).index;
+        }
+        else
+        {
+            slot = chooseSlot(allocation, value, reserved, &slotsCount);
+        }
+
+        compiler->slots[value] = slot;
+
+        if (slot >= reserved && allocation->ends[value] > allocation->slotEnds[slot])
+        {
+            allocation->slotEnds[slot] = allocation->ends[value];
+        }
+    }
+
+    compiler->slotsCount = slotsCount;
+
+    return stored;
+}
+
+// The slot of a phi it's copied to or of an operand it's copied from, the lowest free one otherwise
+uint32_t chooseSlot(SlotAllocation* allocation, IrValue value, uint32_t reserved, size_t* slotsCount)
+{
+    assert(allocation != nullptr);
+    assert(slotsCount != nullptr);
+
+    Compiler*            compiler    = allocation->compiler;
+    const IrInstruction* instruction = &INSTRUCTION(value);
+    uint32_t             start       = allocation->starts[value];
+
+    IrValue target = allocation->copyTargets[value];
+    if (target != NO_VALUE && compiler->slots[target] != NO_SLOT &&
+        isSlotFree(allocation, compiler->slots[target], reserved, start))
+    {
+        return compiler->slots[target];
+    }
+
+    for (size_t i = 0; i < instruction->operandsCount && instruction->opcode == IR_PHI; i++)
+    {
+        IrValue operand = instruction->operands[i];
+        if (compiler->placements[operand] != STORED_VALUE || compiler->slots[operand] == NO_SLOT) { continue; }
+
+        if (isSlotFree(allocation, compiler->slots[operand], reserved, start)) { return compiler->slots[operand]; }
+    }
+
+    for (uint32_t slot = reserved; slot < *slotsCount; slot++)
+    {
+        if (isSlotFree(allocation, slot, reserved, start)) { return slot; }
+    }
+
+    return (uint32_t) (*slotsCount)++;
+}
+
+bool isSlotFree(SlotAllocation* allocation, uint32_t slot, uint32_t reserved, uint32_t start)
+{
+    assert(allocation != nullptr);
+
+    return slot >= reserved && allocation->slotEnds[slot] <= start;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "compiler.h"
+
+//------------------------------------------------------------------------------
+// Frame slots of the values the compiler stores (see ValuePlacement). A value
+// is live from where it's popped to its slot to the last place it's pushed
+// from, and values that are never live at the same time share a slot, so the
+// frame enter makes is only as big as the most values live at once.
+//
+// Live ranges are intervals over the code in the order it's written: a value
+// live into a block covers the block's start, one live out of it covers its
+// end. A loop keeps what it uses from before it alive all the way round.
+//
+// Parameters keep the slots the entry pops them to. A phi and an operand that
+// are never live where the other one is computed are put in one place before
+// the scans, so the copy between them on the edge is left out even when their
+// intervals overlap, as they always do around a loop. Otherwise a phi takes
+// the slot of one of its operands when it's free, and an operand the phi's.
+// In a function with riddikulus the variables' slots aren't shared at all.
+//
+// Before the slots, the values are scanned the same way over rbx, rcx and rdx.
+// Nothing is saved around a call, so only values with no call in their range
+// can have a register, and functions with riddikulus use none. The ones used
+// the most keep them, a use in a loop counting ten times one outside of it.
+//
+// The function's frame sizes, with and without sharing, and how many values
+// got a register go to its symbols.
+//------------------------------------------------------------------------------
+void assignSlots (Compiler* compiler);
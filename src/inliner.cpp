@@ -0,0 +1,415 @@
+#include <assert.h>
+#include <stdio.h>
+#include "inliner.h"
+#include "constant_folding.h"
+
+const size_t MAX_INLINED_INSTRUCTIONS = 24; // a call costs 14 and a pop per parameter
+const size_t MAX_VARIABLE_NAME_LENGTH = 64;
+
+struct Inliner
+{
+    SymbolTable*   table;
+    Node**         bodies;    // inlinable function's body by index in the table, nullptr for others
+    Function*      caller;
+    size_t         curCopy;   // numbers the inlined calls, so that variable names don't repeat
+    InliningStats* stats;
+};
+
+void  findInlinable       (Inliner* inliner, Node* root);
+bool  isInlinable         (const Node* function);
+bool  callsFunctions      (const Node* node);
+bool  assigns             (const Node* block, int32_t slot);
+
+void  inlineBlock         (Inliner* inliner, Node* block);
+Node* inlineStatement     (Inliner* inliner, Node* statement);
+Node* findInlinedCall     (Inliner* inliner, Node* expression, bool* effects);
+Node* expandCall          (Inliner* inliner, Node* call, Node* statement);
+
+Node* statementExpression (Node* statement);
+Node* newVariable         (Inliner* inliner, const Function* callee, int32_t slot);
+void  renameVariables     (Node* node, Node** replacements);
+Node* insertBefore        (Node* statement, Node* content);
+void  replaceNode         (Node* node, Node* replacement);
+
+#define ASSERT_INLINER(inliner) assert(inliner        != nullptr); \
+                                assert(inliner->table != nullptr); \
+                                assert(inliner->stats != nullptr);
+
+void inlineCalls(Node* root, SymbolTable* table, InliningStats* stats)
+{
+    assert(table != nullptr);
+    assert(stats != nullptr);
+
+    Inliner inliner = {};
+    inliner.table  = table;
+    inliner.stats  = stats;
+    inliner.bodies = (Node**) calloc(table->functionsCount, sizeof(Node*));
+    assert(inliner.bodies != nullptr || table->functionsCount == 0);
+
+    findInlinable(&inliner, root);
+
+    for (Node* declaration = root; declaration != nullptr; declaration = declaration->left)
+    {
+        inliner.caller = getFunction(table, declaration->right->data.name.id);
+        assert(inliner.caller != nullptr);
+
+        inlineBlock(&inliner, declaration->right->left);
+    }
+
+    free(inliner.bodies);
+}
+
+void findInlinable(Inliner* inliner, Node* root)
+{
+    ASSERT_INLINER(inliner);
+
+    for (Node* declaration = root; declaration != nullptr; declaration = declaration->left)
+    {
+        Node*     function = declaration->right;
+        Function* symbols  = getFunction(inliner->table, function->data.name.id);
+        assert(symbols != nullptr);
+
+        if (isInlinable(function))
+        {
+            inliner->bodies[symbols - inliner->table->functions] = function->left;
+        }
+    }
+}
+
+bool isInlinable(const Node* function)
+{
+    assert(function != nullptr);
+
+    if (function->data.name.id == MAIN_SYMBOL) { return false; }
+
+    const Node* block = function->left;
+    if (block == nullptr || block->right == nullptr) { return false; }
+
+    size_t instructions = 0;
+    for (const Node* statement = block->right; statement != nullptr; statement = statement->right)
+    {
+        const Node* content = statement->left;
+        bool        isLast  = statement->right == nullptr;
+
+        switch (content->type)
+        {
+            case JUMP_TYPE:
+            {
+                if (!isLast) { return false; }
+
+                instructions += countInstructions(content->right);
+                break;
+            }
+
+            case VDECL_TYPE:
+            case ASSG_TYPE:
+            {
+                if (isLast) { return false; }
+
+                instructions += countInstructions(content->right) + 1;
+                break;
+            }
+
+            case CALL_TYPE:
+            {
+                if (isLast) { return false; }
+
+                instructions += countInstructions(content);
+                break;
+            }
+
+            default:
+            {
+                return false;
+            }
+        }
+
+        if (callsFunctions(content)) { return false; }
+    }
+
+    return instructions <= MAX_INLINED_INSTRUCTIONS;
+}
+
+// Built-ins aside, riddikulus is a jump rather than a call and can't be inlined either
+bool callsFunctions(const Node* node)
+{
+    if (node == nullptr) { return false; }
+
+    if (node->type == CALL_TYPE)
+    {
+        SymbolId function = node->left->data.name.id;
+
+        if (function != PRINT_SYMBOL && function != SCAN_SYMBOL &&
+            function != FLOOR_SYMBOL && function != SQRT_SYMBOL)
+        {
+            return true;
+        }
+    }
+
+    return callsFunctions(node->left) || callsFunctions(node->right);
+}
+
+bool assigns(const Node* block, int32_t slot)
+{
+    assert(block != nullptr);
+
+    for (const Node* statement = block->right; statement != nullptr; statement = statement->right)
+    {
+        const Node* content = statement->left;
+
+        if ((content->type == VDECL_TYPE || content->type == ASSG_TYPE) && content->left->data.name.slot == slot)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void inlineBlock(Inliner* inliner, Node* block)
+{
+    ASSERT_INLINER(inliner);
+
+    if (block == nullptr) { return; }
+
+    for (Node* statement = block->right; statement != nullptr; statement = statement->right)
+    {
+        statement = inlineStatement(inliner, statement);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Inlined statements are inserted before the statement, so it moves further
+// down the block: returns its node. The expression is searched again after
+// every inlined call, the replaced call could have been its root.
+//------------------------------------------------------------------------------
+Node* inlineStatement(Inliner* inliner, Node* statement)
+{
+    ASSERT_INLINER(inliner);
+    assert(statement != nullptr);
+
+    Node* content = statement->left;
+    bool  effects = false;
+    Node* call    = findInlinedCall(inliner, statementExpression(statement), &effects);
+
+    while (call != nullptr)
+    {
+        statement = expandCall(inliner, call, statement);
+
+        effects = false;
+        call    = findInlinedCall(inliner, statementExpression(statement), &effects);
+    }
+
+    if (content->type == COND_TYPE)
+    {
+        inlineBlock(inliner, content->right->left);
+        inlineBlock(inliner, content->right->right);
+    }
+
+    if (content->type == LOOP_TYPE)
+    {
+        inlineBlock(inliner, content->right);
+    }
+
+    return statement;
+}
+
+//------------------------------------------------------------------------------
+// First inlinable call in evaluation order that nothing with effects is
+// evaluated before. Its own arguments may have effects: they move together
+// with it and stay in order.
+//------------------------------------------------------------------------------
+Node* findInlinedCall(Inliner* inliner, Node* expression, bool* effects)
+{
+    ASSERT_INLINER(inliner);
+    assert(effects != nullptr);
+
+    if (expression == nullptr || *effects) { return nullptr; }
+
+    if (expression->type == MATH_TYPE)
+    {
+        Node* call = findInlinedCall(inliner, expression->left, effects);
+        if (call != nullptr) { return call; }
+
+        return findInlinedCall(inliner, expression->right, effects);
+    }
+
+    if (expression->type != CALL_TYPE) { return nullptr; }
+
+    size_t argumentsCount = 0;
+    for (Node* argument = expression->right; argument != nullptr; argument = argument->right)
+    {
+        Node* call = findInlinedCall(inliner, argument->left, effects);
+        if (call != nullptr) { return call; }
+
+        argumentsCount++;
+    }
+
+    Function* callee = getFunction(inliner->table, expression->left->data.name.id);
+
+    if (callee != nullptr && inliner->bodies[callee - inliner->table->functions] != nullptr &&
+        callee->paramsCount == argumentsCount)
+    {
+        return expression;
+    }
+
+    if (hasSideEffects(expression)) { *effects = true; }
+
+    return nullptr;
+}
+
+//------------------------------------------------------------------------------
+// Arguments are chained from the last one and evaluated in chain order, the
+// assignments keep that order. Returns the statement's node, as inlineStatement.
+//------------------------------------------------------------------------------
+Node* expandCall(Inliner* inliner, Node* call, Node* statement)
+{
+    ASSERT_INLINER(inliner);
+    assert(call      != nullptr);
+    assert(statement != nullptr);
+
+    Function* callee = getFunction(inliner->table, call->left->data.name.id);
+    Node*     body   = inliner->bodies[callee - inliner->table->functions];
+
+    Node** replacements = (Node**) calloc(callee->varsCount, sizeof(Node*));
+    assert(replacements != nullptr);
+
+    int32_t param = (int32_t) callee->paramsCount - 1;
+    for (Node* argument = call->right; argument != nullptr; argument = argument->right, param--)
+    {
+        Node* value    = argument->left;
+        bool  isSimple = value->type == NUMB_TYPE || value->type == NAME_TYPE;
+
+        if (isSimple && !assigns(body, param))
+        {
+            replacements[param] = value;
+            continue;
+        }
+
+        replacements[param] = newVariable(inliner, callee, param);
+        statement = insertBefore(statement, newNode(ASSG_TYPE, {}, copyTree(replacements[param]), value));
+    }
+
+    for (int32_t slot = (int32_t) callee->paramsCount; slot < (int32_t) callee->varsCount; slot++)
+    {
+        replacements[slot] = newVariable(inliner, callee, slot);
+    }
+
+    Node* result = nullptr;
+    for (Node* curStatement = body->right; curStatement != nullptr; curStatement = curStatement->right)
+    {
+        Node* content = copyTree(curStatement->left);
+        renameVariables(content, replacements);
+
+        if (content->type == JUMP_TYPE)
+        {
+            result = content->right;
+            break;
+        }
+
+        statement = insertBefore(statement, content);
+    }
+
+    assert(result != nullptr);
+
+    free(replacements);
+
+    inliner->curCopy++;
+    inliner->stats->inlinedCalls++;
+
+    replaceNode(call, result);
+
+    return statement;
+}
+
+//------------------------------------------------------------------------------
+// What the statement itself evaluates before anything else. A loop evaluates
+// its condition on every iteration, there's no place before it for inlined
+// statements, so it has none.
+//------------------------------------------------------------------------------
+Node* statementExpression(Node* statement)
+{
+    assert(statement != nullptr);
+
+    Node* content = statement->left;
+
+    switch (content->type)
+    {
+        case COND_TYPE:  { return content->left;  }
+        case LOOP_TYPE:  { return nullptr;        }
+        case VDECL_TYPE:
+        case ASSG_TYPE:
+        case JUMP_TYPE:  { return content->right; }
+        default:         { return content;        }
+    }
+}
+
+// Variable names have no underscores, so these can't clash with them
+Node* newVariable(Inliner* inliner, const Function* callee, int32_t slot)
+{
+    ASSERT_INLINER(inliner);
+    assert(callee != nullptr);
+
+    char name[MAX_VARIABLE_NAME_LENGTH] = {};
+    int  length = snprintf(name, sizeof(name), "%s_%s_%zu", getSymbolName(callee->name),
+                           getSymbolName(callee->vars[slot]), inliner->curCopy);
+    assert(length > 0);
+
+    if ((size_t) length >= sizeof(name)) { length = sizeof(name) - 1; }
+
+    SymbolId symbol = intern(name, (size_t) length);
+    int      offset = pushVariable(inliner->caller, symbol);
+
+    inliner->stats->addedVariables++;
+
+    return newNode(NAME_TYPE, { .name = { symbol, offset } }, nullptr, nullptr);
+}
+
+// Variables are leaves, so are their replacements: the node itself takes the replacement's place
+void renameVariables(Node* node, Node** replacements)
+{
+    assert(replacements != nullptr);
+
+    if (node == nullptr) { return; }
+
+    if (node->type == NAME_TYPE && node->data.name.slot != NO_SLOT)
+    {
+        const Node* replacement = replacements[node->data.name.slot];
+        assert(replacement != nullptr);
+
+        setData(node, replacement->type, replacement->data);
+        return;
+    }
+
+    renameVariables(node->left,  replacements);
+    renameVariables(node->right, replacements);
+}
+
+//------------------------------------------------------------------------------
+// The statement's node stays in front with the new content, its old content
+// moves to a new node right after it, which is returned.
+//------------------------------------------------------------------------------
+Node* insertBefore(Node* statement, Node* content)
+{
+    assert(statement != nullptr);
+    assert(content   != nullptr);
+
+    Node* moved = newNode(STAT_TYPE, {}, statement->left, statement->right);
+
+    setLeft  (statement, content);
+    setRight (statement, moved);
+
+    return moved;
+}
+
+void replaceNode(Node* node, Node* replacement)
+{
+    assert(node         != nullptr);
+    assert(node->parent != nullptr);
+    assert(replacement  != nullptr);
+
+    if (isLeft(node)) { setLeft  (node->parent, replacement); }
+    else              { setRight (node->parent, replacement); }
+
+    deleteNode(node);
+}
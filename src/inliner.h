@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdio.h>
+#include "expression_tree.h"
+#include "symbol_table.h"
+
+//------------------------------------------------------------------------------
+// Inlines calls of small leaf functions into the syntax tree. A function can
+// be inlined if it calls no other functions (so it can't be recursive), its
+// body is straight line code that ends with its only return, and the body
+// is short enough (see MAX_INLINED_INSTRUCTIONS).
+//
+// The call's arguments and the callee's statements become statements before
+// the one with the call, and the call itself is replaced with the returned
+// expression. The callee's variables get fresh slots in the caller, a number
+// or variable argument is used directly if the callee never assigns that
+// parameter.
+//------------------------------------------------------------------------------
+struct InliningStats
+{
+    size_t inlinedCalls;
+    size_t addedVariables;
+};
+
+void inlineCalls (Node* root, SymbolTable* table, InliningStats* stats);
@@ -0,0 +1,215 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interner.h"
+#include "syntax.h"
+
+#define ASSERT_INTERNER() assert(INTERNER.names != nullptr); \
+                          assert(INTERNER.table != nullptr);
+
+const double   REALLOC_MULTIPLIER       = 2;
+const size_t   DEFAULT_SYMBOLS_CAPACITY = 256;
+const size_t   DEFAULT_TABLE_CAPACITY   = 512; // must be a power of two
+
+const uint32_t FNV_OFFSET_BASIS         = 2166136261u;
+const uint32_t FNV_PRIME                = 16777619u;
+
+struct Interner
+{
+    const char** names;
+    uint32_t*    lengths;
+    uint32_t*    hashes;
+    size_t       symbolsCount;
+    size_t       symbolsCapacity;
+
+    SymbolId*    table; // open addressing, NO_SYMBOL marks a free slot
+    size_t       tableCapacity;
+
+    Arena*       strings; // names are never moved, so getSymbolName results stay valid
+};
+
+static Interner INTERNER = {};
+
+uint32_t    hashString      (const char* name, size_t length);
+void        reallocSymbols  ();
+void        rehashTable     ();
+void        insertIntoTable (SymbolId symbol);
+
+void constructInterner(Arena* arena)
+{
+    assert(INTERNER.names == nullptr);
+    assert(arena          != nullptr);
+
+    INTERNER.names           = (const char**) calloc(DEFAULT_SYMBOLS_CAPACITY, sizeof(const char*));
+    INTERNER.lengths         = (uint32_t*)    calloc(DEFAULT_SYMBOLS_CAPACITY, sizeof(uint32_t));
+    INTERNER.hashes          = (uint32_t*)    calloc(DEFAULT_SYMBOLS_CAPACITY, sizeof(uint32_t));
+    INTERNER.symbolsCount    = 0;
+    INTERNER.symbolsCapacity = DEFAULT_SYMBOLS_CAPACITY;
+
+    INTERNER.table           = (SymbolId*) malloc(DEFAULT_TABLE_CAPACITY * sizeof(SymbolId));
+    INTERNER.tableCapacity   = DEFAULT_TABLE_CAPACITY;
+
+    assert(INTERNER.names   != nullptr);
+    assert(INTERNER.lengths != nullptr);
+    assert(INTERNER.hashes  != nullptr);
+    assert(INTERNER.table   != nullptr);
+
+    memset(INTERNER.table, 0xFF, DEFAULT_TABLE_CAPACITY * sizeof(SymbolId));
+
+    INTERNER.strings = arena;
+
+    SymbolId symbol = intern(MAIN_FUNCTION_NAME);
+    assert(symbol == MAIN_SYMBOL);
+
+    symbol = intern(KEYWORDS[PRINT_KEYWORD].name);
+    assert(symbol == PRINT_SYMBOL);
+
+    symbol = intern(KEYWORDS[SCAN_KEYWORD].name);
+    assert(symbol == SCAN_SYMBOL);
+
+    symbol = intern(KEYWORDS[FLOOR_KEYWORD].name);
+    assert(symbol == FLOOR_SYMBOL);
+
+    symbol = intern(KEYWORDS[SQRT_KEYWORD].name);
+    assert(symbol == SQRT_SYMBOL);
+
+    symbol = intern(KEYWORDS[RAND_JUMP_KEYWORD].name);
+    assert(symbol == RAND_JUMP_SYMBOL);
+}
+
+void destroyInterner()
+{
+    ASSERT_INTERNER();
+
+    free(INTERNER.names);
+    free(INTERNER.lengths);
+    free(INTERNER.hashes);
+    free(INTERNER.table);
+
+    INTERNER = {};
+}
+
+SymbolId intern(const char* name, size_t length)
+{
+    ASSERT_INTERNER();
+    assert(name != nullptr);
+
+    uint32_t hash = hashString(name, length);
+    size_t   mask = INTERNER.tableCapacity - 1;
+
+    for (size_t i = hash & mask; INTERNER.table[i] != NO_SYMBOL; i = (i + 1) & mask)
+    {
+        SymbolId symbol = INTERNER.table[i];
+
+        if (INTERNER.hashes[symbol] == hash && INTERNER.lengths[symbol] == length &&
+            memcmp(INTERNER.names[symbol], name, length) == 0)
+        {
+            return symbol;
+        }
+    }
+
+    if (INTERNER.symbolsCount >= INTERNER.symbolsCapacity)
+    {
+        reallocSymbols();
+    }
+
+    SymbolId symbol = (SymbolId) INTERNER.symbolsCount++;
+
+    INTERNER.names[symbol]   = copyString(INTERNER.strings, name, length);
+    INTERNER.lengths[symbol] = (uint32_t) length;
+    INTERNER.hashes[symbol]  = hash;
+
+    if (2 * INTERNER.symbolsCount > INTERNER.tableCapacity)
+    {
+        rehashTable();
+    }
+    else
+    {
+        insertIntoTable(symbol);
+    }
+
+    return symbol;
+}
+
+SymbolId intern(const char* name)
+{
+    assert(name != nullptr);
+
+    return intern(name, strlen(name));
+}
+
+const char* getSymbolName(SymbolId symbol)
+{
+    ASSERT_INTERNER();
+    assert(symbol < INTERNER.symbolsCount);
+
+    return INTERNER.names[symbol];
+}
+
+size_t getSymbolsCount()
+{
+    return INTERNER.symbolsCount;
+}
+
+uint32_t hashString(const char* name, size_t length)
+{
+    assert(name != nullptr);
+
+    uint32_t hash = FNV_OFFSET_BASIS;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (uint8_t) name[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+void reallocSymbols()
+{
+    ASSERT_INTERNER();
+
+    INTERNER.symbolsCapacity *= REALLOC_MULTIPLIER;
+
+    INTERNER.names   = (const char**) realloc(INTERNER.names,   INTERNER.symbolsCapacity * sizeof(const char*));
+    INTERNER.lengths = (uint32_t*)    realloc(INTERNER.lengths, INTERNER.symbolsCapacity * sizeof(uint32_t));
+    INTERNER.hashes  = (uint32_t*)    realloc(INTERNER.hashes,  INTERNER.symbolsCapacity * sizeof(uint32_t));
+
+    assert(INTERNER.names   != nullptr);
+    assert(INTERNER.lengths != nullptr);
+    assert(INTERNER.hashes  != nullptr);
+}
+
+void rehashTable()
+{
+    ASSERT_INTERNER();
+
+    free(INTERNER.table);
+
+    INTERNER.tableCapacity *= REALLOC_MULTIPLIER;
+    INTERNER.table = (SymbolId*) malloc(INTERNER.tableCapacity * sizeof(SymbolId));
+    assert(INTERNER.table != nullptr);
+
+    memset(INTERNER.table, 0xFF, INTERNER.tableCapacity * sizeof(SymbolId));
+
+    for (SymbolId symbol = 0; symbol < INTERNER.symbolsCount; symbol++)
+    {
+        insertIntoTable(symbol);
+    }
+}
+
+void insertIntoTable(SymbolId symbol)
+{
+    ASSERT_INTERNER();
+
+    size_t mask = INTERNER.tableCapacity - 1;
+    size_t i    = INTERNER.hashes[symbol] & mask;
+
+    while (INTERNER.table[i] != NO_SYMBOL)
+    {
+        i = (i + 1) & mask;
+    }
+
+    INTERNER.table[i] = symbol;
+}
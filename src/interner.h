@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "arena.h"
+
+typedef uint32_t SymbolId;
+
+static const SymbolId NO_SYMBOL = UINT32_MAX;
+
+//------------------------------------------------------------------------------
+// Names interned before everything else, so their ids are known constants.
+//------------------------------------------------------------------------------
+enum ReservedSymbol : SymbolId
+{
+    MAIN_SYMBOL,
+    PRINT_SYMBOL,
+    SCAN_SYMBOL,
+    FLOOR_SYMBOL,
+    SQRT_SYMBOL,
+    RAND_JUMP_SYMBOL,
+
+    RESERVED_SYMBOLS_COUNT
+};
+
+void        constructInterner (Arena* arena);
+void        destroyInterner   ();
+
+SymbolId    intern            (const char* name, size_t length);
+SymbolId    intern            (const char* name);
+const char* getSymbolName     (SymbolId symbol);
+size_t      getSymbolsCount   ();
@@ -0,0 +1,1012 @@
+#include <assert.h>
+#include <string.h>
+#include "ir.h"
+
+const size_t DEFAULT_IR_CAPACITY = 8;
+
+#define ASSERT_PROGRAM(program)   assert(program        != nullptr); \
+                                  assert(program->table != nullptr);
+
+#define ASSERT_FUNCTION(function) assert(function          != nullptr); \
+                                  assert(function->symbols != nullptr);
+
+#define INSTRUCTION(value) (function->instructions[value])
+#define BLOCK(block)       (function->blocks[block])
+
+void*  growArray        (IrProgram* program, void* array, size_t* capacity, size_t elementSize);
+void   insertIntoCode   (IrProgram* program, IrFunction* function, IrBlockId block, size_t position, IrValue value);
+void   removeFromCode   (IrFunction* function, IrValue value);
+size_t layoutPosition   (const IrFunction* function, IrBlockId block);
+bool   isPhiTrivial     (const IrFunction* function, IrValue phi, IrValue* replacement);
+size_t postorder        (const IrFunction* function, IrBlockId* order, size_t* numbers);
+
+IrError verifyBlock     (const IrFunction* function, IrBlockId block);
+IrError verifyEdges     (const IrFunction* function, IrBlockId block);
+IrError verifyOperands  (const IrFunction* function, IrValue value, const IrBlockId* dominators);
+size_t  operandsNeeded  (IrOpcode opcode);
+
+void    dumpFunction    (const IrProgram* program, const IrFunction* function, FILE* file);
+void    dumpInstruction (const IrProgram* program, const IrFunction* function, IrValue value, FILE* file);
+
+void construct(IrProgram* program, SymbolTable* table)
+{
+    assert(program != nullptr);
+    assert(table   != nullptr);
+
+    program->table          = table;
+    program->functionsCount = table->functionsCount;
+
+    construct(&program->arena);
+
+    program->functions = (IrFunction*) allocate(&program->arena, (table->functionsCount + 1) * sizeof(IrFunction));
+    assert(program->functions != nullptr);
+
+    for (size_t i = 0; i < table->functionsCount; i++)
+    {
+        program->functions[i]         = {};
+        program->functions[i].symbols = &table->functions[i];
+    }
+
+    for (size_t i = 0; i < LABEL_KINDS_COUNT; i++)
+    {
+        program->labelsCount[i] = 0;
+    }
+}
+
+void destroy(IrProgram* program)
+{
+    assert(program != nullptr);
+
+    destroy(&program->arena);
+
+    program->table          = nullptr;
+    program->functions      = nullptr;
+    program->functionsCount = 0;
+}
+
+const char* errorString(IrError error)
+{
+    if (error < IR_ERRORS_COUNT)
+    {
+        return IR_ERROR_STRINGS[error];
+    }
+
+    return "UNDEFINED error";
+}
+
+// Everything lives in the program's arena, so there's nothing to free when an array moves
+void* growArray(IrProgram* program, void* array, size_t* capacity, size_t elementSize)
+{
+    ASSERT_PROGRAM(program);
+    assert(capacity != nullptr);
+
+    size_t oldCapacity = *capacity;
+    *capacity = (oldCapacity == 0) ? DEFAULT_IR_CAPACITY : oldCapacity * 2;
+
+    void* newArray = reallocate(&program->arena, array, oldCapacity * elementSize, *capacity * elementSize);
+    assert(newArray != nullptr);
+
+    return newArray;
+}
+
+//------------------------------------------------------------------------------
+// A new block isn't in the layout yet: it goes there with placeBlock, once
+// it's known where it should be written out.
+//------------------------------------------------------------------------------
+IrBlockId addBlock(IrProgram* program, IrFunction* function, LabelKind label, size_t index)
+{
+    ASSERT_PROGRAM(program);
+    ASSERT_FUNCTION(function);
+    assert(label < LABEL_KINDS_COUNT);
+
+    if (function->blocksCount >= function->blocksCapacity)
+    {
+        function->blocks = (IrBlock*) growArray(program, function->blocks, &function->blocksCapacity,
+                                                sizeof(IrBlock));
+    }
+
+    IrBlockId block = (IrBlockId) function->blocksCount++;
+
+    BLOCK(block)            = {};
+    BLOCK(block).label      = label;
+    BLOCK(block).labelIndex = index;
+
+    return block;
+}
+
+// Right after the given block, at the end if there is none
+void placeBlock(IrProgram* program, IrFunction* function, IrBlockId block, IrBlockId after)
+{
+    ASSERT_PROGRAM(program);
+    ASSERT_FUNCTION(function);
+    assert(block < function->blocksCount);
+
+    if (function->layoutCount >= function->layoutCapacity)
+    {
+        function->layout = (IrBlockId*) growArray(program, function->layout, &function->layoutCapacity,
+                                                  sizeof(IrBlockId));
+    }
+
+    size_t position = (after == NO_BLOCK) ? function->layoutCount : layoutPosition(function, after) + 1;
+    assert(position <= function->layoutCount);
+
+    memmove(function->layout + position + 1, function->layout + position,
+            (function->layoutCount - position) * sizeof(IrBlockId));
+
+    function->layout[position] = block;
+    function->layoutCount++;
+}
+
+size_t layoutPosition(const IrFunction* function, IrBlockId block)
+{
+    ASSERT_FUNCTION(function);
+
+    for (size_t i = 0; i < function->layoutCount; i++)
+    {
+        if (function->layout[i] == block) { return i; }
+    }
+
+    assert(!"Block isn't placed");
+    return function->layoutCount;
+}
+
+//------------------------------------------------------------------------------
+// The block's instructions go and so do its edges to its successors. Edges
+// from its predecessors are the caller's business: the block is expected to
+// be unreachable.
+//------------------------------------------------------------------------------
+void removeBlock(IrFunction* function, IrBlockId block)
+{
+    ASSERT_FUNCTION(function);
+    assert(block < function->blocksCount);
+    assert(!BLOCK(block).removed);
+
+    IrValue last = terminator(function, block);
+
+    if (last != NO_VALUE)
+    {
+        for (size_t i = successorsCount(function, block); i > 0; i--)
+        {
+            removeEdge(function, block, successor(function, block, i - 1));
+        }
+    }
+
+    for (size_t i = 0; i < BLOCK(block).codeCount; i++)
+    {
+        INSTRUCTION(BLOCK(block).code[i]).block = NO_BLOCK;
+    }
+
+    BLOCK(block).codeCount = 0;
+    BLOCK(block).removed   = true;
+
+    size_t position = layoutPosition(function, block);
+
+    memmove(function->layout + position, function->layout + position + 1,
+            (function->layoutCount - position - 1) * sizeof(IrBlockId));
+
+    function->layoutCount--;
+}
+
+// The phis in the target need an operand for the new edge, added in the same order
+void addEdge(IrProgram* program, IrFunction* function, IrBlockId from, IrBlockId to)
+{
+    ASSERT_PROGRAM(program);
+    ASSERT_FUNCTION(function);
+    assert(from < function->blocksCount);
+    assert(to   < function->blocksCount);
+
+    IrBlock* target = &BLOCK(to);
+
+    if (target->predsCount >= target->predsCapacity)
+    {
+        target->preds = (IrBlockId*) growArray(program, target->preds, &target->predsCapacity, sizeof(IrBlockId));
+    }
+
+    target->preds[target->predsCount++] = from;
+}
+
+// Only the predecessor list and the phis change, the jump is the caller's
+void removeEdge(IrFunction* function, IrBlockId from, IrBlockId to)
+{
+    ASSERT_FUNCTION(function);
+    assert(from < function->blocksCount);
+    assert(to   < function->blocksCount);
+
+    IrBlock* target = &BLOCK(to);
+
+    size_t edge = 0;
+    while (edge < target->predsCount && target->preds[edge] != from) { edge++; }
+
+    assert(edge < target->predsCount);
+
+    memmove(target->preds + edge, target->preds + edge + 1, (target->predsCount - edge - 1) * sizeof(IrBlockId));
+    target->predsCount--;
+
+    for (size_t i = 0; i < target->codeCount && INSTRUCTION(target->code[i]).opcode == IR_PHI; i++)
+    {
+        IrInstruction* phi = &INSTRUCTION(target->code[i]);
+        assert(edge < phi->operandsCount);
+
+        memmove(phi->operands + edge, phi->operands + edge + 1, (phi->operandsCount - edge - 1) * sizeof(IrValue));
+        phi->operandsCount--;
+    }
+}
+
+//------------------------------------------------------------------------------
+// A branch to a block with phis gets a block of its own in between, so that
+// the phis' copies have somewhere to go. The new block takes the branch's
+// place among the target's predecessors and is put right before the target.
+//------------------------------------------------------------------------------
+size_t splitCriticalEdges(IrProgram* program, IrFunction* function)
+{
+    ASSERT_PROGRAM(program);
+    ASSERT_FUNCTION(function);
+
+    size_t split       = 0;
+    size_t blocksCount = function->blocksCount;
+
+    for (IrBlockId block = 0; block < blocksCount; block++)
+    {
+        if (BLOCK(block).removed || successorsCount(function, block) < 2) { continue; }
+
+        IrInstruction* branch = &INSTRUCTION(terminator(function, block));
+
+        for (size_t i = 0; i < 2; i++)
+        {
+            IrBlockId target = branch->targets[i];
+
+            bool hasPhis = BLOCK(target).codeCount > 0 && INSTRUCTION(BLOCK(target).code[0]).opcode == IR_PHI;
+            if (!hasPhis || BLOCK(target).predsCount < 2) { continue; }
+
+            IrBlockId middle = addBlock(program, function, BLOCK_LABEL, program->labelsCount[BLOCK_LABEL]++);
+
+            IrValue jump = addInstruction(program, function, middle, IR_JUMP);
+            INSTRUCTION(jump).targets[0] = target;
+
+            size_t edge = 0;
+            while (BLOCK(target).preds[edge] != block) { edge++; }
+
+            BLOCK(target).preds[edge] = middle;
+            addEdge(program, function, block, middle);
+
+            branch = &INSTRUCTION(terminator(function, block));
+            branch->targets[i] = middle;
+
+            size_t position = layoutPosition(function, target);
+            placeBlock(program, function, middle, position > 0 ? function->layout[position - 1] : NO_BLOCK);
+
+            split++;
+        }
+    }
+
+    return split;
+}
+
+IrValue addInstruction(IrProgram* program, IrFunction* function, IrBlockId block, IrOpcode opcode)
+{
+    ASSERT_PROGRAM(program);
+    ASSERT_FUNCTION(function);
+    assert(block < function->blocksCount);
+
+    return insertInstruction(program, function, block, BLOCK(block).codeCount, opcode);
+}
+
+IrValue insertInstruction(IrProgram* program, IrFunction* function, IrBlockId block, size_t position,
+                          IrOpcode opcode)
+{
+    ASSERT_PROGRAM(program);
+    ASSERT_FUNCTION(function);
+    assert(block  <  function->blocksCount);
+    assert(opcode <  IR_OPCODES_COUNT);
+
+    if (function->instructionsCount >= function->instructionsCapacity)
+    {
+        function->instructions = (IrInstruction*) growArray(program, function->instructions,
+                                                            &function->instructionsCapacity,
+                                                            sizeof(IrInstruction));
+    }
+
+    IrValue value = (IrValue) function->instructionsCount++;
+
+    INSTRUCTION(value)            = {};
+    INSTRUCTION(value).opcode     = opcode;
+    INSTRUCTION(value).block      = block;
+    INSTRUCTION(value).targets[0] = NO_BLOCK;
+    INSTRUCTION(value).targets[1] = NO_BLOCK;
+
+    insertIntoCode(program, function, block, position, value);
+
+    return value;
+}
+
+IrValue addConst(IrProgram* program, IrFunction* function, IrBlockId block, double number)
+{
+    IrValue value = addInstruction(program, function, block, IR_CONST);
+    INSTRUCTION(value).number = number;
+
+    return value;
+}
+
+void insertIntoCode(IrProgram* program, IrFunction* function, IrBlockId block, size_t position, IrValue value)
+{
+    ASSERT_PROGRAM(program);
+    ASSERT_FUNCTION(function);
+
+    IrBlock* target = &BLOCK(block);
+    assert(position <= target->codeCount);
+
+    if (target->codeCount >= target->codeCapacity)
+    {
+        target->code = (IrValue*) growArray(program, target->code, &target->codeCapacity, sizeof(IrValue));
+    }
+
+    memmove(target->code + position + 1, target->code + position, (target->codeCount - position) * sizeof(IrValue));
+
+    target->code[position] = value;
+    target->codeCount++;
+}
+
+void removeFromCode(IrFunction* function, IrValue value)
+{
+    ASSERT_FUNCTION(function);
+
+    IrBlock* block    = &BLOCK(INSTRUCTION(value).block);
+    size_t   position = findInstruction(function, value);
+
+    memmove(block->code + position, block->code + position + 1, (block->codeCount - position - 1) * sizeof(IrValue));
+    block->codeCount--;
+}
+
+void addOperand(IrProgram* program, IrFunction* function, IrValue value, IrValue operand)
+{
+    ASSERT_PROGRAM(program);
+    ASSERT_FUNCTION(function);
+    assert(value < function->instructionsCount);
+
+    IrInstruction* instruction = &INSTRUCTION(value);
+
+    instruction->operands = (IrValue*) reallocate(&program->arena, instruction->operands,
+                                                  instruction->operandsCount       * sizeof(IrValue),
+                                                  (instruction->operandsCount + 1) * sizeof(IrValue));
+    assert(instruction->operands != nullptr);
+
+    instruction->operands[instruction->operandsCount++] = operand;
+}
+
+void moveInstruction(IrProgram* program, IrFunction* function, IrValue value, IrBlockId block, size_t position)
+{
+    ASSERT_PROGRAM(program);
+    ASSERT_FUNCTION(function);
+    assert(value < function->instructionsCount);
+    assert(INSTRUCTION(value).block != NO_BLOCK);
+
+    removeFromCode(function, value);
+
+    INSTRUCTION(value).block = block;
+    insertIntoCode(program, function, block, position, value);
+}
+
+// Its uses are the caller's business
+void removeInstruction(IrFunction* function, IrValue value)
+{
+    ASSERT_FUNCTION(function);
+    assert(value < function->instructionsCount);
+    assert(INSTRUCTION(value).block != NO_BLOCK);
+
+    removeFromCode(function, value);
+    INSTRUCTION(value).block = NO_BLOCK;
+}
+
+void replaceUses(IrFunction* function, IrValue value, IrValue replacement)
+{
+    ASSERT_FUNCTION(function);
+
+    for (size_t i = 0; i < function->instructionsCount; i++)
+    {
+        IrInstruction* instruction = &INSTRUCTION(i);
+        if (instruction->block == NO_BLOCK) { continue; }
+
+        for (size_t j = 0; j < instruction->operandsCount; j++)
+        {
+            if (instruction->operands[j] == value) { instruction->operands[j] = replacement; }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// A phi is trivial if all its operands are one value, not counting the phi
+// itself (a loop that doesn't change the variable). Removing one can make
+// others trivial, so it goes on until nothing changes.
+//------------------------------------------------------------------------------
+size_t removeTrivialPhis(IrFunction* function)
+{
+    ASSERT_FUNCTION(function);
+
+    size_t removed = 0;
+    bool   changed = true;
+
+    while (changed)
+    {
+        changed = false;
+
+        for (IrValue value = 0; value < function->instructionsCount; value++)
+        {
+            IrValue replacement = NO_VALUE;
+            if (!isPhiTrivial(function, value, &replacement)) { continue; }
+
+            replaceUses       (function, value, replacement);
+            removeInstruction (function, value);
+
+            removed++;
+            changed = true;
+        }
+    }
+
+    return removed;
+}
+
+bool isPhiTrivial(const IrFunction* function, IrValue phi, IrValue* replacement)
+{
+    ASSERT_FUNCTION(function);
+    assert(replacement != nullptr);
+
+    const IrInstruction* instruction = &INSTRUCTION(phi);
+    if (instruction->block == NO_BLOCK || instruction->opcode != IR_PHI) { return false; }
+
+    IrValue same = NO_VALUE;
+
+    for (size_t i = 0; i < instruction->operandsCount; i++)
+    {
+        IrValue operand = instruction->operands[i];
+        if (operand == phi || operand == same) { continue; }
+
+        if (same != NO_VALUE) { return false; }
+        same = operand;
+    }
+
+    *replacement = same;
+
+    return same != NO_VALUE;
+}
+
+IrValue terminator(const IrFunction* function, IrBlockId block)
+{
+    ASSERT_FUNCTION(function);
+    assert(block < function->blocksCount);
+
+    const IrBlock* instructions = &BLOCK(block);
+    if (instructions->codeCount == 0) { return NO_VALUE; }
+
+    IrValue last = instructions->code[instructions->codeCount - 1];
+
+    return isTerminator(INSTRUCTION(last).opcode) ? last : NO_VALUE;
+}
+
+size_t successorsCount(const IrFunction* function, IrBlockId block)
+{
+    ASSERT_FUNCTION(function);
+
+    IrValue last = terminator(function, block);
+    if (last == NO_VALUE) { return 0; }
+
+    switch (INSTRUCTION(last).opcode)
+    {
+        case IR_JUMP:   { return 1; }
+        case IR_BRANCH: { return 2; }
+        default:        { return 0; }
+    }
+}
+
+IrBlockId successor(const IrFunction* function, IrBlockId block, size_t number)
+{
+    ASSERT_FUNCTION(function);
+    assert(number < successorsCount(function, block));
+
+    return INSTRUCTION(terminator(function, block)).targets[number];
+}
+
+size_t findInstruction(const IrFunction* function, IrValue value)
+{
+    ASSERT_FUNCTION(function);
+    assert(value < function->instructionsCount);
+    assert(INSTRUCTION(value).block != NO_BLOCK);
+
+    const IrBlock* block = &BLOCK(INSTRUCTION(value).block);
+
+    for (size_t i = 0; i < block->codeCount; i++)
+    {
+        if (block->code[i] == value) { return i; }
+    }
+
+    assert(!"Instruction isn't in its block");
+    return block->codeCount;
+}
+
+// users gets the last instruction that uses each value, it can be nullptr
+void countUses(const IrFunction* function, uint32_t* uses, IrValue* users)
+{
+    ASSERT_FUNCTION(function);
+    assert(uses != nullptr);
+
+    memset(uses, 0, function->instructionsCount * sizeof(uint32_t));
+
+    for (IrValue value = 0; value < function->instructionsCount; value++)
+    {
+        const IrInstruction* instruction = &INSTRUCTION(value);
+        if (instruction->block == NO_BLOCK) { continue; }
+
+        for (size_t i = 0; i < instruction->operandsCount; i++)
+        {
+            uses[instruction->operands[i]]++;
+
+            if (users != nullptr) { users[instruction->operands[i]] = value; }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Immediate dominators by the iterative algorithm of Cooper, Harvey and
+// Kennedy over the reverse postorder. The entry is its own dominator,
+// unreachable blocks get NO_BLOCK.
+//------------------------------------------------------------------------------
+void findDominators(const IrFunction* function, IrBlockId* dominators)
+{
+    ASSERT_FUNCTION(function);
+    assert(dominators != nullptr);
+
+    size_t     blocksCount = function->blocksCount;
+    IrBlockId* order       = (IrBlockId*) calloc(blocksCount + 1, sizeof(IrBlockId));
+    size_t*    numbers     = (size_t*)    calloc(blocksCount + 1, sizeof(size_t));
+    assert(order   != nullptr);
+    assert(numbers != nullptr);
+
+    size_t reachable = postorder(function, order, numbers);
+
+    for (size_t i = 0; i < blocksCount; i++)
+    {
+        dominators[i] = NO_BLOCK;
+    }
+
+    if (reachable == 0)
+    {
+        free(order);
+        free(numbers);
+        return;
+    }
+
+    dominators[0] = 0;
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+
+        for (size_t i = reachable - 1; i-- > 0;)
+        {
+            IrBlockId      block        = order[i];
+            const IrBlock* instructions = &BLOCK(block);
+            IrBlockId      dominator    = NO_BLOCK;
+
+            for (size_t j = 0; j < instructions->predsCount; j++)
+            {
+                IrBlockId pred = instructions->preds[j];
+                if (dominators[pred] == NO_BLOCK) { continue; }
+
+                if (dominator == NO_BLOCK) { dominator = pred; continue; }
+
+                IrBlockId other = pred;
+                while (other != dominator)
+                {
+                    while (numbers[other]     < numbers[dominator]) { other     = dominators[other];     }
+                    while (numbers[dominator] < numbers[other])     { dominator = dominators[dominator]; }
+                }
+            }
+
+            if (dominators[block] != dominator)
+            {
+                dominators[block] = dominator;
+                changed = true;
+            }
+        }
+    }
+
+    free(order);
+    free(numbers);
+}
+
+// Blocks reachable from the entry in postorder, numbers are their positions in it
+size_t postorder(const IrFunction* function, IrBlockId* order, size_t* numbers)
+{
+    ASSERT_FUNCTION(function);
+    assert(order   != nullptr);
+    assert(numbers != nullptr);
+
+    if (function->blocksCount == 0) { return 0; }
+
+    IrBlockId* stack   = (IrBlockId*) calloc(function->blocksCount, sizeof(IrBlockId));
+    size_t*    next    = (size_t*)    calloc(function->blocksCount, sizeof(size_t));
+    bool*      visited = (bool*)      calloc(function->blocksCount, sizeof(bool));
+    assert(stack != nullptr && next != nullptr && visited != nullptr);
+
+    size_t depth = 0;
+    size_t count = 0;
+
+    stack[depth++] = 0;
+    visited[0]     = true;
+
+    while (depth > 0)
+    {
+        IrBlockId block = stack[depth - 1];
+
+        if (next[block] < successorsCount(function, block))
+        {
+            IrBlockId target = successor(function, block, next[block]++);
+
+            if (!visited[target])
+            {
+                visited[target] = true;
+                stack[depth++]  = target;
+            }
+
+            continue;
+        }
+
+        numbers[block] = count;
+        order[count++] = block;
+        depth--;
+    }
+
+    free(stack);
+    free(next);
+    free(visited);
+
+    return count;
+}
+
+bool dominates(const IrBlockId* dominators, IrBlockId first, IrBlockId second)
+{
+    assert(dominators != nullptr);
+
+    if (dominators[second] == NO_BLOCK) { return false; }
+
+    while (second != first)
+    {
+        if (dominators[second] == second) { return false; }
+
+        second = dominators[second];
+    }
+
+    return true;
+}
+
+bool hasResult(IrOpcode opcode)
+{
+    return opcode != IR_STORE && opcode != IR_OUT && !isTerminator(opcode);
+}
+
+// No effects and nothing read from memory, so the value only depends on the operands
+bool isPure(IrOpcode opcode)
+{
+    return (opcode >= IR_ADD && opcode <= IR_SQRT) || opcode == IR_CONST || opcode == IR_PARAM ||
+           opcode == IR_PHI;
+}
+
+bool isTerminator(IrOpcode opcode)
+{
+    return opcode >= IR_JUMP && opcode <= IR_RANDOM_JUMP;
+}
+
+IrOpcode toIrOpcode(MathOp operation)
+{
+    assert(operation <= GREATER_OP);
+
+    return (IrOpcode) ((int) IR_ADD + (int) operation);
+}
+
+//------------------------------------------------------------------------------
+// Checks the structure of the blocks, that predecessors match the jumps, the
+// operands and that every use is dominated by the definition. Unreachable
+// blocks are only checked for structure, nothing dominates them.
+//------------------------------------------------------------------------------
+IrError verify(const IrProgram* program, const IrFunction* function)
+{
+    ASSERT_PROGRAM(program);
+    ASSERT_FUNCTION(function);
+
+    if (function->blocksCount == 0) { return IR_NO_ERROR; }
+
+    size_t placed = 0;
+    for (IrBlockId block = 0; block < function->blocksCount; block++)
+    {
+        if (BLOCK(block).removed) { continue; }
+
+        size_t times = 0;
+        for (size_t i = 0; i < function->layoutCount; i++)
+        {
+            if (function->layout[i] == block) { times++; }
+        }
+
+        if (times != 1) { return IR_ERROR_BROKEN_LAYOUT; }
+        placed++;
+    }
+
+    if (placed != function->layoutCount) { return IR_ERROR_BROKEN_LAYOUT; }
+
+    // Nothing jumps back to the entry, the stack code starts it by popping the parameters
+    if (BLOCK(0).removed || BLOCK(0).predsCount > 0) { return IR_ERROR_BROKEN_EDGE; }
+
+    for (IrBlockId block = 0; block < function->blocksCount; block++)
+    {
+        if (BLOCK(block).removed) { continue; }
+
+        IrError error = verifyBlock(function, block);
+        if (error == IR_NO_ERROR) { error = verifyEdges(function, block); }
+
+        if (error != IR_NO_ERROR) { return error; }
+    }
+
+    IrBlockId* dominators = (IrBlockId*) calloc(function->blocksCount, sizeof(IrBlockId));
+    assert(dominators != nullptr);
+
+    findDominators(function, dominators);
+
+    IrError error = IR_NO_ERROR;
+    for (IrValue value = 0; value < function->instructionsCount && error == IR_NO_ERROR; value++)
+    {
+        if (INSTRUCTION(value).block == NO_BLOCK) { continue; }
+
+        error = verifyOperands(function, value, dominators);
+    }
+
+    free(dominators);
+
+    return error;
+}
+
+IrError verifyBlock(const IrFunction* function, IrBlockId block)
+{
+    ASSERT_FUNCTION(function);
+
+    const IrBlock* instructions = &BLOCK(block);
+
+    if (terminator(function, block) == NO_VALUE) { return IR_ERROR_NO_TERMINATOR; }
+
+    bool phisEnded = false;
+    for (size_t i = 0; i < instructions->codeCount; i++)
+    {
+        const IrInstruction* instruction = &INSTRUCTION(instructions->code[i]);
+
+        if (instruction->block != block) { return IR_ERROR_MISPLACED_INSTRUCTION; }
+
+        bool isLast = i == instructions->codeCount - 1;
+        if (isTerminator(instruction->opcode) != isLast) { return IR_ERROR_MISPLACED_INSTRUCTION; }
+
+        if (instruction->opcode != IR_PHI) { phisEnded = true; continue; }
+
+        if (phisEnded || function->inMemory)                      { return IR_ERROR_MISPLACED_INSTRUCTION; }
+        if (instruction->operandsCount != instructions->predsCount) { return IR_ERROR_PHI_OPERANDS;          }
+    }
+
+    return IR_NO_ERROR;
+}
+
+// Every jump has its edge among the target's predecessors and the other way round
+IrError verifyEdges(const IrFunction* function, IrBlockId block)
+{
+    ASSERT_FUNCTION(function);
+
+    for (size_t i = 0; i < successorsCount(function, block); i++)
+    {
+        IrBlockId target = successor(function, block, i);
+        if (target >= function->blocksCount || BLOCK(target).removed) { return IR_ERROR_BROKEN_EDGE; }
+
+        size_t jumps = 0;
+        for (size_t j = 0; j < successorsCount(function, block); j++)
+        {
+            if (successor(function, block, j) == target) { jumps++; }
+        }
+
+        size_t edges = 0;
+        for (size_t j = 0; j < BLOCK(target).predsCount; j++)
+        {
+            if (BLOCK(target).preds[j] == block) { edges++; }
+        }
+
+        if (jumps != edges) { return IR_ERROR_BROKEN_EDGE; }
+    }
+
+    for (size_t i = 0; i < BLOCK(block).predsCount; i++)
+    {
+        IrBlockId pred = BLOCK(block).preds[i];
+        if (pred >= function->blocksCount || BLOCK(pred).removed) { return IR_ERROR_BROKEN_EDGE; }
+
+        bool found = false;
+        for (size_t j = 0; j < successorsCount(function, pred); j++)
+        {
+            if (successor(function, pred, j) == block) { found = true; }
+        }
+
+        if (!found) { return IR_ERROR_BROKEN_EDGE; }
+    }
+
+    return IR_NO_ERROR;
+}
+
+// A phi uses its operand at the end of the predecessor it comes from
+IrError verifyOperands(const IrFunction* function, IrValue value, const IrBlockId* dominators)
+{
+    ASSERT_FUNCTION(function);
+    assert(dominators != nullptr);
+
+    const IrInstruction* instruction = &INSTRUCTION(value);
+
+    size_t needed = operandsNeeded(instruction->opcode);
+    if (needed != SIZE_MAX && instruction->operandsCount != needed)
+    {
+        bool isBareReturn = instruction->opcode == IR_RETURN && instruction->operandsCount == 0;
+        if (!isBareReturn) { return IR_ERROR_BAD_OPERAND; }
+    }
+
+    for (size_t i = 0; i < instruction->operandsCount; i++)
+    {
+        IrValue operand = instruction->operands[i];
+
+        if (operand >= function->instructionsCount || INSTRUCTION(operand).block == NO_BLOCK ||
+            !hasResult(INSTRUCTION(operand).opcode))
+        {
+            return IR_ERROR_BAD_OPERAND;
+        }
+
+        IrBlockId definition = INSTRUCTION(operand).block;
+        IrBlockId use        = instruction->block;
+
+        if (instruction->opcode == IR_PHI)
+        {
+            use = BLOCK(instruction->block).preds[i];
+            if (dominators[use] == NO_BLOCK) { continue; }
+
+            if (!dominates(dominators, definition, use)) { return IR_ERROR_NOT_DOMINATED; }
+            continue;
+        }
+
+        if (dominators[use] == NO_BLOCK) { continue; }
+
+        if (definition == use)
+        {
+            if (findInstruction(function, operand) >= findInstruction(function, value)) { return IR_ERROR_NOT_DOMINATED; }
+            continue;
+        }
+
+        if (!dominates(dominators, definition, use)) { return IR_ERROR_NOT_DOMINATED; }
+    }
+
+    return IR_NO_ERROR;
+}
+
+// SIZE_MAX for any number, a return may also have none
+size_t operandsNeeded(IrOpcode opcode)
+{
+    switch (opcode)
+    {
+        case IR_CONST:
+        case IR_PARAM:
+        case IR_LOAD:
+        case IR_IN:
+        case IR_JUMP:
+        case IR_RANDOM_JUMP: { return 0;        }
+        case IR_CALL:
+        case IR_PHI:         { return SIZE_MAX; }
+        case IR_STORE:
+        case IR_FLOOR:
+        case IR_SQRT:
+        case IR_OUT:
+        case IR_BRANCH:
+        case IR_RETURN:      { return 1;        }
+        default:             { return 2;        }
+    }
+}
+
+void dump(const IrProgram* program, FILE* file)
+{
+    ASSERT_PROGRAM(program);
+    assert(file != nullptr);
+
+    for (size_t i = 0; i < program->functionsCount; i++)
+    {
+        if (program->functions[i].blocksCount == 0) { continue; }
+
+        dumpFunction(program, &program->functions[i], file);
+    }
+}
+
+void dumpFunction(const IrProgram* program, const IrFunction* function, FILE* file)
+{
+    ASSERT_PROGRAM(program);
+    ASSERT_FUNCTION(function);
+    assert(file != nullptr);
+
+    fprintf(file, "%s(", getSymbolName(function->symbols->name));
+
+    for (size_t i = 0; i < function->symbols->paramsCount; i++)
+    {
+        fprintf(file, "%s%s", (i > 0) ? ", " : "", getSymbolName(function->symbols->vars[i]));
+    }
+
+    fprintf(file, ")%s\n", function->inMemory ? ", variables in memory" : "");
+
+    for (size_t i = 0; i < function->layoutCount; i++)
+    {
+        IrBlockId      block        = function->layout[i];
+        const IrBlock* instructions = &BLOCK(block);
+
+        fprintf(file, "  b%u (%s_%zu)", block, LABEL_NAMES[instructions->label], instructions->labelIndex);
+
+        for (size_t j = 0; j < instructions->predsCount; j++)
+        {
+            fprintf(file, "%s b%u", (j == 0) ? " <-" : ",", instructions->preds[j]);
+        }
+
+        fprintf(file, ":\n");
+
+        for (size_t j = 0; j < instructions->codeCount; j++)
+        {
+            dumpInstruction(program, function, instructions->code[j], file);
+        }
+    }
+
+    fprintf(file, "\n");
+}
+
+void dumpInstruction(const IrProgram* program, const IrFunction* function, IrValue value, FILE* file)
+{
+    ASSERT_PROGRAM(program);
+    ASSERT_FUNCTION(function);
+    assert(file != nullptr);
+
+    const IrInstruction* instruction = &INSTRUCTION(value);
+
+    fprintf(file, "    ");
+
+    if (hasResult(instruction->opcode)) { fprintf(file, "%%%u = ", value); }
+
+    fprintf(file, "%s", IR_OPCODE_NAMES[instruction->opcode]);
+
+    switch (instruction->opcode)
+    {
+        case IR_CONST: { fprintf(file, " %lg", instruction->number); break; }
+
+        case IR_PARAM:
+        case IR_LOAD:
+        case IR_STORE:
+        {
+            fprintf(file, " %s", getSymbolName(function->symbols->vars[instruction->index]));
+            if (instruction->opcode == IR_STORE) { fprintf(file, ","); }
+            break;
+        }
+
+        case IR_CALL:
+        {
+            fprintf(file, " %s", getSymbolName(program->table->functions[instruction->index].name));
+            break;
+        }
+
+        default: { break; }
+    }
+
+    for (size_t i = 0; i < instruction->operandsCount; i++)
+    {
+        fprintf(file, "%s%%%u", (i > 0) ? ", " : " ", instruction->operands[i]);
+
+        if (instruction->opcode == IR_PHI)
+        {
+            fprintf(file, " from b%u", BLOCK(instruction->block).preds[i]);
+        }
+    }
+
+    for (size_t i = 0; i < successorsCount(function, instruction->block) && isTerminator(instruction->opcode); i++)
+    {
+        fprintf(file, "%sb%u", (i > 0 || instruction->operandsCount > 0) ? ", " : " ", instruction->targets[i]);
+    }
+
+    fprintf(file, "\n");
+}
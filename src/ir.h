@@ -0,0 +1,223 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include "syntax.h"
+#include "symbol_table.h"
+#include "arena.h"
+
+//------------------------------------------------------------------------------
+// Intermediate representation between the syntax tree and the stack CPU code.
+// A function is a graph of basic blocks. Every instruction defines at most one
+// value and is itself the name of it (its index in the function), values are
+// assigned once (SSA). Where control flow joins, after revelio and at while
+// headers, a variable with different values on the incoming edges gets a phi,
+// with one operand per predecessor, in the order of the block's predecessors.
+//
+// A function with riddikulus in it can be entered at any of its blocks, so no
+// values flow between them: its variables stay in their frame slots, read by
+// IR_LOAD and written by IR_STORE, and it has no phis. Passes leave it alone.
+//
+// A variable read before it's assigned on some path is 0 there, as in the C
+// back end.
+//------------------------------------------------------------------------------
+typedef uint32_t IrValue;
+typedef uint32_t IrBlockId;
+
+static const IrValue   NO_VALUE = UINT32_MAX;
+static const IrBlockId NO_BLOCK = UINT32_MAX;
+
+// In the order of MathOp, see toIrOpcode
+enum IrOpcode
+{
+    IR_CONST,         // number
+    IR_PARAM,         // index is the parameter's number
+    IR_LOAD,          // index is the variable's slot
+    IR_STORE,         // index is the variable's slot, stores the operand
+
+    IR_ADD,
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_EQUAL,         // comparisons are 1 or 0
+    IR_NOT_EQUAL,
+    IR_LESS_EQUAL,
+    IR_GREATER_EQUAL,
+    IR_LESS,
+    IR_GREATER,
+
+    IR_FLOOR,
+    IR_SQRT,
+    IR_IN,
+    IR_OUT,
+    IR_CALL,          // index is the callee's in the symbol table, operands are the arguments as evaluated
+    IR_PHI,
+
+    IR_JUMP,          // to targets[0]
+    IR_BRANCH,        // to targets[0] if the operand isn't 0, to targets[1] otherwise
+    IR_RETURN,        // the operand is the returned value, falling off the function's end has none
+    IR_RANDOM_JUMP,   // riddikulus
+
+    IR_OPCODES_COUNT
+};
+
+static const char* IR_OPCODE_NAMES[IR_OPCODES_COUNT] = {
+    "const", "param", "load", "store",
+    "add", "sub", "mul", "div",
+    "equal", "not_equal", "less_equal", "greater_equal", "less", "greater",
+    "floor", "sqrt", "in", "out", "call", "phi",
+    "jump", "branch", "return", "random_jump"
+};
+
+//------------------------------------------------------------------------------
+// Blocks keep the label they get in the stack CPU code, riddikulus may jump to
+// any of them. Numbers are shared by the blocks of one statement, e.g.
+// WHILE_n, WHILE_BODY_n and WHILE_END_n.
+//------------------------------------------------------------------------------
+enum LabelKind
+{
+    IF_LABEL,
+    IF_END_LABEL,
+    IF_ELSE_END_LABEL,
+    WHILE_LABEL,
+    WHILE_BODY_LABEL,
+    WHILE_END_LABEL,
+    COMPARISON_LABEL,
+    COMPARISON_END_LABEL,
+    TAIL_CALL_LABEL,      // indexed by function, see tail_calls.h
+    BLOCK_LABEL,          // code after a return or riddikulus, split edges
+
+    LABEL_KINDS_COUNT
+};
+
+static const char* LABEL_NAMES[LABEL_KINDS_COUNT] = {
+    "IF",
+    "IF_END",
+    "IF_ELSE_END",
+    "WHILE",
+    "WHILE_BODY",
+    "WHILE_END",
+    "COMPARISON",
+    "COMPARISON_END",
+    "TAIL_CALL",
+    "BLOCK"
+};
+
+enum IrError
+{
+    IR_NO_ERROR,
+    IR_ERROR_CALL_UNDEFINED_FUNCTION,
+    IR_ERROR_NO_TERMINATOR,
+    IR_ERROR_MISPLACED_INSTRUCTION,
+    IR_ERROR_BROKEN_EDGE,
+    IR_ERROR_PHI_OPERANDS,
+    IR_ERROR_BAD_OPERAND,
+    IR_ERROR_NOT_DOMINATED,
+    IR_ERROR_BROKEN_LAYOUT,
+
+    IR_ERRORS_COUNT
+};
+
+static const char* IR_ERROR_STRINGS[IR_ERRORS_COUNT] = {
+    "no error",
+    "calling undefined function",
+    "block doesn't end with a jump or return",
+    "instruction is out of its place in the block",
+    "predecessors don't match the jumps",
+    "phi doesn't have an operand for every predecessor",
+    "operand is removed or has no value",
+    "value is used where its definition doesn't dominate",
+    "block order doesn't list every block once"
+};
+
+struct IrInstruction
+{
+    IrOpcode  opcode;
+    IrBlockId block;      // NO_BLOCK once removed
+    double    number;     // IR_CONST
+    uint32_t  index;      // parameter number, variable slot or callee
+    IrBlockId targets[2]; // IR_JUMP, IR_BRANCH
+    IrValue*  operands;
+    uint32_t  operandsCount;
+};
+
+struct IrBlock
+{
+    IrValue*   code;      // phis first, the terminator last
+    size_t     codeCount;
+    size_t     codeCapacity;
+
+    IrBlockId* preds;
+    size_t     predsCount;
+    size_t     predsCapacity;
+
+    LabelKind  label;
+    size_t     labelIndex;
+    bool       removed;
+};
+
+struct IrFunction
+{
+    Function*      symbols;
+    bool           inMemory;      // has riddikulus, variables are loaded and stored
+    bool           removed;       // love never calls it, its blocks and instructions are dropped
+
+    IrInstruction* instructions;
+    size_t         instructionsCount;
+    size_t         instructionsCapacity;
+
+    IrBlock*       blocks;        // the entry is block 0
+    size_t         blocksCount;
+    size_t         blocksCapacity;
+
+    IrBlockId*     layout;        // blocks in the order they are written out
+    size_t         layoutCount;
+    size_t         layoutCapacity;
+};
+
+struct IrProgram
+{
+    SymbolTable* table;
+    Arena        arena;                          // everything the functions allocate
+    IrFunction*  functions;                      // indexed like table->functions
+    size_t       functionsCount;
+    size_t       labelsCount [LABEL_KINDS_COUNT]; // next free number of each label kind
+};
+
+void        construct          (IrProgram* program, SymbolTable* table);
+void        destroy            (IrProgram* program);
+const char* errorString        (IrError error);
+
+IrBlockId   addBlock           (IrProgram* program, IrFunction* function, LabelKind label, size_t index);
+void        placeBlock         (IrProgram* program, IrFunction* function, IrBlockId block, IrBlockId after);
+void        removeBlock        (IrFunction* function, IrBlockId block);
+void        addEdge            (IrProgram* program, IrFunction* function, IrBlockId from, IrBlockId to);
+void        removeEdge         (IrFunction* function, IrBlockId from, IrBlockId to);
+size_t      splitCriticalEdges (IrProgram* program, IrFunction* function);
+
+IrValue     addInstruction     (IrProgram* program, IrFunction* function, IrBlockId block, IrOpcode opcode);
+IrValue     insertInstruction  (IrProgram* program, IrFunction* function, IrBlockId block, size_t position,
+                                IrOpcode opcode);
+IrValue     addConst           (IrProgram* program, IrFunction* function, IrBlockId block, double number);
+void        addOperand         (IrProgram* program, IrFunction* function, IrValue value, IrValue operand);
+void        moveInstruction    (IrProgram* program, IrFunction* function, IrValue value, IrBlockId block,
+                                size_t position);
+void        removeInstruction  (IrFunction* function, IrValue value);
+void        replaceUses        (IrFunction* function, IrValue value, IrValue replacement);
+size_t      removeTrivialPhis  (IrFunction* function);
+
+IrValue     terminator         (const IrFunction* function, IrBlockId block);
+size_t      successorsCount    (const IrFunction* function, IrBlockId block);
+IrBlockId   successor          (const IrFunction* function, IrBlockId block, size_t number);
+size_t      findInstruction    (const IrFunction* function, IrValue value);
+void        countUses          (const IrFunction* function, uint32_t* uses, IrValue* users);
+void        findDominators     (const IrFunction* function, IrBlockId* dominators);
+bool        dominates          (const IrBlockId* dominators, IrBlockId first, IrBlockId second);
+
+bool        hasResult          (IrOpcode opcode);
+bool        isPure             (IrOpcode opcode);
+bool        isTerminator       (IrOpcode opcode);
+IrOpcode    toIrOpcode         (MathOp operation);
+
+IrError     verify             (const IrProgram* program, const IrFunction* function);
+void        dump               (const IrProgram* program, FILE* file);
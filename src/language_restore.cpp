@@ -6,54 +6,60 @@
 #include "language_restore.h"
 #include "../libs/utilib.h"
 
-#define OUTPUT     restorer->file
-#define NEW_LINE() write(restorer, "\n")
+#define OUTPUT      restorer->file
+#define NEW_LINE()  write(restorer, "\n")
+
+#define TYPE(node)  NODE_TYPE  (restorer->tree, node)
+#define DATA(node)  NODE_DATA  (restorer->tree, node)
+#define LEFT(node)  NODE_LEFT  (restorer->tree, node)
+#define RIGHT(node) NODE_RIGHT (restorer->tree, node)
 
 struct Restorer
 {
-    size_t curIndent;
-    FILE*  file;
+    size_t             curIndent;
+    FILE*              file;
+    const CompactTree* tree;
 };  
 
 void writeIndented        (Restorer* restorer, const char* format, ...);
 void write                (Restorer* restorer, const char* format, ...);
 
-void restoreFunction      (Restorer* restorer, Node* node);
-void restoreBlock         (Restorer* restorer, Node* block);
-void restoreStatement     (Restorer* restorer, Node* statement);
-void restoreCondition     (Restorer* restorer, Node* condition);
-void restoreLoop          (Restorer* restorer, Node* loop);
-void restoreCmdLine       (Restorer* restorer, Node* line);
-void restoreVDeclaration  (Restorer* restorer, Node* vdecl);
-void restoreAssignment    (Restorer* restorer, Node* assignment);
-void restoreJump          (Restorer* restorer, Node* jump);
-void restoreExpression    (Restorer* restorer, Node* expression);
-void restoreNumber        (Restorer* restorer, Node* number);
-void restoreDerefVar      (Restorer* restorer, Node* var);
-void restoreCall          (Restorer* restorer, Node* call);
-
-bool isOperationNode      (Node* node, MathOp operation);
-bool firstBracketsNeeded  (Node* operation);
-bool secondBracketsNeeded (Node* operation);
-void restoreMathOp        (Restorer* restorer, Node* operation);
-
-bool restoreCode(Node* root, const char* filename)
+void restoreFunction      (Restorer* restorer, NodeIndex node);
+void restoreBlock         (Restorer* restorer, NodeIndex block);
+void restoreStatement     (Restorer* restorer, NodeIndex statement);
+void restoreCondition     (Restorer* restorer, NodeIndex condition);
+void restoreLoop          (Restorer* restorer, NodeIndex loop);
+void restoreCmdLine       (Restorer* restorer, NodeIndex line);
+void restoreVDeclaration  (Restorer* restorer, NodeIndex vdecl);
+void restoreAssignment    (Restorer* restorer, NodeIndex assignment);
+void restoreJump          (Restorer* restorer, NodeIndex jump);
+void restoreExpression    (Restorer* restorer, NodeIndex expression);
+void restoreNumber        (Restorer* restorer, NodeIndex number);
+void restoreDerefVar      (Restorer* restorer, NodeIndex var);
+void restoreCall          (Restorer* restorer, NodeIndex call);
+
+bool isOperationNode      (Restorer* restorer, NodeIndex node, MathOp operation);
+bool firstBracketsNeeded  (Restorer* restorer, NodeIndex operation);
+bool secondBracketsNeeded (Restorer* restorer, NodeIndex operation);
+void restoreMathOp        (Restorer* restorer, NodeIndex operation);
+
+bool restoreCode(const CompactTree* tree, const char* filename)
 {   
-    assert(root     != nullptr);
+    assert(tree     != nullptr);
     assert(filename != nullptr);
 
     FILE* file = fopen(filename, "w");
     if (file == nullptr) { return false; }
 
-    Restorer restorer  = { 0, file };
+    Restorer restorer  = { 0, file, tree };
 
     write(&restorer, "%s %.*s\n\n", KEYWORDS[PROG_START_KEYWORD].name, strchr(filename, '.') - filename, filename);
 
-    Node* curDeclaration = root;
-    while (curDeclaration != nullptr)
+    NodeIndex curDeclaration = (tree->nodesCount > 0) ? 0 : NO_NODE; // root is node 0
+    while (curDeclaration != NO_NODE)
     {
-        restoreFunction(&restorer, curDeclaration->right);
-        curDeclaration = curDeclaration->left;
+        restoreFunction(&restorer, NODE_RIGHT(tree, curDeclaration));
+        curDeclaration = NODE_LEFT(tree, curDeclaration);
     }
 
     write(&restorer, "%s", KEYWORDS[PROG_END_KEYWORD].name);
@@ -94,114 +100,114 @@ void write(Restorer* restorer, const char* format, ...)
     va_end(args);
 }
 
-void restoreFunction(Restorer* restorer, Node* node)
+void restoreFunction(Restorer* restorer, NodeIndex node)
 {
     assert(restorer != nullptr);
-    assert(node     != nullptr);
+    assert(node     != NO_NODE);
 
-    write(restorer, "%s %s ", getKeywordString(FDECL_KEYWORD), node->data.id);
+    write(restorer, "%s %s ", getKeywordString(FDECL_KEYWORD), getSymbolName(DATA(node).name.id));
 
-    Node* curArg = node->right;
-    if (curArg == nullptr)
+    NodeIndex curArg = RIGHT(node);
+    if (curArg == NO_NODE)
     {
         write(restorer, "%s", getKeywordString(ZERO_KEYWORD));
     }
 
-    while (curArg != nullptr)
+    while (curArg != NO_NODE)
     {
-        write(restorer, curArg->data.id);
+        write(restorer, getSymbolName(DATA(curArg).name.id));
 
-        if (curArg->right != nullptr)
+        if (RIGHT(curArg) != NO_NODE)
         {
             write(restorer, ", ");
         }
 
-        curArg = curArg->right;
+        curArg = RIGHT(curArg);
     }
 
     NEW_LINE();
-    restoreBlock(restorer, node->left);
+    restoreBlock(restorer, LEFT(node));
     NEW_LINE();
 }
 
-void restoreBlock(Restorer* restorer, Node* block)
+void restoreBlock(Restorer* restorer, NodeIndex block)
 {
     assert(restorer != nullptr);
-    assert(block    != nullptr);
+    assert(block    != NO_NODE);
 
     writeIndented(restorer, "%s\n", getKeywordString(OPEN_BRACE_KEYWORD));
     restorer->curIndent++;
 
-    Node* curStatement = block->right;
-    while (curStatement != nullptr)
+    NodeIndex curStatement = RIGHT(block);
+    while (curStatement != NO_NODE)
     {
         restoreStatement(restorer, curStatement);
-        curStatement = curStatement->right;
+        curStatement = RIGHT(curStatement);
     }
 
     restorer->curIndent--;
     writeIndented(restorer, "%s\n", getKeywordString(CLOSE_BRACE_KEYWORD));
 }
 
-void restoreStatement(Restorer* restorer, Node* statement)
+void restoreStatement(Restorer* restorer, NodeIndex statement)
 {
     assert(restorer  != nullptr);
-    assert(statement != nullptr);
+    assert(statement != NO_NODE);
 
-    switch (statement->left->type)
+    switch (TYPE(LEFT(statement)))
     {
-        case COND_TYPE: { restoreCondition (restorer, statement->left); break; }
-        case LOOP_TYPE: { restoreLoop      (restorer, statement->left); break; }
-        default:        { restoreCmdLine   (restorer, statement->left); break; }
+        case COND_TYPE: { restoreCondition (restorer, LEFT(statement)); break; }
+        case LOOP_TYPE: { restoreLoop      (restorer, LEFT(statement)); break; }
+        default:        { restoreCmdLine   (restorer, LEFT(statement)); break; }
     }
 }
 
-void restoreCondition(Restorer* restorer, Node* condition)
+void restoreCondition(Restorer* restorer, NodeIndex condition)
 {
     assert(restorer  != nullptr);
-    assert(condition != nullptr);
+    assert(condition != NO_NODE);
 
     writeIndented(restorer, "%s ", getKeywordString(IF_KEYWORD));
 
     write(restorer, "%s ", getKeywordString(BRACKET_KEYWORD));
-    restoreExpression(restorer, condition->left);
+    restoreExpression(restorer, LEFT(condition));
     write(restorer, " %s", getKeywordString(BRACKET_KEYWORD));
     NEW_LINE();
 
-    restoreBlock(restorer, condition->right->left);
+    restoreBlock(restorer, LEFT(RIGHT(condition)));
 
-    if (condition->right->right != nullptr)
+    if (RIGHT(RIGHT(condition)) != NO_NODE)
     {
         writeIndented(restorer, "%s\n", getKeywordString(ELSE_KEYWORD));
-        restoreBlock(restorer, condition->right->right);
+        restoreBlock(restorer, RIGHT(RIGHT(condition)));
     }
 
     NEW_LINE();
 }
 
-void restoreLoop(Restorer* restorer, Node* loop)
+void restoreLoop(Restorer* restorer, NodeIndex loop)
 {
     assert(restorer != nullptr);
-    assert(loop     != nullptr);
+    assert(loop     != NO_NODE);
 
     writeIndented(restorer, "%s ", getKeywordString(LOOP_KEYWORD));
     write(restorer, "%s ", getKeywordString(BRACKET_KEYWORD));
-    restoreExpression(restorer, loop->left);
+    restoreExpression(restorer, LEFT(loop));
     write(restorer, " %s",getKeywordString(BRACKET_KEYWORD));
 
     NEW_LINE();
-    restoreBlock(restorer, loop->right);
+    restoreBlock(restorer, RIGHT(loop));
     NEW_LINE();
 }
 
-void restoreCmdLine(Restorer* restorer, Node* line)
+void restoreCmdLine(Restorer* restorer, NodeIndex line)
 {
     assert(restorer != nullptr);
-    assert(line     != nullptr);
+    assert(line     != NO_NODE);
 
     writeIndented(restorer, " - ");
 
-    switch (line->type)
+    switch (TYPE(line))
     {
         case VDECL_TYPE: { restoreVDeclaration (restorer, line); break; }
         case ASSG_TYPE:  { restoreAssignment   (restorer, line); break; }
@@ -212,39 +218,39 @@ void restoreCmdLine(Restorer* restorer, Node* line)
     NEW_LINE();
 }
 
-void restoreVDeclaration(Restorer* restorer, Node* vdecl)
+void restoreVDeclaration(Restorer* restorer, NodeIndex vdecl)
 {
     assert(restorer != nullptr);
-    assert(vdecl    != nullptr);
+    assert(vdecl    != NO_NODE);
 
     write(restorer, "%s ", getKeywordString(VDECL_KEYWORD));
     restoreAssignment(restorer, vdecl);
 }
 
-void restoreAssignment(Restorer* restorer, Node* assignment)
+void restoreAssignment(Restorer* restorer, NodeIndex assignment)
 {
     assert(restorer   != nullptr);
-    assert(assignment != nullptr);
+    assert(assignment != NO_NODE);
 
-    write(restorer, "%s %s ", assignment->left->data.id, getKeywordString(ASSGN_KEYWORD));
-    restoreExpression(restorer, assignment->right);
+    write(restorer, "%s %s ", getSymbolName(DATA(LEFT(assignment)).name.id), getKeywordString(ASSGN_KEYWORD));
+    restoreExpression(restorer, RIGHT(assignment));
 }
 
-void restoreJump(Restorer* restorer, Node* jump)
+void restoreJump(Restorer* restorer, NodeIndex jump)
 {
     assert(restorer != nullptr);
-    assert(jump     != nullptr);
+    assert(jump     != NO_NODE);
 
     write(restorer, "%s ", getKeywordString(RETURN_KEYWORD));
-    restoreExpression(restorer, jump->right);
+    restoreExpression(restorer, RIGHT(jump));
 }
 
-void restoreExpression(Restorer* restorer, Node* expression)
+void restoreExpression(Restorer* restorer, NodeIndex expression)
 {
     assert(restorer   != nullptr);
-    assert(expression != nullptr);
+    assert(expression != NO_NODE);
 
-    switch (expression->type)
+    switch (TYPE(expression))
     {
         case NUMB_TYPE: { restoreNumber   (restorer, expression); break; }
         case NAME_TYPE: { restoreDerefVar (restorer, expression); break; }
@@ -253,118 +259,119 @@ void restoreExpression(Restorer* restorer, Node* expression)
     }
 }
 
-void restoreNumber(Restorer* restorer, Node* number)
+void restoreNumber(Restorer* restorer, NodeIndex number)
 {
     assert(restorer != nullptr);
-    assert(number   != nullptr);
+    assert(number   != NO_NODE);
 
-    write(restorer, "%lg", number->data.number);
+    write(restorer, "%lg", DATA(number).number);
 }
 
-void restoreDerefVar(Restorer* restorer, Node* var)
+void restoreDerefVar(Restorer* restorer, NodeIndex var)
 {
     assert(restorer != nullptr);
-    assert(var      != nullptr);
+    assert(var      != NO_NODE);
 
-    write(restorer, "%s %s", getKeywordString(DEREF_KEYWORD), var->data.id);
+    write(restorer, "%s %s", getKeywordString(DEREF_KEYWORD), getSymbolName(DATA(var).name.id));
 }
 
-void restoreCall(Restorer* restorer, Node* call)
+void restoreCall(Restorer* restorer, NodeIndex call)
 {
     assert(restorer != nullptr);
-    assert(call     != nullptr);
+    assert(call     != NO_NODE);
+
+    SymbolId    function = DATA(LEFT(call)).name.id;
+    const char* name     = getSymbolName(function);
 
-    const char* function = call->left->data.id;
-    if (strcmp(function, getKeywordString(SCAN_KEYWORD)) == 0)
+    if (function == SCAN_SYMBOL)
     {
-        write(restorer, function);
+        write(restorer, name);
         return;
     }
 
-    if (strcmp(function, getKeywordString(PRINT_KEYWORD)) == 0)
+    if (function == PRINT_SYMBOL)
     {
-        write(restorer, "%s ", function);
-        restoreExpression(restorer, call->right->left);
+        write(restorer, "%s ", name);
+        restoreExpression(restorer, LEFT(RIGHT(call)));
         return;
     }
 
-    if (strcmp(function, getKeywordString(FLOOR_KEYWORD)) != 0 && 
-        strcmp(function, getKeywordString(SQRT_KEYWORD))  != 0)
+    if (function != FLOOR_SYMBOL && function != SQRT_SYMBOL)
     {
         write(restorer, "%s ", getKeywordString(CALL_KEYWORD));
     }
 
-    write(restorer, "%s %s ", function, getKeywordString(BRACKET_KEYWORD));
+    write(restorer, "%s %s ", name, getKeywordString(BRACKET_KEYWORD));
 
-    Node* curParam = call->right;
-    while (curParam != nullptr)
+    NodeIndex curParam = RIGHT(call);
+    while (curParam != NO_NODE)
     {
-        restoreExpression(restorer, curParam->left);
+        restoreExpression(restorer, LEFT(curParam));
 
-        if (curParam->right != nullptr)
+        if (RIGHT(curParam) != NO_NODE)
         {
             write(restorer, ", ");
         }
 
-        curParam = curParam->right;
+        curParam = RIGHT(curParam);
     }
 
     write(restorer, " %s", getKeywordString(BRACKET_KEYWORD));
 }
 
-bool isOperationNode(Node* node, MathOp operation)
+bool isOperationNode(Restorer* restorer, NodeIndex node, MathOp operation)
 {
-    assert(node != nullptr);
+    assert(node != NO_NODE);
 
-    return node->type == MATH_TYPE && node->data.operation == operation;
+    return TYPE(node) == MATH_TYPE && DATA(node).operation == operation;
 }
 
-bool firstBracketsNeeded(Node* operation)
+bool firstBracketsNeeded(Restorer* restorer, NodeIndex operation)
 {
-    assert(operation != nullptr);
+    assert(operation != NO_NODE);
 
-    return (isOperationNode(operation,       MUL_OP) || isOperationNode(operation,       DIV_OP)) &&
-           (isOperationNode(operation->left, ADD_OP) || isOperationNode(operation->left, SUB_OP));
+    return (isOperationNode(restorer, operation,       MUL_OP) || isOperationNode(restorer, operation,       DIV_OP)) &&
+           (isOperationNode(restorer, LEFT(operation), ADD_OP) || isOperationNode(restorer, LEFT(operation), SUB_OP));
 }
 
-bool secondBracketsNeeded(Node* operation)
+bool secondBracketsNeeded(Restorer* restorer, NodeIndex operation)
 {
-    assert(operation != nullptr);
+    assert(operation != NO_NODE);
 
-    return (isOperationNode(operation,       MUL_OP) || 
-            isOperationNode(operation,       DIV_OP) || 
-            isOperationNode(operation,       SUB_OP)) &&
+    return (isOperationNode(restorer, operation,       MUL_OP) || 
+            isOperationNode(restorer, operation,       DIV_OP) || 
+            isOperationNode(restorer, operation,       SUB_OP)) &&
 
-           (isOperationNode(operation->left, ADD_OP) || 
-            isOperationNode(operation->left, SUB_OP));
+           (isOperationNode(restorer, LEFT(operation), ADD_OP) || 
+            isOperationNode(restorer, LEFT(operation), SUB_OP));
 }
 
-void restoreMathOp(Restorer* restorer, Node* operation)
+void restoreMathOp(Restorer* restorer, NodeIndex operation)
 {
     assert(restorer  != nullptr);
-    assert(operation != nullptr);
+    assert(operation != NO_NODE);
 
-    if (firstBracketsNeeded(operation))
+    if (firstBracketsNeeded(restorer, operation))
     {
         write(restorer, "%s ", getKeywordString(BRACKET_KEYWORD));
-        restoreExpression(restorer, operation->left);
+        restoreExpression(restorer, LEFT(operation));
         write(restorer, " %s", getKeywordString(BRACKET_KEYWORD));
     }
     else
     {
-        restoreExpression(restorer, operation->left);
+        restoreExpression(restorer, LEFT(operation));
     }
 
-    write(restorer, " %s ", KEYWORDS[PLUS_KEYWORD + operation->data.operation].name);
+    write(restorer, " %s ", KEYWORDS[PLUS_KEYWORD + DATA(operation).operation].name);
 
-    if (secondBracketsNeeded(operation))
+    if (secondBracketsNeeded(restorer, operation))
     {
         write(restorer, "%s ", getKeywordString(BRACKET_KEYWORD));
-        restoreExpression(restorer, operation->right);
+        restoreExpression(restorer, RIGHT(operation));
         write(restorer, " %s", getKeywordString(BRACKET_KEYWORD));
     }
     else
     {
-        restoreExpression(restorer, operation->right);
+        restoreExpression(restorer, RIGHT(operation));
     }
 }
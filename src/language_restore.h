@@ -1,5 +1,5 @@
 #pragma once
 
-#include "expression_tree.h"
+#include "compact_tree.h"
 
-bool restoreCode(Node* root, const char* filename);
\ No newline at end of file
+bool restoreCode(const CompactTree* tree, const char* filename);
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "loop_invariants.h"
+
+#define INSTRUCTION(value) (function->instructions[value])
+#define BLOCK(block)       (function->blocks[block])
+
+struct Loop
+{
+    IrBlockId header;
+    size_t    size;   // blocks in the body, the header included
+};
+
+void      hoistFunction (IrProgram* program, IrFunction* function, LoopInvariantStats* stats);
+size_t    markLoop      (const IrFunction* function, const IrBlockId* dominators, IrBlockId header, IrBlockId* marks,
+                         IrBlockId* stack);
+IrBlockId findPreheader (const IrFunction* function, const IrBlockId* dominators, IrBlockId header);
+size_t    hoistPosition (const IrFunction* function, IrBlockId preheader);
+size_t    hoistLoop     (IrProgram* program, IrFunction* function, IrBlockId header, IrBlockId preheader,
+                         const IrBlockId* marks);
+bool      isInvariant   (const IrFunction* function, IrValue value, IrBlockId header, const IrBlockId* marks);
+int       compareLoops  (const void* first, const void* second);
+
+void hoistLoopInvariants(IrProgram* program, void* stats)
+{
+    assert(program != nullptr);
+    assert(stats   != nullptr);
+
+    for (size_t i = 0; i < program->functionsCount; i++)
+    {
+        IrFunction* function = &program->functions[i];
+        if (function->inMemory || function->blocksCount == 0) { continue; }
+
+        hoistFunction(program, function, (LoopInvariantStats*) stats);
+    }
+}
+
+void hoistFunction(IrProgram* program, IrFunction* function, LoopInvariantStats* stats)
+{
+    assert(program  != nullptr);
+    assert(function != nullptr);
+    assert(stats    != nullptr);
+
+    size_t blocksCount = function->blocksCount + 1;
+
+    IrBlockId* dominators = (IrBlockId*) calloc(blocksCount, sizeof(IrBlockId));
+    IrBlockId* marks      = (IrBlockId*) calloc(blocksCount, sizeof(IrBlockId));
+    IrBlockId* stack      = (IrBlockId*) calloc(blocksCount, sizeof(IrBlockId));
+    Loop*      loops      = (Loop*)      calloc(blocksCount, sizeof(Loop));
+    assert(dominators != nullptr);
+    assert(marks      != nullptr);
+    assert(stack      != nullptr);
+    assert(loops      != nullptr);
+
+    findDominators(function, dominators);
+    memset(marks, 0xFF, blocksCount * sizeof(IrBlockId));
+
+    size_t loopsCount = 0;
+
+    for (IrBlockId header = 0; header < function->blocksCount; header++)
+    {
+        if (BLOCK(header).removed || dominators[header] == NO_BLOCK) { continue; }
+
+        size_t size = markLoop(function, dominators, header, marks, stack);
+        if (size != 0) { loops[loopsCount++] = { header, size }; }
+    }
+
+    // A loop inside another one has fewer blocks than it
+    qsort(loops, loopsCount, sizeof(Loop), compareLoops);
+
+    for (size_t i = 0; i < loopsCount; i++)
+    {
+        IrBlockId header    = loops[i].header;
+        IrBlockId preheader = findPreheader(function, dominators, header);
+        if (preheader == NO_BLOCK) { continue; }
+
+        // The header's own marks from the sizing above would stop the walk early
+        memset(marks, 0xFF, blocksCount * sizeof(IrBlockId));
+        markLoop(function, dominators, header, marks, stack);
+
+        size_t hoisted = hoistLoop(program, function, header, preheader, marks);
+        if (hoisted == 0) { continue; }
+
+        stats->hoistedValues += hoisted;
+        stats->loops++;
+    }
+
+    free(dominators);
+    free(marks);
+    free(stack);
+    free(loops);
+}
+
+//------------------------------------------------------------------------------
+// Marks the blocks of the header's loop with the header, walking back from
+// the jumps to it until the header. Blocks the entry can't reach aren't part
+// of it. Returns how many there are, 0 if nothing jumps back to it.
+//------------------------------------------------------------------------------
+size_t markLoop(const IrFunction* function, const IrBlockId* dominators, IrBlockId header, IrBlockId* marks,
+                IrBlockId* stack)
+{
+    assert(function   != nullptr);
+    assert(dominators != nullptr);
+    assert(marks      != nullptr);
+    assert(stack      != nullptr);
+
+    size_t size       = 0;
+    size_t stackCount = 0;
+
+    for (size_t i = 0; i < BLOCK(header).predsCount; i++)
+    {
+        IrBlockId pred = BLOCK(header).preds[i];
+        if (!dominates(dominators, header, pred)) { continue; }
+
+        if (size == 0)
+        {
+            marks[header] = header;
+            size++;
+        }
+
+        if (marks[pred] == header) { continue; }
+
+        marks[pred]         = header;
+        stack[stackCount++] = pred;
+        size++;
+    }
+
+    while (stackCount > 0)
+    {
+        IrBlockId block = stack[--stackCount];
+
+        for (size_t i = 0; i < BLOCK(block).predsCount; i++)
+        {
+            IrBlockId pred = BLOCK(block).preds[i];
+            if (marks[pred] == header || dominators[pred] == NO_BLOCK) { continue; }
+
+            marks[pred]         = header;
+            stack[stackCount++] = pred;
+            size++;
+        }
+    }
+
+    return size;
+}
+
+//------------------------------------------------------------------------------
+// The only block that enters the loop, NO_BLOCK if there are more. A while's
+// is its test at the top, which also goes past the loop when the condition
+// is false from the start.
+//------------------------------------------------------------------------------
+IrBlockId findPreheader(const IrFunction* function, const IrBlockId* dominators, IrBlockId header)
+{
+    assert(function   != nullptr);
+    assert(dominators != nullptr);
+
+    IrBlockId preheader = NO_BLOCK;
+
+    for (size_t i = 0; i < BLOCK(header).predsCount; i++)
+    {
+        IrBlockId pred = BLOCK(header).preds[i];
+        if (dominates(dominators, header, pred)) { continue; }
+
+        if (preheader != NO_BLOCK) { return NO_BLOCK; }
+
+        preheader = pred;
+    }
+
+    return preheader;
+}
+
+// Right before the jump, or before the condition of a branch so it stays next to it
+size_t hoistPosition(const IrFunction* function, IrBlockId preheader)
+{
+    assert(function != nullptr);
+
+    size_t               position = BLOCK(preheader).codeCount - 1;
+    const IrInstruction* jump     = &INSTRUCTION(BLOCK(preheader).code[position]);
+
+    if (jump->opcode == IR_BRANCH && position > 0 && BLOCK(preheader).code[position - 1] == jump->operands[0])
+    {
+        position--;
+    }
+
+    return position;
+}
+
+//------------------------------------------------------------------------------
+// Moves invariant math to the preheader in the order it's found, right before
+// the jump. What it uses is either already there or computed earlier, as the
+// preheader is dominated by everything defined outside the loop that the
+// loop uses. Goes on until nothing moves, as moving a value can make its
+// users invariant. Constants move along, they are pushed as numbers wherever
+// they are used anyway, so they aren't counted.
+//------------------------------------------------------------------------------
+size_t hoistLoop(IrProgram* program, IrFunction* function, IrBlockId header, IrBlockId preheader,
+                 const IrBlockId* marks)
+{
+    assert(program  != nullptr);
+    assert(function != nullptr);
+    assert(marks    != nullptr);
+
+    size_t hoisted = 0;
+    bool   changed = true;
+
+    while (changed)
+    {
+        changed = false;
+
+        for (size_t i = 0; i < function->layoutCount; i++)
+        {
+            IrBlockId block = function->layout[i];
+            if (marks[block] != header) { continue; }
+
+            for (size_t j = 0; j < BLOCK(block).codeCount; )
+            {
+                IrValue value = BLOCK(block).code[j];
+
+                if (!isInvariant(function, value, header, marks))
+                {
+                    j++;
+                    continue;
+                }
+
+                moveInstruction(program, function, value, preheader, hoistPosition(function, preheader));
+
+                if (INSTRUCTION(value).opcode != IR_CONST) { hoisted++; }
+                changed = true;
+            }
+        }
+    }
+
+    return hoisted;
+}
+
+bool isInvariant(const IrFunction* function, IrValue value, IrBlockId header, const IrBlockId* marks)
+{
+    assert(function != nullptr);
+    assert(marks    != nullptr);
+
+    const IrInstruction* instruction = &INSTRUCTION(value);
+    if (instruction->opcode != IR_CONST && (instruction->opcode < IR_ADD || instruction->opcode > IR_SQRT))
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < instruction->operandsCount; i++)
+    {
+        if (marks[INSTRUCTION(instruction->operands[i]).block] == header) { return false; }
+    }
+
+    return true;
+}
+
+int compareLoops(const void* first, const void* second)
+{
+    size_t firstSize  = ((const Loop*) first)->size;
+    size_t secondSize = ((const Loop*) second)->size;
+
+    return (firstSize > secondSize) - (firstSize < secondSize);
+}
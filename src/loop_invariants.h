@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ir.h"
+
+//------------------------------------------------------------------------------
+// Loop-invariant code motion. A loop is a header with a jump back to it from
+// a block it dominates: a while's body (WHILE_BODY_n) or a tail call loop
+// (TAIL_CALL_n). Math whose operands are all computed before the loop, or are
+// constants, or are themselves invariant, moves from the body and the test at
+// its bottom to the end of the block that enters the loop, so it runs once
+// instead of on every iteration. Inner loops go first, so their invariants can move on out of
+// the loops around them.
+//
+// Only pure math moves (see isPure), never accio, calls or loads, and it's
+// moved even out of code the loop runs conditionally, as it can't fail: the
+// stack CPU divides by zero and takes square roots of negative numbers
+// without stopping. A loop entered from more than one block is left alone,
+// and so are functions with riddikulus.
+//------------------------------------------------------------------------------
+struct LoopInvariantStats
+{
+    size_t hoistedValues;
+    size_t loops;          // loops something was moved out of
+};
+
+void hoistLoopInvariants (IrProgram* program, void* stats);
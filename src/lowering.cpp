@@ -0,0 +1,673 @@
+#include <assert.h>
+#include <string.h>
+#include "lowering.h"
+
+#define ASSERT_LOWERING(lowering) assert(lowering           != nullptr); \
+                                  assert(lowering->program  != nullptr); \
+                                  assert(lowering->tree     != nullptr); \
+                                  assert(lowering->function != nullptr);
+
+#define TYPE(node)  NODE_TYPE  (lowering->tree, node)
+#define DATA(node)  NODE_DATA  (lowering->tree, node)
+#define LEFT(node)  NODE_LEFT  (lowering->tree, node)
+#define RIGHT(node) NODE_RIGHT (lowering->tree, node)
+
+#define PROGRAM     (lowering->program)
+#define FUNCTION    (lowering->function)
+#define INSTRUCTION(value) (lowering->function->instructions[value])
+
+struct Lowering
+{
+    IrProgram*         program;
+    const CompactTree* tree;
+    IrFunction*        function;
+
+    IrBlockId          block;     // NO_BLOCK after a return or riddikulus
+    IrValue*           vars;      // current value of every variable, NO_VALUE before it's assigned
+    size_t             varsCount;
+    IrValue            zero;      // value of unassigned variables, NO_VALUE until it's needed
+
+    IrError            status;
+};
+
+void      lowerFunction     (Lowering* lowering, NodeIndex node);
+void      lowerBlock        (Lowering* lowering, NodeIndex node);
+void      lowerStatement    (Lowering* lowering, NodeIndex node);
+void      lowerCondition    (Lowering* lowering, NodeIndex node);
+void      lowerLoop         (Lowering* lowering, NodeIndex node);
+bool      lowerLoopTest     (Lowering* lowering, NodeIndex condition, IrBlockId body, IrBlockId exit);
+void      lowerAssignment   (Lowering* lowering, NodeIndex node);
+void      lowerReturn       (Lowering* lowering, NodeIndex node);
+
+IrValue   lowerExpression   (Lowering* lowering, NodeIndex node);
+IrValue   lowerMath         (Lowering* lowering, NodeIndex node);
+IrValue   lowerCall         (Lowering* lowering, NodeIndex node);
+IrValue   lowerUnary        (Lowering* lowering, NodeIndex node, IrOpcode opcode);
+
+IrValue   readVariable      (Lowering* lowering, int32_t slot);
+void      writeVariable     (Lowering* lowering, int32_t slot, IrValue value);
+IrValue   zeroValue         (Lowering* lowering);
+IrValue   varOrZero         (Lowering* lowering, const IrValue* vars, size_t slot);
+IrValue*  saveVariables     (Lowering* lowering);
+void      mergeVariables    (Lowering* lowering, const IrValue* first, bool firstReached,
+                             const IrValue* second, bool secondReached);
+void      findAssigned      (Lowering* lowering, NodeIndex node, bool* assigned);
+bool      hasRandomJump     (Lowering* lowering, NodeIndex node);
+
+IrValue   addValue          (Lowering* lowering, IrOpcode opcode);
+void      startBlock        (Lowering* lowering, IrBlockId block);
+void      startUnreachable  (Lowering* lowering);
+void      jumpTo            (Lowering* lowering, IrBlockId target);
+
+IrError lowerProgram(IrProgram* program, const CompactTree* tree)
+{
+    assert(program != nullptr);
+    assert(tree    != nullptr);
+
+    Lowering lowering = {};
+    lowering.program = program;
+    lowering.tree    = tree;
+
+    NodeIndex curDeclaration = (tree->nodesCount > 0) ? 0 : NO_NODE; // root is node 0
+    while (curDeclaration != NO_NODE)
+    {
+        NodeIndex function = NODE_RIGHT(tree, curDeclaration);
+        Function* symbols  = getFunction(program->table, NODE_DATA(tree, function).name.id);
+        assert(symbols != nullptr);
+
+        lowering.function = &program->functions[symbols - program->table->functions];
+        lowerFunction(&lowering, function);
+
+        curDeclaration = NODE_LEFT(tree, curDeclaration);
+    }
+
+    return lowering.status;
+}
+
+void lowerFunction(Lowering* lowering, NodeIndex node)
+{
+    ASSERT_LOWERING(lowering);
+    assert(node != NO_NODE);
+
+    const Function* symbols = FUNCTION->symbols;
+
+    FUNCTION->inMemory  = hasRandomJump(lowering, LEFT(node));
+    lowering->varsCount = symbols->varsCount;
+    lowering->zero      = NO_VALUE;
+    lowering->vars      = (IrValue*) calloc(symbols->varsCount + 1, sizeof(IrValue));
+    assert(lowering->vars != nullptr);
+
+    for (size_t i = 0; i < symbols->varsCount; i++)
+    {
+        lowering->vars[i] = NO_VALUE;
+    }
+
+    startBlock(lowering, addBlock(PROGRAM, FUNCTION, BLOCK_LABEL, PROGRAM->labelsCount[BLOCK_LABEL]++));
+
+    // In memory the parameters are simply in their slots
+    for (size_t i = 0; i < symbols->paramsCount && !FUNCTION->inMemory; i++)
+    {
+        IrValue param = addValue(lowering, IR_PARAM);
+        INSTRUCTION(param).index = (uint32_t) i;
+
+        lowering->vars[i] = param;
+    }
+
+    lowerBlock(lowering, LEFT(node));
+
+    if (lowering->block != NO_BLOCK)
+    {
+        addValue(lowering, IR_RETURN);
+    }
+
+    removeTrivialPhis(FUNCTION);
+
+    free(lowering->vars);
+    lowering->vars = nullptr;
+}
+
+void lowerBlock(Lowering* lowering, NodeIndex node)
+{
+    ASSERT_LOWERING(lowering);
+
+    if (node == NO_NODE) { return; }
+
+    for (NodeIndex statement = RIGHT(node); statement != NO_NODE; statement = RIGHT(statement))
+    {
+        lowerStatement(lowering, statement);
+    }
+}
+
+void lowerStatement(Lowering* lowering, NodeIndex node)
+{
+    ASSERT_LOWERING(lowering);
+    assert(node       != NO_NODE);
+    assert(LEFT(node) != NO_NODE);
+
+    if (lowering->block == NO_BLOCK) { startUnreachable(lowering); }
+
+    NodeIndex content = LEFT(node);
+
+    switch (TYPE(content))
+    {
+        case COND_TYPE:  { lowerCondition  (lowering, content); break; }
+        case LOOP_TYPE:  { lowerLoop       (lowering, content); break; }
+        case VDECL_TYPE: { lowerAssignment (lowering, content); break; }
+        case ASSG_TYPE:  { lowerAssignment (lowering, content); break; }
+        case JUMP_TYPE:  { lowerReturn     (lowering, content); break; }
+        default:         { lowerExpression (lowering, content); break; }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Both branches start with the variables as they were before the condition.
+// A branch without otherwise gets an empty block all the same, so that the
+// join's phis have an edge of their own to copy on.
+//------------------------------------------------------------------------------
+void lowerCondition(Lowering* lowering, NodeIndex node)
+{
+    ASSERT_LOWERING(lowering);
+    assert(node != NO_NODE);
+
+    size_t  label     = PROGRAM->labelsCount[IF_LABEL]++;
+    IrValue condition = lowerExpression(lowering, LEFT(node));
+
+    IrBlockId thenBlock = addBlock(PROGRAM, FUNCTION, IF_LABEL,          label);
+    IrBlockId elseBlock = addBlock(PROGRAM, FUNCTION, IF_END_LABEL,      label);
+    IrBlockId joinBlock = addBlock(PROGRAM, FUNCTION, IF_ELSE_END_LABEL, label);
+
+    if (lowering->block != NO_BLOCK)
+    {
+        IrValue branch = addValue(lowering, IR_BRANCH);
+        addOperand(PROGRAM, FUNCTION, branch, condition);
+
+        INSTRUCTION(branch).targets[0] = thenBlock;
+        INSTRUCTION(branch).targets[1] = elseBlock;
+
+        addEdge(PROGRAM, FUNCTION, lowering->block, thenBlock);
+        addEdge(PROGRAM, FUNCTION, lowering->block, elseBlock);
+    }
+
+    IrValue* before = saveVariables(lowering);
+
+    startBlock (lowering, thenBlock);
+    lowerBlock (lowering, LEFT(RIGHT(node)));
+
+    bool thenReached = lowering->block != NO_BLOCK;
+    jumpTo(lowering, joinBlock);
+
+    IrValue* afterThen = saveVariables(lowering);
+    memcpy(lowering->vars, before, lowering->varsCount * sizeof(IrValue));
+
+    startBlock (lowering, elseBlock);
+    lowerBlock (lowering, RIGHT(RIGHT(node)));
+
+    bool elseReached = lowering->block != NO_BLOCK;
+    jumpTo(lowering, joinBlock);
+
+    startBlock     (lowering, joinBlock);
+    mergeVariables (lowering, afterThen, thenReached, lowering->vars, elseReached);
+
+    free(before);
+    free(afterThen);
+}
+
+//------------------------------------------------------------------------------
+// Loops are rotated: WHILE_n tests the condition once before the loop, and
+// the condition is tested again at the bottom of the body, which branches
+// back to WHILE_BODY_n, so an iteration takes a single jump. WHILE_BODY_n
+// gets its phis before the body is lowered: a phi for every variable the body
+// assigns, with the value from the guard first and the one from the bottom
+// second. The ones the body doesn't really change are trivial and go later.
+// WHILE_END_n merges the variables as the guard and the bottom leave them.
+//------------------------------------------------------------------------------
+void lowerLoop(Lowering* lowering, NodeIndex node)
+{
+    ASSERT_LOWERING(lowering);
+    assert(node != NO_NODE);
+
+    size_t label = PROGRAM->labelsCount[WHILE_LABEL]++;
+
+    IrBlockId guard = addBlock(PROGRAM, FUNCTION, WHILE_LABEL,      label);
+    IrBlockId body  = addBlock(PROGRAM, FUNCTION, WHILE_BODY_LABEL, label);
+    IrBlockId exit  = addBlock(PROGRAM, FUNCTION, WHILE_END_LABEL,  label);
+
+    jumpTo     (lowering, guard);
+    startBlock (lowering, guard);
+
+    bool     guardReached = lowerLoopTest(lowering, LEFT(node), body, exit);
+    IrValue* atGuard      = saveVariables(lowering);
+
+    bool*    assigned = (bool*)    calloc(lowering->varsCount + 1, sizeof(bool));
+    IrValue* phis     = (IrValue*) calloc(lowering->varsCount + 1, sizeof(IrValue));
+    assert(assigned != nullptr);
+    assert(phis     != nullptr);
+
+    // Riddikulus in the condition leaves the body unreachable, with nothing to merge
+    if (!FUNCTION->inMemory && guardReached) { findAssigned(lowering, RIGHT(node), assigned); }
+
+    startBlock(lowering, body);
+
+    for (size_t slot = 0; slot < lowering->varsCount; slot++)
+    {
+        if (!assigned[slot]) { continue; }
+
+        phis[slot] = addValue(lowering, IR_PHI);
+        addOperand(PROGRAM, FUNCTION, phis[slot], varOrZero(lowering, atGuard, slot));
+
+        lowering->vars[slot] = phis[slot];
+    }
+
+    lowerBlock(lowering, RIGHT(node));
+
+    if (lowering->block != NO_BLOCK)
+    {
+        for (size_t slot = 0; slot < lowering->varsCount; slot++)
+        {
+            if (!assigned[slot]) { continue; }
+
+            addOperand(PROGRAM, FUNCTION, phis[slot], varOrZero(lowering, lowering->vars, slot));
+        }
+    }
+
+    bool bottomReached = lowerLoopTest(lowering, LEFT(node), body, exit);
+
+    startBlock     (lowering, exit);
+    mergeVariables (lowering, atGuard, guardReached, lowering->vars, bottomReached);
+
+    free(assigned);
+    free(phis);
+    free(atGuard);
+}
+
+// Branches to the body if the condition holds and to the exit otherwise, false if riddikulus jumped away
+bool lowerLoopTest(Lowering* lowering, NodeIndex condition, IrBlockId body, IrBlockId exit)
+{
+    ASSERT_LOWERING(lowering);
+    assert(condition != NO_NODE);
+
+    if (lowering->block == NO_BLOCK) { return false; }
+
+    IrValue value = lowerExpression(lowering, condition);
+    if (lowering->block == NO_BLOCK) { return false; }
+
+    IrValue branch = addValue(lowering, IR_BRANCH);
+    addOperand(PROGRAM, FUNCTION, branch, value);
+
+    INSTRUCTION(branch).targets[0] = body;
+    INSTRUCTION(branch).targets[1] = exit;
+
+    addEdge(PROGRAM, FUNCTION, lowering->block, body);
+    addEdge(PROGRAM, FUNCTION, lowering->block, exit);
+
+    lowering->block = NO_BLOCK;
+
+    return true;
+}
+
+void lowerAssignment(Lowering* lowering, NodeIndex node)
+{
+    ASSERT_LOWERING(lowering);
+    assert(node != NO_NODE);
+    assert(DATA(LEFT(node)).name.slot != NO_SLOT);
+
+    IrValue value = lowerExpression(lowering, RIGHT(node));
+    if (lowering->block == NO_BLOCK) { return; }
+
+    writeVariable(lowering, DATA(LEFT(node)).name.slot, value);
+}
+
+void lowerReturn(Lowering* lowering, NodeIndex node)
+{
+    ASSERT_LOWERING(lowering);
+    assert(node != NO_NODE);
+
+    IrValue value = lowerExpression(lowering, RIGHT(node));
+    if (lowering->block == NO_BLOCK) { return; }
+
+    IrValue ret = addValue(lowering, IR_RETURN);
+    addOperand(PROGRAM, FUNCTION, ret, value);
+
+    lowering->block = NO_BLOCK;
+}
+
+// NO_VALUE if riddikulus jumped away somewhere inside
+IrValue lowerExpression(Lowering* lowering, NodeIndex node)
+{
+    ASSERT_LOWERING(lowering);
+    assert(node != NO_NODE);
+
+    switch (TYPE(node))
+    {
+        case MATH_TYPE: { return lowerMath (lowering, node); }
+        case CALL_TYPE: { return lowerCall (lowering, node); }
+
+        case NUMB_TYPE:
+        {
+            return addConst(PROGRAM, FUNCTION, lowering->block, DATA(node).number);
+        }
+
+        case NAME_TYPE:
+        {
+            assert(DATA(node).name.slot != NO_SLOT);
+            return readVariable(lowering, DATA(node).name.slot);
+        }
+
+        default:
+        {
+            assert(!"Invalid node type");
+            return NO_VALUE;
+        }
+    }
+}
+
+IrValue lowerMath(Lowering* lowering, NodeIndex node)
+{
+    ASSERT_LOWERING(lowering);
+    assert(node != NO_NODE);
+
+    IrValue left = lowerExpression(lowering, LEFT(node));
+    if (lowering->block == NO_BLOCK) { return NO_VALUE; }
+
+    IrValue right = lowerExpression(lowering, RIGHT(node));
+    if (lowering->block == NO_BLOCK) { return NO_VALUE; }
+
+    IrValue value = addValue(lowering, toIrOpcode(DATA(node).operation));
+    addOperand(PROGRAM, FUNCTION, value, left);
+    addOperand(PROGRAM, FUNCTION, value, right);
+
+    return value;
+}
+
+//------------------------------------------------------------------------------
+// Arguments are evaluated in the order they are chained in, the last one
+// first, and are the call's operands in that order. flagrate is a statement,
+// so nothing uses its instruction as a value.
+//------------------------------------------------------------------------------
+IrValue lowerCall(Lowering* lowering, NodeIndex node)
+{
+    ASSERT_LOWERING(lowering);
+    assert(node != NO_NODE);
+
+    SymbolId name = DATA(LEFT(node)).name.id;
+
+    switch (name)
+    {
+        case PRINT_SYMBOL: { return lowerUnary (lowering, node, IR_OUT);   }
+        case FLOOR_SYMBOL: { return lowerUnary (lowering, node, IR_FLOOR); }
+        case SQRT_SYMBOL:  { return lowerUnary (lowering, node, IR_SQRT);  }
+        case SCAN_SYMBOL:  { return addValue   (lowering, IR_IN);          }
+
+        case RAND_JUMP_SYMBOL:
+        {
+            addValue(lowering, IR_RANDOM_JUMP);
+            lowering->block = NO_BLOCK;
+            return NO_VALUE;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+
+    Function* callee = getFunction(PROGRAM->table, name);
+    if (callee == nullptr)
+    {
+        lowering->status = IR_ERROR_CALL_UNDEFINED_FUNCTION;
+        printf("COMPILATION ERROR: %s\n", errorString(lowering->status));
+
+        return zeroValue(lowering);
+    }
+
+    size_t   argumentsCount = 0;
+    IrValue* arguments      = nullptr;
+
+    for (NodeIndex argument = RIGHT(node); argument != NO_NODE; argument = RIGHT(argument))
+    {
+        argumentsCount++;
+    }
+
+    arguments = (IrValue*) calloc(argumentsCount + 1, sizeof(IrValue));
+    assert(arguments != nullptr);
+
+    size_t curArgument = 0;
+    for (NodeIndex argument = RIGHT(node); argument != NO_NODE; argument = RIGHT(argument))
+    {
+        arguments[curArgument++] = lowerExpression(lowering, LEFT(argument));
+
+        if (lowering->block == NO_BLOCK)
+        {
+            free(arguments);
+            return NO_VALUE;
+        }
+    }
+
+    IrValue call = addValue(lowering, IR_CALL);
+    INSTRUCTION(call).index = (uint32_t) (callee - PROGRAM->table->functions);
+
+    for (size_t i = 0; i < argumentsCount; i++)
+    {
+        addOperand(PROGRAM, FUNCTION, call, arguments[i]);
+    }
+
+    free(arguments);
+
+    return call;
+}
+
+IrValue lowerUnary(Lowering* lowering, NodeIndex node, IrOpcode opcode)
+{
+    ASSERT_LOWERING(lowering);
+    assert(node        != NO_NODE);
+    assert(RIGHT(node) != NO_NODE);
+
+    IrValue operand = lowerExpression(lowering, LEFT(RIGHT(node)));
+    if (lowering->block == NO_BLOCK) { return NO_VALUE; }
+
+    IrValue value = addValue(lowering, opcode);
+    addOperand(PROGRAM, FUNCTION, value, operand);
+
+    return value;
+}
+
+IrValue readVariable(Lowering* lowering, int32_t slot)
+{
+    ASSERT_LOWERING(lowering);
+    assert(slot >= 0 && (size_t) slot < lowering->varsCount);
+
+    if (!FUNCTION->inMemory) { return varOrZero(lowering, lowering->vars, (size_t) slot); }
+
+    IrValue load = addValue(lowering, IR_LOAD);
+    INSTRUCTION(load).index = (uint32_t) slot;
+
+    return load;
+}
+
+void writeVariable(Lowering* lowering, int32_t slot, IrValue value)
+{
+    ASSERT_LOWERING(lowering);
+    assert(slot >= 0 && (size_t) slot < lowering->varsCount);
+
+    if (!FUNCTION->inMemory)
+    {
+        lowering->vars[slot] = value;
+        return;
+    }
+
+    IrValue store = addValue(lowering, IR_STORE);
+    INSTRUCTION(store).index = (uint32_t) slot;
+    addOperand(PROGRAM, FUNCTION, store, value);
+}
+
+// Made once, in the entry after the parameters, where it dominates every use
+IrValue zeroValue(Lowering* lowering)
+{
+    ASSERT_LOWERING(lowering);
+
+    if (lowering->zero == NO_VALUE)
+    {
+        size_t position = FUNCTION->inMemory ? 0 : FUNCTION->symbols->paramsCount;
+
+        lowering->zero = insertInstruction(PROGRAM, FUNCTION, 0, position, IR_CONST);
+        INSTRUCTION(lowering->zero).number = 0;
+    }
+
+    return lowering->zero;
+}
+
+IrValue varOrZero(Lowering* lowering, const IrValue* vars, size_t slot)
+{
+    ASSERT_LOWERING(lowering);
+    assert(vars != nullptr);
+
+    return (vars[slot] == NO_VALUE) ? zeroValue(lowering) : vars[slot];
+}
+
+IrValue* saveVariables(Lowering* lowering)
+{
+    ASSERT_LOWERING(lowering);
+
+    IrValue* copy = (IrValue*) calloc(lowering->varsCount + 1, sizeof(IrValue));
+    assert(copy != nullptr);
+
+    memcpy(copy, lowering->vars, lowering->varsCount * sizeof(IrValue));
+
+    return copy;
+}
+
+//------------------------------------------------------------------------------
+// The join's predecessors are the ends of the branches that didn't return,
+// then first and else second. With none of them the code after the join is
+// unreachable and nothing is assigned there.
+//------------------------------------------------------------------------------
+void mergeVariables(Lowering* lowering, const IrValue* first, bool firstReached,
+                    const IrValue* second, bool secondReached)
+{
+    ASSERT_LOWERING(lowering);
+    assert(first  != nullptr);
+    assert(second != nullptr);
+
+    if (!firstReached || !secondReached)
+    {
+        for (size_t slot = 0; slot < lowering->varsCount; slot++)
+        {
+            if      (firstReached)  { lowering->vars[slot] = first[slot];  }
+            else if (secondReached) { lowering->vars[slot] = second[slot]; }
+            else                    { lowering->vars[slot] = NO_VALUE;     }
+        }
+
+        return;
+    }
+
+    IrValue* merged = (IrValue*) calloc(lowering->varsCount + 1, sizeof(IrValue));
+    assert(merged != nullptr);
+
+    for (size_t slot = 0; slot < lowering->varsCount; slot++)
+    {
+        if (first[slot] == second[slot])
+        {
+            merged[slot] = first[slot];
+            continue;
+        }
+
+        IrValue firstValue  = varOrZero(lowering, first,  slot);
+        IrValue secondValue = varOrZero(lowering, second, slot);
+
+        merged[slot] = addValue(lowering, IR_PHI);
+        addOperand(PROGRAM, FUNCTION, merged[slot], firstValue);
+        addOperand(PROGRAM, FUNCTION, merged[slot], secondValue);
+    }
+
+    memcpy(lowering->vars, merged, lowering->varsCount * sizeof(IrValue));
+    free(merged);
+}
+
+void findAssigned(Lowering* lowering, NodeIndex node, bool* assigned)
+{
+    ASSERT_LOWERING(lowering);
+    assert(assigned != nullptr);
+
+    if (node == NO_NODE) { return; }
+
+    for (NodeIndex statement = RIGHT(node); statement != NO_NODE; statement = RIGHT(statement))
+    {
+        NodeIndex content = LEFT(statement);
+
+        switch (TYPE(content))
+        {
+            case VDECL_TYPE:
+            case ASSG_TYPE:
+            {
+                assigned[DATA(LEFT(content)).name.slot] = true;
+                break;
+            }
+
+            case COND_TYPE:
+            {
+                findAssigned(lowering, LEFT(RIGHT(content)),  assigned);
+                findAssigned(lowering, RIGHT(RIGHT(content)), assigned);
+                break;
+            }
+
+            case LOOP_TYPE: { findAssigned(lowering, RIGHT(content), assigned); break; }
+            default:        { break; }
+        }
+    }
+}
+
+bool hasRandomJump(Lowering* lowering, NodeIndex node)
+{
+    ASSERT_LOWERING(lowering);
+
+    if (node == NO_NODE) { return false; }
+
+    if (TYPE(node) == CALL_TYPE && DATA(LEFT(node)).name.id == RAND_JUMP_SYMBOL) { return true; }
+
+    return hasRandomJump(lowering, LEFT(node)) || hasRandomJump(lowering, RIGHT(node));
+}
+
+IrValue addValue(Lowering* lowering, IrOpcode opcode)
+{
+    ASSERT_LOWERING(lowering);
+    assert(lowering->block != NO_BLOCK);
+
+    return addInstruction(PROGRAM, FUNCTION, lowering->block, opcode);
+}
+
+// Blocks are written out in the order the statements start them
+void startBlock(Lowering* lowering, IrBlockId block)
+{
+    ASSERT_LOWERING(lowering);
+    assert(block != NO_BLOCK);
+
+    placeBlock(PROGRAM, FUNCTION, block, NO_BLOCK);
+    lowering->block = block;
+}
+
+// Nothing flows in, so no variable has a value yet
+void startUnreachable(Lowering* lowering)
+{
+    ASSERT_LOWERING(lowering);
+
+    startBlock(lowering, addBlock(PROGRAM, FUNCTION, BLOCK_LABEL, PROGRAM->labelsCount[BLOCK_LABEL]++));
+
+    for (size_t slot = 0; slot < lowering->varsCount; slot++)
+    {
+        lowering->vars[slot] = NO_VALUE;
+    }
+}
+
+void jumpTo(Lowering* lowering, IrBlockId target)
+{
+    ASSERT_LOWERING(lowering);
+
+    if (lowering->block == NO_BLOCK) { return; }
+
+    IrValue jump = addValue(lowering, IR_JUMP);
+    INSTRUCTION(jump).targets[0] = target;
+
+    addEdge(PROGRAM, FUNCTION, lowering->block, target);
+
+    lowering->block = NO_BLOCK;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "ir.h"
+#include "compact_tree.h"
+
+//------------------------------------------------------------------------------
+// Builds the IR of every function from the flattened syntax tree. Variables
+// become SSA values as the statements are lowered in order: revelio merges
+// the values its branches end with, a while loop is rotated to test at the
+// bottom and gets a phi at the top of its body for every variable the body
+// assigns, and the phis that turn out to be trivial are removed at the end of
+// the function.
+//
+// Statements after a return or riddikulus go into a block nothing jumps to.
+//------------------------------------------------------------------------------
+IrError lowerProgram (IrProgram* program, const CompactTree* tree);
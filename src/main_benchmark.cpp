@@ -0,0 +1,906 @@
+#include <assert.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "tokenizer.h"
+#include "parser.h"
+#include "compiler.h"
+#include "lowering.h"
+#include "pass_manager.h"
+#include "dead_code.h"
+#include "tail_calls.h"
+#include "common_subexpressions.h"
+#include "loop_invariants.h"
+#include "assembler.h"
+#include "vm.h"
+#include "../libs/file_manager.h"
+
+#define UTB_DEFINITIONS
+#include "../libs/utilib.h"
+
+enum Error
+{
+    NO_ERROR,
+    BENCHMARK_UNSPECIFIED,
+    BENCHMARK_UNKNOWN
+};
+
+struct Benchmark
+{
+    const char* name;
+    void        (*run) (size_t size);
+    size_t      defaultSize;
+    const char* helpMessage;
+};
+
+// A program compiled and run on the VM by the calls and loop benchmarks
+struct VmProgram
+{
+    const char* label;  // printf format of what's computed, its argument is size * scale
+    const char* source; // printf format of the program, the same argument
+    size_t      scale;
+};
+
+struct ProgramText
+{
+    char*  buffer;
+    size_t size;
+    size_t capacity;
+};
+
+void   benchmarkTokenizer    (size_t megabytes);
+void   benchmarkKeywords     (const Tokenizer* tokenizer);
+int    matchKeywordLinear    (const char* position, const char* end);
+void   benchmarkCodegen      (size_t kiloNodes);
+void   benchmarkSymbolTable  (size_t functionsCount);
+void   benchmarkVm           (size_t megaIterations);
+void   benchmarkCalls        (size_t size);
+void   benchmarkLoop         (size_t megaIterations);
+void   runVmProgram          (const char* benchmark, const VmProgram* program, size_t argument, PassManager* passes,
+                              Arena* arena);
+CompilerError compileTree    (const CompactTree* tree, SymbolTable* table, PassManager* passes, OutputFormat format,
+                              bool commentsEnabled, const char* outputFile);
+
+double getTime               ();
+size_t getPeakMemory         ();
+size_t countNodes            (const Node* root);
+void   append                (ProgramText* text, const char* format, ...);
+void   generateFunctionName  (char* name, size_t index);
+char*  generateProgram       (size_t functionsCount, size_t* size);
+char*  generateProgramOfSize (size_t minSize, size_t* size);
+void   printHelp             ();
+
+const size_t MAX_NAME_LENGTH  = 16;
+const size_t MEGABYTE         = 1024 * 1024;
+const size_t SAMPLE_FUNCTIONS = 64;
+const size_t KILO             = 1000;
+const char*  CODEGEN_OUTPUT   = "benchmark_codegen.asm";
+const char*  CODEGEN_IMAGE    = "benchmark_codegen.bin";
+const size_t LOCALS_COUNT     = 512;
+const size_t LOOKUP_ROUNDS    = 4;
+
+// A hand-written summing loop over frame variables that tests at the top, the loop benchmark runs compiled ones
+const char*  VM_LOOP_PROGRAM  = "push 0\n"
+                                "pop [rax+2]\n"
+                                "push 0\n"
+                                "pop [rax+3]\n"
+                                "WHILE_0:\n"
+                                "push [rax+2]\n"
+                                "push %zu\n"
+                                "jae :WHILE_END_0\n"
+                                "push [rax+3]\n"
+                                "push [rax+2]\n"
+                                "add\n"
+                                "pop [rax+3]\n"
+                                "push [rax+2]\n"
+                                "push 1\n"
+                                "add\n"
+                                "pop [rax+2]\n"
+                                "jmp :WHILE_0\n"
+                                "WHILE_END_0:\n"
+                                "hlt\n";
+const size_t VM_SUM_SLOT      = 3;
+
+const char*  PROGRAM_IMAGE    = "benchmark_program.bin";
+const size_t PROGRAM_RESULT   = 0; // love returns it, it's the only value on the stack after hlt
+const size_t MAX_LABEL_LENGTH = 64;
+
+// Recursion with next to no work besides the calls, so that they dominate the time
+const VmProgram CALL_PROGRAMS[] = {
+    { "fib(%zu)", "Godric's-Hollow fib\n\n"
+             "imperio fib n\n"
+             "alohomora\n"
+             "    revelio protego legilimens n less 2 protego\n"
+             "    alohomora\n"
+             "        - reverte legilimens n\n"
+             "    colloportus\n"
+             "    - reverte depulso fib protego legilimens n flipendo 1 protego epoximise "
+                      "depulso fib protego legilimens n flipendo 2 protego\n"
+             "colloportus\n\n"
+             "imperio love horcrux\n"
+             "alohomora\n"
+             "    - avenseguim result carpe-retractum depulso fib protego %zu protego\n"
+             "    - reverte legilimens result\n"
+             "colloportus\n\n"
+             "Privet-Drive", 1 },
+
+    { "fact(20) x %zu", "Godric's-Hollow fact\n\n"
+              "imperio fact n\n"
+              "alohomora\n"
+              "    revelio protego legilimens n less 2 protego\n"
+              "    alohomora\n"
+              "        - reverte 1\n"
+              "    colloportus\n"
+              "    - reverte legilimens n geminio depulso fact protego legilimens n flipendo 1 protego\n"
+              "colloportus\n\n"
+              "imperio love horcrux\n"
+              "alohomora\n"
+              "    - avenseguim result carpe-retractum 0\n"
+              "    - avenseguim i carpe-retractum 0\n"
+              "    while protego legilimens i less %zu protego\n"
+              "    alohomora\n"
+              "        - result carpe-retractum depulso fact protego 20 protego\n"
+              "        - i carpe-retractum legilimens i epoximise 1\n"
+              "    colloportus\n"
+              "    - reverte legilimens result\n"
+              "colloportus\n\n"
+              "Privet-Drive", 5000 },
+
+    { "ackermann(2, %zu)", "Godric's-Hollow ackermann\n\n"
+                   "imperio ack m, n\n"
+                   "alohomora\n"
+                   "    revelio protego legilimens m equal 0 protego\n"
+                   "    alohomora\n"
+                   "        - reverte legilimens n epoximise 1\n"
+                   "    colloportus\n"
+                   "    revelio protego legilimens n equal 0 protego\n"
+                   "    alohomora\n"
+                   "        - reverte depulso ack protego legilimens m flipendo 1, 1 protego\n"
+                   "    colloportus\n"
+                   "    - reverte depulso ack protego legilimens m flipendo 1, "
+                              "depulso ack protego legilimens m, legilimens n flipendo 1 protego protego\n"
+                   "colloportus\n\n"
+                   "imperio love horcrux\n"
+                   "alohomora\n"
+                   "    - avenseguim result carpe-retractum depulso ack protego 2, %zu protego\n"
+                   "    - reverte legilimens result\n"
+                   "colloportus\n\n"
+                   "Privet-Drive", 40 }
+};
+
+const size_t CALL_PROGRAMS_COUNT = sizeof(CALL_PROGRAMS) / sizeof(CALL_PROGRAMS[0]);
+
+// The bound is a parameter, so k * k / 3 isn't known when compiling, but it's the same on every iteration.
+// The plain sum has nothing to hoist and shows the cost of the loop itself
+const VmProgram LOOP_PROGRAMS[] = {
+    { "k * k / 3 + i for i <= k = %zu", "Godric's-Hollow invariant\n\n"
+                                        "imperio sum k\n"
+                                        "alohomora\n"
+                                        "    - avenseguim s carpe-retractum 0\n"
+                                        "    - avenseguim i carpe-retractum 0\n"
+                                        "    while protego legilimens i less-equal legilimens k protego\n"
+                                        "    alohomora\n"
+                                        "        - s carpe-retractum legilimens s epoximise "
+                                                 "protego legilimens k geminio legilimens k protego sectumsempra 3 "
+                                                 "epoximise legilimens i\n"
+                                        "        - i carpe-retractum legilimens i epoximise 1\n"
+                                        "    colloportus\n"
+                                        "    - reverte legilimens s\n"
+                                        "colloportus\n\n"
+                                        "imperio love horcrux\n"
+                                        "alohomora\n"
+                                        "    - reverte depulso sum protego %zu protego\n"
+                                        "colloportus\n\n"
+                                        "Privet-Drive", 1000000 },
+    { "i for i <= k = %zu",             "Godric's-Hollow sum\n\n"
+                                        "imperio sum k\n"
+                                        "alohomora\n"
+                                        "    - avenseguim s carpe-retractum 0\n"
+                                        "    - avenseguim i carpe-retractum 0\n"
+                                        "    while protego legilimens i less-equal legilimens k protego\n"
+                                        "    alohomora\n"
+                                        "        - s carpe-retractum legilimens s epoximise legilimens i\n"
+                                        "        - i carpe-retractum legilimens i epoximise 1\n"
+                                        "    colloportus\n"
+                                        "    - reverte legilimens s\n"
+                                        "colloportus\n\n"
+                                        "imperio love horcrux\n"
+                                        "alohomora\n"
+                                        "    - reverte depulso sum protego %zu protego\n"
+                                        "colloportus\n\n"
+                                        "Privet-Drive", 1000000 }
+};
+
+const size_t LOOP_PROGRAMS_COUNT = sizeof(LOOP_PROGRAMS) / sizeof(LOOP_PROGRAMS[0]);
+
+const Benchmark BENCHMARKS[] = {
+    { "tokenizer", benchmarkTokenizer, 16,   "\tTokenize <size> megabytes of generated source, print tokens/sec and keyword lookups/sec.\n" },
+    { "codegen",   benchmarkCodegen,   1000, "\tCompile a generated program of <size> thousand AST nodes, print tree memory and codegen time.\n" },
+    { "symbols",   benchmarkSymbolTable, 2000, "\tFill a symbol table with <size> functions of 512 locals each, print lookups/sec.\n" },
+    { "vm",        benchmarkVm,        20,   "\tRun a summing loop of <size> million iterations in the virtual machine, print instructions/sec.\n" },
+    { "calls",     benchmarkCalls,     30,   "\tCompile and run fib(<size>), 5000 * <size> fact(20) and ackermann(2, 40 * <size>), print instructions and time.\n" },
+    { "loop",      benchmarkLoop,      20,   "\tCompile and run loops of <size> million iterations with -O, with and without hoisting loop invariants, print instructions and time.\n" }
+};
+
+const size_t BENCHMARKS_COUNT = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+int main(int argc, const char* argv[])
+{
+    if (argc < 2)
+    {
+        printHelp();
+        return BENCHMARK_UNSPECIFIED;
+    }
+
+    for (size_t i = 0; i < BENCHMARKS_COUNT; i++)
+    {
+        if (strcmp(argv[1], BENCHMARKS[i].name) == 0)
+        {
+            size_t size = (argc > 2) ? strtoul(argv[2], nullptr, 10) : BENCHMARKS[i].defaultSize;
+            BENCHMARKS[i].run(size);
+
+            return NO_ERROR;
+        }
+    }
+
+    printf("Unknown benchmark '%s'!\n", argv[1]);
+    printHelp();
+
+    return BENCHMARK_UNKNOWN;
+}
+
+void printHelp()
+{
+    printf("Usage: benchmark.out <benchmark> [size]\n");
+
+    for (size_t i = 0; i < BENCHMARKS_COUNT; i++)
+    {
+        printf("%s (default size %zu)\n%s", BENCHMARKS[i].name, BENCHMARKS[i].defaultSize, BENCHMARKS[i].helpMessage);
+    }
+}
+
+void benchmarkTokenizer(size_t megabytes)
+{
+    size_t size   = 0;
+    char*  buffer = generateProgramOfSize(megabytes * MEGABYTE, &size);
+
+    Arena arena = {};
+    construct(&arena);
+    constructInterner(&arena);
+
+    double start = getTime();
+
+    Tokenizer tokenizer = {};
+    construct(&tokenizer, buffer, size, false);
+    tokenizeBuffer(&tokenizer);
+
+    double elapsed = getTime() - start;
+
+    printf("tokenizer: %.1lf MB, %zu tokens in %.3lf s (%.2lf Mtokens/s)\n",
+           (double) size / MEGABYTE,
+           tokenizer.tokensCount,
+           elapsed,
+           tokenizer.tokensCount / elapsed / 1e6);
+
+    benchmarkKeywords(&tokenizer);
+
+    destroy(&tokenizer);
+    destroyInterner();
+    destroy(&arena);
+    free(buffer);
+}
+
+//------------------------------------------------------------------------------
+// The keyword lookup alone, done at every token of the input the way the
+// tokenizer does it: with the trie and with the linear scan over KEYWORDS it
+// replaced. Both have to find the same keywords.
+//------------------------------------------------------------------------------
+void benchmarkKeywords(const Tokenizer* tokenizer)
+{
+    assert(tokenizer != nullptr);
+
+    const char* end         = tokenizer->buffer + tokenizer->bufferSize;
+    size_t      trieMatches = 0;
+
+    double start = getTime();
+
+    for (size_t i = 0; i < tokenizer->tokensCount; i++)
+    {
+        if (matchKeyword(tokenizer->tokens[i].pos, end) >= 0) { trieMatches++; }
+    }
+
+    double trieElapsed   = getTime() - start;
+    size_t linearMatches = 0;
+
+    start = getTime();
+
+    for (size_t i = 0; i < tokenizer->tokensCount; i++)
+    {
+        if (matchKeywordLinear(tokenizer->tokens[i].pos, end) >= 0) { linearMatches++; }
+    }
+
+    double linearElapsed = getTime() - start;
+
+    assert(trieMatches == linearMatches);
+
+    printf("keywords: %zu lookups, %zu matches\n"
+           "    linear scan %.3lf s (%.2lf Mlookups/s)\n"
+           "    trie        %.3lf s (%.2lf Mlookups/s)\n",
+           tokenizer->tokensCount,
+           trieMatches,
+           linearElapsed,
+           tokenizer->tokensCount / linearElapsed / 1e6,
+           trieElapsed,
+           tokenizer->tokensCount / trieElapsed / 1e6);
+}
+
+// What processKeyword did before the trie, the first entry of KEYWORDS that matches
+int matchKeywordLinear(const char* position, const char* end)
+{
+    assert(position != nullptr);
+    assert(end      != nullptr);
+
+    for (size_t i = 0; i < KEYWORDS_COUNT; i++)
+    {
+        if (position + KEYWORDS[i].length > end) { continue; }
+
+        if (strncmp(position, KEYWORDS[i].name, KEYWORDS[i].length) == 0) { return (int) i; }
+    }
+
+    return -1;
+}
+
+void benchmarkCodegen(size_t kiloNodes)
+{
+    Arena arena     = {};
+    Arena nodeArena = {};
+    construct(&arena);
+    construct(&nodeArena);
+    setNodeArena(&nodeArena);
+    constructInterner(&arena);
+
+    // Estimate the program size from a small sample
+    size_t sampleSize   = 0;
+    char*  sampleBuffer = generateProgram(SAMPLE_FUNCTIONS, &sampleSize);
+
+    Tokenizer   sampleTokenizer = {};
+    SymbolTable sampleTable     = {};
+    Parser      sampleParser    = {};
+    Node*       sampleTree      = nullptr;
+
+    construct(&sampleTokenizer, sampleBuffer, sampleSize, false);
+    tokenizeBuffer(&sampleTokenizer);
+    construct(&sampleTable, &arena);
+    construct(&sampleParser, &sampleTokenizer);
+    parseProgram(&sampleParser, &sampleTable, &sampleTree);
+
+    size_t functionsCount = kiloNodes * KILO * SAMPLE_FUNCTIONS / countNodes(sampleTree) + 1;
+
+    destroy(&sampleParser);
+    destroy(&sampleTable);
+    destroy(&sampleTokenizer);
+    free(sampleBuffer);
+
+    size_t size   = 0;
+    char*  buffer = generateProgram(functionsCount, &size);
+
+    Tokenizer   tokenizer = {};
+    SymbolTable table     = {};
+    Parser      parser    = {};
+    Node*       tree      = nullptr;
+
+    construct(&tokenizer, buffer, size, false);
+    tokenizeBuffer(&tokenizer);
+    construct(&table, &arena);
+    construct(&parser, &tokenizer);
+
+    if (parseProgram(&parser, &table, &tree) != PARSE_NO_ERROR)
+    {
+        printf("codegen: generated program doesn't parse\n");
+        return;
+    }
+
+    destroy(&parser);
+    destroy(&tokenizer);
+    free(buffer);
+
+    size_t nodesCount = countNodes(tree);
+
+    double start = getTime();
+
+    CompactTree compactedTree = {};
+    construct(&compactedTree, nodesCount);
+    compactTree(&compactedTree, tree);
+
+    double flattenElapsed = getTime() - start;
+
+    setNodeArena(nullptr);
+    destroy(&nodeArena);
+
+    start = getTime();
+
+    compileTree(&compactedTree, &table, nullptr, TEXT_OUTPUT, true, CODEGEN_OUTPUT);
+
+    double codegenElapsed = getTime() - start;
+    size_t outputSize     = getFileSize(CODEGEN_OUTPUT);
+
+    start = getTime();
+
+    compileTree(&compactedTree, &table, nullptr, TEXT_OUTPUT, false, CODEGEN_OUTPUT);
+
+    double strippedElapsed = getTime() - start;
+    size_t strippedSize    = getFileSize(CODEGEN_OUTPUT);
+
+    // Text still has to be assembled before it can run, the image doesn't
+    start = getTime();
+
+    char*  assembly     = nullptr;
+    size_t assemblySize = 0;
+    loadFile(CODEGEN_OUTPUT, &assembly, &assemblySize);
+
+    Bytecode bytecode = {};
+    construct(&bytecode);
+    assemble(&bytecode, assembly, assemblySize, nullptr);
+
+    double assembleElapsed = getTime() - start;
+
+    free(assembly);
+    destroy(&bytecode);
+    remove(CODEGEN_OUTPUT);
+
+    start = getTime();
+
+    compileTree(&compactedTree, &table, nullptr, IMAGE_OUTPUT, false, CODEGEN_IMAGE);
+
+    double imageElapsed = getTime() - start;
+    size_t imageSize    = getFileSize(CODEGEN_IMAGE);
+
+    remove(CODEGEN_IMAGE);
+
+    printf("codegen: %zu nodes, pointer tree %.1lf MB, compact tree %.1lf MB, flatten %.3lf s, peak memory %.1lf MB\n"
+           "         codegen %.3lf s (%.1lf MB/s), without comments %.3lf s (%.1lf MB/s)\n"
+           "         assembling that %.3lf s, image %.3lf s (%.1lf MB)\n",
+           nodesCount,
+           (double) (nodesCount * sizeof(Node)) / MEGABYTE,
+           (double) getMemoryUsed(&compactedTree) / MEGABYTE,
+           flattenElapsed,
+           (double) getPeakMemory() / MEGABYTE,
+           codegenElapsed,
+           outputSize / codegenElapsed / MEGABYTE,
+           strippedElapsed,
+           strippedSize / strippedElapsed / MEGABYTE,
+           assembleElapsed,
+           imageElapsed,
+           (double) imageSize / MEGABYTE);
+
+    destroy(&compactedTree);
+    destroy(&table);
+    destroyInterner();
+    destroy(&arena);
+}
+
+void benchmarkSymbolTable(size_t functionsCount)
+{
+    Arena arena = {};
+    construct(&arena);
+    constructInterner(&arena);
+
+    SymbolTable table = {};
+    construct(&table, &arena);
+
+    char      name[MAX_NAME_LENGTH] = {};
+    SymbolId* functions             = (SymbolId*) calloc(functionsCount, sizeof(SymbolId));
+    SymbolId* locals                = (SymbolId*) calloc(LOCALS_COUNT,   sizeof(SymbolId));
+    assert(functions != nullptr);
+    assert(locals    != nullptr);
+
+    for (size_t i = 0; i < LOCALS_COUNT; i++)
+    {
+        snprintf(name, sizeof(name), "v%zu", i);
+        locals[i] = intern(name);
+    }
+
+    double start = getTime();
+
+    for (size_t i = 0; i < functionsCount; i++)
+    {
+        generateFunctionName(name, i);
+        functions[i] = intern(name);
+
+        Function* function = pushFunction(&table, functions[i]);
+        for (size_t j = 0; j < LOCALS_COUNT; j++)
+        {
+            pushVariable(function, locals[(i + j) % LOCALS_COUNT]);
+        }
+    }
+
+    double fillElapsed = getTime() - start;
+
+    // Every function looks up each of its locals and calls a few other functions, like codegen does
+    size_t lookupsCount = 0;
+    size_t checksum     = 0;
+
+    start = getTime();
+
+    for (size_t round = 0; round < LOOKUP_ROUNDS; round++)
+    {
+        for (size_t i = 0; i < functionsCount; i++)
+        {
+            Function* function = getFunction(&table, functions[(i * 7919 + round) % functionsCount]);
+            assert(function != nullptr);
+
+            for (size_t j = 0; j < LOCALS_COUNT; j++)
+            {
+                checksum += getVarOffset(function, locals[j]);
+            }
+
+            lookupsCount += LOCALS_COUNT + 1;
+        }
+    }
+
+    double lookupElapsed = getTime() - start;
+
+    printf("symbols: %zu functions x %zu locals, fill %.3lf s, %zu lookups in %.3lf s (%.2lf Mlookups/s), checksum %zu\n",
+           functionsCount,
+           LOCALS_COUNT,
+           fillElapsed,
+           lookupsCount,
+           lookupElapsed,
+           lookupsCount / lookupElapsed / 1e6,
+           checksum);
+
+    free(functions);
+    free(locals);
+    destroy(&table);
+    destroyInterner();
+    destroy(&arena);
+}
+
+void benchmarkVm(size_t megaIterations)
+{
+    Arena arena = {};
+    construct(&arena);
+    constructInterner(&arena);
+
+    ProgramText text = {};
+    append(&text, VM_LOOP_PROGRAM, megaIterations * KILO * KILO);
+
+    Bytecode bytecode = {};
+    construct(&bytecode);
+
+    AssemblerError assemblyResult = assemble(&bytecode, text.buffer, text.size, nullptr);
+    assert(assemblyResult == ASSEMBLER_NO_ERROR);
+
+    VirtualMachine vm = {};
+    construct(&vm);
+
+    double  start     = getTime();
+    VmError runResult = run(&vm, &bytecode);
+    double  elapsed   = getTime() - start;
+
+    assert(runResult == VM_NO_ERROR);
+
+    printf("vm: %zu bytes of bytecode, %llu instructions in %.3lf s (%.1lf Minstructions/s), sum %.0lf\n",
+           bytecode.size,
+           (unsigned long long) vm.executed,
+           elapsed,
+           vm.executed / elapsed / 1e6,
+           vm.memory[VM_SUM_SLOT]);
+
+    destroy(&vm);
+    destroy(&bytecode);
+    free(text.buffer);
+    destroyInterner();
+    destroy(&arena);
+}
+
+void benchmarkCalls(size_t size)
+{
+    Arena arena     = {};
+    Arena nodeArena = {};
+    construct(&arena);
+    construct(&nodeArena);
+    setNodeArena(&nodeArena);
+    constructInterner(&arena);
+
+    for (size_t i = 0; i < CALL_PROGRAMS_COUNT; i++)
+    {
+        runVmProgram("calls", &CALL_PROGRAMS[i], size * CALL_PROGRAMS[i].scale, nullptr, &arena);
+    }
+
+    setNodeArena(nullptr);
+    destroy(&nodeArena);
+    destroyInterner();
+    destroy(&arena);
+}
+
+void benchmarkLoop(size_t megaIterations)
+{
+    Arena arena     = {};
+    Arena nodeArena = {};
+    construct(&arena);
+    construct(&nodeArena);
+    setNodeArena(&nodeArena);
+    constructInterner(&arena);
+
+    // The compiler's -O passes, once without loop-invariant code motion and once with it
+    DeadCodeStats      deadCodeStats      = {};
+    TailCallStats      tailCallStats      = {};
+    CseStats           cseStats           = {};
+    LoopInvariantStats loopInvariantStats = {};
+
+    PassManager withoutHoisting = {};
+    PassManager withHoisting    = {};
+    construct(&withoutHoisting, false);
+    construct(&withHoisting,    false);
+
+    PassManager* managers[] = { &withoutHoisting, &withHoisting };
+    for (PassManager* manager : managers)
+    {
+        addPass(manager, "dead code",             eliminateDeadCode,             &deadCodeStats);
+        addPass(manager, "tail calls",            eliminateTailCalls,            &tailCallStats);
+        addPass(manager, "common subexpressions", eliminateCommonSubexpressions, &cseStats);
+    }
+
+    addPass(&withHoisting, "loop invariants", hoistLoopInvariants, &loopInvariantStats);
+
+    for (size_t i = 0; i < LOOP_PROGRAMS_COUNT; i++)
+    {
+        size_t iterations = megaIterations * LOOP_PROGRAMS[i].scale;
+
+        runVmProgram("loop, not hoisted", &LOOP_PROGRAMS[i], iterations, &withoutHoisting, &arena);
+        runVmProgram("loop, hoisted",     &LOOP_PROGRAMS[i], iterations, &withHoisting,    &arena);
+    }
+
+    destroy(&withHoisting);
+    destroy(&withoutHoisting);
+    setNodeArena(nullptr);
+    destroy(&nodeArena);
+    destroyInterner();
+    destroy(&arena);
+}
+
+void runVmProgram(const char* benchmark, const VmProgram* program, size_t argument, PassManager* passes, Arena* arena)
+{
+    assert(benchmark != nullptr);
+    assert(program   != nullptr);
+    assert(arena     != nullptr);
+
+    ProgramText text = {};
+    append(&text, program->source, argument);
+
+    Tokenizer   tokenizer = {};
+    SymbolTable table     = {};
+    Parser      parser    = {};
+    Node*       tree      = nullptr;
+
+    construct(&tokenizer, text.buffer, text.size, true);
+    tokenizeBuffer(&tokenizer);
+    construct(&table, arena);
+    construct(&parser, &tokenizer);
+
+    ParseError parseResult = parseProgram(&parser, &table, &tree);
+    assert(parseResult == PARSE_NO_ERROR);
+
+    CompactTree compactedTree = {};
+    construct(&compactedTree, countNodes(tree));
+    compactTree(&compactedTree, tree);
+
+    CompilerError compileResult = compileTree(&compactedTree, &table, passes, IMAGE_OUTPUT, false, PROGRAM_IMAGE);
+    assert(compileResult == COMPILER_NO_ERROR);
+
+    char*  image     = nullptr;
+    size_t imageSize = 0;
+    loadFile(PROGRAM_IMAGE, &image, &imageSize);
+    remove(PROGRAM_IMAGE);
+
+    Bytecode bytecode = {};
+    construct(&bytecode);
+
+    bool imageRead = readImage(&bytecode, image, imageSize);
+    assert(imageRead);
+
+    VirtualMachine vm = {};
+    construct(&vm);
+
+    double  start     = getTime();
+    VmError runResult = run(&vm, &bytecode);
+    double  elapsed   = getTime() - start;
+
+    assert(runResult == VM_NO_ERROR);
+
+    char label[MAX_LABEL_LENGTH] = {};
+    snprintf(label, sizeof(label), program->label, argument);
+
+    printf("%s: %s %.0lf, %llu instructions in %.3lf s (%.1lf Minstructions/s)\n",
+           benchmark,
+           label,
+           vm.stack[PROGRAM_RESULT],
+           (unsigned long long) vm.executed,
+           elapsed,
+           vm.executed / elapsed / 1e6);
+
+    destroy(&vm);
+    destroy(&bytecode);
+    free(image);
+    destroy(&compactedTree);
+    destroy(&parser);
+    destroy(&table);
+    destroy(&tokenizer);
+    free(text.buffer);
+}
+
+// Lowering to the IR is part of generating the code, so it's timed with it
+CompilerError compileTree(const CompactTree* tree, SymbolTable* table, PassManager* passes, OutputFormat format,
+                          bool commentsEnabled, const char* outputFile)
+{
+    assert(tree       != nullptr);
+    assert(table      != nullptr);
+    assert(outputFile != nullptr);
+
+    IrProgram program = {};
+    construct(&program, table);
+
+    IrError lowerResult = lowerProgram(&program, tree);
+    assert(lowerResult == IR_NO_ERROR);
+
+    if (passes != nullptr)
+    {
+        IrError passesResult = runPasses(passes, &program);
+        assert(passesResult == IR_NO_ERROR);
+    }
+
+    Compiler compiler = {};
+    construct(&compiler, &program, format, commentsEnabled, nullptr);
+
+    CompilerError result = compile(&compiler, outputFile);
+
+    destroy(&compiler);
+    destroy(&program);
+
+    return result;
+}
+
+double getTime()
+{
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+size_t getPeakMemory()
+{
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_maxrss * 1024;
+}
+
+size_t countNodes(const Node* root)
+{
+    if (root == nullptr) { return 0; }
+
+    return 1 + countNodes(root->left) + countNodes(root->right);
+}
+
+void append(ProgramText* text, const char* format, ...)
+{
+    assert(text   != nullptr);
+    assert(format != nullptr);
+
+    va_list args = {};
+
+    while (true)
+    {
+        va_start(args, format);
+        int written = vsnprintf(text->buffer + text->size, text->capacity - text->size, format, args);
+        va_end(args);
+
+        assert(written >= 0);
+
+        if (text->size + written < text->capacity)
+        {
+            text->size += written;
+            return;
+        }
+
+        text->capacity = 2 * text->capacity + written;
+        text->buffer   = (char*) realloc(text->buffer, text->capacity);
+        assert(text->buffer != nullptr);
+    }
+}
+
+void generateFunctionName(char* name, size_t index)
+{
+    assert(name != nullptr);
+
+    // 'fn' prefix doesn't start any keyword, so the name is always an id
+    size_t length = 0;
+    name[length++] = 'f';
+    name[length++] = 'n';
+
+    do
+    {
+        name[length++] = 'a' + index % 26;
+        index /= 26;
+    }
+    while (index > 0 && length < MAX_NAME_LENGTH - 1);
+
+    name[length] = '\0';
+}
+
+char* generateProgram(size_t functionsCount, size_t* size)
+{
+    assert(size != nullptr);
+
+    ProgramText text = {};
+    char        name[MAX_NAME_LENGTH]     = {};
+    char        prevName[MAX_NAME_LENGTH] = {};
+
+    append(&text, "Godric's-Hollow benchmark\n\n");
+
+    for (size_t i = 0; i < functionsCount; i++)
+    {
+        generateFunctionName(name, i);
+
+        append(&text,
+               "(oNo) generated function %zu\n"
+               "imperio %s a, b\n"
+               "alohomora\n"
+               "    - avenseguim c carpe-retractum legilimens a epoximise legilimens b geminio tria\n"
+               "    revelio protego legilimens c less-equal maxima protego\n"
+               "    alohomora\n"
+               "        - c carpe-retractum legilimens c flipendo duo sectumsempra tria\n"
+               "    colloportus\n"
+               "    otherwise\n"
+               "    alohomora\n"
+               "        - flagrate legilimens c\n"
+               "    colloportus\n"
+               "    while protego legilimens c greater-equal duo protego\n"
+               "    alohomora\n"
+               "        - c carpe-retractum legilimens c flipendo tria epoximise duo\n"
+               "    colloportus\n",
+               i, name);
+
+        if (i == 0)
+        {
+            append(&text, "    - reverte legilimens c\n");
+        }
+        else
+        {
+            append(&text, "    - reverte depulso %s protego legilimens c, legilimens b protego\n", prevName);
+        }
+
+        append(&text, "colloportus\n\n");
+
+        strcpy(prevName, name);
+    }
+
+    append(&text,
+           "imperio love horcrux\n"
+           "alohomora\n"
+           "    - avenseguim x carpe-retractum accio\n"
+           "    - flagrate depulso %s protego legilimens x, duo protego\n"
+           "    - reverte horcrux\n"
+           "colloportus\n\n"
+           "Privet-Drive",
+           prevName);
+
+    *size = text.size;
+
+    return text.buffer;
+}
+
+char* generateProgramOfSize(size_t minSize, size_t* size)
+{
+    assert(size != nullptr);
+
+    size_t sampleSize = 0;
+    free(generateProgram(SAMPLE_FUNCTIONS, &sampleSize));
+
+    return generateProgram(minSize * SAMPLE_FUNCTIONS / sampleSize + 1, size);
+}
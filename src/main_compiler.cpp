@@ -5,6 +5,19 @@
 #include "tokenizer.h"
 #include "parser.h"
 #include "compiler.h"
+#include "lowering.h"
+#include "pass_manager.h"
+#include "dead_code.h"
+#include "tail_calls.h"
+#include "common_subexpressions.h"
+#include "loop_invariants.h"
+#include "native_compiler.h"
+#include "c_transpiler.h"
+#include "peephole.h"
+#include "inliner.h"
+#include "constant_folding.h"
+#include "assembler.h"
+#include "vm.h"
 #include "../libs/file_manager.h"
 
 #define UTB_DEFINITIONS
@@ -16,7 +29,8 @@ enum Error
     INPUT_UNSPECIFIED,
     OUTPUT_UNSPECIFIED,
     INPUT_LOAD_FAILED,
-    COMPILATION_FAILED
+    COMPILATION_FAILED,
+    EXECUTION_FAILED
 };
 
 enum Flag
@@ -25,8 +39,15 @@ enum Flag
     FLAG_GRAPH_DUMP,
     FLAG_OPEN_GRAPH_DUMP,
     FLAG_TREE_DUMP,
+    FLAG_IR_DUMP,
     FLAG_SYMB_TABLE_DUMP,
     FLAG_USE_NUMERICS,
+    FLAG_STRIP_COMMENTS,
+    FLAG_OPTIMIZE,
+    FLAG_RUN,
+    FLAG_IMAGE,
+    FLAG_NATIVE,
+    FLAG_C,
     FLAG_HELP,
     FLAG_OUTPUT,
 
@@ -45,8 +66,15 @@ struct FlagManager
     bool         graphDumpEnabled;
     bool         openGraphDumpEnabled;
     bool         treeDumpEnabled;
+    bool         irDumpEnabled;
     bool         symbTableDumpEnabled;
     bool         useNumerics;
+    bool         stripComments;
+    bool         optimize;
+    bool         run;
+    bool         image;
+    bool         native;
+    bool         c;
 };
 
 struct FlagSpecification
@@ -61,16 +89,27 @@ Error processFlagTokenDump     (FlagManager* flagManager);
 Error processFlagGraphDump     (FlagManager* flagManager);
 Error processFlagOpenGraphDump (FlagManager* flagManager);
 Error processFlagTreeDump      (FlagManager* flagManager);
+Error processFlagIrDump        (FlagManager* flagManager);
 Error processFlagSymbTableDump (FlagManager* flagManager);
 Error processFlagUseNumerics   (FlagManager* flagManager);
+Error processFlagStripComments (FlagManager* flagManager);
+Error processFlagOptimize      (FlagManager* flagManager);
+Error processFlagRun           (FlagManager* flagManager);
+Error processFlagImage         (FlagManager* flagManager);
+Error processFlagNative        (FlagManager* flagManager);
+Error processFlagC             (FlagManager* flagManager);
 Error processFlagHelp          (FlagManager* flagManager);
 Error processFlagOutput        (FlagManager* flagManager);
 
 Error processFlags             (FlagManager* flagManager);
 Error compile                  (FlagManager* flagManager);
+Error runProgram               (const char* programFile, bool isImage);
 void  printHelp                ();
 
 const char*  DEFAULT_OUTPUT      = "a.asm";
+const char*  DEFAULT_IMAGE       = "a.bin";
+const char*  DEFAULT_NATIVE      = "a.s";
+const char*  DEFAULT_C           = "a.c";
 const size_t MAX_FILENAME_LENGTH = 128;
 const size_t MAX_COMMAND_LENGTH  = 256;
 
@@ -90,6 +129,10 @@ const char* FLAGS_HELP_MESSAGES[TOTAL_FLAGS] = {
     /*====FLAG_TREE_DUMP====*/
     "\tWrites the syntax tree to file.\n",
 
+    /*====FLAG_IR_DUMP====*/
+    "\tWrites the intermediate representation the software cpu code is generated from\n"
+    "\tto file, after the optimizations.\n",
+
     /*====FLAG_SYMB_TABLE_DUMP====*/
     "\tPrints the symbol table in the following format:\n"
     "\tSymbol table:\n"
@@ -97,13 +140,41 @@ const char* FLAGS_HELP_MESSAGES[TOTAL_FLAGS] = {
     "\t\tfunctionsCount    = <total number of functions>\n\n"
     "\t\tfunctions = { \n"
     "\t\t\t{ name='<>', varsCapacity=<>, varsCount=<>, paramsCount=<>, \n"
-    "\t\t\t  vars=['<>', '<>', '<>']\n"
+    "\t\t\t  vars=['<>', '<>', '<>'], frameSize=<>, unsharedFrameSize=<>,\n"
+    "\t\t\t  registerValues=<>\n"
     "\t\t\t}\n"
-    "\t\t}\n",
+    "\t\t}\n"
+    "\tonce the program is compiled. Frame sizes are only there for the software cpu code:\n"
+    "\tthe cells enter makes for the function, and how many it would take without values\n"
+    "\tthat are never live at the same time sharing frame slots, and how many values are\n"
+    "\tkept in registers instead.\n",
 
     /*====FLAG_USE_NUMERICS====*/
     "\tAllow using numbers (e.g. '3' instead of 'tria', or '22') in the input file.\n",
 
+    /*====FLAG_STRIP_COMMENTS====*/
+    "\tDon't write comments, function banners and blank lines to the output assembly.\n",
+
+    /*====FLAG_OPTIMIZE====*/
+    "\tOptimize the syntax tree before generating code (inlining of small functions,\n"
+    "\tconstant folding and algebraic simplification), remove dead code, turn self tail\n"
+    "\tcalls into jumps, merge common subexpressions, move loop invariants out of loops,\n"
+    "\trun the peephole pass over the software cpu code and print how much they saved.\n",
+
+    /*====FLAG_RUN====*/
+    "\tAfter compiling, assemble the output and execute it in the built-in virtual machine.\n",
+
+    /*====FLAG_IMAGE====*/
+    "\tWrite a bytecode image for the built-in virtual machine instead of text assembly.\n",
+
+    /*====FLAG_NATIVE====*/
+    "\tWrite x86-64 assembly for Linux instead of the software cpu code. Build it with\n"
+    "\tthe runtime: gcc a.s bin/native_runtime.o -o program\n",
+
+    /*====FLAG_C====*/
+    "\tWrite a C program instead of the software cpu code. Build it with any C compiler:\n"
+    "\tcc -O2 a.c -lm -o program\n",
+
     /*====FLAG_HELP====*/
     "\tPrint this message.\n",
 
@@ -132,6 +203,11 @@ const FlagSpecification FLAG_SPECIFICATIONS[TOTAL_FLAGS] = {
       processFlagTreeDump,
       FLAGS_HELP_MESSAGES[FLAG_TREE_DUMP] },
 
+    { FLAG_IR_DUMP,
+      "--ir-dump",
+      processFlagIrDump,
+      FLAGS_HELP_MESSAGES[FLAG_IR_DUMP] },
+
     { FLAG_SYMB_TABLE_DUMP,
       "--symb-table-dump",
       processFlagSymbTableDump,
@@ -142,6 +218,36 @@ const FlagSpecification FLAG_SPECIFICATIONS[TOTAL_FLAGS] = {
       processFlagUseNumerics,
       FLAGS_HELP_MESSAGES[FLAG_USE_NUMERICS] },
 
+    { FLAG_STRIP_COMMENTS,
+      "--strip-comments",
+      processFlagStripComments,
+      FLAGS_HELP_MESSAGES[FLAG_STRIP_COMMENTS] },
+
+    { FLAG_OPTIMIZE,
+      "-O",
+      processFlagOptimize,
+      FLAGS_HELP_MESSAGES[FLAG_OPTIMIZE] },
+
+    { FLAG_RUN,
+      "--run",
+      processFlagRun,
+      FLAGS_HELP_MESSAGES[FLAG_RUN] },
+
+    { FLAG_IMAGE,
+      "--image",
+      processFlagImage,
+      FLAGS_HELP_MESSAGES[FLAG_IMAGE] },
+
+    { FLAG_NATIVE,
+      "--native",
+      processFlagNative,
+      FLAGS_HELP_MESSAGES[FLAG_NATIVE] },
+
+    { FLAG_C,
+      "--c",
+      processFlagC,
+      FLAGS_HELP_MESSAGES[FLAG_C] },
+
     { FLAG_HELP,
       "-h",
       processFlagHelp,
@@ -173,7 +279,13 @@ int main(int argc, const char* argv[])
         return INPUT_UNSPECIFIED;
     }
 
-    if (flagManager.output == nullptr) { flagManager.output = DEFAULT_OUTPUT; }
+    if (flagManager.output == nullptr)
+    {
+        if      (flagManager.native) { flagManager.output = DEFAULT_NATIVE; }
+        else if (flagManager.c)      { flagManager.output = DEFAULT_C;      }
+        else if (flagManager.image)  { flagManager.output = DEFAULT_IMAGE;  }
+        else                         { flagManager.output = DEFAULT_OUTPUT; }
+    }
 
     return compile(&flagManager);
 }
@@ -236,6 +348,14 @@ Error processFlagTreeDump(FlagManager* flagManager)
     return NO_ERROR;
 }
 
+Error processFlagIrDump(FlagManager* flagManager)
+{
+    assert(flagManager != nullptr);
+
+    flagManager->irDumpEnabled = true;
+    return NO_ERROR;
+}
+
 Error processFlagSymbTableDump(FlagManager* flagManager)
 {
     assert(flagManager != nullptr);
@@ -252,6 +372,54 @@ Error processFlagUseNumerics(FlagManager* flagManager)
     return NO_ERROR;
 }
 
+Error processFlagStripComments(FlagManager* flagManager)
+{
+    assert(flagManager != nullptr);
+
+    flagManager->stripComments = true;
+    return NO_ERROR;
+}
+
+Error processFlagOptimize(FlagManager* flagManager)
+{
+    assert(flagManager != nullptr);
+
+    flagManager->optimize = true;
+    return NO_ERROR;
+}
+
+Error processFlagRun(FlagManager* flagManager)
+{
+    assert(flagManager != nullptr);
+
+    flagManager->run = true;
+    return NO_ERROR;
+}
+
+Error processFlagImage(FlagManager* flagManager)
+{
+    assert(flagManager != nullptr);
+
+    flagManager->image = true;
+    return NO_ERROR;
+}
+
+Error processFlagNative(FlagManager* flagManager)
+{
+    assert(flagManager != nullptr);
+
+    flagManager->native = true;
+    return NO_ERROR;
+}
+
+Error processFlagC(FlagManager* flagManager)
+{
+    assert(flagManager != nullptr);
+
+    flagManager->c = true;
+    return NO_ERROR;
+}
+
 Error processFlagHelp(FlagManager* flagManager)
 {
     assert(flagManager != nullptr);
@@ -301,6 +469,14 @@ Error compile(FlagManager* flagManager)
         return INPUT_LOAD_FAILED;
     }
 
+    // Pointer nodes live only until the tree is flattened, so they get their own arena
+    Arena arena     = {};
+    Arena nodeArena = {};
+    construct(&arena);
+    construct(&nodeArena);
+    setNodeArena(&nodeArena);
+    constructInterner(&arena);
+
     Node* tree = nullptr;
 
     Tokenizer tokenizer = {};
@@ -313,7 +489,7 @@ Error compile(FlagManager* flagManager)
     }
 
     SymbolTable table = {};
-    construct(&table);
+    construct(&table, &arena);
 
     Parser parser = {};
     construct(&parser, &tokenizer);
@@ -323,6 +499,28 @@ Error compile(FlagManager* flagManager)
         return COMPILATION_FAILED;
     }
 
+    // Names are interned, so nothing refers to the tokens or the text once the tree is built
+    destroy(&parser);
+    destroy(&tokenizer);
+    free(buffer);
+
+    if (flagManager->optimize)
+    {
+        InliningStats inliningStats = {};
+        inlineCalls(tree, &table, &inliningStats);
+
+        printf("Inlining: %zu calls inlined, %zu variables added\n",
+               inliningStats.inlinedCalls,
+               inliningStats.addedVariables);
+
+        FoldingStats foldingStats = {};
+        foldConstants(tree, &foldingStats);
+
+        printf("Constant folding: %zu expressions simplified, %zu instructions removed\n",
+               foldingStats.simplifiedExpressions,
+               foldingStats.removedInstructions);
+    }
+
     if (flagManager->graphDumpEnabled)
     {
         int count = counterFileUpdate("log/tree_dumps/graph/count.cnt");
@@ -340,11 +538,6 @@ Error compile(FlagManager* flagManager)
         system(dotCmd);
     }
 
-    if (flagManager->symbTableDumpEnabled)
-    {
-        dump(&table);
-    }
-
     if (flagManager->treeDumpEnabled)
     {
         FILE* file = fopen("dumped_tree.txt", "w");
@@ -355,18 +548,199 @@ Error compile(FlagManager* flagManager)
         fclose(file);
     }   
 
-    Compiler compiler = {};
-    construct(&compiler, tree, &table);
-    if (compile(&compiler, output) != COMPILER_NO_ERROR)
+    CompactTree compactedTree = {};
+    construct(&compactedTree, nodeArena.allocated / sizeof(Node));
+    compactTree(&compactedTree, tree);
+
+    setNodeArena(nullptr);
+    destroy(&nodeArena);
+
+    Compiler           compiler           = {};
+    NativeCompiler     nativeCompiler     = {};
+    CTranspiler        cTranspiler        = {};
+    PeepholeStats      peepholeStats      = {};
+    DeadCodeStats      deadCodeStats      = {};
+    TailCallStats      tailCallStats      = {};
+    CseStats           cseStats           = {};
+    LoopInvariantStats loopInvariantStats = {};
+    IrProgram          program            = {};
+    CompilerError      compileResult      = COMPILER_NO_ERROR;
+
+    if (flagManager->native)
+    {
+        construct(&nativeCompiler, &compactedTree, &table, !flagManager->stripComments);
+        compileResult = compile(&nativeCompiler, output);
+        destroy(&nativeCompiler);
+    }
+    else if (flagManager->c)
+    {
+        construct(&cTranspiler, &compactedTree, &table, !flagManager->stripComments);
+        compileResult = compile(&cTranspiler, output);
+        destroy(&cTranspiler);
+    }
+    else
+    {
+        construct(&program, &table);
+
+        if (lowerProgram(&program, &compactedTree) != IR_NO_ERROR ||
+            verifyProgram(&program, "lowering")    != IR_NO_ERROR)
+        {
+            printf("Couldn't compile the program.\n");
+            return COMPILATION_FAILED;
+        }
+
+        if (flagManager->optimize)
+        {
+            PassManager passManager = {};
+            construct(&passManager, true);
+
+            addPass(&passManager, "dead code",             eliminateDeadCode,             &deadCodeStats);
+            addPass(&passManager, "tail calls",            eliminateTailCalls,            &tailCallStats);
+            addPass(&passManager, "common subexpressions", eliminateCommonSubexpressions, &cseStats);
+            addPass(&passManager, "loop invariants",       hoistLoopInvariants,           &loopInvariantStats);
+
+            IrError passesResult = runPasses(&passManager, &program);
+            destroy(&passManager);
+
+            if (passesResult != IR_NO_ERROR)
+            {
+                printf("Couldn't compile the program.\n");
+                return COMPILATION_FAILED;
+            }
+
+            printf("Dead code: %zu unreachable functions and %zu blocks removed, %zu branches and %zu values folded\n",
+                   deadCodeStats.removedFunctions,
+                   deadCodeStats.removedBlocks,
+                   deadCodeStats.foldedBranches,
+                   deadCodeStats.foldedValues);
+            printf("Tail calls: %zu self calls turned into jumps, %zu of them accumulated in %zu functions\n",
+                   tailCallStats.tailCalls,
+                   tailCallStats.accumulatedCalls,
+                   tailCallStats.accumulatedFunctions);
+            printf("Common subexpressions: %zu evaluations saved\n", cseStats.savedEvaluations);
+            printf("Loop invariants: %zu values moved out of %zu loops\n",
+                   loopInvariantStats.hoistedValues,
+                   loopInvariantStats.loops);
+        }
+
+        if (flagManager->irDumpEnabled)
+        {
+            FILE* file = fopen("dumped_ir.txt", "w");
+            assert(file != nullptr);
+
+            dump(&program, file);
+
+            fclose(file);
+        }
+
+        construct(&compiler, &program, flagManager->image ? IMAGE_OUTPUT : TEXT_OUTPUT,
+                  !flagManager->stripComments, flagManager->optimize ? &peepholeStats : nullptr);
+        compileResult = compile(&compiler, output);
+
+        if (flagManager->optimize)
+        {
+            printf("Peephole optimization: %zu instructions removed\n", peepholeStats.removedInstructions);
+
+            // The IR already cleans up most of what these rules look for, only list the ones that fired
+            for (size_t i = 0; i < PEEPHOLE_RULES_COUNT; i++)
+            {
+                if (peepholeStats.hits[i] == 0) { continue; }
+
+                printf("    %-36s %zu\n", PEEPHOLE_RULE_NAMES[i], peepholeStats.hits[i]);
+            }
+        }
+
+        destroy(&program);
+    }
+
+    if (flagManager->symbTableDumpEnabled)
+    {
+        dump(&table);
+    }
+
+    if (compileResult != COMPILER_NO_ERROR)
     {
         printf("Couldn't compile the program.\n");
         return COMPILATION_FAILED;
     }
 
+    Error result = NO_ERROR;
+    if (flagManager->run && flagManager->native)
+    {
+        printf("Native code isn't run by the virtual machine, build it with the runtime instead.\n");
+    }
+    else if (flagManager->run && flagManager->c)
+    {
+        printf("C code isn't run by the virtual machine, build it with a C compiler instead.\n");
+    }
+    else if (flagManager->run)
+    {
+        result = runProgram(output, flagManager->image);
+    }
+
     destroy(&table);
-    destroy(&tokenizer);
-    destroy(&parser);
     destroy(&compiler);
+    destroy(&compactedTree);
 
-    return NO_ERROR;
+    destroyInterner();
+    destroy(&arena);
+
+    return result;
+}
+
+Error runProgram(const char* programFile, bool isImage)
+{
+    assert(programFile != nullptr);
+
+    char*  buffer     = nullptr;
+    size_t bufferSize = 0;
+
+    if (!loadFile(programFile, &buffer, &bufferSize))
+    {
+        printf("Couldn't load file '%s'\n", programFile);
+        return INPUT_LOAD_FAILED;
+    }
+
+    Bytecode bytecode = {};
+    construct(&bytecode);
+
+    if (isImage)
+    {
+        bool loaded = readImage(&bytecode, buffer, bufferSize);
+        free(buffer);
+
+        if (!loaded)
+        {
+            printf("'%s' isn't a valid bytecode image\n", programFile);
+            destroy(&bytecode);
+            return EXECUTION_FAILED;
+        }
+    }
+    else
+    {
+        size_t         errorLine      = 0;
+        AssemblerError assemblyResult = assemble(&bytecode, buffer, bufferSize, &errorLine);
+        free(buffer);
+
+        if (assemblyResult != ASSEMBLER_NO_ERROR)
+        {
+            printf("ASSEMBLY ERROR: %s (%s:%zu)\n", errorString(assemblyResult), programFile, errorLine);
+            destroy(&bytecode);
+            return EXECUTION_FAILED;
+        }
+    }
+
+    VirtualMachine vm = {};
+    construct(&vm);
+
+    VmError runResult = run(&vm, &bytecode);
+    if (runResult != VM_NO_ERROR)
+    {
+        printf("RUNTIME ERROR: %s\n", errorString(runResult));
+    }
+
+    destroy(&vm);
+    destroy(&bytecode);
+
+    return (runResult == VM_NO_ERROR) ? NO_ERROR : EXECUTION_FAILED;
 }
\ No newline at end of file
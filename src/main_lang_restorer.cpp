@@ -51,6 +51,13 @@ int main(int argc, char* argv[])
 
     output = (output == nullptr) ? (char*) DEFAULT_OUTPUT : output;
 
+    Arena arena     = {};
+    Arena nodeArena = {};
+    construct(&arena);
+    construct(&nodeArena);
+    setNodeArena(&nodeArena);
+    constructInterner(&arena);
+
     Node* readTree = readTreeFromFile(input);
     if (readTree == nullptr)
     {
@@ -58,11 +65,22 @@ int main(int argc, char* argv[])
         return INPUT_LOAD_FAILED;
     }
 
-    if (!restoreCode(readTree, output))
+    CompactTree tree = {};
+    construct(&tree, nodeArena.allocated / sizeof(Node));
+    compactTree(&tree, readTree);
+
+    setNodeArena(nullptr);
+    destroy(&nodeArena);
+
+    if (!restoreCode(&tree, output))
     {
         printf("Restoring program failed.\n");
         return RESTORE_FAILED;
     }
 
+    destroy(&tree);
+    destroyInterner();
+    destroy(&arena);
+
     return NO_ERROR;
 }
\ No newline at end of file
@@ -0,0 +1,1009 @@
+#include <assert.h>
+#include <string.h>
+#include "native_compiler.h"
+
+#define ASSERT_COMPILER(compiler) assert(compiler                 != nullptr); \
+                                  assert(compiler->table          != nullptr); \
+                                  assert(compiler->emitter.buffer != nullptr);
+
+#define OUTPUT      (&compiler->emitter)
+#define CUR_FUNC    compiler->curFunction
+#define FUNC_INDEX  ((size_t) (compiler->curFunction - compiler->table->functions))
+
+#define TYPE(node)  NODE_TYPE  (compiler->tree, node)
+#define DATA(node)  NODE_DATA  (compiler->tree, node)
+#define LEFT(node)  NODE_LEFT  (compiler->tree, node)
+#define RIGHT(node) NODE_RIGHT (compiler->tree, node)
+
+const size_t XMM_STACK_SIZE             = 14; // xmm14 and xmm15 are scratch
+const size_t SCRATCH_XMM                = 15;
+const size_t REGISTER_PARAMS_COUNT      = 8;
+const size_t VALUE_SIZE                 = 8;
+const size_t STACK_ALIGNMENT            = 16;
+const size_t DEFAULT_CONSTANTS_CAPACITY = 64;
+
+const char*  FUNCTION_PREFIX            = "potter_";
+const char*  ENTRY_SYMBOL               = "potter_entry";
+
+void    compileError        (NativeCompiler* compiler, CompilerError error);
+size_t  alignStack          (size_t size);
+
+void    writeFunctionHeader (NativeCompiler* compiler);
+void    writeRandomTable    (NativeCompiler* compiler);
+void    writeConstants      (NativeCompiler* compiler);
+
+void    writeFunction       (NativeCompiler* compiler, NodeIndex node);
+void    writeBlock          (NativeCompiler* compiler, NodeIndex node);
+void    writeStatement      (NativeCompiler* compiler, NodeIndex node);
+
+void    writeCondition      (NativeCompiler* compiler, NodeIndex node);
+void    writeLoop           (NativeCompiler* compiler, NodeIndex node);
+void    writeJumpIfFalse    (NativeCompiler* compiler, NodeIndex node, LabelKind label, size_t index);
+void    writeAssignment     (NativeCompiler* compiler, NodeIndex node);
+void    writeReturn         (NativeCompiler* compiler, NodeIndex node);
+
+void    writeExpression     (NativeCompiler* compiler, NodeIndex node, size_t depth);
+void    writeMath           (NativeCompiler* compiler, NodeIndex node, size_t depth);
+void    writeCompare        (NativeCompiler* compiler, NodeIndex node, size_t depth);
+Operand writeOperands       (NativeCompiler* compiler, NodeIndex node, size_t depth, bool rightInRegister);
+void    writeNumber         (NativeCompiler* compiler, double number, size_t depth);
+
+void    writeCall           (NativeCompiler* compiler, NodeIndex node, size_t depth);
+bool    writeStdCall        (NativeCompiler* compiler, NodeIndex node, size_t depth);
+void    writeRuntimeCall    (NativeCompiler* compiler, const char* name, size_t depth, bool hasArgument);
+void    writeRandomJump     (NativeCompiler* compiler);
+void    saveRegisters       (NativeCompiler* compiler, size_t count);
+void    restoreRegisters    (NativeCompiler* compiler, size_t count);
+
+Operand xmm                 (size_t index);
+Operand addConstant         (NativeCompiler* compiler, double number);
+bool    isSimpleOperand     (NativeCompiler* compiler, NodeIndex node);
+Operand simpleOperand       (NativeCompiler* compiler, NodeIndex node);
+
+void    putInstruction      (NativeCompiler* compiler, const char* instruction);
+void    putInstruction      (NativeCompiler* compiler, const char* mnemonic, Operand destination, Operand source);
+void    putStackAdjustment  (NativeCompiler* compiler, const char* mnemonic, size_t size);
+void    putJump             (NativeCompiler* compiler, const char* mnemonic, LabelKind label, size_t index);
+void    putLabel            (NativeCompiler* compiler, LabelKind label, size_t index);
+void    putFunctionSymbol   (NativeCompiler* compiler, const Function* function);
+void    putOperand          (NativeCompiler* compiler, Operand operand);
+void    putComment          (NativeCompiler* compiler, const char* text);
+
+void construct(NativeCompiler* compiler, const CompactTree* tree, SymbolTable* table, bool commentsEnabled)
+{
+    assert(compiler != nullptr);
+    assert(tree     != nullptr);
+    assert(table    != nullptr);
+
+    compiler->table           = table;
+    compiler->tree            = tree;
+    compiler->commentsEnabled = commentsEnabled;
+}
+
+void destroy(NativeCompiler* compiler)
+{
+    assert(compiler != nullptr);
+
+    compiler->table = nullptr;
+    compiler->tree  = nullptr;
+}
+
+void compileError(NativeCompiler* compiler, CompilerError error)
+{
+    assert(compiler != nullptr);
+
+    compiler->status = error;
+
+    printf("COMPILATION ERROR: %s\n", errorString(error));
+}
+
+CompilerError compile(NativeCompiler* compiler, const char* outputFile)
+{
+    assert(compiler   != nullptr);
+    assert(outputFile != nullptr);
+
+    Function* mainFunction = getFunction(compiler->table, MAIN_SYMBOL);
+    if (mainFunction == nullptr)
+    {
+        compileError(compiler, COMPILER_ERROR_NO_MAIN_FUNCTION);
+        return compiler->status;
+    }
+
+    FILE* file = fopen(outputFile, "w");
+    if (file == nullptr)
+    {
+        compileError(compiler, COMPILER_ERROR_FILE_OPEN_FAILURE);
+        return compiler->status;
+    }
+
+    construct(OUTPUT, file, compiler->commentsEnabled);
+
+    compiler->constants         = (double*) malloc(DEFAULT_CONSTANTS_CAPACITY * sizeof(double));
+    compiler->constantsCount    = 0;
+    compiler->constantsCapacity = DEFAULT_CONSTANTS_CAPACITY;
+    assert(compiler->constants != nullptr);
+
+    putInstruction (compiler, ".intel_syntax noprefix");
+    putInstruction (compiler, ".text");
+
+    // The runtime's main calls the program through this alias of love
+    emit              (OUTPUT, "\t.globl ");
+    emit              (OUTPUT, ENTRY_SYMBOL);
+    emit              (OUTPUT, "\n\t.set ");
+    emit              (OUTPUT, ENTRY_SYMBOL);
+    emit              (OUTPUT, ", ");
+    putFunctionSymbol (compiler, mainFunction);
+    emitChar          (OUTPUT, '\n');
+    emitBlankLine     (OUTPUT);
+
+    CUR_FUNC = compiler->table->functions;
+
+    NodeIndex curDeclaration = (compiler->tree->nodesCount > 0) ? 0 : NO_NODE; // root is node 0
+    while (curDeclaration != NO_NODE)
+    {
+        writeFunction(compiler, RIGHT(curDeclaration));
+        curDeclaration = LEFT(curDeclaration);
+        CUR_FUNC++;
+    }
+
+    writeConstants(compiler);
+    putInstruction(compiler, ".section .note.GNU-stack,\"\",@progbits");
+
+    free(compiler->constants);
+    compiler->constants         = nullptr;
+    compiler->constantsCount    = 0;
+    compiler->constantsCapacity = 0;
+
+    destroy(OUTPUT);
+    fclose(file);
+
+    return compiler->status;
+}
+
+size_t alignStack(size_t size)
+{
+    return (size + STACK_ALIGNMENT - 1) / STACK_ALIGNMENT * STACK_ALIGNMENT;
+}
+
+void writeFunctionHeader(NativeCompiler* compiler)
+{
+    ASSERT_COMPILER(compiler);
+
+    if (!compiler->commentsEnabled) { return; }
+
+    emit(OUTPUT, "# ");
+    emit(OUTPUT, getSymbolName(CUR_FUNC->name));
+    emit(OUTPUT, "(");
+
+    for (size_t i = 0; i < CUR_FUNC->paramsCount; i++)
+    {
+        emit(OUTPUT, getSymbolName(CUR_FUNC->vars[i]));
+
+        if (i < CUR_FUNC->paramsCount - 1)
+        {
+            emit(OUTPUT, ", ");
+        }
+    }
+
+    emit         (OUTPUT, "), frame of ");
+    emitUnsigned (OUTPUT, compiler->frameSize);
+    emit         (OUTPUT, " bytes\n");
+}
+
+void writeFunction(NativeCompiler* compiler, NodeIndex node)
+{
+    ASSERT_COMPILER(compiler);
+    assert(node != NO_NODE);
+
+    compiler->frameSize     = alignStack(CUR_FUNC->varsCount * VALUE_SIZE);
+    compiler->funcCondLabel = compiler->curCondLabel;
+    compiler->funcLoopLabel = compiler->curLoopLabel;
+    compiler->randomJumps   = false;
+
+    writeFunctionHeader (compiler);
+    putFunctionSymbol   (compiler, CUR_FUNC);
+    emit                (OUTPUT, ":\n");
+
+    putInstruction (compiler, "push rbp");
+    putInstruction (compiler, "mov rbp, rsp");
+
+    if (compiler->frameSize > 0)
+    {
+        putStackAdjustment(compiler, "sub", compiler->frameSize);
+    }
+
+    for (size_t i = 0; i < CUR_FUNC->paramsCount; i++)
+    {
+        Operand param = { VAR_OPERAND, i };
+
+        if (i < REGISTER_PARAMS_COUNT)
+        {
+            putInstruction(compiler, "movsd", param, xmm(i));
+        }
+        else
+        {
+            putInstruction(compiler, "movsd", xmm(SCRATCH_XMM), { ARGUMENT_OPERAND, i - REGISTER_PARAMS_COUNT });
+            putInstruction(compiler, "movsd", param, xmm(SCRATCH_XMM));
+        }
+    }
+
+    // riddikulus may restart the body, so it's one of the jump targets
+    emit         (OUTPUT, ".LBODY_");
+    emitUnsigned (OUTPUT, FUNC_INDEX);
+    emit         (OUTPUT, ":\n");
+
+    writeBlock(compiler, LEFT(node));
+
+    // Falling off the end returns 0
+    putInstruction (compiler, "pxor xmm0, xmm0");
+    putInstruction (compiler, "leave");
+    putInstruction (compiler, "ret");
+
+    if (compiler->randomJumps) { writeRandomTable(compiler); }
+
+    emitBlankLine(OUTPUT);
+}
+
+//------------------------------------------------------------------------------
+// Offsets of the function's labels relative to the table, so that it needs no
+// relocations and works in position independent executables.
+//------------------------------------------------------------------------------
+void writeRandomTable(NativeCompiler* compiler)
+{
+    ASSERT_COMPILER(compiler);
+
+    size_t conditions = compiler->curCondLabel - compiler->funcCondLabel;
+    size_t loops      = compiler->curLoopLabel - compiler->funcLoopLabel;
+
+    emit         (OUTPUT, "\t.set .LRANDOM_COUNT_");
+    emitUnsigned (OUTPUT, FUNC_INDEX);
+    emit         (OUTPUT, ", ");
+    emitUnsigned (OUTPUT, 1 + 2 * conditions + 3 * loops);
+    emitChar     (OUTPUT, '\n');
+
+    putInstruction (compiler, ".section .rodata");
+    putInstruction (compiler, ".align 4");
+
+    emit         (OUTPUT, ".LRANDOM_");
+    emitUnsigned (OUTPUT, FUNC_INDEX);
+    emit         (OUTPUT, ":\n");
+
+    static const LabelKind CONDITION_LABELS[] = { IF_END_LABEL, IF_ELSE_END_LABEL };
+    static const LabelKind LOOP_LABELS[]      = { WHILE_LABEL, WHILE_BODY_LABEL, WHILE_END_LABEL };
+
+    emit         (OUTPUT, "\t.long .LBODY_");
+    emitUnsigned (OUTPUT, FUNC_INDEX);
+    emit         (OUTPUT, " - .LRANDOM_");
+    emitUnsigned (OUTPUT, FUNC_INDEX);
+    emitChar     (OUTPUT, '\n');
+
+    for (size_t i = compiler->funcCondLabel; i < compiler->curCondLabel; i++)
+    {
+        for (LabelKind label : CONDITION_LABELS)
+        {
+            emit         (OUTPUT, "\t.long .L");
+            emit         (OUTPUT, LABEL_NAMES[label]);
+            emitChar     (OUTPUT, '_');
+            emitUnsigned (OUTPUT, i);
+            emit         (OUTPUT, " - .LRANDOM_");
+            emitUnsigned (OUTPUT, FUNC_INDEX);
+            emitChar     (OUTPUT, '\n');
+        }
+    }
+
+    for (size_t i = compiler->funcLoopLabel; i < compiler->curLoopLabel; i++)
+    {
+        for (LabelKind label : LOOP_LABELS)
+        {
+            emit         (OUTPUT, "\t.long .L");
+            emit         (OUTPUT, LABEL_NAMES[label]);
+            emitChar     (OUTPUT, '_');
+            emitUnsigned (OUTPUT, i);
+            emit         (OUTPUT, " - .LRANDOM_");
+            emitUnsigned (OUTPUT, FUNC_INDEX);
+            emitChar     (OUTPUT, '\n');
+        }
+    }
+
+    putInstruction(compiler, ".text");
+}
+
+void writeConstants(NativeCompiler* compiler)
+{
+    ASSERT_COMPILER(compiler);
+
+    if (compiler->constantsCount == 0) { return; }
+
+    putInstruction (compiler, ".section .rodata");
+    putInstruction (compiler, ".align 8");
+
+    for (size_t i = 0; i < compiler->constantsCount; i++)
+    {
+        uint64_t bits = 0;
+        memcpy(&bits, &compiler->constants[i], sizeof(bits));
+
+        emit         (OUTPUT, ".LC");
+        emitUnsigned (OUTPUT, i);
+        emit         (OUTPUT, ":\n\t.quad ");
+        emitUnsigned (OUTPUT, bits);
+
+        if (compiler->commentsEnabled)
+        {
+            emit       (OUTPUT, " # ");
+            emitNumber (OUTPUT, compiler->constants[i]);
+        }
+
+        emitChar(OUTPUT, '\n');
+    }
+
+    putInstruction(compiler, ".text");
+}
+
+void writeBlock(NativeCompiler* compiler, NodeIndex node)
+{
+    ASSERT_COMPILER(compiler);
+    assert(node != NO_NODE);
+
+    NodeIndex curStatement = RIGHT(node);
+    while (curStatement != NO_NODE)
+    {
+        writeStatement(compiler, curStatement);
+        curStatement = RIGHT(curStatement);
+    }
+}
+
+void writeStatement(NativeCompiler* compiler, NodeIndex node)
+{
+    ASSERT_COMPILER(compiler);
+    assert(node       != NO_NODE);
+    assert(LEFT(node) != NO_NODE);
+
+    switch (TYPE(LEFT(node)))
+    {
+        case COND_TYPE:  { writeCondition  (compiler, LEFT(node));    break; }
+        case LOOP_TYPE:  { writeLoop       (compiler, LEFT(node));    break; }
+        case VDECL_TYPE: { writeAssignment (compiler, LEFT(node));    break; }
+        case ASSG_TYPE:  { writeAssignment (compiler, LEFT(node));    break; }
+        case JUMP_TYPE:  { writeReturn     (compiler, LEFT(node));    break; }
+        default:         { writeExpression (compiler, LEFT(node), 0); break; }
+    }
+}
+
+void writeCondition(NativeCompiler* compiler, NodeIndex node)
+{
+    ASSERT_COMPILER(compiler);
+    assert(node != NO_NODE);
+
+    putComment(compiler, "IF statement");
+
+    size_t label = compiler->curCondLabel++;
+
+    writeJumpIfFalse (compiler, LEFT(node), IF_END_LABEL, label);
+    writeBlock       (compiler, LEFT(RIGHT(node)));
+
+    putJump  (compiler, "jmp", IF_ELSE_END_LABEL, label);
+    putLabel (compiler, IF_END_LABEL, label);
+
+    if (RIGHT(RIGHT(node)) != NO_NODE)
+    {
+        writeBlock(compiler, RIGHT(RIGHT(node)));
+    }
+
+    putLabel(compiler, IF_ELSE_END_LABEL, label);
+}
+
+void writeLoop(NativeCompiler* compiler, NodeIndex node)
+{
+    ASSERT_COMPILER(compiler);
+    assert(node != NO_NODE);
+
+    size_t label = compiler->curLoopLabel++;
+
+    putLabel         (compiler, WHILE_LABEL, label);
+    writeJumpIfFalse (compiler, LEFT(node), WHILE_END_LABEL, label);
+    putLabel         (compiler, WHILE_BODY_LABEL, label);
+
+    writeBlock(compiler, RIGHT(node));
+
+    putJump  (compiler, "jmp", WHILE_LABEL, label);
+    putLabel (compiler, WHILE_END_LABEL, label);
+}
+
+//------------------------------------------------------------------------------
+// ucomisd reports NaN operands as unordered, which sets ZF, PF and CF at
+// once. The jumps are picked so that comparisons with NaN are false, as they
+// are in the software CPU.
+//------------------------------------------------------------------------------
+void writeJumpIfFalse(NativeCompiler* compiler, NodeIndex node, LabelKind label, size_t index)
+{
+    ASSERT_COMPILER(compiler);
+    assert(node != NO_NODE);
+
+    if (!(TYPE(node) == MATH_TYPE && DATA(node).operation > DIV_OP))
+    {
+        writeExpression (compiler, node, 0);
+        putInstruction  (compiler, "pxor xmm15, xmm15");
+        putInstruction  (compiler, "ucomisd", xmm(0), xmm(SCRATCH_XMM));
+        putInstruction  (compiler, "jp 1f");
+        putJump         (compiler, "je", label, index);
+        putInstruction  (compiler, "1:");
+        return;
+    }
+
+    MathOp  operation = DATA(node).operation;
+    bool    swapped   = operation == LESS_OP || operation == LESS_EQUAL_OP;
+    Operand right     = writeOperands(compiler, node, 0, swapped);
+
+    if (swapped) { putInstruction(compiler, "ucomisd", right,  xmm(0)); }
+    else         { putInstruction(compiler, "ucomisd", xmm(0), right);  }
+
+    switch (operation)
+    {
+        case GREATER_OP:
+        case LESS_OP:          { putJump(compiler, "jbe", label, index); break; }
+        case GREATER_EQUAL_OP:
+        case LESS_EQUAL_OP:    { putJump(compiler, "jb",  label, index); break; }
+
+        case EQUAL_OP:
+        {
+            putJump(compiler, "jne", label, index);
+            putJump(compiler, "jp",  label, index);
+            break;
+        }
+
+        case NOT_EQUAL_OP:
+        {
+            putInstruction (compiler, "jp 1f");
+            putJump        (compiler, "je", label, index);
+            putInstruction (compiler, "1:");
+            break;
+        }
+
+        default: { assert(!"Invalid cmp op"); break; }
+    }
+}
+
+void writeAssignment(NativeCompiler* compiler, NodeIndex node)
+{
+    ASSERT_COMPILER(compiler);
+    assert(node != NO_NODE);
+
+    assert(DATA(LEFT(node)).name.slot != NO_SLOT);
+
+    writeExpression(compiler, RIGHT(node), 0);
+
+    Operand variable = { VAR_OPERAND, (size_t) DATA(LEFT(node)).name.slot };
+    putInstruction(compiler, "movsd", variable, xmm(0));
+}
+
+void writeReturn(NativeCompiler* compiler, NodeIndex node)
+{
+    ASSERT_COMPILER(compiler);
+    assert(node != NO_NODE);
+
+    writeExpression(compiler, RIGHT(node), 0);
+
+    putInstruction (compiler, "leave");
+    putInstruction (compiler, "ret");
+}
+
+void writeExpression(NativeCompiler* compiler, NodeIndex node, size_t depth)
+{
+    ASSERT_COMPILER(compiler);
+    assert(node  != NO_NODE);
+    assert(depth <  XMM_STACK_SIZE);
+
+    switch (TYPE(node))
+    {
+        case MATH_TYPE: { writeMath   (compiler, node, depth);              break; }
+        case NUMB_TYPE: { writeNumber (compiler, DATA(node).number, depth); break; }
+        case CALL_TYPE: { writeCall   (compiler, node, depth);              break; }
+
+        case NAME_TYPE:
+        {
+            putInstruction(compiler, "movsd", xmm(depth), simpleOperand(compiler, node));
+            break;
+        }
+
+        default: { assert(!"Invalid node type"); break; }
+    }
+}
+
+void writeMath(NativeCompiler* compiler, NodeIndex node, size_t depth)
+{
+    ASSERT_COMPILER(compiler);
+    assert(node != NO_NODE);
+
+    if (DATA(node).operation > DIV_OP)
+    {
+        writeCompare(compiler, node, depth);
+        return;
+    }
+
+    Operand right = writeOperands(compiler, node, depth, false);
+
+    switch (DATA(node).operation)
+    {
+        case ADD_OP: { putInstruction(compiler, "addsd", xmm(depth), right); break; }
+        case SUB_OP: { putInstruction(compiler, "subsd", xmm(depth), right); break; }
+        case MUL_OP: { putInstruction(compiler, "mulsd", xmm(depth), right); break; }
+        case DIV_OP: { putInstruction(compiler, "divsd", xmm(depth), right); break; }
+        default:     { assert(!"Invalid math op"); break; }
+    }
+}
+
+void writeCompare(NativeCompiler* compiler, NodeIndex node, size_t depth)
+{
+    ASSERT_COMPILER(compiler);
+    assert(node != NO_NODE);
+
+    MathOp  operation = DATA(node).operation;
+    bool    swapped   = operation == LESS_OP || operation == LESS_EQUAL_OP;
+    Operand right     = writeOperands(compiler, node, depth, swapped);
+
+    if (swapped) { putInstruction(compiler, "ucomisd", right,      xmm(depth)); }
+    else         { putInstruction(compiler, "ucomisd", xmm(depth), right);      }
+
+    switch (operation)
+    {
+        case GREATER_OP:
+        case LESS_OP:          { putInstruction(compiler, "seta al");  break; }
+        case GREATER_EQUAL_OP:
+        case LESS_EQUAL_OP:    { putInstruction(compiler, "setae al"); break; }
+
+        case EQUAL_OP:
+        {
+            putInstruction (compiler, "sete al");
+            putInstruction (compiler, "setnp cl");
+            putInstruction (compiler, "and al, cl");
+            break;
+        }
+
+        case NOT_EQUAL_OP:
+        {
+            putInstruction (compiler, "setne al");
+            putInstruction (compiler, "setp cl");
+            putInstruction (compiler, "or al, cl");
+            break;
+        }
+
+        default: { assert(!"Invalid cmp op"); break; }
+    }
+
+    putInstruction (compiler, "movzx eax, al");
+    emit           (OUTPUT, "\tcvtsi2sd ");
+    putOperand     (compiler, xmm(depth));
+    emit           (OUTPUT, ", eax\n");
+}
+
+//------------------------------------------------------------------------------
+// Leaves the left operand in xmm<depth> and returns where the right one is.
+// Numbers and variables are used straight from memory unless a register is
+// required. When the register stack runs out, the left operand waits on the
+// machine stack and the right one ends up in the scratch register.
+//------------------------------------------------------------------------------
+Operand writeOperands(NativeCompiler* compiler, NodeIndex node, size_t depth, bool rightInRegister)
+{
+    ASSERT_COMPILER(compiler);
+    assert(node != NO_NODE);
+
+    writeExpression(compiler, LEFT(node), depth);
+
+    if (!rightInRegister && isSimpleOperand(compiler, RIGHT(node)))
+    {
+        return simpleOperand(compiler, RIGHT(node));
+    }
+
+    if (depth + 1 < XMM_STACK_SIZE)
+    {
+        writeExpression(compiler, RIGHT(node), depth + 1);
+        return xmm(depth + 1);
+    }
+
+    putStackAdjustment (compiler, "sub", STACK_ALIGNMENT);
+    putInstruction     (compiler, "movsd", { STACK_OPERAND, 0 }, xmm(depth));
+
+    writeExpression(compiler, RIGHT(node), depth);
+
+    putInstruction     (compiler, "movapd", xmm(SCRATCH_XMM), xmm(depth));
+    putInstruction     (compiler, "movsd",  xmm(depth), { STACK_OPERAND, 0 });
+    putStackAdjustment (compiler, "add", STACK_ALIGNMENT);
+
+    return xmm(SCRATCH_XMM);
+}
+
+void writeNumber(NativeCompiler* compiler, double number, size_t depth)
+{
+    ASSERT_COMPILER(compiler);
+
+    if (number == 0 && !signbit(number))
+    {
+        putInstruction(compiler, "pxor", xmm(depth), xmm(depth));
+        return;
+    }
+
+    putInstruction(compiler, "movsd", xmm(depth), addConstant(compiler, number));
+}
+
+//------------------------------------------------------------------------------
+// Registers below depth hold values of the enclosing expression and are saved
+// around the call. The parser keeps the arguments last to first, and they're
+// evaluated in that order, as the software CPU does. The ones that go on the
+// stack come first, then the register ones are evaluated up the register
+// stack and reversed into place.
+//------------------------------------------------------------------------------
+void writeCall(NativeCompiler* compiler, NodeIndex node, size_t depth)
+{
+    ASSERT_COMPILER(compiler);
+    assert(node != NO_NODE);
+
+    if (writeStdCall(compiler, node, depth)) { return; }
+
+    Function* function = getFunction(compiler->table, DATA(LEFT(node)).name.id);
+    if (function == nullptr)
+    {
+        compileError(compiler, COMPILER_ERROR_CALL_UNDEFINED_FUNCTION);
+        return;
+    }
+
+    size_t argsCount = 0;
+    for (NodeIndex curParamExpr = RIGHT(node); curParamExpr != NO_NODE; curParamExpr = RIGHT(curParamExpr))
+    {
+        argsCount++;
+    }
+
+    size_t registerArgs  = (argsCount < REGISTER_PARAMS_COUNT) ? argsCount : REGISTER_PARAMS_COUNT;
+    size_t stackArgs     = argsCount - registerArgs;
+    size_t stackArgsSize = alignStack(stackArgs * VALUE_SIZE);
+
+    saveRegisters(compiler, depth);
+
+    if (stackArgsSize > 0) { putStackAdjustment(compiler, "sub", stackArgsSize); }
+
+    size_t    arg          = 0;
+    NodeIndex curParamExpr = RIGHT(node);
+    while (curParamExpr != NO_NODE)
+    {
+        if (arg < stackArgs)
+        {
+            writeExpression (compiler, LEFT(curParamExpr), 0);
+            putInstruction  (compiler, "movsd", { STACK_OPERAND, stackArgs - 1 - arg }, xmm(0));
+        }
+        else
+        {
+            writeExpression(compiler, LEFT(curParamExpr), arg - stackArgs);
+        }
+
+        curParamExpr = RIGHT(curParamExpr);
+        arg++;
+    }
+
+    for (size_t i = 0; i < registerArgs / 2; i++)
+    {
+        putInstruction (compiler, "movapd", xmm(SCRATCH_XMM),              xmm(i));
+        putInstruction (compiler, "movapd", xmm(i),                        xmm(registerArgs - 1 - i));
+        putInstruction (compiler, "movapd", xmm(registerArgs - 1 - i), xmm(SCRATCH_XMM));
+    }
+
+    emit              (OUTPUT, "\tcall ");
+    putFunctionSymbol (compiler, function);
+    emitChar          (OUTPUT, '\n');
+
+    if (stackArgsSize > 0) { putStackAdjustment(compiler, "add", stackArgsSize); }
+    if (depth > 0)         { putInstruction(compiler, "movapd", xmm(depth), xmm(0)); }
+
+    restoreRegisters(compiler, depth);
+}
+
+bool writeStdCall(NativeCompiler* compiler, NodeIndex node, size_t depth)
+{
+    ASSERT_COMPILER(compiler);
+    assert(node != NO_NODE);
+
+    switch (DATA(LEFT(node)).name.id)
+    {
+        case PRINT_SYMBOL:
+        {
+            writeExpression  (compiler, LEFT(RIGHT(node)), depth);
+            writeRuntimeCall (compiler, "potter_flagrate", depth, true);
+            break;
+        }
+
+        case SCAN_SYMBOL:
+        {
+            writeRuntimeCall(compiler, "potter_accio", depth, false);
+            break;
+        }
+
+        case FLOOR_SYMBOL:
+        {
+            writeExpression (compiler, LEFT(RIGHT(node)), depth);
+            emit            (OUTPUT, "\troundsd ");
+            putOperand      (compiler, xmm(depth));
+            emit            (OUTPUT, ", ");
+            putOperand      (compiler, xmm(depth));
+            emit            (OUTPUT, ", 9\n"); // round down, don't raise inexact
+            break;
+        }
+
+        case SQRT_SYMBOL:
+        {
+            writeExpression (compiler, LEFT(RIGHT(node)), depth);
+            putInstruction  (compiler, "sqrtsd", xmm(depth), xmm(depth));
+            break;
+        }
+
+        case RAND_JUMP_SYMBOL:
+        {
+            writeRandomJump(compiler);
+            break;
+        }
+
+        default:
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void writeRuntimeCall(NativeCompiler* compiler, const char* name, size_t depth, bool hasArgument)
+{
+    ASSERT_COMPILER(compiler);
+    assert(name != nullptr);
+
+    saveRegisters(compiler, depth);
+
+    if (hasArgument && depth > 0) { putInstruction(compiler, "movapd", xmm(0), xmm(depth)); }
+
+    emit     (OUTPUT, "\tcall ");
+    emit     (OUTPUT, name);
+    emitChar (OUTPUT, '\n');
+
+    if (depth > 0) { putInstruction(compiler, "movapd", xmm(depth), xmm(0)); }
+
+    restoreRegisters(compiler, depth);
+}
+
+//------------------------------------------------------------------------------
+// Jumps to the start of the body or to a random label of the current function.
+// Whatever the enclosing expression kept on the stack is dropped.
+//------------------------------------------------------------------------------
+void writeRandomJump(NativeCompiler* compiler)
+{
+    ASSERT_COMPILER(compiler);
+
+    compiler->randomJumps = true;
+
+    emit         (OUTPUT, "\tlea rsp, [rbp-");
+    emitUnsigned (OUTPUT, compiler->frameSize);
+    emit         (OUTPUT, "]\n\tmov edi, OFFSET .LRANDOM_COUNT_");
+    emitUnsigned (OUTPUT, FUNC_INDEX);
+    emit         (OUTPUT, "\n\tcall potter_random\n\tlea rdx, .LRANDOM_");
+    emitUnsigned (OUTPUT, FUNC_INDEX);
+    emit         (OUTPUT, "[rip]\n");
+
+    putInstruction (compiler, "movsxd rax, DWORD PTR [rdx+rax*4]");
+    putInstruction (compiler, "add rax, rdx");
+    putInstruction (compiler, "jmp rax");
+}
+
+void saveRegisters(NativeCompiler* compiler, size_t count)
+{
+    ASSERT_COMPILER(compiler);
+
+    if (count == 0) { return; }
+
+    putStackAdjustment(compiler, "sub", alignStack(count * VALUE_SIZE));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        putInstruction(compiler, "movsd", { STACK_OPERAND, i }, xmm(i));
+    }
+}
+
+void restoreRegisters(NativeCompiler* compiler, size_t count)
+{
+    ASSERT_COMPILER(compiler);
+
+    if (count == 0) { return; }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        putInstruction(compiler, "movsd", xmm(i), { STACK_OPERAND, i });
+    }
+
+    putStackAdjustment(compiler, "add", alignStack(count * VALUE_SIZE));
+}
+
+Operand xmm(size_t index)
+{
+    return { XMM_OPERAND, index };
+}
+
+Operand addConstant(NativeCompiler* compiler, double number)
+{
+    ASSERT_COMPILER(compiler);
+
+    if (compiler->constantsCount >= compiler->constantsCapacity)
+    {
+        compiler->constantsCapacity *= 2;
+        compiler->constants = (double*) realloc(compiler->constants, compiler->constantsCapacity * sizeof(double));
+        assert(compiler->constants != nullptr);
+    }
+
+    compiler->constants[compiler->constantsCount] = number;
+
+    return { CONSTANT_OPERAND, compiler->constantsCount++ };
+}
+
+bool isSimpleOperand(NativeCompiler* compiler, NodeIndex node)
+{
+    ASSERT_COMPILER(compiler);
+    assert(node != NO_NODE);
+
+    return TYPE(node) == NUMB_TYPE || TYPE(node) == NAME_TYPE;
+}
+
+Operand simpleOperand(NativeCompiler* compiler, NodeIndex node)
+{
+    ASSERT_COMPILER(compiler);
+    assert(isSimpleOperand(compiler, node));
+
+    if (TYPE(node) == NUMB_TYPE)
+    {
+        return addConstant(compiler, DATA(node).number);
+    }
+
+    assert(DATA(node).name.slot != NO_SLOT);
+
+    return { VAR_OPERAND, (size_t) DATA(node).name.slot };
+}
+
+void putInstruction(NativeCompiler* compiler, const char* instruction)
+{
+    ASSERT_COMPILER(compiler);
+    assert(instruction != nullptr);
+
+    emitChar (OUTPUT, '\t');
+    emit     (OUTPUT, instruction);
+    emitChar (OUTPUT, '\n');
+}
+
+void putInstruction(NativeCompiler* compiler, const char* mnemonic, Operand destination, Operand source)
+{
+    ASSERT_COMPILER(compiler);
+    assert(mnemonic != nullptr);
+
+    emitChar   (OUTPUT, '\t');
+    emit       (OUTPUT, mnemonic);
+    emitChar   (OUTPUT, ' ');
+    putOperand (compiler, destination);
+    emit       (OUTPUT, ", ");
+    putOperand (compiler, source);
+    emitChar   (OUTPUT, '\n');
+}
+
+void putStackAdjustment(NativeCompiler* compiler, const char* mnemonic, size_t size)
+{
+    ASSERT_COMPILER(compiler);
+    assert(mnemonic != nullptr);
+    assert(size % STACK_ALIGNMENT == 0);
+
+    emitChar     (OUTPUT, '\t');
+    emit         (OUTPUT, mnemonic);
+    emit         (OUTPUT, " rsp, ");
+    emitUnsigned (OUTPUT, size);
+    emitChar     (OUTPUT, '\n');
+}
+
+void putJump(NativeCompiler* compiler, const char* mnemonic, LabelKind label, size_t index)
+{
+    ASSERT_COMPILER(compiler);
+    assert(label < LABEL_KINDS_COUNT);
+
+    emitChar     (OUTPUT, '\t');
+    emit         (OUTPUT, mnemonic);
+    emit         (OUTPUT, " .L");
+    emit         (OUTPUT, LABEL_NAMES[label]);
+    emitChar     (OUTPUT, '_');
+    emitUnsigned (OUTPUT, index);
+    emitChar     (OUTPUT, '\n');
+}
+
+void putLabel(NativeCompiler* compiler, LabelKind label, size_t index)
+{
+    ASSERT_COMPILER(compiler);
+    assert(label < LABEL_KINDS_COUNT);
+
+    emit         (OUTPUT, ".L");
+    emit         (OUTPUT, LABEL_NAMES[label]);
+    emitChar     (OUTPUT, '_');
+    emitUnsigned (OUTPUT, index);
+    emit         (OUTPUT, ":\n");
+}
+
+// Names are letters only, so the prefix keeps them apart from the runtime and libc
+void putFunctionSymbol(NativeCompiler* compiler, const Function* function)
+{
+    ASSERT_COMPILER(compiler);
+    assert(function != nullptr);
+
+    emit(OUTPUT, FUNCTION_PREFIX);
+    emit(OUTPUT, getSymbolName(function->name));
+}
+
+void putOperand(NativeCompiler* compiler, Operand operand)
+{
+    ASSERT_COMPILER(compiler);
+
+    switch (operand.kind)
+    {
+        case XMM_OPERAND:
+        {
+            assert(operand.index <= SCRATCH_XMM);
+
+            emit         (OUTPUT, "xmm");
+            emitUnsigned (OUTPUT, operand.index);
+            break;
+        }
+
+        case VAR_OPERAND:
+        {
+            emit         (OUTPUT, "QWORD PTR [rbp-");
+            emitUnsigned (OUTPUT, (operand.index + 1) * VALUE_SIZE);
+            emitChar     (OUTPUT, ']');
+            break;
+        }
+
+        case STACK_OPERAND:
+        {
+            emit(OUTPUT, "QWORD PTR [rsp");
+
+            if (operand.index > 0)
+            {
+                emitChar     (OUTPUT, '+');
+                emitUnsigned (OUTPUT, operand.index * VALUE_SIZE);
+            }
+
+            emitChar(OUTPUT, ']');
+            break;
+        }
+
+        case ARGUMENT_OPERAND:
+        {
+            // Above the saved rbp and the return address
+            emit         (OUTPUT, "QWORD PTR [rbp+");
+            emitUnsigned (OUTPUT, 2 * VALUE_SIZE + operand.index * VALUE_SIZE);
+            emitChar     (OUTPUT, ']');
+            break;
+        }
+
+        case CONSTANT_OPERAND:
+        {
+            emit         (OUTPUT, "QWORD PTR .LC");
+            emitUnsigned (OUTPUT, operand.index);
+            emit         (OUTPUT, "[rip]");
+            break;
+        }
+
+        default:
+        {
+            assert(!"Invalid operand kind");
+            break;
+        }
+    }
+}
+
+void putComment(NativeCompiler* compiler, const char* text)
+{
+    ASSERT_COMPILER(compiler);
+    assert(text != nullptr);
+
+    if (!compiler->commentsEnabled) { return; }
+
+    emit     (OUTPUT, "\t# ");
+    emit     (OUTPUT, text);
+    emitChar (OUTPUT, '\n');
+}
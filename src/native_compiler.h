@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdio.h>
+#include "compact_tree.h"
+#include "compiler.h"
+
+//------------------------------------------------------------------------------
+// x86-64 back end. Writes GAS assembly (Intel syntax) for Linux, following the
+// System V calling convention: a function gets its first eight parameters in
+// xmm0-xmm7, the rest on the stack, and returns its value in xmm0. Variables
+// live in the function's frame at [rbp-8*(slot+1)].
+//
+// Expressions are evaluated on a stack of SSE registers, an expression at
+// depth d leaves its value in xmm<d>. Calls clobber every xmm register, so
+// the live ones are saved around them. accio, flagrate and riddikulus call
+// into the runtime (native_runtime.cpp), which also has the program's main:
+//     gcc program.s bin/native_runtime.o -o program
+//------------------------------------------------------------------------------
+enum OperandKind
+{
+    XMM_OPERAND,      // xmm<index>
+    VAR_OPERAND,      // variable with slot index in the frame
+    STACK_OPERAND,    // [rsp+8*index]
+    ARGUMENT_OPERAND, // index-th parameter passed on the stack
+    CONSTANT_OPERAND  // index-th number in the constant pool
+};
+
+struct Operand
+{
+    OperandKind kind;
+    size_t      index;
+};
+
+struct NativeCompiler
+{
+    SymbolTable*       table;
+    const CompactTree* tree;
+    Emitter            emitter;
+    bool               commentsEnabled;
+    Function*          curFunction;
+    size_t             frameSize;         // bytes of the current function's variables
+
+    double*            constants;
+    size_t             constantsCount;
+    size_t             constantsCapacity;
+
+    size_t             curCondLabel;
+    size_t             curLoopLabel;
+    size_t             funcCondLabel;     // first labels of the current function,
+    size_t             funcLoopLabel;     // riddikulus jumps to one of its labels
+    bool               randomJumps;
+
+    CompilerError      status;
+};
+
+void          construct (NativeCompiler* compiler, const CompactTree* tree, SymbolTable* table, bool commentsEnabled);
+void          destroy   (NativeCompiler* compiler);
+CompilerError compile   (NativeCompiler* compiler, const char* outputFile);
@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+//------------------------------------------------------------------------------
+// Runtime of the programs compiled by the native back end. It has the main
+// function and the built-ins that need the C library, and behaves like the
+// virtual machine does: flagrate prints with %lg, and a failed accio stops
+// the program with the same error message.
+//------------------------------------------------------------------------------
+extern "C"
+{
+    double potter_entry    ();
+    double potter_accio    ();
+    double potter_flagrate (double value);
+    int    potter_random   (int count);
+}
+
+int main()
+{
+    potter_entry();
+
+    return 0;
+}
+
+double potter_accio()
+{
+    double value = 0;
+
+    if (scanf("%lg", &value) != 1)
+    {
+        printf("RUNTIME ERROR: couldn't read a number from the input\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return value;
+}
+
+double potter_flagrate(double value)
+{
+    printf("%lg\n", value);
+
+    return value;
+}
+
+int potter_random(int count)
+{
+    return rand() % count;
+}
@@ -19,7 +19,8 @@
 #define REQUIRE_ID(id)                  if (!requireIdToken(parser, id))                  { return nullptr; }
 #define REQUIRE_KEYWORD(keyword, error) if (!requireKeywordToken(parser, keyword, error)) { return nullptr; }
 #define REQUIRE_NEW_LINES()             if (!requireNewLines(parser))                     { return nullptr; }
-#define REQUIRE_VAR_DECLARED(var)       if (getVarOffset(parser->curFunction, var) == -1)        \
+#define REQUIRE_VAR_DECLARED(var)       (var)->data.name.slot = getVarOffset(parser->curFunction, (var)->data.name.id); \
+                                        if ((var)->data.name.slot == NO_SLOT)                    \
                                         {                                                        \
                                             proceed(parser, -1);                                 \
                                             SYNTAX_ERROR(PARSE_ERROR_VARIABLE_UNDECLARED_USAGE); \
@@ -31,7 +32,7 @@ void   proceed             (Parser* parser);
 int    tokensLeft          (Parser* parser);
 bool   isEndReached        (Parser* parser);
 
-bool   requireIdToken      (Parser* parser, const char* id);
+bool   requireIdToken      (Parser* parser, SymbolId id);
 bool   requireKeywordToken (Parser* parser, KeywordCode keywordCode, ParseError error);
 bool   requireNewLines     (Parser* parser);
 
@@ -52,7 +53,7 @@ Node*  parseVDeclaration   (Parser* parser);
 Node*  parseAssignment     (Parser* parser);
 Node*  parseCall           (Parser* parser);
 Node*  parsePrint          (Parser* parser);
-Node*  parseStandardFunc   (Parser* parser, KeywordCode keywordCode);
+Node*  parseStandardFunc   (Parser* parser, KeywordCode keywordCode, SymbolId function);
 Node*  parseExprList       (Parser* parser);
 Node*  parseParamList      (Parser* parser);
 Node*  parseJump           (Parser* parser);
@@ -133,7 +134,7 @@ bool isEndReached(Parser* parser)
     return tokensLeft(parser) <= 1;
 }
 
-bool requireIdToken(Parser* parser, const char* id)
+bool requireIdToken(Parser* parser, SymbolId id)
 {
     ASSERT_PARSER(parser);
     CHECK_END_REACHED(false);
@@ -144,7 +145,7 @@ bool requireIdToken(Parser* parser, const char* id)
         return false;
     }
 
-    if (id != nullptr && strcmp(id, curToken(parser)->data.id) != 0)
+    if (id != NO_SYMBOL && !isId(curToken(parser), id))
     {
         syntaxError(parser, PARSE_ERROR_INVALID_ID);
         return false;
@@ -240,7 +241,7 @@ ParseError parseProgram(Parser* parser, SymbolTable* table, Node** root)
     parser->table = table;
 
     requireKeywordToken(parser, PROG_START_KEYWORD, PARSE_ERROR_NO_PROG_START);
-    requireIdToken(parser, nullptr);
+    requireIdToken(parser, NO_SYMBOL);
     requireNewLines(parser);
 
     *root = parseProgramBody(parser);
@@ -284,12 +285,12 @@ Node* parseDeclaration(Parser* parser)
     Node* declaration = newNode(DECL_TYPE, {}, nullptr, parseId(parser));
     if (declaration->right == nullptr) { SYNTAX_ERROR(PARSE_ERROR_ID_NEEDED); }
 
-    if (getFunction(parser->table, declaration->right->data.id) != nullptr)
+    if (getFunction(parser->table, declaration->right->data.name.id) != nullptr)
     {
         SYNTAX_ERROR(PARSE_ERROR_FUNCTION_SECOND_DECLARATION);
     }
 
-    parser->curFunction = pushFunction(parser->table, declaration->right->data.id);
+    parser->curFunction = pushFunction(parser->table, declaration->right->data.name.id);
 
     Node* params = parseParamList(parser);
 
@@ -476,7 +477,7 @@ Node* parseFactor(Parser* parser)
     {
         factor = parseNumber(parser);
     }
-    else
+    else if (isKeywordType(curToken(parser)))
     {
         switch (curToken(parser)->data.keywordCode)
         {
@@ -496,25 +497,25 @@ Node* parseFactor(Parser* parser)
                 factor = parseId(parser);
                 if (factor == nullptr) { SYNTAX_ERROR(PARSE_ERROR_DEREFERENCING_NO_VARIABLE); }
         
-                REQUIRE_VAR_DECLARED(factor->data.id);
+                REQUIRE_VAR_DECLARED(factor);
 
                 break;
             }
 
             case CALL_KEYWORD:  { factor = parseCall         (parser);                break; }
-            case FLOOR_KEYWORD: { factor = parseStandardFunc (parser, FLOOR_KEYWORD); break; }
-            case SQRT_KEYWORD:  { factor = parseStandardFunc (parser, SQRT_KEYWORD);  break; }
+            case FLOOR_KEYWORD: { factor = parseStandardFunc (parser, FLOOR_KEYWORD, FLOOR_SYMBOL); break; }
+            case SQRT_KEYWORD:  { factor = parseStandardFunc (parser, SQRT_KEYWORD,  SQRT_SYMBOL);  break; }
 
             case SCAN_KEYWORD:
             {
-                factor = newNode(CALL_TYPE, {}, NAME(KEYWORDS[SCAN_KEYWORD].name), nullptr);
+                factor = newNode(CALL_TYPE, {}, NAME(SCAN_SYMBOL), nullptr);
                 proceed(parser);
                 break;
             }
 
             case RAND_JUMP_KEYWORD:
             {
-                factor = newNode(CALL_TYPE, {}, NAME(KEYWORDS[RAND_JUMP_KEYWORD].name), nullptr);
+                factor = newNode(CALL_TYPE, {}, NAME(RAND_JUMP_SYMBOL), nullptr);
                 proceed(parser);
                 break;
             }
@@ -536,7 +537,7 @@ Node* parseVDeclaration(Parser* parser)
 
     if (!isIdType(curToken(parser))) { SYNTAX_ERROR(PARSE_ERROR_VARIABLE_DECLARATION_NO_ASSIGNMENT); }
 
-    const char* id = curToken(parser)->data.id;
+    SymbolId id = curToken(parser)->data.id;
     if (getVarOffset(parser->curFunction, id) != -1) { SYNTAX_ERROR(PARSE_ERROR_VARIABLE_SECOND_DECLARATION); }
 
     pushVariable(parser->curFunction, id);
@@ -560,7 +561,7 @@ Node* parseAssignment(Parser* parser)
     }
 
     Node* variable = parseId(parser);
-    REQUIRE_VAR_DECLARED(variable->data.id);
+    REQUIRE_VAR_DECLARED(variable);
     REQUIRE_KEYWORD(ASSGN_KEYWORD, PARSE_ERROR_VARIABLE_DECLARATION_NO_ASSIGNMENT);
 
     Node* expression = parseExpression(parser);
@@ -576,7 +577,7 @@ Node* parseCall(Parser* parser)
     if (!isKeyword(curToken(parser), CALL_KEYWORD)) { return nullptr; }
     proceed(parser);
 
-    REQUIRE_ID(nullptr);
+    REQUIRE_ID(NO_SYMBOL);
     proceed(parser, -1);
 
     Node* function = parseId(parser);
@@ -609,10 +610,10 @@ Node* parsePrint(Parser* parser)
 
     Node* exprList = newNode(LIST_TYPE, {}, expression, nullptr);
 
-    return newNode(CALL_TYPE, {}, NAME(KEYWORDS[PRINT_KEYWORD].name), exprList);
+    return newNode(CALL_TYPE, {}, NAME(PRINT_SYMBOL), exprList);
 }
 
-Node* parseStandardFunc(Parser* parser, KeywordCode keywordCode)
+Node* parseStandardFunc(Parser* parser, KeywordCode keywordCode, SymbolId function)
 {
     ASSERT_PARSER(parser);
     
@@ -628,7 +629,7 @@ Node* parseStandardFunc(Parser* parser, KeywordCode keywordCode)
 
     Node* exprList = newNode(LIST_TYPE, {}, expression, nullptr);
 
-    return newNode(CALL_TYPE, {}, NAME(KEYWORDS[keywordCode].name), exprList);
+    return newNode(CALL_TYPE, {}, NAME(function), exprList);
 }
 
 Node* parseFloor(Parser* parser)
@@ -647,7 +648,7 @@ Node* parseFloor(Parser* parser)
 
     Node* exprList = newNode(LIST_TYPE, {}, expression, nullptr);
 
-    return newNode(CALL_TYPE, {}, NAME(KEYWORDS[FLOOR_KEYWORD].name), exprList);
+    return newNode(CALL_TYPE, {}, NAME(FLOOR_SYMBOL), exprList);
 }
 
 Node* parseSqrt(Parser* parser)
@@ -666,7 +667,7 @@ Node* parseSqrt(Parser* parser)
 
     Node* exprList = newNode(LIST_TYPE, {}, expression, nullptr);
 
-    return newNode(CALL_TYPE, {}, NAME(KEYWORDS[SQRT_KEYWORD].name), exprList);
+    return newNode(CALL_TYPE, {}, NAME(SQRT_SYMBOL), exprList);
 }
 
 Node* parseExprList(Parser* parser)
@@ -699,7 +700,7 @@ Node* parseParamList(Parser* parser)
     if (param == nullptr) { return nullptr; }
 
     Node* prevParam = param;
-    pushParameter(parser->curFunction, prevParam->data.id);
+    prevParam->data.name.slot = pushParameter(parser->curFunction, prevParam->data.name.id);
 
     while (isKeyword(curToken(parser), COMMA_KEYWORD))
     {
@@ -709,7 +710,7 @@ Node* parseParamList(Parser* parser)
         if (prevParam->right == nullptr) { SYNTAX_ERROR(PARSE_ERROR_FUNCTION_PARAMS_NEEDED); }
 
         prevParam = prevParam->right;
-        pushParameter(parser->curFunction, prevParam->data.id);
+        prevParam->data.name.slot = pushParameter(parser->curFunction, prevParam->data.name.id);
     }
 
     return param;
@@ -801,8 +802,8 @@ Node* parseId(Parser* parser)
 
     if (!isIdType(curToken(parser))) { return nullptr; }
 
-    const char* id = curToken(parser)->data.id;
+    SymbolId id = curToken(parser)->data.id;
     proceed(parser);
 
-    return newNode(NAME_TYPE, { .id = id }, nullptr, nullptr);
+    return NAME(id);
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include <assert.h>
+#include "pass_manager.h"
+
+const size_t DEFAULT_PASSES_CAPACITY = 8;
+
+#define ASSERT_MANAGER(manager) assert(manager         != nullptr); \
+                                assert(manager->passes != nullptr);
+
+void construct(PassManager* manager, bool verifyEnabled)
+{
+    assert(manager != nullptr);
+
+    manager->passes = (Pass*) calloc(DEFAULT_PASSES_CAPACITY, sizeof(Pass));
+    assert(manager->passes != nullptr);
+
+    manager->passesCount    = 0;
+    manager->passesCapacity = DEFAULT_PASSES_CAPACITY;
+    manager->verifyEnabled  = verifyEnabled;
+}
+
+void destroy(PassManager* manager)
+{
+    ASSERT_MANAGER(manager);
+
+    free(manager->passes);
+
+    manager->passes         = nullptr;
+    manager->passesCount    = 0;
+    manager->passesCapacity = 0;
+}
+
+void addPass(PassManager* manager, const char* name, PassFunction run, void* stats)
+{
+    ASSERT_MANAGER(manager);
+    assert(name != nullptr);
+    assert(run  != nullptr);
+
+    if (manager->passesCount == manager->passesCapacity)
+    {
+        manager->passesCapacity *= 2;
+        manager->passes = (Pass*) realloc(manager->passes, manager->passesCapacity * sizeof(Pass));
+        assert(manager->passes != nullptr);
+    }
+
+    manager->passes[manager->passesCount++] = { name, run, stats };
+}
+
+IrError runPasses(PassManager* manager, IrProgram* program)
+{
+    ASSERT_MANAGER(manager);
+    assert(program != nullptr);
+
+    for (size_t i = 0; i < manager->passesCount; i++)
+    {
+        const Pass* pass = &manager->passes[i];
+        pass->run(program, pass->stats);
+
+        if (manager->verifyEnabled)
+        {
+            IrError error = verifyProgram(program, pass->name);
+            if (error != IR_NO_ERROR) { return error; }
+        }
+    }
+
+    return IR_NO_ERROR;
+}
+
+IrError verifyProgram(const IrProgram* program, const char* stage)
+{
+    assert(program != nullptr);
+    assert(stage   != nullptr);
+
+    for (size_t i = 0; i < program->functionsCount; i++)
+    {
+        IrError error = verify(program, &program->functions[i]);
+
+        if (error != IR_NO_ERROR)
+        {
+            printf("IR ERROR after %s: %s: %s\n", stage,
+                   getSymbolName(program->functions[i].symbols->name), errorString(error));
+            return error;
+        }
+    }
+
+    return IR_NO_ERROR;
+}
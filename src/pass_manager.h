@@ -0,0 +1,35 @@
+#pragma once
+
+#include "ir.h"
+
+//------------------------------------------------------------------------------
+// Runs the optimizations over the IR one after another, in the order they are
+// added. Every pass gets the whole program and a pointer to its own stats,
+// which the pass manager doesn't look into. With verification on, the program
+// is checked after each pass and the first broken one stops the rest.
+//------------------------------------------------------------------------------
+typedef void (*PassFunction) (IrProgram* program, void* stats);
+
+struct Pass
+{
+    const char*  name;
+    PassFunction run;
+    void*        stats;
+};
+
+struct PassManager
+{
+    Pass*  passes;
+    size_t passesCount;
+    size_t passesCapacity;
+
+    bool   verifyEnabled;
+};
+
+void    construct     (PassManager* manager, bool verifyEnabled);
+void    destroy       (PassManager* manager);
+
+void    addPass       (PassManager* manager, const char* name, PassFunction run, void* stats);
+IrError runPasses     (PassManager* manager, IrProgram* program);
+
+IrError verifyProgram (const IrProgram* program, const char* stage);
@@ -0,0 +1,287 @@
+#include <assert.h>
+#include "peephole.h"
+
+const size_t NO_POSITION = SIZE_MAX;
+
+typedef bool (*RuleFunction) (InstructionList* code, size_t position);
+
+bool   removeUnreachableCode (InstructionList* code, size_t position);
+bool   removeJumpToNext      (InstructionList* code, size_t position);
+bool   shortenJumpChain      (InstructionList* code, size_t position);
+bool   removePushPop         (InstructionList* code, size_t position);
+bool   forwardStoredConstant (InstructionList* code, size_t position);
+
+void   compactCode           (InstructionList* code);
+size_t countCode             (const InstructionList* code);
+size_t nextInstruction       (const InstructionList* code, size_t position);
+size_t findLabel             (const InstructionList* code, LabelKind label, size_t index);
+size_t jumpTargetCode        (const InstructionList* code, LabelKind label, size_t index);
+bool   isJump                (Opcode opcode);
+bool   isCode                (const InstructionList* code, size_t position, Opcode opcode);
+bool   sameLocation          (const Instruction* first, const Instruction* second);
+
+static const RuleFunction RULES[PEEPHOLE_RULES_COUNT] = {
+    removeUnreachableCode,
+    removeJumpToNext,
+    shortenJumpChain,
+    removePushPop,
+    forwardStoredConstant
+};
+
+void optimizeCode(InstructionList* code, PeepholeStats* stats)
+{
+    assert(code  != nullptr);
+    assert(stats != nullptr);
+
+    size_t codeCount = countCode(code);
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+
+        for (size_t position = 0; position < code->count; position++)
+        {
+            for (size_t rule = 0; rule < PEEPHOLE_RULES_COUNT; rule++)
+            {
+                if (code->instructions[position].kind != CODE_INSTRUCTION) { break; }
+
+                if (RULES[rule](code, position))
+                {
+                    stats->hits[rule]++;
+                    changed = true;
+                }
+            }
+        }
+
+        compactCode(code);
+    }
+
+    stats->removedInstructions += codeCount - countCode(code);
+}
+
+// Nothing jumps between a jump and the next label, rndjmp also only lands on labels
+bool removeUnreachableCode(InstructionList* code, size_t position)
+{
+    assert(code != nullptr);
+
+    Opcode opcode = code->instructions[position].opcode;
+    if (opcode != OP_JMP && opcode != OP_RET && opcode != OP_HLT) { return false; }
+
+    bool removed = false;
+    for (size_t i = position + 1; i < code->count && code->instructions[i].kind != LABEL_INSTRUCTION; i++)
+    {
+        if (code->instructions[i].kind == CODE_INSTRUCTION) { removed = true; }
+
+        if (code->instructions[i].kind != BLANK_LINE_INSTRUCTION)
+        {
+            code->instructions[i].kind = DELETED_INSTRUCTION;
+        }
+    }
+
+    return removed;
+}
+
+bool removeJumpToNext(InstructionList* code, size_t position)
+{
+    assert(code != nullptr);
+
+    Instruction* jump = &code->instructions[position];
+    if (jump->opcode != OP_JMP) { return false; }
+
+    for (size_t i = position + 1; i < code->count && code->instructions[i].kind != CODE_INSTRUCTION; i++)
+    {
+        const Instruction* label = &code->instructions[i];
+
+        if (label->kind == LABEL_INSTRUCTION && label->label == jump->label && label->index == jump->index)
+        {
+            jump->kind = DELETED_INSTRUCTION;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// Follows the whole chain at once. Structured code has no jump cycles, but if
+// the chain leads into one it's left alone, so that the pass still finishes.
+//------------------------------------------------------------------------------
+bool shortenJumpChain(InstructionList* code, size_t position)
+{
+    assert(code != nullptr);
+
+    Instruction* jump = &code->instructions[position];
+    if (!isJump(jump->opcode)) { return false; }
+
+    LabelKind label  = jump->label;
+    size_t    index  = jump->index;
+    size_t    target = jumpTargetCode(code, label, index);
+
+    if (!isCode(code, target, OP_JMP)) { return false; }
+
+    for (size_t hops = 0; isCode(code, target, OP_JMP); hops++)
+    {
+        if (hops == code->count) { return false; }
+
+        label  = code->instructions[target].label;
+        index  = code->instructions[target].index;
+        target = jumpTargetCode(code, label, index);
+
+        if (label == jump->label && index == jump->index) { return false; }
+    }
+
+    jump->label = label;
+    jump->index = index;
+
+    return true;
+}
+
+bool removePushPop(InstructionList* code, size_t position)
+{
+    assert(code != nullptr);
+
+    Instruction* push = &code->instructions[position];
+    if (push->opcode != OP_PUSH_REG && push->opcode != OP_PUSH_MEM) { return false; }
+
+    size_t next = nextInstruction(code, position);
+    if (next == NO_POSITION) { return false; }
+
+    Instruction* pop = &code->instructions[next];
+    if (pop->opcode != (push->opcode == OP_PUSH_REG ? OP_POP_REG : OP_POP_MEM) || !sameLocation(push, pop))
+    {
+        return false;
+    }
+
+    push->kind = DELETED_INSTRUCTION;
+    pop->kind  = DELETED_INSTRUCTION;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// push n / pop [x] / push [x] becomes push n / pop [x] / push n. The stack CPU
+// has no dup, so the store has to stay, but the reload no longer goes through
+// memory.
+//------------------------------------------------------------------------------
+bool forwardStoredConstant(InstructionList* code, size_t position)
+{
+    assert(code != nullptr);
+
+    const Instruction* push = &code->instructions[position];
+    if (push->opcode != OP_PUSH_NUMBER) { return false; }
+
+    size_t store = nextInstruction(code, position);
+    if (!isCode(code, store, OP_POP_MEM)) { return false; }
+
+    size_t reload = nextInstruction(code, store);
+    if (!isCode(code, reload, OP_PUSH_MEM) || !sameLocation(&code->instructions[store], &code->instructions[reload]))
+    {
+        return false;
+    }
+
+    code->instructions[reload].opcode = OP_PUSH_NUMBER;
+    code->instructions[reload].number = push->number;
+
+    return true;
+}
+
+void compactCode(InstructionList* code)
+{
+    assert(code != nullptr);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < code->count; i++)
+    {
+        if (code->instructions[i].kind != DELETED_INSTRUCTION)
+        {
+            code->instructions[kept++] = code->instructions[i];
+        }
+    }
+
+    code->count = kept;
+}
+
+size_t countCode(const InstructionList* code)
+{
+    assert(code != nullptr);
+
+    size_t count = 0;
+    for (size_t i = 0; i < code->count; i++)
+    {
+        if (code->instructions[i].kind == CODE_INSTRUCTION) { count++; }
+    }
+
+    return count;
+}
+
+// Next code instruction if nothing but comments separate it from this one
+size_t nextInstruction(const InstructionList* code, size_t position)
+{
+    assert(code != nullptr);
+
+    for (size_t i = position + 1; i < code->count; i++)
+    {
+        InstructionKind kind = code->instructions[i].kind;
+
+        if (kind == CODE_INSTRUCTION)  { return i;           }
+        if (kind == LABEL_INSTRUCTION) { return NO_POSITION; }
+    }
+
+    return NO_POSITION;
+}
+
+size_t findLabel(const InstructionList* code, LabelKind label, size_t index)
+{
+    assert(code != nullptr);
+
+    for (size_t i = 0; i < code->count; i++)
+    {
+        const Instruction* instruction = &code->instructions[i];
+
+        if (instruction->kind == LABEL_INSTRUCTION && instruction->label == label && instruction->index == index)
+        {
+            return i;
+        }
+    }
+
+    return NO_POSITION;
+}
+
+// First code instruction at the label, past any other labels
+size_t jumpTargetCode(const InstructionList* code, LabelKind label, size_t index)
+{
+    assert(code != nullptr);
+
+    size_t position = findLabel(code, label, index);
+    if (position == NO_POSITION) { return NO_POSITION; }
+
+    for (size_t i = position + 1; i < code->count; i++)
+    {
+        if (code->instructions[i].kind == CODE_INSTRUCTION) { return i; }
+    }
+
+    return NO_POSITION;
+}
+
+bool isJump(Opcode opcode)
+{
+    return opcode >= OP_JMP && opcode <= OP_JBE;
+}
+
+bool isCode(const InstructionList* code, size_t position, Opcode opcode)
+{
+    assert(code != nullptr);
+
+    return position != NO_POSITION && code->instructions[position].opcode == opcode;
+}
+
+bool sameLocation(const Instruction* first, const Instruction* second)
+{
+    assert(first  != nullptr);
+    assert(second != nullptr);
+
+    bool isMemory = first->opcode == OP_PUSH_MEM || first->opcode == OP_POP_MEM;
+
+    return first->reg == second->reg && (!isMemory || first->offset == second->offset);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "compiler.h"
+
+//------------------------------------------------------------------------------
+// Peephole pass over a function's code. The rules are tried at every
+// instruction until none of them changes anything. Labels are never removed,
+// riddikulus may jump to any of them.
+//------------------------------------------------------------------------------
+enum PeepholeRule
+{
+    UNREACHABLE_CODE_RULE, // code after jmp, ret or hlt up to the next label
+    JUMP_TO_NEXT_RULE,     // jmp to the label right after it
+    JUMP_CHAIN_RULE,       // jump to a jmp goes to that jmp's target instead
+    PUSH_POP_RULE,         // push and pop of the same location
+    STORED_CONSTANT_RULE,  // reload of a number that was just stored is the number itself
+
+    PEEPHOLE_RULES_COUNT
+};
+
+static const char* PEEPHOLE_RULE_NAMES[PEEPHOLE_RULES_COUNT] = {
+    "unreachable code removed",
+    "jumps to the next label removed",
+    "jump chains shortened",
+    "push/pop pairs removed",
+    "reloads of stored numbers replaced"
+};
+
+struct PeepholeStats
+{
+    size_t hits[PEEPHOLE_RULES_COUNT];
+    size_t removedInstructions;
+};
+
+void optimizeCode (InstructionList* code, PeepholeStats* stats);
@@ -4,43 +4,59 @@
 #include <string.h>
 #include "symbol_table.h"
 
-const double REALLOC_MULTIPLIER     = 1.8;
-const size_t DEFAULT_FUNCS_CAPACITY = 8;
-const size_t DEFAULT_VARS_CAPACITY  = 16;
+const double   REALLOC_MULTIPLIER           = 1.8;
+const size_t   DEFAULT_FUNCS_CAPACITY       = 8;
+const size_t   DEFAULT_VARS_CAPACITY        = 16;
+const size_t   DEFAULT_FUNCS_TABLE_CAPACITY = 16; // must be a power of two
+const size_t   DEFAULT_VARS_TABLE_CAPACITY  = 32; // must be a power of two
 
-void reallocFunctions(SymbolTable* table);
-void reallocVariables(Function* function);
+const uint32_t FIBONACCI_MULTIPLIER         = 2654435769u;
 
-void construct(SymbolTable* table)
+void       reallocFunctions   (SymbolTable* table);
+void       reallocVariables   (Function* function);
+void       rehashFunctions    (SymbolTable* table);
+void       rehashVariables    (Function* function);
+
+uint32_t   hashSymbol         (SymbolId symbol);
+void       insertIndex        (TableIndex* hashTable, size_t capacity, uint32_t hash, TableIndex index);
+
+void construct(SymbolTable* table, Arena* arena)
 {
     assert(table != nullptr);
+    assert(arena != nullptr);
 
-    table->functions = (Function*) calloc(DEFAULT_FUNCS_CAPACITY, sizeof(Function));
-    assert(table->functions != nullptr);
+    table->functions      = (Function*)   calloc(DEFAULT_FUNCS_CAPACITY,       sizeof(Function));
+    table->functionsTable = (TableIndex*) malloc(DEFAULT_FUNCS_TABLE_CAPACITY * sizeof(TableIndex));
+    assert(table->functions      != nullptr);
+    assert(table->functionsTable != nullptr);
 
-    table->functionsCount    = 0;
-    table->functionsCapacity = DEFAULT_FUNCS_CAPACITY;
+    memset(table->functionsTable, 0xFF, DEFAULT_FUNCS_TABLE_CAPACITY * sizeof(TableIndex));
+
+    table->functionsCount         = 0;
+    table->functionsCapacity      = DEFAULT_FUNCS_CAPACITY;
+    table->functionsTableCapacity = DEFAULT_FUNCS_TABLE_CAPACITY;
+    table->arena                  = arena;
 }
 
 void destroy(SymbolTable* table)
 {
     assert(table != nullptr);
 
-    for (size_t i = 0; i < table->functionsCount; i++)
-    {
-        free(table->functions[i].vars);
-    }
+    if (table->functions      != nullptr) { free(table->functions); }
+    if (table->functionsTable != nullptr) { free(table->functionsTable); }
 
-    if (table->functions != nullptr) { free(table->functions); }
-
-    table->functionsCount    = 0;
-    table->functionsCapacity = 0;
+    table->functions              = nullptr;
+    table->functionsTable         = nullptr;
+    table->functionsCount         = 0;
+    table->functionsCapacity      = 0;
+    table->functionsTableCapacity = 0;
+    table->arena                  = nullptr;
 }
 
-Function* pushFunction(SymbolTable* table, const char* function)
+Function* pushFunction(SymbolTable* table, SymbolId function)
 {
     assert(table            != nullptr);
-    assert(function         != nullptr);
+    assert(function         != NO_SYMBOL);
     assert(table->functions != nullptr);
 
     while (table->functionsCount >= table->functionsCapacity)
@@ -48,42 +64,68 @@ Function* pushFunction(SymbolTable* table, const char* function)
         reallocFunctions(table);
     }
 
-    table->functions[table->functionsCount].name         = function;
-    table->functions[table->functionsCount].vars         = (char**) calloc(DEFAULT_VARS_CAPACITY, sizeof(char*));
-    table->functions[table->functionsCount].varsCapacity = DEFAULT_VARS_CAPACITY;
+    Function* newFunction = &(table->functions[table->functionsCount]);
+
+    newFunction->name              = function;
+    newFunction->arena             = table->arena;
+    newFunction->vars              = (SymbolId*)   allocate(table->arena, DEFAULT_VARS_CAPACITY       * sizeof(SymbolId));
+    newFunction->varsTable         = (TableIndex*) allocate(table->arena, DEFAULT_VARS_TABLE_CAPACITY * sizeof(TableIndex));
+    newFunction->varsCapacity      = DEFAULT_VARS_CAPACITY;
+    newFunction->varsTableCapacity = DEFAULT_VARS_TABLE_CAPACITY;
+    newFunction->varsCount         = 0;
+    newFunction->paramsCount       = 0;
+    newFunction->frameSize         = 0;
+    newFunction->unsharedFrameSize = 0;
+    newFunction->registerValues    = 0;
+
+    memset(newFunction->varsTable, 0xFF, DEFAULT_VARS_TABLE_CAPACITY * sizeof(TableIndex));
 
     table->functionsCount++;
 
-    return &(table->functions[table->functionsCount - 1]);
+    if (2 * table->functionsCount > table->functionsTableCapacity)
+    {
+        rehashFunctions(table);
+    }
+    else
+    {
+        insertIndex(table->functionsTable, table->functionsTableCapacity, hashSymbol(function), 
+                    (TableIndex) (table->functionsCount - 1));
+    }
+
+    return newFunction;
 }
 
-Function* getFunction(SymbolTable* table, const char* function)
+Function* getFunction(SymbolTable* table, SymbolId function)
 {
-    assert(table    != nullptr);
-    assert(function != nullptr);
+    assert(table            != nullptr);
+    assert(function         != NO_SYMBOL);
     assert(table->functions != nullptr);
 
-    for (size_t i = 0; i < table->functionsCount; i++)
+    size_t mask = table->functionsTableCapacity - 1;
+
+    for (size_t i = hashSymbol(function) & mask; table->functionsTable[i] != NO_INDEX; i = (i + 1) & mask)
     {
-        if (strcmp(table->functions[i].name, function) == 0)
+        if (table->functions[table->functionsTable[i]].name == function)
         {
-            return &(table->functions[i]);
+            return &(table->functions[table->functionsTable[i]]);
         }
     }
 
     return nullptr;
 }
 
-void pushParameter(Function* function, const char* parameter)
+int pushParameter(Function* function, SymbolId parameter)
 {
-    pushVariable(function, parameter);
+    int offset = pushVariable(function, parameter);
     function->paramsCount++;
+
+    return offset;
 }
 
-void pushVariable(Function* function, const char* variable)
+int pushVariable(Function* function, SymbolId variable)
 {
     assert(function       != nullptr);
-    assert(variable       != nullptr);
+    assert(variable       != NO_SYMBOL);
     assert(function->vars != nullptr);
 
     while (function->varsCount >= function->varsCapacity)
@@ -91,22 +133,36 @@ void pushVariable(Function* function, const char* variable)
         reallocVariables(function);
     }
 
-    function->vars[function->varsCount] = (char*) variable;
+    function->vars[function->varsCount] = variable;
 
     function->varsCount++;
+
+    if (2 * function->varsCount > function->varsTableCapacity)
+    {
+        rehashVariables(function);
+    }
+    else
+    {
+        insertIndex(function->varsTable, function->varsTableCapacity, hashSymbol(variable), 
+                    (TableIndex) (function->varsCount - 1));
+    }
+
+    return (int) function->varsCount - 1;
 }
 
-int getVarOffset(Function* function, const char* variable)
+int getVarOffset(Function* function, SymbolId variable)
 {
     assert(function       != nullptr);
-    assert(variable       != nullptr);
+    assert(variable       != NO_SYMBOL);
     assert(function->vars != nullptr);
 
-    for (size_t i = 0; i < function->varsCount; i++)
+    size_t mask = function->varsTableCapacity - 1;
+
+    for (size_t i = hashSymbol(variable) & mask; function->varsTable[i] != NO_INDEX; i = (i + 1) & mask)
     {
-        if (strcmp(function->vars[i], variable) == 0)
+        if (function->vars[function->varsTable[i]] == variable)
         {
-            return i;
+            return (int) function->varsTable[i];
         }
     }
 
@@ -128,11 +184,77 @@ void reallocVariables(Function* function)
     assert(function       != nullptr);
     assert(function->vars != nullptr);
 
+    size_t oldCapacity = function->varsCapacity;
+
     function->varsCapacity *= REALLOC_MULTIPLIER;
-    function->vars = (char**) realloc(function->vars, function->varsCapacity * sizeof(char*));
+    function->vars = (SymbolId*) reallocate(function->arena, function->vars,
+                                            oldCapacity            * sizeof(SymbolId),
+                                            function->varsCapacity * sizeof(SymbolId));
     assert(function->vars != nullptr);
 }
 
+void rehashFunctions(SymbolTable* table)
+{
+    assert(table                 != nullptr);
+    assert(table->functionsTable != nullptr);
+
+    table->functionsTableCapacity *= 2;
+    table->functionsTable = (TableIndex*) realloc(table->functionsTable, table->functionsTableCapacity * sizeof(TableIndex));
+    assert(table->functionsTable != nullptr);
+
+    memset(table->functionsTable, 0xFF, table->functionsTableCapacity * sizeof(TableIndex));
+
+    for (size_t i = 0; i < table->functionsCount; i++)
+    {
+        insertIndex(table->functionsTable, table->functionsTableCapacity, hashSymbol(table->functions[i].name), 
+                    (TableIndex) i);
+    }
+}
+
+void rehashVariables(Function* function)
+{
+    assert(function            != nullptr);
+    assert(function->varsTable != nullptr);
+
+    size_t oldCapacity = function->varsTableCapacity;
+
+    function->varsTableCapacity *= 2;
+    function->varsTable = (TableIndex*) reallocate(function->arena, function->varsTable,
+                                                   oldCapacity                 * sizeof(TableIndex),
+                                                   function->varsTableCapacity * sizeof(TableIndex));
+    assert(function->varsTable != nullptr);
+
+    memset(function->varsTable, 0xFF, function->varsTableCapacity * sizeof(TableIndex));
+
+    for (size_t i = 0; i < function->varsCount; i++)
+    {
+        insertIndex(function->varsTable, function->varsTableCapacity, hashSymbol(function->vars[i]), 
+                    (TableIndex) i);
+    }
+}
+
+uint32_t hashSymbol(SymbolId symbol)
+{
+    uint32_t hash = symbol * FIBONACCI_MULTIPLIER;
+
+    return hash ^ (hash >> 16);
+}
+
+void insertIndex(TableIndex* hashTable, size_t capacity, uint32_t hash, TableIndex index)
+{
+    assert(hashTable != nullptr);
+
+    size_t mask = capacity - 1;
+    size_t i    = hash & mask;
+
+    while (hashTable[i] != NO_INDEX)
+    {
+        i = (i + 1) & mask;
+    }
+
+    hashTable[i] = index;
+}
+
 void dump(SymbolTable* table)
 {
     assert(table != nullptr);
@@ -155,17 +277,25 @@ void dump(SymbolTable* table)
             Function* function = &(table->functions[i]);
             printf("{ name='%s', varsCapacity=%zu, varsCount=%zu, paramsCount=%zu, \n                  "
                    "  vars=[",
-                   function->name, 
+                   getSymbolName(function->name), 
                    function->varsCapacity,
                    function->varsCount,
                    function->paramsCount);
 
             for (size_t j = 0; j < function->varsCount; j++)
             {
-                printf("'%s', ", function->vars[j]);
+                printf("'%s', ", getSymbolName(function->vars[j]));
+            }
+
+            printf("\b\b]");
+
+            if (function->frameSize != 0)
+            {
+                printf(", frameSize=%zu, unsharedFrameSize=%zu, registerValues=%zu",
+                       function->frameSize, function->unsharedFrameSize, function->registerValues);
             }
 
-            printf("\b\b] }");
+            printf(" }");
 
             if (i < table->functionsCount - 1)
             {
@@ -1,31 +1,56 @@
 #pragma once
 
 #include <stdlib.h>
+#include <stdint.h>
+#include "interner.h"
+#include "arena.h"
+
+//------------------------------------------------------------------------------
+// Both functions and variables are kept in insertion order (a variable's index
+// is its frame offset) and additionally indexed by open addressing hash tables
+// of those indices, keyed by symbol id. NO_INDEX marks a free slot.
+//------------------------------------------------------------------------------
+typedef uint32_t TableIndex;
+
+static const TableIndex NO_INDEX = UINT32_MAX;
 
 struct Function
 {
-    const char* name;
+    SymbolId    name;
 
-    char**      vars;
+    Arena*      arena;       // vars and varsTable are allocated from here
+    SymbolId*   vars;
     size_t      varsCapacity;
     size_t      varsCount;   // local variables count (including parameters!)
     size_t      paramsCount; // parameters count
+
+    size_t      frameSize;         // cells enter makes for it, 0 until compiled to stack code
+    size_t      unsharedFrameSize; // what it would be with a slot for every stored value
+    size_t      registerValues;    // stored values kept in registers instead of the frame
+
+    TableIndex* varsTable;
+    size_t      varsTableCapacity;
 };
 
 struct SymbolTable
 {
-    Function* functions;
-    size_t    functionsCapacity;
-    size_t    functionsCount;
+    Function*   functions;
+    size_t      functionsCapacity;
+    size_t      functionsCount;
+
+    TableIndex* functionsTable;
+    size_t      functionsTableCapacity;
+
+    Arena*      arena;
 };
 
-void      construct     (SymbolTable* table);
+void      construct     (SymbolTable* table, Arena* arena);
 void      destroy       (SymbolTable* table);
 void      dump          (SymbolTable* table);
 
-Function* pushFunction  (SymbolTable* table, const char* function);
-Function* getFunction   (SymbolTable* table, const char* function);
+Function* pushFunction  (SymbolTable* table, SymbolId function);
+Function* getFunction   (SymbolTable* table, SymbolId function);
 
-void      pushParameter (Function* function, const char* parameter);
-void      pushVariable  (Function* function, const char* variable);
-int       getVarOffset  (Function* function, const char* variable);
+int       pushParameter (Function* function, SymbolId parameter);
+int       pushVariable  (Function* function, SymbolId variable);
+int       getVarOffset  (Function* function, SymbolId variable);
@@ -82,7 +82,7 @@ struct Keyword
 
 static const char* MAIN_FUNCTION_NAME = "love";
 
-static const Keyword KEYWORDS[KEYWORDS_COUNT] = {
+static constexpr Keyword KEYWORDS[KEYWORDS_COUNT] = {
     { "Godric's-Hollow", 15, PROG_START_KEYWORD    },
     { "Privet-Drive",    12, PROG_END_KEYWORD      },
     { "\n",              1,  NEW_LINE_KEYWORD      },
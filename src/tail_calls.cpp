@@ -0,0 +1,385 @@
+#include <assert.h>
+#include "tail_calls.h"
+
+#define INSTRUCTION(value) (function->instructions[value])
+#define BLOCK(block)       (function->blocks[block])
+
+//------------------------------------------------------------------------------
+// Return that becomes a jump. operation is the add or mul of an accumulated
+// one, NO_VALUE for a plain tail call.
+//------------------------------------------------------------------------------
+struct TailReturn
+{
+    IrValue ret;
+    IrValue call;
+    IrValue operation;
+};
+
+struct Recursion
+{
+    IrFunction* function;
+    uint32_t    index;       // in the symbol table
+
+    TailReturn* returns;
+    size_t      returnsCount;
+
+    IrOpcode    operation;   // IR_ADD or IR_MUL if accumulated
+    bool        accumulated;
+
+    IrBlockId   header;
+    IrValue*    params;      // phis of the parameters in the header
+    IrValue     accumulator; // phi in the header
+    IrValue     zero;        // what a return without a value accumulates, NO_VALUE until needed
+};
+
+void    eliminateInFunction (IrProgram* program, uint32_t index, TailCallStats* stats);
+size_t  findTailReturns     (Recursion* recursion, const uint32_t* uses);
+bool    matchTailReturn     (const Recursion* recursion, IrValue ret, const uint32_t* uses, TailReturn* tail);
+bool    isTailCall          (const Recursion* recursion, IrValue value, IrValue ret, const uint32_t* uses);
+void    addHeader           (IrProgram* program, Recursion* recursion);
+void    convertTailReturn   (IrProgram* program, Recursion* recursion, const TailReturn* tail);
+void    accumulateReturn    (IrProgram* program, Recursion* recursion, IrValue ret);
+IrValue addEntryConst       (IrProgram* program, Recursion* recursion, double number);
+
+void eliminateTailCalls(IrProgram* program, void* stats)
+{
+    assert(program != nullptr);
+    assert(stats   != nullptr);
+
+    for (size_t i = 0; i < program->functionsCount; i++)
+    {
+        eliminateInFunction(program, (uint32_t) i, (TailCallStats*) stats);
+    }
+}
+
+void eliminateInFunction(IrProgram* program, uint32_t index, TailCallStats* stats)
+{
+    assert(program != nullptr);
+    assert(stats   != nullptr);
+
+    IrFunction* function = &program->functions[index];
+    if (function->inMemory || function->blocksCount == 0) { return; }
+
+    Recursion recursion = {};
+    recursion.function = function;
+    recursion.index    = index;
+
+    uint32_t* uses = (uint32_t*) calloc(function->instructionsCount + 1, sizeof(uint32_t));
+    recursion.returns = (TailReturn*) calloc(function->instructionsCount + 1, sizeof(TailReturn));
+    recursion.params  = (IrValue*) calloc(function->symbols->paramsCount + 1, sizeof(IrValue));
+    assert(uses              != nullptr);
+    assert(recursion.returns != nullptr);
+    assert(recursion.params  != nullptr);
+
+    countUses(function, uses, nullptr);
+
+    if (findTailReturns(&recursion, uses) > 0)
+    {
+        // Returns are found before the header takes the entry's code, their instructions stay where they are
+        addHeader(program, &recursion);
+
+        for (size_t i = 0; i < recursion.returnsCount; i++)
+        {
+            convertTailReturn(program, &recursion, &recursion.returns[i]);
+        }
+
+        for (IrValue value = 0; value < function->instructionsCount && recursion.accumulated; value++)
+        {
+            bool converted = false;
+            for (size_t i = 0; i < recursion.returnsCount; i++)
+            {
+                if (recursion.returns[i].ret == value) { converted = true; }
+            }
+
+            if (!converted && INSTRUCTION(value).block != NO_BLOCK && INSTRUCTION(value).opcode == IR_RETURN)
+            {
+                accumulateReturn(program, &recursion, value);
+            }
+        }
+
+        removeTrivialPhis(function);
+
+        stats->tailCalls += recursion.returnsCount;
+
+        if (recursion.accumulated)
+        {
+            stats->accumulatedFunctions++;
+
+            for (size_t i = 0; i < recursion.returnsCount; i++)
+            {
+                if (recursion.returns[i].operation != NO_VALUE) { stats->accumulatedCalls++; }
+            }
+        }
+    }
+
+    free(uses);
+    free(recursion.returns);
+    free(recursion.params);
+}
+
+//------------------------------------------------------------------------------
+// The accumulator is only worth it if some return uses it, and only possible
+// if all of them combine with the same operator. With mixed operators only
+// the plain tail calls are taken.
+//------------------------------------------------------------------------------
+size_t findTailReturns(Recursion* recursion, const uint32_t* uses)
+{
+    assert(recursion != nullptr);
+    assert(uses      != nullptr);
+
+    const IrFunction* function = recursion->function;
+    bool              mixed    = false;
+
+    for (IrValue value = 0; value < function->instructionsCount; value++)
+    {
+        if (INSTRUCTION(value).block == NO_BLOCK || INSTRUCTION(value).opcode != IR_RETURN) { continue; }
+
+        TailReturn tail = {};
+        if (!matchTailReturn(recursion, value, uses, &tail)) { continue; }
+
+        if (tail.operation != NO_VALUE)
+        {
+            IrOpcode opcode = INSTRUCTION(tail.operation).opcode;
+
+            if (recursion->accumulated && recursion->operation != opcode) { mixed = true; }
+
+            recursion->accumulated = true;
+            recursion->operation   = opcode;
+        }
+
+        recursion->returns[recursion->returnsCount++] = tail;
+    }
+
+    if (mixed)
+    {
+        size_t plain = 0;
+        for (size_t i = 0; i < recursion->returnsCount; i++)
+        {
+            if (recursion->returns[i].operation == NO_VALUE) { recursion->returns[plain++] = recursion->returns[i]; }
+        }
+
+        recursion->returnsCount = plain;
+        recursion->accumulated  = false;
+    }
+
+    return recursion->returnsCount;
+}
+
+// 'f(...)', 'a op f(...)' or 'f(...) op a' with op add or mul
+bool matchTailReturn(const Recursion* recursion, IrValue ret, const uint32_t* uses, TailReturn* tail)
+{
+    assert(recursion != nullptr);
+    assert(tail      != nullptr);
+
+    const IrFunction*    function = recursion->function;
+    const IrInstruction* returned = &INSTRUCTION(ret);
+
+    if (returned->operandsCount != 1) { return false; }
+
+    IrValue value = returned->operands[0];
+
+    if (isTailCall(recursion, value, ret, uses))
+    {
+        *tail = { ret, value, NO_VALUE };
+        return true;
+    }
+
+    const IrInstruction* operation = &INSTRUCTION(value);
+
+    if (operation->opcode != IR_ADD && operation->opcode != IR_MUL) { return false; }
+    if (uses[value] != 1 || operation->block != returned->block)   { return false; }
+
+    // The call evaluated last is the one nothing but pure code follows
+    for (size_t i = 2; i > 0; i--)
+    {
+        IrValue call = operation->operands[i - 1];
+
+        if (isTailCall(recursion, call, ret, uses))
+        {
+            *tail = { ret, call, value };
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// Self call with exactly the parameters' arguments, whose value is only
+// returned. Anything after it in the block has to be pure: it goes away with
+// the return or moves before the jump unchanged.
+//------------------------------------------------------------------------------
+bool isTailCall(const Recursion* recursion, IrValue value, IrValue ret, const uint32_t* uses)
+{
+    assert(recursion != nullptr);
+    assert(uses      != nullptr);
+
+    const IrFunction*    function = recursion->function;
+    const IrInstruction* call     = &INSTRUCTION(value);
+
+    if (call->opcode != IR_CALL || call->index != recursion->index) { return false; }
+    if (call->operandsCount != function->symbols->paramsCount)      { return false; }
+    if (uses[value] != 1 || call->block != INSTRUCTION(ret).block)   { return false; }
+
+    const IrBlock* block = &BLOCK(call->block);
+
+    for (size_t i = findInstruction(function, value) + 1; block->code[i] != ret; i++)
+    {
+        if (!isPure(INSTRUCTION(block->code[i]).opcode)) { return false; }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Everything but the parameters and constants moves from the entry to the
+// header, which gets the phis. The entry is left to pop the parameters and
+// fall through into the header.
+//------------------------------------------------------------------------------
+void addHeader(IrProgram* program, Recursion* recursion)
+{
+    assert(program   != nullptr);
+    assert(recursion != nullptr);
+
+    IrFunction* function = recursion->function;
+    IrBlockId   header   = addBlock(program, function, TAIL_CALL_LABEL, recursion->index);
+
+    recursion->header = header;
+    recursion->zero   = NO_VALUE;
+
+    placeBlock(program, function, header, 0);
+
+    size_t position = 0;
+    while (position < BLOCK(0).codeCount)
+    {
+        IrValue  value  = BLOCK(0).code[position];
+        IrOpcode opcode = INSTRUCTION(value).opcode;
+
+        if (opcode == IR_PARAM || opcode == IR_CONST) { position++; continue; }
+
+        moveInstruction(program, function, value, header, BLOCK(header).codeCount);
+    }
+
+    for (size_t i = successorsCount(function, header); i > 0; i--)
+    {
+        IrBlock* target = &BLOCK(successor(function, header, i - 1));
+
+        for (size_t j = 0; j < target->predsCount; j++)
+        {
+            if (target->preds[j] == 0) { target->preds[j] = header; }
+        }
+    }
+
+    IrValue jump = addInstruction(program, function, 0, IR_JUMP);
+    INSTRUCTION(jump).targets[0] = header;
+    addEdge(program, function, 0, header);
+
+    for (size_t i = 0; i < BLOCK(0).codeCount; i++)
+    {
+        IrValue param = BLOCK(0).code[i];
+        if (INSTRUCTION(param).opcode != IR_PARAM) { continue; }
+
+        uint32_t number = INSTRUCTION(param).index;
+        IrValue  phi    = insertInstruction(program, function, header, number, IR_PHI);
+
+        replaceUses (function, param, phi);
+        addOperand  (program, function, phi, param);
+
+        recursion->params[number] = phi;
+    }
+
+    if (recursion->accumulated)
+    {
+        IrValue identity = addEntryConst(program, recursion, recursion->operation == IR_MUL ? 1 : -0.0);
+
+        recursion->accumulator = insertInstruction(program, function, header, function->symbols->paramsCount,
+                                                   IR_PHI);
+        addOperand(program, function, recursion->accumulator, identity);
+    }
+}
+
+// Arguments are the call's operands in evaluation order, the last parameter's first
+void convertTailReturn(IrProgram* program, Recursion* recursion, const TailReturn* tail)
+{
+    assert(program   != nullptr);
+    assert(recursion != nullptr);
+    assert(tail      != nullptr);
+
+    IrFunction* function = recursion->function;
+    IrBlockId   block    = INSTRUCTION(tail->ret).block;
+    size_t      params   = function->symbols->paramsCount;
+
+    const IrValue* arguments = INSTRUCTION(tail->call).operands;
+    IrValue        operand   = NO_VALUE;
+
+    // Read only now, the parameters among the operands have become the header's phis
+    if (tail->operation != NO_VALUE)
+    {
+        const IrValue* operands = INSTRUCTION(tail->operation).operands;
+        operand = (operands[0] == tail->call) ? operands[1] : operands[0];
+    }
+
+    removeInstruction(function, tail->ret);
+    if (tail->operation != NO_VALUE) { removeInstruction(function, tail->operation); }
+    removeInstruction(function, tail->call);
+
+    IrValue accumulator = recursion->accumulator;
+
+    if (tail->operation != NO_VALUE)
+    {
+        accumulator = addInstruction(program, function, block, recursion->operation);
+        addOperand(program, function, accumulator, operand);
+        addOperand(program, function, accumulator, recursion->accumulator);
+    }
+
+    IrValue jump = addInstruction(program, function, block, IR_JUMP);
+    INSTRUCTION(jump).targets[0] = recursion->header;
+    addEdge(program, function, block, recursion->header);
+
+    for (size_t i = 0; i < params; i++)
+    {
+        addOperand(program, function, recursion->params[i], arguments[params - 1 - i]);
+    }
+
+    if (recursion->accumulated)
+    {
+        addOperand(program, function, recursion->accumulator, accumulator);
+    }
+}
+
+// Falling off the end returns 0, which is accumulated all the same
+void accumulateReturn(IrProgram* program, Recursion* recursion, IrValue ret)
+{
+    assert(program   != nullptr);
+    assert(recursion != nullptr);
+
+    IrFunction* function = recursion->function;
+
+    if (INSTRUCTION(ret).operandsCount == 0)
+    {
+        if (recursion->zero == NO_VALUE) { recursion->zero = addEntryConst(program, recursion, 0); }
+
+        addOperand(program, function, ret, recursion->zero);
+    }
+
+    IrValue value = insertInstruction(program, function, INSTRUCTION(ret).block, findInstruction(function, ret),
+                                      recursion->operation);
+    addOperand(program, function, value, INSTRUCTION(ret).operands[0]);
+    addOperand(program, function, value, recursion->accumulator);
+
+    INSTRUCTION(ret).operands[0] = value;
+}
+
+// Before the entry's jump, where it dominates everything
+IrValue addEntryConst(IrProgram* program, Recursion* recursion, double number)
+{
+    assert(program   != nullptr);
+    assert(recursion != nullptr);
+
+    IrFunction* function = recursion->function;
+
+    IrValue value = insertInstruction(program, function, 0, BLOCK(0).codeCount - 1, IR_CONST);
+    INSTRUCTION(value).number = number;
+
+    return value;
+}
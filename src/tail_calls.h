@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ir.h"
+
+//------------------------------------------------------------------------------
+// Self recursion turned into loops on the IR. A function that returns a call
+// of itself doesn't need a new frame for it: the entry's code moves to a
+// TAIL_CALL block with a phi for every parameter, and the return becomes a
+// jump there with the call's arguments as the phis' new operands.
+//
+// When a function also returns 'a + f(...)' or 'a * f(...)' (the same
+// operator everywhere) and nothing but pure code is left after the call, it
+// gets an accumulator phi as well. Such a return adds (multiplies) 'a' into it
+// and jumps, every other return adds the accumulator to its value. As with
+// constant folding, this regroups floating point operations.
+//
+// Functions with riddikulus keep their variables in memory and are left alone.
+//------------------------------------------------------------------------------
+struct TailCallStats
+{
+    size_t tailCalls;   // returns that become jumps, accumulating ones included
+    size_t accumulatedCalls;
+    size_t accumulatedFunctions;
+};
+
+void eliminateTailCalls (IrProgram* program, void* stats);
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include "tokenizer.h"
 #include "../libs/utilib.h"
@@ -9,12 +10,105 @@
                                     assert((tokenizer)->position != nullptr); \
                                     assert((tokenizer)->tokens   != nullptr); 
 
-const size_t MAX_TOKENS_COUNT = 8192;
+const double REALLOC_MULTIPLIER      = 2;
+const size_t DEFAULT_TOKENS_CAPACITY = 8192;
+const size_t MAX_TRIE_NODES          = 512;
+const size_t TRIE_ALPHABET_SIZE      = 256;
+const int    TRIE_NO_NODE            = -1;
+
+//------------------------------------------------------------------------------
+// Keyword trie is built from KEYWORDS at compile time. The root level is a
+// direct table indexed by the first character, deeper levels are kept as
+// sibling lists (they rarely have more than a couple of entries).
+//------------------------------------------------------------------------------
+struct KeywordTrieNode
+{
+    char    symbol;
+    int16_t keyword;     // index in KEYWORDS of the keyword ending here or TRIE_NO_NODE
+    int16_t firstChild;
+    int16_t nextSibling;
+};
+
+struct KeywordTrie
+{
+    int16_t         roots[TRIE_ALPHABET_SIZE];
+    KeywordTrieNode nodes[MAX_TRIE_NODES];
+    size_t          nodesCount;
+};
+
+constexpr int16_t addTrieNode(KeywordTrie* trie, char symbol)
+{
+    assert(trie->nodesCount < MAX_TRIE_NODES);
+
+    trie->nodes[trie->nodesCount] = { symbol, TRIE_NO_NODE, TRIE_NO_NODE, TRIE_NO_NODE };
+
+    return (int16_t) trie->nodesCount++;
+}
+
+constexpr int16_t findTrieChild(const KeywordTrie* trie, int16_t node, char symbol)
+{
+    int16_t child = trie->nodes[node].firstChild;
+
+    while (child != TRIE_NO_NODE && trie->nodes[child].symbol != symbol)
+    {
+        child = trie->nodes[child].nextSibling;
+    }
+
+    return child;
+}
+
+constexpr KeywordTrie buildKeywordTrie()
+{
+    KeywordTrie trie = {};
+
+    for (size_t i = 0; i < TRIE_ALPHABET_SIZE; i++)
+    {
+        trie.roots[i] = TRIE_NO_NODE;
+    }
+
+    for (size_t i = 0; i < KEYWORDS_COUNT; i++)
+    {
+        const char* name  = KEYWORDS[i].name;
+        uint8_t     first = (uint8_t) name[0];
+
+        if (trie.roots[first] == TRIE_NO_NODE)
+        {
+            trie.roots[first] = addTrieNode(&trie, name[0]);
+        }
+
+        int16_t node = trie.roots[first];
+
+        for (size_t j = 1; j < KEYWORDS[i].length; j++)
+        {
+            int16_t child = findTrieChild(&trie, node, name[j]);
+
+            if (child == TRIE_NO_NODE)
+            {
+                child = addTrieNode(&trie, name[j]);
+
+                trie.nodes[child].nextSibling = trie.nodes[node].firstChild;
+                trie.nodes[node].firstChild   = child;
+            }
+
+            node = child;
+        }
+
+        assert(name[KEYWORDS[i].length] == '\0');
+        assert(trie.nodes[node].keyword == TRIE_NO_NODE);
+
+        trie.nodes[node].keyword = (int16_t) i;
+    }
+
+    return trie;
+}
+
+static constexpr KeywordTrie KEYWORD_TRIE = buildKeywordTrie();
 
 bool   finished        (Tokenizer* tokenizer);
 void   skipSpaces      (Tokenizer* tokenizer);
 void   proceed         (Tokenizer* tokenizer, size_t step);
 void   addToken        (Tokenizer* tokenizer, Token token);
+void   reallocTokens   (Tokenizer* tokenizer);
 bool   processKeyword  (Tokenizer* tokenizer);
 bool   isKeywordNumber (Keyword keyword);
 double keywordToNumber (Keyword keyword);
@@ -29,9 +123,10 @@ void construct(Tokenizer* tokenizer, const char* buffer, size_t bufferSize, bool
     tokenizer->bufferSize  = bufferSize;
     tokenizer->position    = buffer;
 
-    tokenizer->tokens      = (Token*) calloc(MAX_TOKENS_COUNT, sizeof(Token));
-    tokenizer->tokensCount = 0;
-    tokenizer->currentLine = 0;
+    tokenizer->tokens         = (Token*) calloc(DEFAULT_TOKENS_CAPACITY, sizeof(Token));
+    tokenizer->tokensCount    = 0;
+    tokenizer->tokensCapacity = DEFAULT_TOKENS_CAPACITY;
+    tokenizer->currentLine    = 0;
 
     tokenizer->useNumericNumbers = useNumericNumbers;
 
@@ -48,9 +143,10 @@ void destroy(Tokenizer* tokenizer)
     tokenizer->bufferSize  = 0;
     tokenizer->position    = nullptr;
 
-    tokenizer->tokens      = nullptr;
-    tokenizer->tokensCount = 0;
-    tokenizer->currentLine = 0;
+    tokenizer->tokens         = nullptr;
+    tokenizer->tokensCount    = 0;
+    tokenizer->tokensCapacity = 0;
+    tokenizer->currentLine    = 0;
 }
 
 bool isNumberType(Token* token)
@@ -81,11 +177,11 @@ bool isNumber(Token* token, double number)
     return isNumberType(token) && dcompare(token->data.number, number) == 0;
 }
 
-bool isId(Token* token, const char* id)
+bool isId(Token* token, SymbolId id)
 {
     assert(token != nullptr);
 
-    return isIdType(token) && strcmp(token->data.id, id) == 0;
+    return isIdType(token) && token->data.id == id;
 }
 
 bool isKeyword(Token* token, KeywordCode keywordCode)
@@ -163,64 +259,100 @@ void addToken(Tokenizer* tokenizer, Token token)
 {
     ASSERT_TOKENIZER(tokenizer);
 
+    // One zeroed token is always kept past the end, the parser peeks at it
+    if (tokenizer->tokensCount + 1 >= tokenizer->tokensCapacity)
+    {
+        reallocTokens(tokenizer);
+    }
+
     tokenizer->tokens[tokenizer->tokensCount++] = token;
 }
 
-bool processKeyword(Tokenizer* tokenizer)
+void reallocTokens(Tokenizer* tokenizer)
 {
     ASSERT_TOKENIZER(tokenizer);
 
-    for (size_t i = 0; i < KEYWORDS_COUNT; i++)
-    {
-        Keyword keyword = KEYWORDS[i];
+    size_t oldCapacity = tokenizer->tokensCapacity;
+
+    tokenizer->tokensCapacity *= REALLOC_MULTIPLIER;
+    tokenizer->tokens = (Token*) realloc(tokenizer->tokens, tokenizer->tokensCapacity * sizeof(Token));
+    assert(tokenizer->tokens != nullptr);
+
+    memset(tokenizer->tokens + oldCapacity, 0, (tokenizer->tokensCapacity - oldCapacity) * sizeof(Token));
+}
 
-        if (tokenizer->position + keyword.length > tokenizer->buffer + tokenizer->bufferSize)
+int matchKeyword(const char* position, const char* end)
+{
+    assert(position != nullptr);
+    assert(end      != nullptr);
+
+    if (position >= end) { return TRIE_NO_NODE; }
+
+    int     keyword = TRIE_NO_NODE;
+    int16_t node    = KEYWORD_TRIE.roots[(uint8_t) *position];
+
+    // Walk as deep as the input allows and remember the last keyword passed,
+    // so that e.g. 'less-equal' wins over its prefix 'less'.
+    for (const char* cur = position + 1; node != TRIE_NO_NODE; cur++)
+    {
+        if (KEYWORD_TRIE.nodes[node].keyword != TRIE_NO_NODE)
         {
-            continue;
+            keyword = KEYWORD_TRIE.nodes[node].keyword;
         }
 
-        if (strncmp(tokenizer->position, keyword.name, keyword.length) == 0)
-        {
-            if (isKeywordNumber(keyword))
-            {
-                addToken(tokenizer, {NUMBER_TOKEN_TYPE, {.number = keywordToNumber(keyword)}, tokenizer->currentLine, tokenizer->position});
-            }
-            else if (keyword.code == COMMENT_KEYWORD)
-            {
-                const char* newLine = strchr(tokenizer->position, '\n');
-
-                addToken(tokenizer, {KEYWORD_TOKEN_TYPE, {.keywordCode = NEW_LINE_KEYWORD}, tokenizer->currentLine, tokenizer->position});
-                    
-                if (newLine != nullptr)
-                {
-                    proceed(tokenizer, newLine - tokenizer->position + 1);
-                } 
-                else
-                {
-                    proceed(tokenizer, tokenizer->bufferSize);
-                }
-
-                tokenizer->currentLine++;
-
-                return true;
-            }
-            else
-            {
-                addToken(tokenizer, {KEYWORD_TOKEN_TYPE, {.keywordCode = keyword.code}, tokenizer->currentLine, tokenizer->position});
-            }
+        if (cur >= end) { break; }
 
-            if (*(tokenizer->position) == '\n')
-            {
-                tokenizer->currentLine++;
-            }
+        node = findTrieChild(&KEYWORD_TRIE, node, *cur);
+    }
+
+    return keyword;
+}
+
+bool processKeyword(Tokenizer* tokenizer)
+{
+    ASSERT_TOKENIZER(tokenizer);
+
+    int index = matchKeyword(tokenizer->position, tokenizer->buffer + tokenizer->bufferSize);
+    if (index == TRIE_NO_NODE) { return false; }
 
-            proceed(tokenizer, keyword.length);
+    Keyword keyword = KEYWORDS[index];
 
-            return true;
+    if (isKeywordNumber(keyword))
+    {
+        addToken(tokenizer, {NUMBER_TOKEN_TYPE, {.number = keywordToNumber(keyword)}, tokenizer->currentLine, tokenizer->position});
+    }
+    else if (keyword.code == COMMENT_KEYWORD)
+    {
+        const char* newLine = strchr(tokenizer->position, '\n');
+
+        addToken(tokenizer, {KEYWORD_TOKEN_TYPE, {.keywordCode = NEW_LINE_KEYWORD}, tokenizer->currentLine, tokenizer->position});
+            
+        if (newLine != nullptr)
+        {
+            proceed(tokenizer, newLine - tokenizer->position + 1);
+        } 
+        else
+        {
+            proceed(tokenizer, tokenizer->bufferSize);
         }
+
+        tokenizer->currentLine++;
+
+        return true;
+    }
+    else
+    {
+        addToken(tokenizer, {KEYWORD_TOKEN_TYPE, {.keywordCode = keyword.code}, tokenizer->currentLine, tokenizer->position});
     }
 
-    return false;
+    if (*(tokenizer->position) == '\n')
+    {
+        tokenizer->currentLine++;
+    }
+
+    proceed(tokenizer, keyword.length);
+
+    return true;
 }
 
 bool isKeywordNumber(Keyword keyword)
@@ -269,7 +401,7 @@ bool processId(Tokenizer* tokenizer)
         return false;
     }
 
-    addToken(tokenizer, {ID_TOKEN_TYPE, {.id = copyString(tokenizer->position, length)}, tokenizer->currentLine, tokenizer->position});
+    addToken(tokenizer, {ID_TOKEN_TYPE, {.id = intern(tokenizer->position, length)}, tokenizer->currentLine, tokenizer->position});
     proceed(tokenizer, length);
 
     return true;
@@ -295,7 +427,7 @@ void dumpTokens(Token* tokens, size_t count)
 
             case ID_TOKEN_TYPE: 
             { 
-                printf("(id) '%s'\n", tokens[i].data.id);
+                printf("(id) %u '%s'\n", tokens[i].data.id, getSymbolName(tokens[i].data.id));
                 break; 
             }
 
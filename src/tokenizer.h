@@ -1,10 +1,11 @@
 #pragma once
 #include "syntax.h"
+#include "interner.h"
 
 union TokenData
 {
     double      number;
-    char*       id;
+    SymbolId    id;
     KeywordCode keywordCode;
 };
 
@@ -33,6 +34,7 @@ struct Tokenizer
 
     Token*      tokens;
     size_t      tokensCount;
+    size_t      tokensCapacity;
     size_t      currentLine;
 };
 
@@ -44,7 +46,7 @@ bool isIdType       (Token* token);
 bool isKeywordType  (Token* token);
 
 bool isNumber       (Token* token, double number);
-bool isId           (Token* token, const char* id);
+bool isId           (Token* token, SymbolId id);
 bool isKeyword      (Token* token, KeywordCode keywordCode);
 
 bool isComparand    (Token* token);
@@ -52,4 +54,5 @@ bool isTerm         (Token* token);
 bool isFactor       (Token* token);
  
 void tokenizeBuffer (Tokenizer* tokenizer);
+int  matchKeyword   (const char* position, const char* end); // index in KEYWORDS of the longest match, -1 if none
 void dumpTokens     (Token* tokens, size_t count);
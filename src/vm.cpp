@@ -0,0 +1,447 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "vm.h"
+
+#define ASSERT_VM(vm) assert((vm)         != nullptr); \
+                      assert((vm)->memory != nullptr);                           \
+                      assert((vm)->stack  != nullptr);
+
+const size_t   DEFAULT_MEMORY_SIZE         = 1 << 20;
+const size_t   DEFAULT_STACK_CAPACITY      = 1 << 16;
+const size_t   DEFAULT_CALL_STACK_CAPACITY = 1 << 16;
+const uint32_t NO_CELL                     = UINT32_MAX;
+
+//------------------------------------------------------------------------------
+// Before running, bytecode is translated to direct threaded code. Every opcode
+// becomes the address of its handler, followed by the already decoded operands,
+// and jump targets become cell pointers. A handler ends by jumping through the
+// next handler address itself, there's no central dispatch switch.
+//------------------------------------------------------------------------------
+union Cell
+{
+    const void* handler;
+    double      number;
+    int64_t     offset;
+    size_t      reg;
+    Cell*       target;
+};
+
+struct ThreadedCode
+{
+    Cell*  cells;
+    Cell** labels;
+    size_t labelsCount;
+};
+
+VmError translate         (const Bytecode* bytecode, const void* const* handlers, ThreadedCode* threaded);
+size_t  operandCellsCount (Opcode opcode);
+
+void construct(VirtualMachine* vm)
+{
+    assert(vm != nullptr);
+
+    vm->memory            = (double*) calloc(DEFAULT_MEMORY_SIZE, sizeof(double));
+    vm->memorySize        = DEFAULT_MEMORY_SIZE;
+    vm->stack             = (double*) calloc(DEFAULT_STACK_CAPACITY, sizeof(double));
+    vm->stackCapacity     = DEFAULT_STACK_CAPACITY;
+    vm->callStackCapacity = DEFAULT_CALL_STACK_CAPACITY;
+    vm->executed          = 0;
+
+    for (size_t i = 0; i <= REGISTERS_COUNT; i++)
+    {
+        vm->registers[i] = 0;
+    }
+
+    assert(vm->memory != nullptr);
+    assert(vm->stack  != nullptr);
+}
+
+void destroy(VirtualMachine* vm)
+{
+    ASSERT_VM(vm);
+
+    free(vm->memory);
+    free(vm->stack);
+
+    vm->memory        = nullptr;
+    vm->memorySize    = 0;
+    vm->stack         = nullptr;
+    vm->stackCapacity = 0;
+}
+
+const char* errorString(VmError error)
+{
+    if (error < VM_ERRORS_COUNT)
+    {
+        return VM_ERROR_STRINGS[error];
+    }
+
+    return "UNDEFINED error";
+}
+
+// Taking label addresses and goto through them are GNU extensions
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+VmError run(VirtualMachine* vm, const Bytecode* bytecode)
+{
+    ASSERT_VM(vm);
+    assert(bytecode != nullptr);
+
+    static const void* const HANDLERS[OPCODES_COUNT] = {
+        &&HLT, &&PUSH_NUMBER, &&PUSH_REG, &&PUSH_MEM, &&POP_REG, &&POP_MEM,
+        &&ADD, &&SUB, &&MUL, &&DIV,
+        &&JMP, &&JE, &&JNE, &&JA, &&JB, &&JAE, &&JBE,
+        &&CALL, &&RET, &&IN, &&OUT, &&FLR, &&SQRT, &&RNDJMP,
+        &&ENTER, &&LEAVE
+    };
+
+    ThreadedCode threaded = {};
+    VmError      status   = translate(bytecode, HANDLERS, &threaded);
+    if (status != VM_NO_ERROR) { return status; }
+
+    Cell** callStack = (Cell**) calloc(vm->callStackCapacity, sizeof(Cell*));
+    assert(callStack != nullptr);
+
+    for (size_t i = 0; i < REGISTERS_COUNT; i++)
+    {
+        vm->registers[i] = 0;
+    }
+
+    double*  registers    = vm->registers;
+    double*  memory       = vm->memory;
+    double   memorySize   = (double) vm->memorySize;
+    double*  stack        = vm->stack;
+    double*  stackEnd     = vm->stack + vm->stackCapacity;
+    Cell**   callStackEnd = callStack + vm->callStackCapacity;
+
+    Cell*    ip           = threaded.cells;
+    double*  sp           = stack;     // first free slot
+    Cell**   csp          = callStack; // first free slot
+    uint64_t executed     = 0;
+
+    #define FAIL(error)        { status = error; goto FINISH; }
+    #define NEXT()             { executed++; goto *(ip++)->handler; }
+    #define REQUIRE_VALUES(n)  if (sp - stack < (n)) FAIL(VM_ERROR_STACK_UNDERFLOW)
+    #define REQUIRE_ROOM()     if (sp == stackEnd)   FAIL(VM_ERROR_STACK_OVERFLOW)
+
+    #define ADDRESS(cell)                                                        \
+        size_t address = 0;                                                      \
+        {                                                                        \
+            double value = registers[(cell)[0].reg] + (double) (cell)[1].offset; \
+            if (!(value >= 0 && value < memorySize))                             \
+                FAIL(VM_ERROR_MEMORY_ACCESS_VIOLATION)                           \
+            address = (size_t) value;                                            \
+        }
+
+    #define BINARY(operator)                                                     \
+        REQUIRE_VALUES(2);                                                       \
+        sp--;                                                                    \
+        sp[-1] = sp[-1] operator sp[0];                                          \
+        NEXT()
+
+    #define JUMP_IF(operator)                                                    \
+        REQUIRE_VALUES(2);                                                       \
+        sp -= 2;                                                                 \
+        ip = (sp[0] operator sp[1]) ? ip->target : ip + 1;                       \
+        NEXT()
+
+    NEXT();
+
+    PUSH_NUMBER:
+        REQUIRE_ROOM();
+        *sp++ = ip->number;
+        ip++;
+        NEXT();
+
+    PUSH_REG:
+        REQUIRE_ROOM();
+        *sp++ = registers[ip->reg];
+        ip++;
+        NEXT();
+
+    PUSH_MEM:
+    {
+        REQUIRE_ROOM();
+        ADDRESS(ip);
+        *sp++ = memory[address];
+        ip += 2;
+        NEXT();
+    }
+
+    POP_REG:
+        REQUIRE_VALUES(1);
+        registers[ip->reg] = *--sp;
+        ip++;
+        NEXT();
+
+    POP_MEM:
+    {
+        REQUIRE_VALUES(1);
+        ADDRESS(ip);
+        memory[address] = *--sp;
+        ip += 2;
+        NEXT();
+    }
+
+    ADD: BINARY(+);
+    SUB: BINARY(-);
+    MUL: BINARY(*);
+    DIV: BINARY(/);
+
+    JMP:
+        ip = ip->target;
+        NEXT();
+
+    JE:  JUMP_IF(==);
+    JNE: JUMP_IF(!=);
+    JA:  JUMP_IF(>);
+    JB:  JUMP_IF(<);
+    JAE: JUMP_IF(>=);
+    JBE: JUMP_IF(<=);
+
+    CALL:
+        if (csp == callStackEnd) FAIL(VM_ERROR_CALL_STACK_OVERFLOW);
+        *csp++ = ip + 1;
+        ip     = ip->target;
+        NEXT();
+
+    RET:
+        if (csp == callStack) { goto FINISH; }
+        ip = *--csp;
+        NEXT();
+
+    // A frame keeps the size of the one before it at [rax] and its own size at [rax+1]
+    ENTER:
+    {
+        double frame = registers[RAX];
+        if (!(frame >= 0 && frame + 1 < memorySize)) FAIL(VM_ERROR_MEMORY_ACCESS_VIOLATION);
+
+        double size = memory[(size_t) frame + 1];
+        double next = frame + size;
+        if (!(next >= 0 && next + 1 < memorySize)) FAIL(VM_ERROR_MEMORY_ACCESS_VIOLATION);
+
+        memory[(size_t) next]     = size;
+        memory[(size_t) next + 1] = (double) ip->offset;
+        registers[RAX]            = next;
+        ip++;
+        NEXT();
+    }
+
+    LEAVE:
+    {
+        double frame = registers[RAX];
+        if (!(frame >= 0 && frame < memorySize)) FAIL(VM_ERROR_MEMORY_ACCESS_VIOLATION);
+
+        registers[RAX] = frame - memory[(size_t) frame];
+        NEXT();
+    }
+
+    IN:
+        REQUIRE_ROOM();
+        if (scanf("%lg", sp) != 1) FAIL(VM_ERROR_INPUT_FAILURE);
+        sp++;
+        NEXT();
+
+    OUT:
+        REQUIRE_VALUES(1);
+        printf("%lg\n", *--sp);
+        NEXT();
+
+    FLR:
+        REQUIRE_VALUES(1);
+        sp[-1] = floor(sp[-1]);
+        NEXT();
+
+    SQRT:
+        REQUIRE_VALUES(1);
+        sp[-1] = sqrt(sp[-1]);
+        NEXT();
+
+    RNDJMP:
+        if (threaded.labelsCount > 0)
+        {
+            ip = threaded.labels[(size_t) rand() % threaded.labelsCount];
+        }
+        NEXT();
+
+    HLT:
+    FINISH:
+        vm->executed = executed;
+
+    #undef FAIL
+    #undef NEXT
+    #undef REQUIRE_VALUES
+    #undef REQUIRE_ROOM
+    #undef ADDRESS
+    #undef BINARY
+    #undef JUMP_IF
+
+    free(callStack);
+    free(threaded.cells);
+    free(threaded.labels);
+
+    return status;
+}
+
+#pragma GCC diagnostic pop
+
+VmError translate(const Bytecode* bytecode, const void* const* handlers, ThreadedCode* threaded)
+{
+    assert(bytecode != nullptr);
+    assert(handlers != nullptr);
+    assert(threaded != nullptr);
+
+    const uint8_t* code = bytecode->code;
+    size_t         size = bytecode->size;
+
+    // Cell index of every instruction start, so that jump targets can be checked and mapped
+    uint32_t* cellIndices = (uint32_t*) malloc((size + 1) * sizeof(uint32_t));
+    assert(cellIndices != nullptr);
+
+    for (size_t i = 0; i <= size; i++)
+    {
+        cellIndices[i] = NO_CELL;
+    }
+
+    size_t cellsCount = 0;
+    for (size_t offset = 0; offset < size; offset += instructionLength((Opcode) code[offset]))
+    {
+        if (code[offset] >= OPCODES_COUNT || offset + instructionLength((Opcode) code[offset]) > size)
+        {
+            free(cellIndices);
+            return VM_ERROR_INVALID_CODE;
+        }
+
+        cellIndices[offset] = (uint32_t) cellsCount;
+        cellsCount += 1 + operandCellsCount((Opcode) code[offset]);
+    }
+
+    // Falling off the end of the code halts
+    cellIndices[size] = (uint32_t) cellsCount;
+    cellsCount++;
+
+    threaded->cells       = (Cell*)  calloc(cellsCount, sizeof(Cell));
+    threaded->labels      = (Cell**) calloc(bytecode->symbolsCount + 1, sizeof(Cell*));
+    threaded->labelsCount = bytecode->symbolsCount;
+
+    assert(threaded->cells  != nullptr);
+    assert(threaded->labels != nullptr);
+
+    VmError status = VM_NO_ERROR;
+    Cell*   cell   = threaded->cells;
+
+    for (size_t offset = 0; offset < size && status == VM_NO_ERROR; offset += instructionLength((Opcode) code[offset]))
+    {
+        Opcode         opcode   = (Opcode) code[offset];
+        const uint8_t* operands = code + offset + 1;
+
+        (cell++)->handler = handlers[opcode];
+
+        switch (opcode)
+        {
+            case OP_PUSH_NUMBER:
+            {
+                (cell++)->number = readDouble(operands);
+                break;
+            }
+
+            case OP_PUSH_REG:
+            case OP_POP_REG:
+            case OP_PUSH_MEM:
+            case OP_POP_MEM:
+            {
+                bool isMemory = opcode == OP_PUSH_MEM || opcode == OP_POP_MEM;
+                if (operands[0] > (isMemory ? NO_REGISTER : REGISTERS_COUNT - 1))
+                {
+                    status = VM_ERROR_INVALID_CODE;
+                    break;
+                }
+
+                (cell++)->reg = operands[0];
+                if (isMemory) { (cell++)->offset = readInt32(operands + 1); }
+                break;
+            }
+
+            case OP_JMP:
+            case OP_JE:
+            case OP_JNE:
+            case OP_JA:
+            case OP_JB:
+            case OP_JAE:
+            case OP_JBE:
+            case OP_CALL:
+            {
+                uint32_t target = readUint32(operands);
+                if (target > size || cellIndices[target] == NO_CELL)
+                {
+                    status = VM_ERROR_INVALID_CODE;
+                    break;
+                }
+
+                (cell++)->target = threaded->cells + cellIndices[target];
+                break;
+            }
+
+            case OP_ENTER:
+            {
+                (cell++)->offset = readUint32(operands);
+                break;
+            }
+
+            default:
+            {
+                break;
+            }
+        }
+    }
+
+    cell->handler = handlers[OP_HLT];
+
+    for (size_t i = 0; i < bytecode->symbolsCount && status == VM_NO_ERROR; i++)
+    {
+        uint32_t label = bytecode->symbols[i].offset;
+        if (label > size || cellIndices[label] == NO_CELL)
+        {
+            status = VM_ERROR_INVALID_CODE;
+            break;
+        }
+
+        threaded->labels[i] = threaded->cells + cellIndices[label];
+    }
+
+    free(cellIndices);
+
+    if (status != VM_NO_ERROR)
+    {
+        free(threaded->cells);
+        free(threaded->labels);
+        *threaded = {};
+    }
+
+    return status;
+}
+
+size_t operandCellsCount(Opcode opcode)
+{
+    switch (opcode)
+    {
+        case OP_PUSH_MEM:
+        case OP_POP_MEM:  { return 2; }
+        case OP_PUSH_NUMBER:
+        case OP_PUSH_REG:
+        case OP_POP_REG:
+        case OP_JMP:
+        case OP_JE:
+        case OP_JNE:
+        case OP_JA:
+        case OP_JB:
+        case OP_JAE:
+        case OP_JBE:
+        case OP_CALL:
+        case OP_ENTER:    { return 1; }
+        default:          { return 0; }
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "bytecode.h"
+
+enum VmError
+{
+    VM_NO_ERROR,
+    VM_ERROR_INVALID_CODE,
+    VM_ERROR_STACK_OVERFLOW,
+    VM_ERROR_STACK_UNDERFLOW,
+    VM_ERROR_CALL_STACK_OVERFLOW,
+    VM_ERROR_MEMORY_ACCESS_VIOLATION,
+    VM_ERROR_INPUT_FAILURE,
+
+    VM_ERRORS_COUNT
+};
+
+static const char* VM_ERROR_STRINGS[VM_ERRORS_COUNT] = {
+    "no error",
+    "invalid opcode or jump target in the code",
+    "value stack overflow",
+    "pop from the empty value stack",
+    "call stack overflow (recursion is too deep)",
+    "memory access out of range",
+    "couldn't read a number from the input"
+};
+
+//------------------------------------------------------------------------------
+// Executes bytecode of the stack CPU. Memory, registers and the stacks hold
+// doubles, an address is the register value truncated to an integer plus the
+// offset. ret with an empty call stack stops the program like hlt does.
+//------------------------------------------------------------------------------
+struct VirtualMachine
+{
+    double*  memory;
+    size_t   memorySize;
+
+    double*  stack;
+    size_t   stackCapacity;
+
+    size_t   callStackCapacity;
+
+    double   registers[REGISTERS_COUNT + 1]; // registers[NO_REGISTER] is always 0
+
+    uint64_t executed; // instructions executed by the last run
+};
+
+void        construct   (VirtualMachine* vm);
+void        destroy     (VirtualMachine* vm);
+const char* errorString (VmError error);
+VmError     run         (VirtualMachine* vm, const Bytecode* bytecode);